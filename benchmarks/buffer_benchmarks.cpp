@@ -0,0 +1,109 @@
+// MessageBuffer and MessageBufferPool microbenchmarks
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "MessageBuffer.h"
+
+namespace {
+
+int maxThreads() {
+    unsigned int cores = std::thread::hardware_concurrency();
+    return cores > 1 ? static_cast<int>(cores) : 2;
+}
+
+// Fill a buffer of the argument's size with 64-byte appends
+void BM_MessageBufferAppend(benchmark::State& state) {
+    const size_t capacity = static_cast<size_t>(state.range(0));
+    std::string chunk(64, 'x');
+    MessageBuffer buffer(capacity);
+
+    for (auto _ : state) {
+        buffer.reset();
+        while (buffer.append(chunk)) {
+        }
+        benchmark::DoNotOptimize(buffer.data());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                            static_cast<int64_t>(capacity / chunk.size() * chunk.size()));
+}
+BENCHMARK(BM_MessageBufferAppend)
+    ->Arg(BufferConfig::SMALL_MESSAGE_SIZE)
+    ->Arg(BufferConfig::MEDIUM_MESSAGE_SIZE)
+    ->Arg(BufferConfig::LARGE_MESSAGE_SIZE);
+
+// Split a full buffer in half, the partial-send path
+void BM_MessageBufferSplitAt(benchmark::State& state) {
+    const size_t capacity = static_cast<size_t>(state.range(0));
+    std::string payload(capacity, 'x');
+    MessageBuffer buffer(capacity);
+
+    for (auto _ : state) {
+        buffer.reset();
+        buffer.append(payload);
+        std::unique_ptr<MessageBuffer> tail = buffer.splitAt(capacity / 2);
+        benchmark::DoNotOptimize(tail.get());
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_MessageBufferSplitAt)
+    ->Arg(BufferConfig::SMALL_MESSAGE_SIZE)
+    ->Arg(BufferConfig::LARGE_MESSAGE_SIZE);
+
+// One buffer at a time: served from the thread's magazine
+void BM_PoolAcquireRelease(benchmark::State& state) {
+    MessageBufferPool& pool = MessageBufferPool::getInstance();
+    const size_t length = static_cast<size_t>(state.range(0));
+
+    for (auto _ : state) {
+        std::unique_ptr<MessageBuffer> buffer = pool.acquire(length);
+        benchmark::DoNotOptimize(buffer.get());
+        pool.release(std::move(buffer));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_PoolAcquireRelease)
+    ->Arg(BufferConfig::SMALL_MESSAGE_SIZE)
+    ->Arg(BufferConfig::LARGE_MESSAGE_SIZE)
+    ->ThreadRange(1, maxThreads());
+
+// Bursts larger than a magazine: every thread goes through the shared depot
+void BM_PoolBurst(benchmark::State& state) {
+    MessageBufferPool& pool = MessageBufferPool::getInstance();
+    const size_t burst = static_cast<size_t>(state.range(0));
+    std::vector<std::unique_ptr<MessageBuffer>> held;
+    held.reserve(burst);
+
+    for (auto _ : state) {
+        for (size_t i = 0; i < burst; ++i) {
+            held.push_back(pool.acquire(BufferConfig::MEDIUM_MESSAGE_SIZE));
+        }
+        for (auto& buffer : held) {
+            pool.release(std::move(buffer));
+        }
+        held.clear();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * burst));
+}
+BENCHMARK(BM_PoolBurst)
+    ->Arg(MessageBufferPool::MAGAZINE_BATCH * 8)
+    ->ThreadRange(1, maxThreads());
+
+// Broadcast references: the capacity-0 shared class
+void BM_PoolAcquireShared(benchmark::State& state) {
+    MessageBufferPool& pool = MessageBufferPool::getInstance();
+    std::string message(256, 'x');
+    struct iovec part = {const_cast<char*>(message.data()), message.size()};
+    std::shared_ptr<const SharedPayload> payload = SharedPayload::create(&part, 1);
+
+    for (auto _ : state) {
+        std::unique_ptr<MessageBuffer> buffer = pool.acquireShared(payload);
+        benchmark::DoNotOptimize(buffer.get());
+        pool.release(std::move(buffer));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_PoolAcquireShared)->ThreadRange(1, maxThreads());
+
+} // namespace
@@ -0,0 +1,114 @@
+// Receive-path framing microbenchmarks: extractMessages() on pipelined input
+#include <benchmark/benchmark.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include "ConnectionHandler.h"
+#include "ConnectionHandlerT.h"
+#include "Framing.h"
+#include "Logger.h"
+
+namespace {
+
+// A pipelined burst of count messages of the given size, framed for mode
+std::string pipelinedInput(FramingMode mode, size_t size, size_t count) {
+    std::string payload(size, 'x');
+    std::string input;
+    for (size_t i = 0; i < count; ++i) {
+        struct iovec parts[Framing::MAX_FRAME_PARTS];
+        char header[Framing::MAX_HEADER_SIZE];
+        size_t parts_count = Framing::frameParts(mode, payload.data(), payload.size(), header, parts);
+        for (size_t j = 0; j < parts_count; ++j) {
+            input.append(static_cast<const char*>(parts[j].iov_base), parts[j].iov_len);
+        }
+    }
+    return input;
+}
+
+// Handler policy for the ConnectionHandlerT runs, the same work as the
+// onMessageView lambda below
+struct CountingHandler {
+    size_t* delivered;
+
+    void operator()(std::string_view message, ConnectionHandler*) {
+        benchmark::DoNotOptimize(message.data());
+        ++*delivered;
+    }
+};
+
+// Feed the burst through handleReceived() as the io_uring backend does; the
+// handler owns one end of a socketpair so close() has a real fd to close.
+// Codec void runs the std::function path, otherwise ConnectionHandlerT.
+template<class Codec>
+void runExtract(benchmark::State& state, FramingMode mode) {
+    Logger::getInstance().setLevel(LogLevel::Warn);
+
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1) {
+        state.SkipWithError("socketpair failed");
+        return;
+    }
+
+    const size_t size = static_cast<size_t>(state.range(0));
+    const size_t count = static_cast<size_t>(state.range(1));
+    std::string input = pipelinedInput(mode, size, count);
+
+    size_t delivered = 0;
+    if constexpr (std::is_void_v<Codec>) {
+        ConnectionHandler handler(fds[0], PeerAddress());
+        handler.setFraming(mode);
+        handler.onMessageView = [&delivered](std::string_view message, ConnectionHandler*) {
+            benchmark::DoNotOptimize(message.data());
+            ++delivered;
+        };
+
+        for (auto _ : state) {
+            handler.handleReceived(input.data(), input.size());
+        }
+    } else {
+        ConnectionHandlerT<Codec, CountingHandler> handler(fds[0], PeerAddress(), CountingHandler{&delivered});
+
+        for (auto _ : state) {
+            handler.handleReceived(input.data(), input.size());
+        }
+    }
+    ::close(fds[1]);
+
+    if (delivered != state.iterations() * count) {
+        state.SkipWithError("messages lost in framing");
+        return;
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(delivered));
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * input.size()));
+}
+
+void BM_ExtractNewline(benchmark::State& state) {
+    runExtract<void>(state, FramingMode::Newline);
+}
+
+void BM_ExtractLength32(benchmark::State& state) {
+    runExtract<void>(state, FramingMode::Length32);
+}
+
+void BM_ExtractVarint(benchmark::State& state) {
+    runExtract<void>(state, FramingMode::Varint);
+}
+
+void BM_ExtractNewlineTyped(benchmark::State& state) {
+    runExtract<NewlineCodec>(state, FramingMode::Newline);
+}
+
+void BM_ExtractLength32Typed(benchmark::State& state) {
+    runExtract<Length32Codec>(state, FramingMode::Length32);
+}
+
+// {message size, messages per read}
+BENCHMARK(BM_ExtractNewline)->Args({64, 1})->Args({64, 16})->Args({64, 256})->Args({1024, 16});
+BENCHMARK(BM_ExtractLength32)->Args({64, 1})->Args({64, 16})->Args({64, 256})->Args({1024, 16});
+BENCHMARK(BM_ExtractVarint)->Args({64, 16})->Args({1024, 16});
+BENCHMARK(BM_ExtractNewlineTyped)->Args({64, 1})->Args({64, 16})->Args({64, 256})->Args({1024, 16});
+BENCHMARK(BM_ExtractLength32Typed)->Args({64, 1})->Args({64, 16})->Args({64, 256})->Args({1024, 16});
+
+} // namespace
@@ -0,0 +1,134 @@
+// MessageQueue microbenchmarks
+#include <benchmark/benchmark.h>
+#include <sys/uio.h>
+#include <climits>
+#include <memory>
+#include <string>
+#include <thread>
+#include "MessageBuffer.h"
+
+namespace {
+
+int maxThreads() {
+    unsigned int cores = std::thread::hardware_concurrency();
+    return cores > 1 ? static_cast<int>(cores) : 2;
+}
+
+// Enqueue then pop one message, the unloaded request/reply path
+void BM_QueueEnqueuePop(benchmark::State& state) {
+    MessageQueue queue;
+    std::string message(static_cast<size_t>(state.range(0)), 'x');
+
+    for (auto _ : state) {
+        queue.enqueue(message);
+        benchmark::DoNotOptimize(queue.front());
+        queue.pop();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * message.size()));
+}
+BENCHMARK(BM_QueueEnqueuePop)->Arg(64)->Arg(1024)->Arg(BufferConfig::MAX_MESSAGE_SIZE);
+
+// Header + payload framing as ConnectionHandler queues it
+void BM_QueueEnqueueParts(benchmark::State& state) {
+    MessageQueue queue;
+    std::string payload(static_cast<size_t>(state.range(0)), 'x');
+    char header[4] = {0, 0, 0, 64};
+    struct iovec parts[2] = {{header, sizeof(header)}, {const_cast<char*>(payload.data()), payload.size()}};
+
+    for (auto _ : state) {
+        queue.enqueue(parts, 2);
+        queue.pop();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_QueueEnqueueParts)->Arg(64)->Arg(1024);
+
+// Fill with a burst of replies, then drain it the way handleWrite() does:
+// gather into iovecs and consume what the socket "accepted"
+void BM_QueueGatherDrain(benchmark::State& state) {
+    MessageQueue queue;
+    const size_t burst = static_cast<size_t>(state.range(0));
+    std::string message(64, 'x');
+    struct iovec iov[IOV_MAX];
+
+    for (auto _ : state) {
+        for (size_t i = 0; i < burst; ++i) {
+            queue.enqueue(message);
+        }
+        while (size_t count = queue.gather(iov, IOV_MAX)) {
+            size_t bytes = 0;
+            for (size_t i = 0; i < count; ++i) {
+                bytes += iov[i].iov_len;
+            }
+            queue.consume(bytes);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * burst));
+}
+BENCHMARK(BM_QueueGatherDrain)->Arg(16)->Arg(256)->Arg(BufferConfig::SEND_QUEUE_CAPACITY);
+
+// Partial sends: the kernel takes a little less than each gathered batch
+void BM_QueuePartialConsume(benchmark::State& state) {
+    MessageQueue queue;
+    std::string message(1024, 'x');
+    struct iovec iov[IOV_MAX];
+
+    for (auto _ : state) {
+        for (size_t i = 0; i < 64; ++i) {
+            queue.enqueue(message);
+        }
+        while (size_t count = queue.gather(iov, IOV_MAX)) {
+            size_t bytes = 0;
+            for (size_t i = 0; i < count; ++i) {
+                bytes += iov[i].iov_len;
+            }
+            queue.consume(bytes > 1000 ? bytes - 1000 : bytes);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * 64));
+}
+BENCHMARK(BM_QueuePartialConsume);
+
+// Many producers into one connection's queue (broadcast, handlers on the
+// scheduler) while thread 0 drains it as the connection's I/O thread
+MessageQueue* shared_queue = nullptr;
+
+void BM_QueueContended(benchmark::State& state) {
+    if (state.thread_index() == 0) {
+        shared_queue = new MessageQueue();
+    }
+    std::string message(64, 'x');
+    struct iovec iov[IOV_MAX];
+    int64_t queued = 0;
+    int64_t full = 0;
+
+    for (auto _ : state) {
+        if (state.thread_index() == 0) {
+            // Consumer
+            if (size_t count = shared_queue->gather(iov, IOV_MAX)) {
+                size_t bytes = 0;
+                for (size_t i = 0; i < count; ++i) {
+                    bytes += iov[i].iov_len;
+                }
+                shared_queue->consume(bytes);
+            }
+        } else if (shared_queue->enqueue(message) == SendStatus::Queued) {
+            ++queued;
+        } else {
+            ++full;
+        }
+    }
+    state.SetItemsProcessed(queued);
+    state.counters["queue_full"] = benchmark::Counter(static_cast<double>(full), benchmark::Counter::kIsRate);
+
+    if (state.thread_index() == 0) {
+        // Producers have stopped once the consumer passes the final barrier
+        shared_queue->clear();
+        delete shared_queue;
+        shared_queue = nullptr;
+    }
+}
+BENCHMARK(BM_QueueContended)->ThreadRange(2, maxThreads())->UseRealTime();
+
+} // namespace
@@ -0,0 +1,99 @@
+#include "../include/NetworkServer.h"
+#include "../include/Coroutine.h"
+#include <chrono>
+#include <csignal>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// Example session coroutines: every connection is one coroutine on its
+// reactor, and waiting for the client, a timer or a slow backend call
+// suspends it instead of blocking a thread.
+//
+//   wait <ms>   reply after a timer
+//   slow <ms>   reply after a blocking "database" call on the scheduler
+//   anything    echoed back
+//   quit        close the connection
+
+namespace {
+
+// Stand-in for a blocking client library
+std::string slowLookup(int milliseconds) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+    return "looked up in " + std::to_string(milliseconds) + " ms";
+}
+
+int parseMilliseconds(std::string_view message, size_t prefix) {
+    try {
+        return std::stoi(std::string(message.substr(prefix)));
+    } catch (const std::exception&) {
+        return 100;
+    }
+}
+
+// A helper coroutine awaited by the session; the view is valid until the
+// session's next read()
+Async<std::string> answer(NetworkServer& server, std::string_view message) {
+    if (message.rfind("wait ", 0) == 0) {
+        int milliseconds = parseMilliseconds(message, 5);
+        co_await sleepFor(std::chrono::milliseconds(milliseconds));
+        co_return "waited " + std::to_string(milliseconds) + " ms";
+    }
+    if (message.rfind("slow ", 0) == 0) {
+        int milliseconds = parseMilliseconds(message, 5);
+        co_return co_await server.offload([milliseconds]() { return slowLookup(milliseconds); });
+    }
+    co_return "echo: " + std::string(message);
+}
+
+Task session(NetworkServer& server, AsyncConnection conn) {
+    conn.send("hello " + conn.getClientInfo().str());
+
+    while (auto message = co_await conn.read()) {
+        if (*message == "quit") {
+            conn.send("bye");
+            conn.close();
+            break;
+        }
+        conn.send(co_await answer(server, *message));
+    }
+}
+
+} // namespace
+
+int main() {
+    // Handle Ctrl+C on a thread of its own; every thread started from here
+    // on, the logger's included, inherits the mask
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    ServerConfig config = readConfig("settings.config");
+    Logger::getInstance().setLevel(config.log_level);
+
+    try {
+        NetworkServer server(config);
+        server.setSessionHandler([&server](AsyncConnection conn) { return session(server, std::move(conn)); });
+
+        if (!server.start()) {
+            std::cerr << "Failed to start server" << std::endl;
+            return 1;
+        }
+        std::cout << "Coroutine session server on port " << config.port << std::endl;
+
+        std::thread signal_thread([&server, signals]() {
+            int signal = 0;
+            sigwait(&signals, &signal);
+            server.stop();
+        });
+        signal_thread.detach();
+        server.run();
+    } catch (const std::exception& e) {
+        std::cerr << "Server error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
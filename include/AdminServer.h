@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+// Minimal HTTP listener for operational endpoints, kept off the data path:
+// it runs on its own thread and port and serves one short request per
+// connection.
+//
+//   GET /metrics   Prometheus text format, produced by the render callback
+class AdminServer {
+public:
+    static constexpr size_t MAX_REQUEST_SIZE = 8192;
+    static constexpr int REQUEST_TIMEOUT_MS = 1000;
+
+    AdminServer(const std::string& address, int port, std::function<std::string()> render_metrics);
+    ~AdminServer();
+
+    AdminServer(const AdminServer&) = delete;
+    AdminServer& operator=(const AdminServer&) = delete;
+
+    bool start();
+    void stop();
+
+private:
+    std::string address_;
+    int port_;
+    std::function<std::string()> render_metrics_;
+    int listen_fd_;
+    int wake_fd_;       // eventfd that ends the accept loop
+    std::atomic<bool> running_;
+    std::thread thread_;
+
+    void run();
+    void serve(int client_fd);
+    static void sendResponse(int client_fd, const char* status, const char* content_type, const std::string& body);
+};
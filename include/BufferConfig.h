@@ -12,17 +12,31 @@ struct BufferConfig {
     static constexpr size_t LARGE_MESSAGE_SIZE = 4096;   // Large data transfers
     static constexpr size_t MAX_MESSAGE_SIZE = 16384;    // Maximum allowed message
     
-    // Pool configuration
+    // Pool configuration: idle buffers retained per size class
     static constexpr size_t SMALL_POOL_SIZE = 100;
     static constexpr size_t MEDIUM_POOL_SIZE = 50;
     static constexpr size_t LARGE_POOL_SIZE = 20;
+    static constexpr size_t SHARED_REF_POOL_SIZE = 1024;  // Broadcast references, no payload
+    
+    // Backpressure: reading from a client pauses once this many bytes wait
+    // in its send queue and resumes when the queue drained to the low mark
+    static constexpr size_t SEND_HIGH_WATERMARK = 256 * 1024;
+    static constexpr size_t SEND_LOW_WATERMARK = 64 * 1024;
+    
+    // Maximum buffers waiting in one connection's send queue (a message
+    // larger than LARGE_MESSAGE_SIZE takes several). Replies of 64 bytes or
+    // more reach the high watermark first; smaller ones pause the client
+    // once fewer than SEND_QUEUE_HEADROOM slots are left, so the replies of
+    // the message being handled still fit.
+    static constexpr size_t SEND_QUEUE_HEADROOM = 256;
+    static constexpr size_t SEND_QUEUE_CAPACITY = SEND_HIGH_WATERMARK / 64 + SEND_QUEUE_HEADROOM;
     
     // Pre-allocation settings
     static constexpr size_t PREALLOCATED_CONNECTIONS = 100;
     static constexpr size_t READ_BUFFER_RESERVE = 8192;
     
     // Memory management
-    static constexpr size_t MAX_TOTAL_MEMORY_MB = 100;  // 100MB limit
+    static constexpr size_t MAX_TOTAL_MEMORY_MB = 100;  // 100MB default limit
     static constexpr size_t CLEANUP_INTERVAL_SECONDS = 30;
 };
 
@@ -35,7 +49,12 @@ public:
     void deallocate(size_t bytes);
     size_t getCurrentUsage() const { return current_usage_.load(); }
     size_t getPeakUsage() const { return peak_usage_.load(); }
+    
+    // Admission control: while the limit is exceeded the server refuses new
+    // connections and queued data, and sheds its slowest readers. 0 disables it.
     bool isMemoryLimitExceeded() const;
+    void setMemoryLimit(size_t bytes) { limit_bytes_.store(bytes); }
+    size_t getMemoryLimit() const { return limit_bytes_.load(); }
     
     void reset();
 
@@ -43,5 +62,5 @@ private:
     MemoryTracker() = default;
     std::atomic<size_t> current_usage_{0};
     std::atomic<size_t> peak_usage_{0};
-    static constexpr size_t MAX_MEMORY_BYTES = BufferConfig::MAX_TOTAL_MEMORY_MB * 1024 * 1024;
+    std::atomic<size_t> limit_bytes_{BufferConfig::MAX_TOTAL_MEMORY_MB * 1024 * 1024};
 };
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <netinet/in.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "ServerConfig.h"
+
+// Node-to-node relay that extends broadcastMessage() and publish() across
+// a cluster of NetworkServer processes.
+//
+// Every node reads the same membership list (cluster_nodes) and knows its
+// own entry (cluster_node_id). It listens for relay links on its entry's
+// port and keeps one persistent outgoing link to every other member. A
+// link only carries what its dialing node published, so a relayed record
+// is delivered locally and never relayed again, and every payload crosses
+// to each peer node exactly once, whatever the number of its clients.
+//
+// Links use length32 framing. The first frame is a hello carrying the
+// sender's node id; every further frame is one record:
+//
+//   'B' payload                            broadcastMessage()
+//   'P' topic length (2 bytes BE) topic payload   publish()
+//
+// Records are appended to the link's send buffer by any thread and written
+// by the relay thread, which drains everything queued since its last write
+// in one send(): no acknowledgements, no per-record syscalls. While a peer
+// is unreachable its records are dropped and counted, and the link is
+// redialed with backoff.
+class ClusterRelay {
+public:
+    static constexpr char HELLO_MAGIC[] = {'\0', 'r', 'e', 'l', 'a', 'y'};
+    static constexpr size_t HELLO_SIZE = sizeof(HELLO_MAGIC) + sizeof(uint32_t);
+    static constexpr char RECORD_BROADCAST = 'B';
+    static constexpr char RECORD_PUBLISH = 'P';
+    static constexpr size_t MAX_TOPIC_SIZE = UINT16_MAX;
+    static constexpr size_t MAX_RECORD_SIZE = 1024 * 1024;      // Larger records are dropped
+    static constexpr size_t SEND_BUFFER_LIMIT = 8 * 1024 * 1024; // Queued bytes per peer, more are dropped
+    static constexpr size_t RECV_CHUNK = 64 * 1024;
+    static constexpr size_t RECV_CHUNKS_PER_ROUND = 16;         // Per link, the rest waits for the next poll
+    static constexpr int RECONNECT_MIN_MS = 100;
+    static constexpr int RECONNECT_MAX_MS = 5000;
+
+    // Relayed records, on the relay thread; topic is empty for broadcasts
+    using Handler = std::function<void(char kind, std::string_view topic, std::string_view payload)>;
+
+    ClusterRelay(int node_id, const std::vector<ClusterMember>& members, Handler handler);
+    ~ClusterRelay();
+
+    ClusterRelay(const ClusterRelay&) = delete;
+    ClusterRelay& operator=(const ClusterRelay&) = delete;
+
+    // Resolve the members, listen on this node's port and start dialing;
+    // false (logged) if this node is not a member or the port is taken
+    bool start();
+    // Close every link; records queued from then on are dropped, so a
+    // draining server can stop it early (hot restart)
+    void stop();
+
+    // Queue one record for every peer. Thread-safe.
+    void broadcast(std::string_view payload);
+    void publish(std::string_view topic, std::string_view payload);
+
+    size_t getPeerCount() const { return peers_.size(); }
+    size_t getConnectedPeerCount() const;
+
+private:
+    // Outgoing link to one member
+    struct Peer {
+        int id = 0;
+        std::string name;               // host:port, for logs
+        struct sockaddr_in address = {};
+        int fd = -1;
+        std::atomic<bool> connected{false};
+        bool connecting = false;        // Non-blocking connect() in flight
+        int backoff_ms = RECONNECT_MIN_MS;
+        std::chrono::steady_clock::time_point next_attempt;
+
+        // Appended by publishers, swapped out by the relay thread
+        std::mutex queue_mutex;
+        std::string queued;
+        size_t queued_records = 0;
+        // Relay thread only: taken from queued, written up to sent
+        std::string sending;
+        size_t sending_records = 0;
+        size_t sent = 0;
+    };
+
+    // Incoming link from a member
+    struct Link {
+        int fd = -1;
+        in_addr_t address = 0;          // Must match the member's
+        int node_id = 0;                // 0 until the hello arrived
+        std::string buffer;
+    };
+
+    int node_id_;
+    std::vector<ClusterMember> members_;
+    Handler handler_;
+    int listen_port_;
+    int listen_fd_;
+    int wake_fd_;       // eventfd for queued records and stop()
+    std::atomic<bool> running_;
+    std::thread thread_;
+    std::vector<std::unique_ptr<Peer>> peers_;
+    std::vector<Link> links_;   // Relay thread only
+
+    void run();
+    void enqueue(const char* header, size_t header_size, std::string_view topic, std::string_view payload);
+    void dial(Peer& peer);
+    void onConnected(Peer& peer);
+    void disconnect(Peer& peer, const char* reason);
+    // Write what is queued; false when the socket buffer is full
+    bool flush(Peer& peer);
+    void acceptLinks();
+    // Read and deliver; false once the link is closed or broken
+    bool readLink(Link& link);
+    bool frameLink(Link& link);
+    bool deliver(Link& link, std::string_view frame);
+};
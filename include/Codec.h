@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "BufferConfig.h"
+#include "Framing.h"
+
+// Compile-time framing policies, one per FramingMode, for the receive loop
+// of ConnectionHandler and ConnectionHandlerT. The mode is a constant, so
+// Framing::decodeHeader() folds down to that mode's branch.
+//
+// MAX_MESSAGE_SIZE bounds one inbound payload; a longer one disconnects the
+// client. A protocol with smaller messages derives its own limit:
+//
+//   struct ControlCodec : Length32Codec {
+//       static constexpr size_t MAX_MESSAGE_SIZE = 512;
+//   };
+
+struct NewlineCodec {
+    static constexpr FramingMode MODE = FramingMode::Newline;
+    static constexpr bool DELIMITED = true;
+    // Lines are only bounded by the read buffer limit
+    static constexpr size_t MAX_MESSAGE_SIZE = SIZE_MAX;
+};
+
+struct Length32Codec {
+    static constexpr FramingMode MODE = FramingMode::Length32;
+    static constexpr bool DELIMITED = false;
+    static constexpr size_t MAX_MESSAGE_SIZE = BufferConfig::MAX_MESSAGE_SIZE;
+};
+
+struct VarintCodec {
+    static constexpr FramingMode MODE = FramingMode::Varint;
+    static constexpr bool DELIMITED = false;
+    static constexpr size_t MAX_MESSAGE_SIZE = BufferConfig::MAX_MESSAGE_SIZE;
+};
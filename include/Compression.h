@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+typedef struct ZSTD_CDict_s ZSTD_CDict;
+
+// Negotiated zstd compression of server-to-client messages on length32
+// listeners.
+//
+// A client opts in with the first frame it sends: HELLO_MAGIC followed by
+// the 4-byte big-endian id of the dictionary it holds (0 for none). The
+// server answers with HELLO_MAGIC and its dictionary id when the ids match,
+// or with DECLINE_MAGIC, before any compressed frame. From then on a frame
+// whose length header has COMPRESSED_FLAG set carries a zstd frame of
+// (length & ~COMPRESSED_FLAG) bytes; frames without it are plain, e.g.
+// messages below the size threshold. Client frames are never compressed.
+//
+// Compression contexts and output buffers are per thread and reused, the
+// dictionary is digested once and shared by every thread.
+class MessageCompressor {
+public:
+    static constexpr uint32_t COMPRESSED_FLAG = 0x80000000u;
+    static constexpr char HELLO_MAGIC[] = {'\0', 'z', 's', 't', 'd'};
+    static constexpr char DECLINE_MAGIC[] = {'\0', 'n', 'o', 'n', 'e'};
+    static constexpr size_t MAGIC_SIZE = sizeof(HELLO_MAGIC);
+    static constexpr size_t HELLO_SIZE = MAGIC_SIZE + sizeof(uint32_t);
+
+    MessageCompressor();
+    ~MessageCompressor();
+
+    MessageCompressor(const MessageCompressor&) = delete;
+    MessageCompressor& operator=(const MessageCompressor&) = delete;
+
+    // Load the dictionary (zstd --train output, empty for none); false
+    // (logged) on a read error or when built without zstd
+    bool init(int level, const std::string& dictionary_file, size_t min_size);
+
+    uint32_t getDictionaryId() const { return dictionary_id_; }
+    size_t getMinSize() const { return min_size_; }
+
+    // Compress into the calling thread's buffer, valid until its next call.
+    // False when length is below the threshold or nothing would be saved.
+    bool compress(const char* data, size_t length, std::string_view& out) const;
+
+    // Whether a client's first frame is a hello, and the dictionary it names
+    static bool parseHello(std::string_view frame, uint32_t& dictionary_id);
+    // Server answers, out holds HELLO_SIZE bytes; return their length
+    size_t encodeAccept(char* out) const;
+    static size_t encodeDecline(char* out);
+
+private:
+    int level_;
+    size_t min_size_;
+    uint32_t dictionary_id_;
+    std::vector<char> dictionary_;
+    ZSTD_CDict* cdict_;
+};
@@ -1,32 +1,130 @@
 #pragma once
 
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <climits>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <string>
+#include <string_view>
 #include <memory>
 #include <functional>
 #include <queue>
 #include <mutex>
 #include <chrono>
+#include <atomic>
+#include <vector>
 #include "MessageBuffer.h"
+#include "ConnectionWorker.h"
+#include "Framing.h"
+#include "TimerWheel.h"
+#include "PeerAddress.h"
 
+class TlsSession;
+class MessageCompressor;
+class TrafficCapture;
+
+// Every complete message framed from one read, in arrival order. The views
+// point into the receive buffer and are only valid for the duration of the
+// callback that receives the batch.
+struct MessageBatch {
+    const std::string_view* messages;
+    size_t count;
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const std::string_view& operator[](size_t index) const { return messages[index]; }
+    const std::string_view* begin() const { return messages; }
+    const std::string_view* end() const { return messages + count; }
+};
+
+// One client connection: receive framing, message dispatch, the send queue
+// and timeouts. The framing loop is a template over the codec (Codec.h);
+// this class picks it by the listener's FramingMode and hands messages to
+// the std::function callbacks below. ConnectionHandlerT (ConnectionHandlerT.h)
+// compiles it for one codec and handler type instead.
 class ConnectionHandler {
 public:
-    ConnectionHandler(int client_fd, const std::string& client_ip, int client_port);
-    ~ConnectionHandler();
+    ConnectionHandler(int client_fd, const PeerAddress& peer);
+    virtual ~ConnectionHandler();
     
     // Main handling methods
     void handleRead();
     void handleWrite();
     void processMessages();
     
-    // Message handling - optimized for memory efficiency
-    void sendMessage(const std::string& message);
-    void sendMessage(const char* data, size_t length);
-    void sendMessage(const MessageBuffer& buffer);
+    // Completion-based I/O (io_uring): the backend does the syscalls and
+    // reports the results here, on the connection's I/O thread.
+    // handleReceived() is false when a paused connection has no room for
+    // the bytes; the backend keeps them and offers them again, in order,
+    // once onReadResumed() is called.
+    bool handleReceived(const char* data, size_t length);
+    void handleReceiveError(int error);                     // 0 = orderly shutdown
+    size_t prepareSend(struct iovec* iov, size_t max_count); // Gather queued data
+    void handleSent(ssize_t result);                        // Bytes sent or -errno
+    
+    // Message handling - optimized for memory efficiency. Nothing is queued
+    // unless SendStatus::Queued is returned.
+    SendStatus sendMessage(const std::string& message);
+    SendStatus sendMessage(const char* data, size_t length);
+    SendStatus sendMessage(const MessageBuffer& buffer);
+    // Queue pre-framed bytes shared with other connections (broadcast)
+    SendStatus sendMessage(std::shared_ptr<const SharedPayload> payload);
     bool hasMessagesToSend() const;
+    size_t getQueuedBytes() const { return send_queue_.bytes(); }
+    // Ask the connection's I/O thread to write what is queued. Thread-safe.
+    void requestFlush();
+    // The last handleWrite() left data queued because the socket was full;
+    // during a TLS handshake, its last flight is waiting for the socket
+    bool isWriteBlocked() const { return write_blocked_; }
+    
+    // Tick flushing: replies wait for the reactor's next flush tick instead
+    // of being written as they are queued, unless threshold bytes pile up.
+    // requestFlush() and the writes after a read honour isFlushDue().
+    void setDeferredFlush(size_t threshold) { deferred_flush_ = true; setFlushThreshold(threshold); }
+    // Any thread, for a configuration reload
+    void setFlushThreshold(size_t threshold) { flush_threshold_.store(threshold, std::memory_order_relaxed); }
+    bool isFlushDue() const {
+        return !deferred_flush_ || send_queue_.bytes() >= flush_threshold_.load(std::memory_order_relaxed);
+    }
+    
+    // Whether the epoll backend currently watches the socket for EPOLLOUT;
+    // only touched on the connection's I/O thread
+    bool isWriteWatched() const { return write_watched_; }
+    void setWriteWatched(bool watched) { write_watched_ = watched; }
+    
+    // TLS listeners: the handshake runs on the I/O thread before anything
+    // is read or written, then the kernel carries the encryption (kTLS).
+    // Replies queued meanwhile are sent once it completes.
+    void startTls(std::unique_ptr<TlsSession> session);
+    bool isHandshaking() const { return tls_ != nullptr; }
+    // Advance the handshake; on failure the connection is disconnected
+    void continueHandshake();
+    
+    // Compression (see MessageCompressor): offered on length32 listeners and
+    // switched on when the client's first frame asks for it. Any thread may
+    // check isCompressing() to pick a broadcast's compressed form.
+    void setCompressor(const MessageCompressor* compressor) {
+        compressor_ = compressor;
+        hello_pending_ = compressor != nullptr;
+    }
+    bool isCompressing() const { return compressing_.load(std::memory_order_acquire); }
+    
+    // Traffic capture (see TrafficCapture): every inbound message is
+    // recorded before it is dispatched. Set after the framing.
+    void setCapture(TrafficCapture* capture);
+    
+    // Backpressure: reading and framing pause once high bytes wait in the
+    // send queue, or once it is within SEND_QUEUE_HEADROOM buffers of its
+    // capacity, and resume when it drained to low; high 0 disables it.
+    // Framing checks after every message, so one read of pipelined
+    // requests cannot queue more replies than the queue holds. Any thread.
+    void setSendWatermarks(size_t high, size_t low) {
+        send_high_watermark_.store(high, std::memory_order_relaxed);
+        send_low_watermark_.store(low, std::memory_order_relaxed);
+    }
+    bool isReadPaused() const { return read_paused_; }
     
     // Connection management
     bool isConnected() const;
@@ -35,34 +133,176 @@ public:
     
     // Getters
     int getClientFd() const { return client_fd_; }
-    std::string getClientInfo() const;
-    std::chrono::steady_clock::time_point getLastActivity() const { return last_activity_; }
+    // "ip:port", formatted on demand into a stack buffer
+    PeerAddress::Text getClientInfo() const { return peer_.toText(); }
+    const PeerAddress& getPeerAddress() const { return peer_; }
+    std::chrono::steady_clock::time_point getLastActivity() const { return toTimePoint(last_activity_.load()); }
+    std::chrono::steady_clock::time_point getLastRead() const { return toTimePoint(last_read_.load()); }
+    // Last byte sent, or when the send queue last became non-empty
+    std::chrono::steady_clock::time_point getLastWrite() const { return toTimePoint(last_write_.load()); }
+    
+    // UDP side channel (see UdpTransport): the token the client prefixes its
+    // datagrams with, and the address the latest one came from
+    uint64_t getDatagramToken() const { return datagram_token_; }
+    void setDatagramToken(uint64_t token) { datagram_token_ = token; }
+    bool getDatagramPeer(PeerAddress& peer) const;  // false until a datagram arrived
+    void setDatagramPeer(const PeerAddress& peer);  // Any thread
+    
+    // Entry in the owning reactor's timer wheel, touched only by that reactor
+    TimerNode<ConnectionHandler>& getTimerNode() { return timer_node_; }
+    
+    // Wire framing for both directions, set by the accepting listener
+    FramingMode getFraming() const { return framing_; }
+    void setFraming(FramingMode framing) { framing_ = framing; }
+    
+    // Worker that owns this connection's I/O (nullptr when handled inline)
+    ConnectionWorker* getWorker() const { return worker_; }
+    void setWorker(ConnectionWorker* worker) { worker_ = worker; }
     
     // Message processing callback
     std::function<void(const std::string&, ConnectionHandler*)> onMessageReceived;
+    
+    // Zero-copy variant, preferred when set. The view points straight into
+    // the receive buffer and is only valid for the duration of the call.
+    std::function<void(std::string_view, ConnectionHandler*)> onMessageView;
+    
+    // Batched variant, preferred over both: called once per read with every
+    // message it completed instead of once per message
+    std::function<void(MessageBatch, ConnectionHandler*)> onMessageBatch;
+    
+    // Called once by the owning worker when the connection is no longer usable
+    std::function<void(ConnectionHandler*)> onClosed;
+    
+    // Wakes the reactor for requestFlush() on connections handled inline
+    std::function<void(ConnectionHandler*)> onFlushRequested;
+    
+    // Called on the I/O thread when isWriteBlocked() changes
+    std::function<void(ConnectionHandler*)> onWriteBlockedChanged;
+    
+    // Called on the I/O thread when a paused connection may read again
+    std::function<void(ConnectionHandler*)> onReadResumed;
+
+protected:
+    // Frame the read buffer with Codec and pass every message to
+    // sink(std::string_view), except a compression hello. Instantiated per
+    // codec and sink, defined in ConnectionHandlerT.h.
+    template<class Codec, class Sink>
+    void frameMessages(Sink&& sink);
+    // Bookkeeping for every message before its handler runs: counters and
+    // capture, then the read-to-handler latency. Inline, ConnectionHandlerT.h.
+    void noteMessage(std::string_view message);
+    void noteHandlerLatency();
+    // Called once the read buffer holds new bytes; one virtual call per read
+    virtual void extractMessages();
+    // Checked by the framing loop after each message (see setSendWatermarks)
+    bool isSendBacklogged() const {
+        size_t high = send_high_watermark_.load(std::memory_order_relaxed);
+        return high > 0 &&
+               (send_queue_.bytes() >= high ||
+                send_queue_.size() + BufferConfig::SEND_QUEUE_HEADROOM >= send_queue_.capacity());
+    }
+    void pauseReading();
 
 private:
+    friend class ConnectionWorker;
+    
+    // Hot fields first: fd, state, scheduling and the send queue head share
+    // the first cache line that event dispatch touches
     int client_fd_;
-    std::string client_ip_;
-    int client_port_;
     bool connected_;
-    std::chrono::steady_clock::time_point last_activity_;
+    bool socket_open_;
+    bool close_requested_;
+    bool write_blocked_;
+    bool write_watched_;
+    bool read_paused_;
+    bool deferred_flush_;
+    FramingMode framing_;       // Wire framing for both directions
     
-    // Message buffers - using memory pool to avoid fragmentation
-    std::string read_buffer_;
+    // Scheduling state, see ConnectionWorker
+    ConnectionWorker* worker_;
+    std::atomic<uint32_t> pending_events_;
+    ReadyLink ready_link_;
     MessageQueue send_queue_;
     
-    // Pre-allocated buffer for common operations
-    std::unique_ptr<MessageBuffer> temp_buffer_;
+    PeerAddress peer_;
+    
+    // Set while the TLS handshake is in progress, I/O thread only
+    std::unique_ptr<TlsSession> tls_;
+    
+    // Offered compression, and whether the client accepted it; the first
+    // frame is checked for a hello only once
+    const MessageCompressor* compressor_;
+    std::atomic<bool> compressing_;
+    bool hello_pending_;
+    
+    // Capture this connection's messages go to, nullptr when off
+    TrafficCapture* capture_;
+    uint32_t capture_connection_;
+    
+    // Datagram endpoint packed as valid bit | IPv4 address | port, 0 = none
+    uint64_t datagram_token_;
+    std::atomic<uint64_t> datagram_peer_;
+    
+    // steady_clock ticks, written by the I/O thread and read by the
+    // reactor's timer wheel
+    std::atomic<std::chrono::steady_clock::rep> last_activity_;
+    std::atomic<std::chrono::steady_clock::rep> last_read_;
+    std::atomic<std::chrono::steady_clock::rep> last_write_;
+    // When the send queue last became non-empty, 0 once its flush was measured
+    std::atomic<std::chrono::steady_clock::rep> queued_since_;
+    // Read time of the bytes being framed, I/O thread only
+    std::chrono::steady_clock::rep dispatch_read_time_;
+    TimerNode<ConnectionHandler> timer_node_;
+    
+    // Reloadable while the connection runs, see NetworkServer::reloadConfig()
+    std::atomic<size_t> send_high_watermark_;
+    std::atomic<size_t> send_low_watermark_;
+    std::atomic<size_t> flush_threshold_;
+    
+    // Message buffers - using memory pool to avoid fragmentation
+    ReadBuffer read_buffer_;
+    size_t scan_offset_;        // Bytes of the pending message already searched for a delimiter
+    
+    // Length-prefixed framing state, the header is decoded once per frame
+    bool frame_header_ready_;
+    size_t frame_header_size_;
+    size_t frame_payload_length_;
+    
+    // Messages collected for onMessageBatch, views into read_buffer_;
+    // the vector keeps its capacity across reads
+    std::vector<std::string_view> batch_;
     
     // Message framing
-    static const size_t MAX_MESSAGE_SIZE = 4096;
-    static const char MESSAGE_DELIMITER = '\n';
+    static constexpr size_t MAX_MESSAGE_SIZE = 4096;
+    static constexpr size_t READ_BUFFER_LIMIT = MAX_MESSAGE_SIZE * 10;
+    static constexpr size_t RECV_CHUNK_SIZE = 4096;
+    static constexpr size_t MAX_WRITE_BATCH = IOV_MAX;     // iovecs per sendmsg()
+    static constexpr char MESSAGE_DELIMITER = Framing::DELIMITER;
+    // onMessageBatch is called early once this many messages are collected,
+    // so the framing loop sees their replies well within the headroom
+    static constexpr size_t MAX_BATCH_MESSAGES = BufferConfig::SEND_QUEUE_HEADROOM / 2;
     
     // Helper methods
-    void updateActivity();
+    void noteReceived();
+    void noteSent(size_t bytes);
+    void setWriteBlocked(bool blocked);
+    void updateReadPause();
+    void resumeFraming();
+    void updateActivity(std::chrono::steady_clock::rep now);
+    void noteQueued(bool was_empty);
+    void markRead();
+    static uint64_t elapsedNanoseconds(std::chrono::steady_clock::rep since, std::chrono::steady_clock::rep now);
+    static std::chrono::steady_clock::time_point toTimePoint(std::chrono::steady_clock::rep ticks) {
+        return std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(ticks));
+    }
     void processIncomingData();
-    void extractMessages();
+    // Disconnect for a frame the codec refuses (cold path)
+    void rejectFrame(const char* reason);
+    SendStatus queueFramed(const char* data, size_t length);
+    void dispatchMessage(std::string_view message);
+    // First frame on a compression listener: true if it was a hello
+    bool negotiateCompression(std::string_view frame);
+    void deliverBatch();
     void handleDisconnection();
     std::string formatMessage(const std::string& message);
 };
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include "Codec.h"
+#include "ConnectionHandler.h"
+#include "Metrics.h"
+#include "TrafficCapture.h"
+
+// A connection whose receive path is compiled for one codec and one handler
+// type. Handler is called as handler(std::string_view, ConnectionHandler*)
+// straight from the framing loop, so the codec's branches and the call are
+// resolved at compile time and the handler can be inlined into the loop:
+// no std::function per message, no dispatch on the framing mode. Reading,
+// sending, timeouts, TLS, compression and capture are ConnectionHandler's.
+//
+// Each connection owns its Handler, so it may keep per-connection state.
+// NetworkServer::setTypedMessageHandler() creates these for every listener;
+// the batch, view and session callbacks are not used for them.
+template<class Codec, class Handler>
+class ConnectionHandlerT final : public ConnectionHandler {
+public:
+    static_assert(std::is_invocable_v<Handler&, std::string_view, ConnectionHandler*>,
+                  "Handler must be callable as handler(std::string_view, ConnectionHandler*)");
+
+    static constexpr FramingMode FRAMING = Codec::MODE;
+    static constexpr size_t MAX_MESSAGE_SIZE = Codec::MAX_MESSAGE_SIZE;
+
+    ConnectionHandlerT(int client_fd, const PeerAddress& peer, Handler handler)
+        : ConnectionHandler(client_fd, peer), handler_(std::move(handler)) {
+        setFraming(Codec::MODE);
+    }
+
+    Handler& getHandler() { return handler_; }
+    const Handler& getHandler() const { return handler_; }
+
+protected:
+    void extractMessages() override {
+        frameMessages<Codec>([this](std::string_view message) {
+            noteMessage(message);
+            noteHandlerLatency();
+            handler_(message, static_cast<ConnectionHandler*>(this));
+        });
+    }
+
+private:
+    Handler handler_;
+};
+
+inline void ConnectionHandler::noteMessage(std::string_view message) {
+    Metrics::add(Counter::MessagesReceived);
+    if (capture_) {
+        capture_->recordMessage(capture_connection_, framing_, message, dispatch_read_time_);
+    }
+}
+
+inline void ConnectionHandler::noteHandlerLatency() {
+    if (Metrics::getInstance().isEnabled()) {
+        // Includes the handlers of earlier messages from the same read
+        auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+        Metrics::record(Histogram::ReadToHandler, elapsedNanoseconds(dispatch_read_time_, now));
+    }
+}
+
+template<class Codec, class Sink>
+void ConnectionHandler::frameMessages(Sink&& sink) {
+    if constexpr (Codec::DELIMITED) {
+        // Frame in place: each message is a view into the read buffer and the
+        // consumed prefix is reclaimed lazily, so pipelined input is O(n)
+        while (connected_ && !read_paused_ && read_buffer_.readable() > scan_offset_) {
+            const char* begin = read_buffer_.readPtr();
+            size_t available = read_buffer_.readable();
+
+            const void* found = std::memchr(begin + scan_offset_, MESSAGE_DELIMITER, available - scan_offset_);
+            if (!found) {
+                if constexpr (Codec::MAX_MESSAGE_SIZE < SIZE_MAX) {
+                    if (available > Codec::MAX_MESSAGE_SIZE) {
+                        rejectFrame("too large");
+                        return;
+                    }
+                }
+                // Remember how far we searched so the partial message is not rescanned
+                scan_offset_ = available;
+                break;
+            }
+
+            size_t length = static_cast<const char*>(found) - begin;
+            scan_offset_ = 0;
+
+            // Skip empty messages
+            if (length > 0) {
+                if constexpr (Codec::MAX_MESSAGE_SIZE < SIZE_MAX) {
+                    if (length > Codec::MAX_MESSAGE_SIZE) {
+                        rejectFrame("too large");
+                        return;
+                    }
+                }
+                sink(std::string_view(begin, length));
+            }
+
+            read_buffer_.consume(length + 1); // Remove message and delimiter
+            
+            // The rest waits in the read buffer until the replies drained
+            if (length > 0 && isSendBacklogged()) {
+                pauseReading();
+                break;
+            }
+        }
+    } else {
+        // Boundaries come from the header, the payload is never scanned
+        while (connected_ && !read_paused_) {
+            if (!frame_header_ready_) {
+                size_t header_size = 0;
+                size_t payload_length = 0;
+                Framing::HeaderStatus status = Framing::decodeHeader(
+                    Codec::MODE, read_buffer_.readPtr(), read_buffer_.readable(), header_size, payload_length);
+
+                if (status == Framing::HeaderStatus::NeedMore) {
+                    break;
+                }
+
+                // Reject oversized frames before reading their payload
+                if (status == Framing::HeaderStatus::Invalid || payload_length > Codec::MAX_MESSAGE_SIZE) {
+                    rejectFrame(status == Framing::HeaderStatus::Invalid ? "invalid header" : "too large");
+                    return;
+                }
+
+                frame_header_size_ = header_size;
+                frame_payload_length_ = payload_length;
+                frame_header_ready_ = true;
+
+                // Reserve exactly what the rest of the frame needs
+                size_t frame_size = header_size + payload_length;
+                if (read_buffer_.readable() < frame_size) {
+                    // Growing may move the buffer under the collected views
+                    deliverBatch();
+                    read_buffer_.ensureWritable(frame_size - read_buffer_.readable());
+                }
+            }
+
+            size_t frame_size = frame_header_size_ + frame_payload_length_;
+            if (read_buffer_.readable() < frame_size) {
+                break;
+            }
+
+            std::string_view frame(read_buffer_.readPtr() + frame_header_size_, frame_payload_length_);
+            if (!hello_pending_ || !negotiateCompression(frame)) {
+                sink(frame);
+            }
+            read_buffer_.consume(frame_size);
+            frame_header_ready_ = false;
+            
+            if (isSendBacklogged()) {
+                pauseReading();
+                break;
+            }
+        }
+    }
+}
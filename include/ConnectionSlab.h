@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "ConnectionHandler.h"
+
+// Generation-tagged reference to a slab slot, stored in epoll_event.data.u64:
+// generation in the high 32 bits, slot index in the low 32 bits. Generation 0
+// is never issued, so tokens below 2^32 are free to name plain descriptors
+// (listeners, eventfd).
+using ConnectionHandle = uint64_t;
+
+// Dense table of one reactor's connections.
+//
+// Slots are preallocated, reused LIFO through a free list and grown on
+// demand up to a fixed limit. Resolving a handle is an array index plus a
+// generation compare; the generation is bumped whenever a slot is released,
+// so events still queued for a closed connection, or for an fd that has
+// since been reused, resolve to nothing. An fd index serves lookups by
+// descriptor. Not thread-safe: the owning reactor serializes access.
+class ConnectionSlab {
+public:
+    static constexpr ConnectionHandle INVALID_HANDLE = 0;
+
+    ConnectionSlab(size_t initial_slots, size_t max_slots);
+    ~ConnectionSlab();
+
+    ConnectionSlab(const ConnectionSlab&) = delete;
+    ConnectionSlab& operator=(const ConnectionSlab&) = delete;
+
+    // Take ownership of handler; INVALID_HANDLE (handler destroyed) when full
+    ConnectionHandle insert(std::unique_ptr<ConnectionHandler> handler);
+    // Give up ownership; the handle and its fd mapping become invalid
+    std::unique_ptr<ConnectionHandler> release(ConnectionHandle handle);
+    void clear();
+
+    // nullptr for stale or invalid handles
+    ConnectionHandler* get(ConnectionHandle handle) const {
+        size_t index = static_cast<uint32_t>(handle);
+        if (index >= slots_.size()) {
+            return nullptr;
+        }
+        const Slot& slot = slots_[index];
+        return slot.generation == static_cast<uint32_t>(handle >> 32) ? slot.handler.get() : nullptr;
+    }
+
+    // Handle of the connection on fd, INVALID_HANDLE if it is not in this slab
+    ConnectionHandle find(int fd) const {
+        if (fd < 0 || static_cast<size_t>(fd) >= fd_slots_.size() || fd_slots_[fd] == NO_SLOT) {
+            return INVALID_HANDLE;
+        }
+        return makeHandle(fd_slots_[fd]);
+    }
+
+    // Calls f(handle, handler) for every connection, in slot order; f must
+    // not insert or release
+    template<class F>
+    void forEach(F&& f) const {
+        for (size_t i = 0; i < slots_.size(); ++i) {
+            if (slots_[i].handler) {
+                f(makeHandle(static_cast<uint32_t>(i)), slots_[i].handler.get());
+            }
+        }
+    }
+
+    size_t size() const { return size_; }
+    size_t capacity() const { return slots_.size(); }
+    size_t maxSize() const { return max_slots_; }
+    bool empty() const { return size_ == 0; }
+
+    static bool isConnection(uint64_t token) { return (token >> 32) != 0; }
+
+private:
+    static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+    // Everything event dispatch reads sits in one cache line
+    struct Slot {
+        uint32_t generation = 1;
+        int fd = -1;
+        std::unique_ptr<ConnectionHandler> handler;     // nullptr while free
+        uint32_t next_free = NO_SLOT;
+    };
+
+    std::vector<Slot> slots_;
+    std::vector<uint32_t> fd_slots_;    // fd -> slot index, NO_SLOT if not ours
+    uint32_t free_head_;
+    size_t size_;
+    size_t max_slots_;
+
+    ConnectionHandle makeHandle(uint32_t index) const {
+        return (static_cast<uint64_t>(slots_[index].generation) << 32) | index;
+    }
+    bool grow();
+};
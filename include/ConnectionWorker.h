@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include "IntrusiveQueue.h"
+
+class ConnectionHandler;
+
+// Intrusive link embedded in every ConnectionHandler so that it can be
+// queued on its worker without any allocation
+using ReadyLink = MPSCLink<ConnectionHandler>;
+
+// Worker thread that owns a fixed subset of connections.
+//
+// Every connection is pinned to exactly one worker for its whole life, so
+// handleRead()/handleWrite() for a connection never run concurrently and
+// its buffers stay in one core's cache. The reactor posts event bits to the
+// connection; only the transition from "idle" to "scheduled" pushes the
+// connection onto the worker's intrusive MPSC queue, which makes posting
+// allocation free and bounds the queue by the number of connections.
+class ConnectionWorker {
+public:
+    // Event bits accumulated in ConnectionHandler::pending_events_
+    static constexpr uint32_t EVENT_READ = 1u << 0;
+    static constexpr uint32_t EVENT_WRITE = 1u << 1;
+    static constexpr uint32_t EVENT_CLOSE = 1u << 2;     // Peer hung up or socket error
+    static constexpr uint32_t EVENT_DESTROY = 1u << 3;   // Reactor released ownership
+    static constexpr uint32_t EVENT_SCHEDULED = 1u << 31;
+
+    // cpu >= 0 pins the worker thread to that CPU
+    explicit ConnectionWorker(int id, int cpu = -1);
+    ~ConnectionWorker();
+
+    ConnectionWorker(const ConnectionWorker&) = delete;
+    ConnectionWorker& operator=(const ConnectionWorker&) = delete;
+
+    void start();
+    void stop();
+
+    // Deliver events to a connection owned by this worker. Thread-safe.
+    void post(ConnectionHandler* handler, uint32_t events);
+
+    int getId() const { return id_; }
+
+private:
+    int id_;
+    int cpu_;
+    std::thread thread_;
+    std::atomic<bool> running_;
+
+    // Connections with pending events, consumed only by this worker
+    IntrusiveMPSCQueue<ConnectionHandler> ready_;
+
+    // Sleep/wake when the queue is empty
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    std::atomic<bool> sleeping_;
+
+    void run();
+    void process(ConnectionHandler* handler);
+    void drain();
+};
@@ -0,0 +1,367 @@
+#pragma once
+
+// C++20 coroutine API for message handlers, built with -DENABLE_COROUTINES=ON.
+//
+// A session coroutine runs on the reactor that owns its connection and
+// suspends instead of blocking: on the next client message, on a timer, or
+// on a Completion fulfilled by another thread. Thousands of such sessions
+// share the reactor threads, and their frames come from the reactor's
+// CoroutineArena rather than the general heap.
+#ifdef HAVE_COROUTINES
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "ConnectionSlab.h"
+#include "MessageBuffer.h"
+#include "PeerAddress.h"
+#include "TimerWheel.h"
+
+class Reactor;
+
+// Size-classed free lists for coroutine frames, one per reactor.
+// Frames are created and destroyed on the reactor's thread only (every
+// awaitable below resumes there), so the arena takes no lock. Freed frames
+// are kept for reuse; steady-state request handling allocates nothing.
+// The arena also tracks the detached Task frames still alive so that a
+// stopping reactor can destroy the suspended ones.
+class CoroutineArena {
+public:
+    static constexpr size_t GRANULE = 64;
+    static constexpr size_t CLASS_COUNT = 64;   // Frames up to 4KB are pooled
+
+    // Link in the list of live root frames
+    struct RootLink {
+        RootLink* prev = nullptr;
+        RootLink* next = nullptr;
+        std::coroutine_handle<> handle;
+    };
+
+    CoroutineArena();
+    ~CoroutineArena();
+
+    CoroutineArena(const CoroutineArena&) = delete;
+    CoroutineArena& operator=(const CoroutineArena&) = delete;
+
+    // Arena of the reactor running on the calling thread, nullptr elsewhere
+    static CoroutineArena* current();
+    static void setCurrent(CoroutineArena* arena);
+
+    // Frame allocation used by every promise type; falls back to the heap
+    // off a reactor thread and for oversized frames
+    static void* allocateFrame(size_t size);
+    static void deallocateFrame(void* frame, size_t size);
+
+    void addRoot(RootLink* link);
+    void removeRoot(RootLink* link);
+    // Destroy every suspended detached coroutine (reactor shutdown)
+    void destroyRoots();
+
+    size_t getLiveFrames() const { return live_frames_; }
+    size_t getCachedFrames() const { return cached_frames_; }
+
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    FreeBlock* free_[CLASS_COUNT];
+    RootLink* roots_;
+    size_t live_frames_;
+    size_t cached_frames_;
+};
+
+// Frames of every promise type below come from the current arena
+struct ArenaFrame {
+    static void* operator new(size_t size) { return CoroutineArena::allocateFrame(size); }
+    static void operator delete(void* frame, size_t size) { CoroutineArena::deallocateFrame(frame, size); }
+};
+
+namespace coroutine_detail {
+// Resume handle on reactor's thread at its next wakeup. Thread-safe.
+void resumeOn(Reactor* reactor, std::coroutine_handle<> handle);
+// Reactor running on the calling thread; throws std::logic_error elsewhere
+Reactor* requireReactor();
+}
+
+// Detached coroutine: starts immediately, runs to completion on its own
+// and frees its frame at the end. Exceptions that escape are logged.
+class Task {
+public:
+    struct promise_type : ArenaFrame {
+        CoroutineArena::RootLink root;
+        CoroutineArena* arena;
+
+        promise_type();
+        ~promise_type();
+
+        Task get_return_object() noexcept { return Task(); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept;
+    };
+};
+
+// Lazy coroutine producing a T, started by co_await from another
+// coroutine and resuming it when done:
+//   Async<int> lookup(std::string key);
+//   int value = co_await lookup("user:1");
+template<class T>
+class Async;
+
+namespace coroutine_detail {
+
+template<class T>
+struct AsyncPromiseBase : ArenaFrame {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr error;
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    // Symmetric transfer back to the awaiting coroutine
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+        template<class Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            std::coroutine_handle<> continuation = handle.promise().continuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() noexcept { error = std::current_exception(); }
+};
+
+template<class T>
+struct AsyncPromise : AsyncPromiseBase<T> {
+    std::optional<T> value;
+
+    Async<T> get_return_object() noexcept;
+    template<class U>
+    void return_value(U&& result) { value.emplace(std::forward<U>(result)); }
+};
+
+template<>
+struct AsyncPromise<void> : AsyncPromiseBase<void> {
+    Async<void> get_return_object() noexcept;
+    void return_void() noexcept {}
+};
+
+} // namespace coroutine_detail
+
+template<class T>
+class [[nodiscard]] Async {
+public:
+    using promise_type = coroutine_detail::AsyncPromise<T>;
+
+    explicit Async(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+    Async(Async&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+    Async(const Async&) = delete;
+    Async& operator=(const Async&) = delete;
+    ~Async() {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return !handle_ || handle_.done(); }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept {
+        handle_.promise().continuation = continuation;
+        return handle_;
+    }
+    T await_resume() {
+        promise_type& promise = handle_.promise();
+        if (promise.error) {
+            std::rethrow_exception(promise.error);
+        }
+        if constexpr (!std::is_void<T>::value) {
+            return std::move(*promise.value);
+        }
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle_;
+};
+
+namespace coroutine_detail {
+
+template<class T>
+Async<T> AsyncPromise<T>::get_return_object() noexcept {
+    return Async<T>(std::coroutine_handle<AsyncPromise<T>>::from_promise(*this));
+}
+
+inline Async<void> AsyncPromise<void>::get_return_object() noexcept {
+    return Async<void>(std::coroutine_handle<AsyncPromise<void>>::from_promise(*this));
+}
+
+} // namespace coroutine_detail
+
+// One-shot result handed from any thread to a coroutine on a reactor:
+//   Completion<std::string> reply;
+//   server.post([reply]() { reply.complete(queryDatabase()); });
+//   std::string row = co_await reply;
+// Copies share the same result; complete() or fail() must be called
+// exactly once, while the server is still running.
+template<class T>
+class Completion {
+    enum : int { EMPTY, WAITING, DONE };
+
+    struct State {
+        std::atomic<int> status{EMPTY};
+        std::optional<T> value;
+        std::exception_ptr error;
+        Reactor* reactor = nullptr;
+        std::coroutine_handle<> waiter;
+    };
+
+public:
+    Completion() : state_(std::make_shared<State>()) {}
+
+    void complete(T value) const {
+        state_->value.emplace(std::move(value));
+        finish();
+    }
+
+    // Resume the waiter by rethrowing error from its co_await
+    void fail(std::exception_ptr error) const {
+        state_->error = std::move(error);
+        finish();
+    }
+
+    bool isReady() const { return state_->status.load(std::memory_order_acquire) == DONE; }
+
+    struct Awaiter {
+        std::shared_ptr<State> state;
+
+        bool await_ready() const noexcept { return state->status.load(std::memory_order_acquire) == DONE; }
+        bool await_suspend(std::coroutine_handle<> handle) {
+            state->reactor = coroutine_detail::requireReactor();
+            state->waiter = handle;
+            int expected = EMPTY;
+            // Fails only when complete() won the race: resume at once
+            return state->status.compare_exchange_strong(expected, WAITING, std::memory_order_acq_rel);
+        }
+        T await_resume() {
+            if (state->error) {
+                std::rethrow_exception(state->error);
+            }
+            return std::move(*state->value);
+        }
+    };
+    Awaiter operator co_await() const { return Awaiter{state_}; }
+
+private:
+    std::shared_ptr<State> state_;
+
+    void finish() const {
+        if (state_->status.exchange(DONE, std::memory_order_acq_rel) == WAITING) {
+            coroutine_detail::resumeOn(state_->reactor, state_->waiter);
+        }
+    }
+};
+
+// co_await sleepFor(std::chrono::milliseconds(250)); resumes on the same
+// reactor. Timers share the reactor's wheel, so the resolution is one
+// 100 ms tick.
+class SleepAwaiter {
+public:
+    explicit SleepAwaiter(std::chrono::steady_clock::duration duration) : duration_(duration) {}
+    SleepAwaiter(const SleepAwaiter&) = delete;
+    SleepAwaiter& operator=(const SleepAwaiter&) = delete;
+    ~SleepAwaiter();
+
+    bool await_ready() const noexcept { return duration_ <= std::chrono::steady_clock::duration::zero(); }
+    void await_suspend(std::coroutine_handle<> handle);
+    void await_resume() noexcept {}
+
+    TimerNode<SleepAwaiter>& getTimerNode() { return timer_node_; }
+    void fire() { handle_.resume(); }
+
+private:
+    std::chrono::steady_clock::duration duration_;
+    std::coroutine_handle<> handle_;
+    Reactor* reactor_ = nullptr;
+    TimerNode<SleepAwaiter> timer_node_;
+};
+
+inline SleepAwaiter sleepFor(std::chrono::steady_clock::duration duration) {
+    return SleepAwaiter(duration);
+}
+
+// A client connection as seen by its session coroutine. Copies refer to
+// the same connection; all calls must come from the session's reactor.
+class AsyncConnection {
+public:
+    // Shared between the reactor's connection table and the coroutine
+    struct Session {
+        Reactor* reactor;
+        ConnectionHandle handle;
+        ConnectionHandler* handler;         // nullptr once the reactor dropped it
+        PeerAddress peer;
+        std::coroutine_handle<> reader;     // Coroutine waiting in read()
+        bool closed = false;
+        bool closing = false;               // close() is flushing
+
+        // Messages not read yet, a ring of strings that keep their capacity,
+        // so steady traffic allocates nothing per message. A connection
+        // worker fills it from its own thread, hence the lock.
+        std::mutex inbox_mutex;
+        std::vector<std::unique_ptr<std::string>> inbox;
+        size_t inbox_head = 0;
+        size_t inbox_count = 0;
+        std::unique_ptr<std::string> current;  // Returned by the last read()
+        bool wake_posted = false;
+
+        Session();
+        // Reactor thread: queue a message and wake the reader
+        void deliver(std::string_view message);
+        // Any thread: queue a message; true when the caller must have the
+        // reactor call wake(), once per batch of messages
+        bool queue(std::string_view message);
+        // Reactor thread: resume the reader if a message is waiting
+        void wake();
+        bool hasMessage();
+        // Reactor thread: the connection is gone, wake the reader with nullopt
+        void detach();
+    };
+
+    explicit AsyncConnection(std::shared_ptr<Session> session) : session_(std::move(session)) {}
+
+    // Next complete message, or std::nullopt once the connection is closed.
+    // The view stays valid until the next read(); copy it to keep it longer.
+    struct ReadAwaiter {
+        Session* session;
+
+        bool await_ready() const noexcept { return session->closed || session->hasMessage(); }
+        void await_suspend(std::coroutine_handle<> handle);
+        std::optional<std::string_view> await_resume();
+    };
+    ReadAwaiter read() const { return ReadAwaiter{session_.get()}; }
+
+    // Queue a message and flush it; Disconnected after close
+    SendStatus send(const std::string& message) const;
+    // Close once queued replies reached the socket (at most 5 s later);
+    // pending reads then return std::nullopt
+    void close() const;
+
+    bool isOpen() const { return !session_->closed; }
+    ConnectionHandler* getHandler() const { return session_->handler; }
+    PeerAddress::Text getClientInfo() const { return session_->peer.toText(); }
+
+private:
+    std::shared_ptr<Session> session_;
+
+    static Task closeWhenFlushed(std::shared_ptr<Session> session);
+};
+
+#endif // HAVE_COROUTINES
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Thread placement for reactors, connection workers and scheduler threads.
+//
+// A pinned thread stays on its core, and the memory it first touches is
+// allocated on that core's NUMA node by the kernel's default policy. State
+// that is built on the main thread before the owner runs (a reactor's slab
+// and io_uring rings, a worker's queues) is allocated under a
+// ScopedNodePreference for the owner's node instead.
+namespace CpuAffinity {
+
+// Parse "0-3,8,10-11" into CPU numbers; false on malformed input
+bool parseCpuList(const std::string& text, std::vector<int>& cpus);
+
+// CPU assigned to the index-th thread of a kind, -1 when cpus is empty
+inline int cpuFor(const std::vector<int>& cpus, size_t index) {
+    return cpus.empty() ? -1 : cpus[index % cpus.size()];
+}
+
+// Pin the calling thread; cpu -1 leaves it alone. Logs and returns false
+// when the CPU does not exist or is outside the process's cpuset.
+bool pinCurrentThread(int cpu, const char* who);
+
+// NUMA node of cpu from sysfs, 0 when unknown or on single-node hosts
+int nodeOfCpu(int cpu);
+
+// Allocations of the calling thread prefer cpu's NUMA node while this
+// lives (set_mempolicy MPOL_PREFERRED); cpu -1 changes nothing
+class ScopedNodePreference {
+public:
+    explicit ScopedNodePreference(int cpu);
+    ~ScopedNodePreference();
+
+    ScopedNodePreference(const ScopedNodePreference&) = delete;
+    ScopedNodePreference& operator=(const ScopedNodePreference&) = delete;
+
+private:
+    bool active_;
+};
+
+} // namespace CpuAffinity
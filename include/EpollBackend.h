@@ -0,0 +1,58 @@
+#pragma once
+
+#include <sys/epoll.h>
+#include <vector>
+#include "IoBackend.h"
+
+class Reactor;
+
+// Readiness-based backend: edge-triggered epoll, with the reads and writes
+// done by the reactor or the connection's worker once a socket is ready.
+// Works on every kernel and is the fallback when io_uring is unavailable.
+//
+// Writes are attempted inline first. EPOLLOUT is only watched while a
+// connection's socket is full, and dropped again once its queue drained.
+// Edge-triggered input left unread by a paused connection is picked up
+// explicitly when it resumes.
+class EpollBackend : public IoBackend {
+public:
+    explicit EpollBackend(Reactor& reactor);
+    ~EpollBackend() override;
+
+    bool init();
+
+    const char* name() const override { return "epoll"; }
+
+    bool addListener(int listen_fd) override;
+    void removeListener(int listen_fd) override;
+    bool addWakeFd(int wake_fd) override;
+
+    bool addConnection(ConnectionHandle handle, ConnectionHandler* handler) override;
+    void removeConnection(ConnectionHandle handle, ConnectionHandler* handler) override;
+    void release(ConnectionHandle handle, std::unique_ptr<ConnectionHandler> handler) override;
+
+    void write(ConnectionHandle handle, ConnectionHandler* handler) override;
+    void requestWrite(ConnectionHandle handle, ConnectionHandler* handler) override;
+    void writeBlockedChanged(ConnectionHandle handle, ConnectionHandler* handler) override;
+    void resumeRead(ConnectionHandle handle, ConnectionHandler* handler) override;
+
+    bool poll(int timeout_ms) override;
+
+private:
+    static constexpr int MAX_EVENTS = 100;
+
+    Reactor& reactor_;
+    int epoll_fd_;
+    int wake_fd_;
+
+    // Inline connections to flush, or whose EPOLLOUT interest changed, since
+    // the last wait. Settled together before the next one, so a connection
+    // costs at most one epoll_ctl() per loop iteration.
+    std::vector<ConnectionHandle> pending_;
+    // Inline connections resumed after backpressure, read before the next wait
+    std::vector<ConnectionHandle> resumed_;
+
+    void acceptConnections(int listen_fd);
+    void flushPending();
+    void updateInterest(ConnectionHandle handle, ConnectionHandler* handler);
+};
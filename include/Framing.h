@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <sys/uio.h>
+
+// Wire framing used by a listener and every connection it accepts
+enum class FramingMode {
+    Newline,    // message + '\n' (TestClient protocol)
+    Length32,   // 4-byte big-endian length + payload
+    Varint      // LEB128 varint length + payload
+};
+
+namespace Framing {
+
+constexpr size_t MODE_COUNT = 3;
+constexpr size_t LENGTH32_HEADER_SIZE = 4;
+constexpr size_t MAX_VARINT_HEADER_SIZE = 5;   // Enough for any 32-bit length
+constexpr size_t MAX_HEADER_SIZE = MAX_VARINT_HEADER_SIZE;
+constexpr size_t MAX_FRAME_PARTS = 2;
+inline constexpr char DELIMITER = '\n';
+
+// Result of decoding a length header from a partial input
+enum class HeaderStatus {
+    Complete,
+    NeedMore,
+    Invalid
+};
+
+// Decode a length header from the start of data.
+// On Complete, header_size and payload_length are set.
+inline HeaderStatus decodeHeader(FramingMode mode, const char* data, size_t available,
+                                 size_t& header_size, size_t& payload_length) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+
+    if (mode == FramingMode::Length32) {
+        if (available < LENGTH32_HEADER_SIZE) {
+            return HeaderStatus::NeedMore;
+        }
+        payload_length = (static_cast<size_t>(bytes[0]) << 24) |
+                         (static_cast<size_t>(bytes[1]) << 16) |
+                         (static_cast<size_t>(bytes[2]) << 8) |
+                         static_cast<size_t>(bytes[3]);
+        header_size = LENGTH32_HEADER_SIZE;
+        return HeaderStatus::Complete;
+    }
+
+    // Varint: 7 bits per byte, high bit set on all but the last byte
+    size_t value = 0;
+    for (size_t i = 0; i < MAX_VARINT_HEADER_SIZE; ++i) {
+        if (i >= available) {
+            return HeaderStatus::NeedMore;
+        }
+        value |= static_cast<size_t>(bytes[i] & 0x7f) << (7 * i);
+        if ((bytes[i] & 0x80) == 0) {
+            header_size = i + 1;
+            payload_length = value;
+            return HeaderStatus::Complete;
+        }
+    }
+    return HeaderStatus::Invalid;
+}
+
+// Encode a length header into out (at least MAX_HEADER_SIZE bytes).
+// Returns the number of bytes written.
+inline size_t encodeHeader(FramingMode mode, size_t payload_length, char* out) {
+    unsigned char* bytes = reinterpret_cast<unsigned char*>(out);
+
+    if (mode == FramingMode::Length32) {
+        bytes[0] = static_cast<unsigned char>(payload_length >> 24);
+        bytes[1] = static_cast<unsigned char>(payload_length >> 16);
+        bytes[2] = static_cast<unsigned char>(payload_length >> 8);
+        bytes[3] = static_cast<unsigned char>(payload_length);
+        return LENGTH32_HEADER_SIZE;
+    }
+
+    if (mode == FramingMode::Varint) {
+        size_t i = 0;
+        do {
+            unsigned char byte = payload_length & 0x7f;
+            payload_length >>= 7;
+            bytes[i++] = payload_length ? (byte | 0x80) : byte;
+        } while (payload_length && i < MAX_VARINT_HEADER_SIZE);
+        return i;
+    }
+
+    return 0;
+}
+
+// Describe the wire form of a message as iovecs without copying it.
+// header must hold MAX_HEADER_SIZE bytes and outlive parts.
+// Returns the number of parts used (at most MAX_FRAME_PARTS).
+inline size_t frameParts(FramingMode mode, const char* data, size_t length,
+                         char* header, struct iovec* parts) {
+    if (mode == FramingMode::Newline) {
+        parts[0].iov_base = const_cast<char*>(data);
+        parts[0].iov_len = length;
+        parts[1].iov_base = const_cast<char*>(&DELIMITER);
+        parts[1].iov_len = 1;
+    } else {
+        parts[0].iov_base = header;
+        parts[0].iov_len = encodeHeader(mode, length, header);
+        parts[1].iov_base = const_cast<char*>(data);
+        parts[1].iov_len = length;
+    }
+    return 2;
+}
+
+// Parse a settings.config value ("newline", "length32", "varint")
+inline bool parseMode(const std::string& value, FramingMode& mode) {
+    if (value == "newline") {
+        mode = FramingMode::Newline;
+    } else if (value == "length32") {
+        mode = FramingMode::Length32;
+    } else if (value == "varint") {
+        mode = FramingMode::Varint;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+inline const char* modeName(FramingMode mode) {
+    switch (mode) {
+        case FramingMode::Length32: return "length32";
+        case FramingMode::Varint: return "varint";
+        default: return "newline";
+    }
+}
+
+} // namespace Framing
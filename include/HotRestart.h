@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+class NetworkServer;
+
+// A listening TCP socket handed from one server process to the next
+struct HandoffSocket {
+    int port;
+    int fd;
+};
+
+// Zero-downtime restart: a new process takes over the listening sockets of
+// the running one over a Unix socket (hot_restart_socket), passed with
+// SCM_RIGHTS, so the kernel's accept queues are never closed and no
+// client sees a refused connection.
+//
+//   new -> old   TAKEOVER_REQUEST
+//   old -> new   socket count, then (port, fd) entries in batches
+//   new          sets up its reactors on the inherited sockets
+//   new -> old   CONFIRM
+//   old          stops accepting, releases the admin, UDP and cluster ports
+//   old -> new   RELEASED; new binds those ports and starts serving
+//   old          drains its connections for up to drain_timeout, then stops
+//
+// Until CONFIRM arrives the old process keeps serving unchanged, so a
+// successor that fails to start costs nothing. Both processes accept from
+// the same sockets meanwhile.
+class HotRestart {
+public:
+    static constexpr char TAKEOVER_REQUEST[] = {'\0', 't', 'a', 'k', 'e', 'o', 'v', 'e', 'r'};
+    static constexpr char CONFIRM = 'C';
+    static constexpr char RELEASED = 'R';
+    static constexpr size_t MAX_SOCKETS = 1024;
+    static constexpr size_t SOCKETS_PER_MESSAGE = 64;   // Descriptors per sendmsg()
+    static constexpr int STEP_TIMEOUT_MS = 30000;       // Each side's wait for the other
+
+    HotRestart(NetworkServer& server, const std::string& path);
+    ~HotRestart();
+
+    HotRestart(const HotRestart&) = delete;
+    HotRestart& operator=(const HotRestart&) = delete;
+
+    // New process: take the listening sockets of the process serving on
+    // path. False when none answers, which is a cold start.
+    bool takeOver(std::vector<HandoffSocket>& sockets);
+    // New process, once its listeners are set up on the inherited sockets:
+    // let the predecessor stop accepting and wait until it released its
+    // other ports. False (logged) if it did not answer.
+    bool confirmTakeover();
+
+    // Serve takeover requests on path for the rest of this process's life
+    bool listen();
+    void stop();
+
+    bool isDraining() const { return draining_; }
+
+private:
+    NetworkServer& server_;
+    std::string path_;
+    int predecessor_fd_;    // New process: connection to the old one
+    int listen_fd_;
+    int wake_fd_;           // eventfd for stop()
+    std::atomic<bool> running_;
+    std::atomic<bool> draining_;
+    std::thread thread_;
+
+    void run();
+    // Old process: hand the sockets over; true once the successor took them
+    bool serveTakeover(int successor_fd);
+    void drain();
+    // Wait for fd to become readable, false on timeout or stop()
+    bool waitReadable(int fd, int timeout_ms);
+};
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Link embedded in objects that travel through an IntrusiveMPSCQueue
+template<class T>
+struct MPSCLink {
+    std::atomic<MPSCLink*> next{nullptr};
+    T* owner = nullptr;
+};
+
+// Intrusive multi-producer / single-consumer queue (Vyukov).
+//
+// push() is wait-free and callable from any thread; pop(), peek() and
+// the other consumer operations must only be called from one thread at a
+// time. Nodes are never allocated by the queue, the link lives in the
+// queued object. An optional capacity turns it into a bounded queue:
+// tryPush() refuses new nodes once that many are in flight.
+template<class T>
+class IntrusiveMPSCQueue {
+public:
+    explicit IntrusiveMPSCQueue(size_t capacity = 0)
+        : head_(&stub_), tail_(&stub_), count_(0), capacity_(capacity) {
+    }
+
+    IntrusiveMPSCQueue(const IntrusiveMPSCQueue&) = delete;
+    IntrusiveMPSCQueue& operator=(const IntrusiveMPSCQueue&) = delete;
+
+    // Producer side
+    void push(MPSCLink<T>* link) {
+        count_.fetch_add(1, std::memory_order_relaxed);
+        link_(link);
+    }
+
+    bool tryPush(MPSCLink<T>* link) {
+        return tryPush(link, link, 1);
+    }
+
+    // Push a pre-linked chain first..last of count nodes in one step, so
+    // nodes from other producers can never interleave with it
+    bool tryPush(MPSCLink<T>* first, MPSCLink<T>* last, size_t count) {
+        size_t previous = count_.fetch_add(count, std::memory_order_relaxed);
+        if (capacity_ > 0 && previous + count > capacity_) {
+            count_.fetch_sub(count, std::memory_order_relaxed);
+            return false;
+        }
+        link_(first, last);
+        return true;
+    }
+
+    // Consumer side. Returns nullptr when empty or while a producer is
+    // between publishing and linking its node.
+    T* pop() {
+        MPSCLink<T>* tail = tail_;
+        MPSCLink<T>* next = tail->next.load(std::memory_order_acquire);
+
+        if (tail == &stub_) {
+            if (!next) {
+                return nullptr;
+            }
+            tail_ = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+
+        if (next) {
+            tail_ = next;
+            return taken(tail);
+        }
+
+        if (tail != head_.load()) {
+            return nullptr; // A producer is mid-push, retry later
+        }
+
+        // Re-insert the stub so the last real node can be detached
+        link_(&stub_);
+        next = tail->next.load(std::memory_order_acquire);
+        if (next) {
+            tail_ = next;
+            return taken(tail);
+        }
+        return nullptr;
+    }
+
+    // Consumer side: oldest node without removing it
+    T* front() {
+        MPSCLink<T>* node = tail_;
+        if (node == &stub_) {
+            node = node->next.load(std::memory_order_acquire);
+        }
+        return node ? node->owner : nullptr;
+    }
+
+    // Consumer side: visit up to max_count queued objects oldest first
+    // without removing them. Returns the number visited.
+    template<class Visitor>
+    size_t peek(Visitor&& visit, size_t max_count) {
+        size_t visited = 0;
+        MPSCLink<T>* node = tail_;
+        while (node && visited < max_count) {
+            if (node != &stub_) {
+                visit(node->owner);
+                ++visited;
+            }
+            node = node->next.load(std::memory_order_acquire);
+        }
+        return visited;
+    }
+
+    // Any thread. Approximate while producers are active.
+    size_t size() const { return count_.load(std::memory_order_relaxed); }
+    bool empty() const { return size() == 0; }
+    size_t capacity() const { return capacity_; }             // 0 = unbounded
+
+    // Consumer side. True when nothing is linked, used before sleeping.
+    bool idle() const { return tail_ == &stub_ && head_.load() == &stub_; }
+
+private:
+    std::atomic<MPSCLink<T>*> head_;   // Producers swap here
+    MPSCLink<T>* tail_;                // Consumer only
+    MPSCLink<T> stub_;
+    std::atomic<size_t> count_;
+    size_t capacity_;
+
+    void link_(MPSCLink<T>* link) {
+        link_(link, link);
+    }
+
+    void link_(MPSCLink<T>* first, MPSCLink<T>* last) {
+        last->next.store(nullptr, std::memory_order_relaxed);
+        MPSCLink<T>* previous = head_.exchange(last);
+        previous->next.store(first, std::memory_order_release);
+    }
+
+    T* taken(MPSCLink<T>* link) {
+        count_.fetch_sub(1, std::memory_order_relaxed);
+        return link->owner;
+    }
+};
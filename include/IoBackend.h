@@ -0,0 +1,45 @@
+#pragma once
+
+#include <memory>
+#include "ConnectionSlab.h"
+
+// How a reactor waits for and performs socket I/O.
+//
+// The reactor keeps everything backend-neutral: the connection table,
+// timers, posted tasks and teardown. A backend registers descriptors,
+// waits, and reports back through the reactor's entry points. Except for
+// requestWrite() and writeBlockedChanged(), every call is made on the
+// reactor thread.
+class IoBackend {
+public:
+    virtual ~IoBackend() = default;
+
+    virtual const char* name() const = 0;
+
+    // Watch a listening socket / the reactor's wake eventfd
+    virtual bool addListener(int listen_fd) = 0;
+    virtual bool addWakeFd(int wake_fd) = 0;
+    // Stop accepting on a listener that stays open (hot restart)
+    virtual void removeListener(int listen_fd) = 0;
+
+    // Start I/O on an accepted connection already stored in the slab
+    virtual bool addConnection(ConnectionHandle handle, ConnectionHandler* handler) = 0;
+    // Stop reporting events for a connection that is being torn down
+    virtual void removeConnection(ConnectionHandle handle, ConnectionHandler* handler) = 0;
+    // Take a removed inline connection and destroy it once the kernel no
+    // longer references its buffers
+    virtual void release(ConnectionHandle handle, std::unique_ptr<ConnectionHandler> handler) = 0;
+
+    // Start writing what the connection has queued
+    virtual void write(ConnectionHandle handle, ConnectionHandler* handler) = 0;
+    // Same, from any thread
+    virtual void requestWrite(ConnectionHandle handle, ConnectionHandler* handler) = 0;
+    // The connection's write started or stopped waiting on a full socket.
+    // Called on the connection's I/O thread (its worker, if it has one).
+    virtual void writeBlockedChanged(ConnectionHandle handle, ConnectionHandler* handler) = 0;
+    // A connection paused by backpressure may read again; called on its I/O thread
+    virtual void resumeRead(ConnectionHandle handle, ConnectionHandler* handler) = 0;
+
+    // Wait up to timeout_ms and dispatch what happened; false on a fatal error
+    virtual bool poll(int timeout_ms) = 0;
+};
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+
+enum class LogLevel {
+    Debug = 0,
+    Info,
+    Warn,
+    Error,
+    Off
+};
+
+// Asynchronous leveled logger.
+//
+// Every logging thread owns a fixed ring of preformatted lines that only it
+// writes and only the background drain thread reads, so logging takes no
+// lock and makes no syscall on the caller's thread. The drain thread writes
+// each batch with one write() per stream: Debug/Info go to stdout,
+// Warn/Error to stderr. Lines are ordered per thread, not across threads.
+// When a ring is full the line is dropped and counted instead of blocking.
+class Logger {
+public:
+    static constexpr size_t MAX_LINE = 240;       // Longer lines are truncated
+    static constexpr size_t RING_CAPACITY = 512;  // Lines buffered per thread
+    static constexpr size_t MAX_RINGS = 128;      // Threads beyond this log synchronously
+
+    static Logger& getInstance();
+    ~Logger();
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    void setLevel(LogLevel level) { level_.store(level, std::memory_order_relaxed); }
+    LogLevel getLevel() const { return level_.load(std::memory_order_relaxed); }
+    bool isEnabled(LogLevel level) const { return level >= getLevel(); }
+
+    // Queue one line (without trailing newline) from the calling thread
+    void write(LogLevel level, const char* text, size_t length);
+
+    // Write out everything queued so far before returning
+    void flush();
+
+    size_t getDroppedCount() const { return dropped_.load(std::memory_order_relaxed); }
+
+    // settings.config values: debug, info, warn, error, off
+    static bool parseLevel(const std::string& value, LogLevel& level);
+    static const char* levelName(LogLevel level);
+
+private:
+    friend struct LogRingHandle;
+
+    struct Record {
+        LogLevel level;
+        uint32_t length;
+        char text[MAX_LINE];
+    };
+
+    // Single-producer / single-consumer ring, reused once its thread exits
+    struct Ring {
+        std::atomic<size_t> head{0};    // Next slot the producer writes
+        std::atomic<size_t> tail{0};    // Next slot the drain thread reads
+        std::atomic<bool> in_use{false};
+        Record records[RING_CAPACITY];
+    };
+
+    std::atomic<LogLevel> level_;
+    std::atomic<size_t> dropped_;
+    size_t reported_dropped_;
+
+    std::unique_ptr<Ring> rings_[MAX_RINGS];
+    std::atomic<size_t> ring_count_;
+    std::mutex rings_mutex_;            // Ring creation and reuse only
+
+    std::mutex drain_mutex_;            // One drainer at a time
+    std::mutex wake_mutex_;
+    std::condition_variable wake_;
+    bool stopping_;
+    std::thread thread_;
+
+    Logger();
+
+    Ring* localRing();
+    Ring* acquireRing();
+    void run();
+    void drain();
+    static void writeAll(int fd, const char* data, size_t length);
+};
+
+// Allocation-free line builder behind the LOG_* macros. Formats into a
+// fixed buffer on the stack and hands the line to the logger when the
+// statement ends.
+class LogLine {
+public:
+    explicit LogLine(LogLevel level) : level_(level), length_(0) {}
+    ~LogLine() { Logger::getInstance().write(level_, buffer_, length_); }
+
+    LogLine(const LogLine&) = delete;
+    LogLine& operator=(const LogLine&) = delete;
+
+    LogLine& operator<<(std::string_view text) { return append(text.data(), text.size()); }
+    LogLine& operator<<(const char* text) { return *this << std::string_view(text ? text : "(null)"); }
+    LogLine& operator<<(const std::string& text) { return append(text.data(), text.size()); }
+    LogLine& operator<<(char c) { return append(&c, 1); }
+    LogLine& operator<<(bool value) { return *this << (value ? "true" : "false"); }
+    LogLine& operator<<(double value);
+    LogLine& operator<<(const void* pointer);
+
+    template<class T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+    LogLine& operator<<(T value) {
+        return std::is_signed<T>::value ? appendSigned(static_cast<long long>(value))
+                                        : appendUnsigned(static_cast<unsigned long long>(value));
+    }
+
+private:
+    LogLevel level_;
+    size_t length_;
+    char buffer_[Logger::MAX_LINE];
+
+    LogLine& append(const char* data, size_t length);
+    LogLine& appendSigned(long long value);
+    LogLine& appendUnsigned(unsigned long long value);
+};
+
+// Usage: LOG_INFO("Reactor " << id << ": new connection from " << ip);
+// Arguments are not evaluated when the level is disabled at runtime.
+#define LOG_AT(level, expr)                                   \
+    do {                                                      \
+        if (Logger::getInstance().isEnabled(level)) {         \
+            LogLine(level) << expr;                           \
+        }                                                     \
+    } while (0)
+
+// Debug lines only exist in builds with -DDEBUG (CMake Debug configuration)
+#ifdef DEBUG
+#define LOG_DEBUG(expr) LOG_AT(LogLevel::Debug, expr)
+#else
+#define LOG_DEBUG(expr) do { } while (0)
+#endif
+
+#define LOG_INFO(expr) LOG_AT(LogLevel::Info, expr)
+#define LOG_WARN(expr) LOG_AT(LogLevel::Warn, expr)
+#define LOG_ERROR(expr) LOG_AT(LogLevel::Error, expr)
@@ -1,69 +1,145 @@
 #pragma once
 
 #include <memory>
+#include <algorithm>
 #include <vector>
 #include <cstring>
 #include <atomic>
 #include <mutex>
+#include <sys/uio.h>
 #include "BufferConfig.h"
+#include "IntrusiveQueue.h"
 
 // Forward declarations
 class MessageBuffer;
 
-// Memory pool for message buffers to avoid fragmentation
+// Outcome of queueing data for a connection
+enum class SendStatus {
+    Queued,
+    QueueFull,      // SEND_QUEUE_CAPACITY buffers already waiting
+    MemoryLimit,    // MemoryTracker is over its limit, the server sheds load
+    Disconnected    // The connection no longer accepts data
+};
+
+// Immutable message bytes shared by many send queues.
+// A broadcast is framed once into a SharedPayload and every connection
+// queues a reference to it instead of its own copy; the bytes are freed
+// when the last queue has sent them.
+class SharedPayload {
+public:
+    // Concatenate parts (e.g. header + payload) into a new payload
+    static std::shared_ptr<const SharedPayload> create(const struct iovec* parts, size_t count);
+    ~SharedPayload();
+    
+    SharedPayload(const SharedPayload&) = delete;
+    SharedPayload& operator=(const SharedPayload&) = delete;
+    
+    const char* data() const { return data_.get(); }
+    size_t size() const { return size_; }
+
+private:
+    explicit SharedPayload(size_t size);
+    
+    std::unique_ptr<char[]> data_;
+    size_t size_;
+};
+
+// Shared, size-classed memory pool for message buffers.
+// One process-wide instance serves every connection. A request gets the
+// smallest class (SMALL/MEDIUM/LARGE_MESSAGE_SIZE) that fits; callers chain
+// LARGE buffers for anything bigger. A fourth class holds payload-less
+// buffers that reference a SharedPayload. Each thread keeps a small magazine of
+// buffers per class and only touches the class depot, under its mutex, to
+// refill or flush a whole batch. The depots retain at most
+// SMALL/MEDIUM/LARGE_POOL_SIZE buffers, the rest are freed.
 class MessageBufferPool {
 public:
-    static constexpr size_t DEFAULT_BUFFER_SIZE = BufferConfig::MEDIUM_MESSAGE_SIZE;
-    static constexpr size_t MAX_POOL_SIZE = BufferConfig::MEDIUM_POOL_SIZE;
+    static constexpr size_t CLASS_COUNT = 4;      // SMALL, MEDIUM, LARGE, shared references
+    static constexpr int SHARED_CLASS = 3;
+    static constexpr size_t MAX_BUFFER_SIZE = BufferConfig::LARGE_MESSAGE_SIZE;
+    static constexpr size_t MAGAZINE_BATCH = 16;
     
-    MessageBufferPool(size_t buffer_size = DEFAULT_BUFFER_SIZE);
+    static MessageBufferPool& getInstance();
     ~MessageBufferPool();
     
-    // Get a buffer from the pool
-    std::unique_ptr<MessageBuffer> acquire();
+    MessageBufferPool(const MessageBufferPool&) = delete;
+    MessageBufferPool& operator=(const MessageBufferPool&) = delete;
+    
+    // Get an empty buffer with capacity >= min(length, MAX_BUFFER_SIZE)
+    std::unique_ptr<MessageBuffer> acquire(size_t length = BufferConfig::MEDIUM_MESSAGE_SIZE);
+    
+    // Get a read-only buffer referencing payload, for queueing it without a copy
+    std::unique_ptr<MessageBuffer> acquireShared(std::shared_ptr<const SharedPayload> payload);
     
-    // Return a buffer to the pool
+    // Return a buffer to the pool (any thread)
     void release(std::unique_ptr<MessageBuffer> buffer);
     
     // Get pool statistics
-    size_t getPoolSize() const { return pool_size_.load(); }
-    size_t getActiveBuffers() const { return active_buffers_.load(); }
+    size_t getPoolSize() const { return pooled_buffers_.load(); }       // Idle in depots
+    size_t getActiveBuffers() const {                                   // In use or thread-cached
+        return allocated_buffers_.load() - pooled_buffers_.load();
+    }
 
 private:
-    size_t buffer_size_;
-    std::atomic<size_t> pool_size_;
-    std::atomic<size_t> active_buffers_;
-    std::vector<std::unique_ptr<MessageBuffer>> available_buffers_;
-    std::mutex pool_mutex_;
+    friend struct BufferMagazine;
+    
+    struct SizeClass {
+        size_t buffer_size;
+        size_t depot_limit;
+        std::mutex mutex;
+        std::vector<MessageBuffer*> depot;
+    };
+    
+    SizeClass classes_[CLASS_COUNT];
+    std::atomic<size_t> allocated_buffers_;
+    std::atomic<size_t> pooled_buffers_;
+    
+    MessageBufferPool();
+    
+    static int classIndex(size_t length);
+    MessageBuffer* take(int index);
+    void refill(int index, std::vector<MessageBuffer*>& into);
+    void flush(int index, std::vector<MessageBuffer*>& from, size_t count);
+    void destroy(MessageBuffer* buffer);
 };
 
 // Efficient message buffer with pre-allocated memory
 class MessageBuffer {
 public:
-    MessageBuffer(size_t capacity);
+    explicit MessageBuffer(size_t capacity);
     ~MessageBuffer();
     
-    // Non-copyable, movable
+    // Non-copyable, non-movable (queued buffers are linked in place)
     MessageBuffer(const MessageBuffer&) = delete;
     MessageBuffer& operator=(const MessageBuffer&) = delete;
-    MessageBuffer(MessageBuffer&&) = default;
-    MessageBuffer& operator=(MessageBuffer&&) = default;
+    MessageBuffer(MessageBuffer&&) = delete;
+    MessageBuffer& operator=(MessageBuffer&&) = delete;
     
     // Buffer operations
     bool append(const char* data, size_t length);
     bool append(const std::string& data);
     bool append(const MessageBuffer& other);
     
+    // Turn into a read-only view of a shared payload (capacity 0 buffers only)
+    void share(std::shared_ptr<const SharedPayload> payload);
+    bool isShared() const { return shared_ != nullptr; }
+    
     // Send operations
     ssize_t sendPartial(int socket_fd, size_t offset = 0);
+    void markSent(size_t bytes) { offset_ = std::min(offset_ + bytes, size_); }
+    
+    // Receive in place: fill the free tail, then commit what was written
+    char* writePtr() { return buffer_.get() + size_; }
+    void commit(size_t length) { size_ = std::min(size_ + length, capacity_); }
+    size_t unsent() const { return size_ - offset_; }
     bool isComplete() const { return offset_ >= size_; }
     bool isEmpty() const { return size_ == 0; }
     
     // Getters
-    const char* data() const { return buffer_.get(); }
+    const char* data() const { return shared_ ? shared_->data() : buffer_.get(); }
     size_t size() const { return size_; }
     size_t capacity() const { return capacity_; }
-    size_t remaining() const { return capacity_ - size_; }
+    size_t remaining() const { return size_ < capacity_ ? capacity_ - size_ : 0; }
     size_t getOffset() const { return offset_; }
     
     // Reset for reuse
@@ -73,33 +149,93 @@ public:
     std::unique_ptr<MessageBuffer> splitAt(size_t position);
 
 private:
+    friend class MessageQueue;
+    
     std::unique_ptr<char[]> buffer_;
     size_t capacity_;
     size_t size_;
     size_t offset_;  // For partial sends
+    std::shared_ptr<const SharedPayload> shared_;
+    MPSCLink<MessageBuffer> queue_link_;
+};
+
+// Contiguous receive buffer with a read cursor.
+// recv() writes straight into the free tail and framing hands out views of
+// the readable region; consumed bytes are reclaimed lazily by a single
+// compaction when space runs out, never once per message.
+class ReadBuffer {
+public:
+    explicit ReadBuffer(size_t max_capacity);
+    ~ReadBuffer();
+
+    ReadBuffer(const ReadBuffer&) = delete;
+    ReadBuffer& operator=(const ReadBuffer&) = delete;
+
+    // Make room for at least min_bytes after the write position.
+    // Returns false when that would exceed max_capacity.
+    bool ensureWritable(size_t min_bytes);
+    char* writePtr() { return data_.get() + write_pos_; }
+    size_t writable() const { return capacity_ - write_pos_; }
+    void commit(size_t length) { write_pos_ += length; }
+
+    const char* readPtr() const { return data_.get() + read_pos_; }
+    size_t readable() const { return write_pos_ - read_pos_; }
+    void consume(size_t length);
+
+    size_t capacity() const { return capacity_; }
+    void clear();
+
+private:
+    std::unique_ptr<char[]> data_;
+    size_t capacity_;
+    size_t max_capacity_;
+    size_t read_pos_;
+    size_t write_pos_;
 };
 
-// Efficient message queue using pre-allocated buffers
+// Lock-free send queue using pooled buffers.
+// Any thread may enqueue (message handlers, broadcast, sendToClient); only
+// the connection's writer consumes. Buffers are linked through their
+// embedded queue_link_, so enqueue and pop are O(1) and take no lock.
+// A message larger than one buffer is queued as a chain of buffers in a
+// single push; an idle queue holds no buffers at all.
 class MessageQueue {
 public:
-    MessageQueue();
-    ~MessageQueue() = default;
+    static constexpr size_t DEFAULT_CAPACITY = BufferConfig::SEND_QUEUE_CAPACITY;
+    
+    explicit MessageQueue(size_t capacity = DEFAULT_CAPACITY);
+    ~MessageQueue();
     
-    // Add message to queue
-    bool enqueue(const char* data, size_t length);
-    bool enqueue(const std::string& message);
+    // Add message to queue (any thread); nothing is queued unless the
+    // result is SendStatus::Queued
+    SendStatus enqueue(const char* data, size_t length);
+    SendStatus enqueue(const std::string& message);
+    // Concatenate several pieces (e.g. header + payload) into one message
+    SendStatus enqueue(const struct iovec* parts, size_t count);
+    // Queue a reference to shared bytes, no copy
+    SendStatus enqueue(std::shared_ptr<const SharedPayload> payload);
     
-    // Get next message for sending
+    // Get next message for sending (consumer only)
     MessageBuffer* front();
-    void pop();
+    bool pop();
+    
+    // Any thread, approximate while producers are active
     bool empty() const;
-    size_t size() const;
+    size_t size() const { return messages_.size(); }                              // Buffers
+    size_t capacity() const { return messages_.capacity(); }
+    size_t bytes() const { return queued_bytes_.load(std::memory_order_relaxed); } // Unsent
+    
+    // Batch drain for vectored writes (consumer only): describe the unsent
+    // bytes of up to max_count queued messages, then account for what the
+    // kernel accepted. consume() advances partial offsets and releases
+    // completed buffers in one pass.
+    size_t gather(struct iovec* iov, size_t max_count);
+    void consume(size_t bytes);
     
-    // Clear all messages
+    // Clear all messages (consumer only)
     void clear();
 
 private:
-    std::vector<std::unique_ptr<MessageBuffer>> messages_;
-    mutable std::mutex queue_mutex_;
-    MessageBufferPool buffer_pool_;
+    IntrusiveMPSCQueue<MessageBuffer> messages_;
+    std::atomic<size_t> queued_bytes_;
 };
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Event counters, one metric (or one label of a metric) each
+enum class Counter : size_t {
+    Accepts = 0,
+    AcceptsRejected,        // Memory or connection limit
+    ConnectionsClosed,
+    MessagesReceived,       // Dispatched to the message handler
+    MessagesSent,           // Queued for sending
+    MessagesDropped,        // Refused by a full send queue or the memory limit
+    BytesReceived,
+    BytesSent,
+    PartialWrites,          // A write that left data queued because the socket was full
+    PoolHits,               // Buffer served from the pool
+    PoolMisses,             // Buffer newly allocated
+    DatagramsReceived,      // Delivered to the datagram handler
+    DatagramsSent,
+    DatagramsDropped,       // Unknown token, truncated, or refused by the send queue
+    TlsHandshakes,          // Completed and handed to kernel TLS
+    TlsHandshakeFailures,
+    MessagesCompressed,     // Sent as zstd frames, broadcasts once
+    CompressionSavedBytes,  // Payload bytes minus compressed bytes
+    RelayRecordsSent,       // Queued for a peer node, once per peer
+    RelayRecordsReceived,
+    RelayRecordsDropped,    // Peer down, its send buffer full, or too large
+    CaptureRecords,         // Written to the traffic capture
+    CaptureRecordsDropped,  // Capture file full
+    SyscallAccept,
+    SyscallRecv,
+    SyscallSend,
+    SyscallEpollWait,
+    SyscallEpollCtl,
+    SyscallUringEnter,
+    SyscallRecvmmsg,
+    SyscallSendmmsg,
+    Count
+};
+
+// Latency distributions, recorded in nanoseconds
+enum class Histogram : size_t {
+    ReadToHandler = 0,      // Bytes received until their message reaches the handler
+    HandlerToFlush,         // Reply queued until the send queue has drained
+    Count
+};
+
+// Process-wide metrics with per-thread counters.
+//
+// Every recording thread owns a shard that only it writes, so counting is a
+// plain load and store on a cache line no other writer touches. A scrape
+// sums all shards; a shard outlives its thread and is handed to the next
+// one, so totals never go backwards. Threads beyond MAX_SHARDS share an
+// overflow shard with atomic adds.
+//
+// Histograms are log-linear like HDR histograms: every power of two is
+// split into SUB_BUCKETS linear buckets, bounding the relative error of a
+// quantile to 1/SUB_BUCKETS over the whole range.
+//
+// Nothing is recorded until setEnabled(true), and disabled call sites cost
+// one relaxed load.
+class Metrics {
+public:
+    static constexpr size_t MAX_SHARDS = 128;
+    static constexpr size_t SUB_BUCKET_BITS = 3;
+    static constexpr size_t SUB_BUCKETS = size_t(1) << SUB_BUCKET_BITS;
+    static constexpr size_t MAX_EXPONENT = 36;    // Values from 2^36 ns (~69 s) share the last bucket
+    static constexpr size_t BUCKET_COUNT = (MAX_EXPONENT - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+
+    static Metrics& getInstance();
+
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    void setEnabled(bool enabled) { enabled_.store(enabled, std::memory_order_relaxed); }
+    bool isEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    static void add(Counter counter, uint64_t value = 1) {
+        Metrics& metrics = getInstance();
+        if (metrics.isEnabled()) {
+            metrics.localShard()->add(static_cast<size_t>(counter), value);
+        }
+    }
+
+    static void record(Histogram histogram, uint64_t nanoseconds) {
+        Metrics& metrics = getInstance();
+        if (metrics.isEnabled()) {
+            metrics.localShard()->record(static_cast<size_t>(histogram), nanoseconds);
+        }
+    }
+
+    // Append every counter and histogram in Prometheus text format
+    void writePrometheus(std::string& out) const;
+
+    // Prometheus text format helpers for values owned elsewhere
+    static void appendGauge(std::string& out, const char* name, const char* help, double value);
+
+    static size_t bucketIndex(uint64_t value);
+    static uint64_t bucketUpperBound(size_t index);    // Largest value in the bucket
+
+private:
+    friend struct MetricsShardHandle;
+
+    static constexpr size_t COUNTER_COUNT = static_cast<size_t>(Counter::Count);
+    static constexpr size_t HISTOGRAM_COUNT = static_cast<size_t>(Histogram::Count);
+
+    struct HistogramData {
+        std::atomic<uint64_t> buckets[BUCKET_COUNT];
+        std::atomic<uint64_t> sum;
+    };
+
+    // Written by its owning thread, read by scrapes
+    struct alignas(64) Shard {
+        std::atomic<bool> in_use{false};
+        bool shared = false;            // The overflow shard, written by many threads
+        std::atomic<uint64_t> counters[COUNTER_COUNT];
+        HistogramData histograms[HISTOGRAM_COUNT];
+
+        Shard();
+        void add(size_t index, uint64_t value) { bump(counters[index], value); }
+        void record(size_t index, uint64_t value);
+        void bump(std::atomic<uint64_t>& slot, uint64_t value) {
+            if (shared) {
+                slot.fetch_add(value, std::memory_order_relaxed);
+            } else {
+                slot.store(slot.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    std::atomic<bool> enabled_;
+    std::unique_ptr<Shard> shards_[MAX_SHARDS];
+    std::atomic<size_t> shard_count_;
+    std::mutex shards_mutex_;           // Shard creation and reuse only
+    Shard overflow_;
+
+    Metrics();
+
+    Shard* localShard();
+    Shard* acquireShard();
+};
@@ -9,43 +9,193 @@
 #include <memory>
 #include <thread>
 #include <atomic>
+#include <vector>
 #include <unordered_map>
-#include "ThreadPool.h"
+#include <mutex>
+#include <stdexcept>
 #include "ConnectionHandler.h"
+#include "ConnectionHandlerT.h"
+#include "ConnectionWorker.h"
+#include "ThreadPool.h"
+#include "WorkStealingPool.h"
+#include "ServerConfig.h"
+#include "Reactor.h"
+#include "TopicRegistry.h"
+#include "AdminServer.h"
+#include "UdpTransport.h"
+#include "TlsContext.h"
+#include "Compression.h"
+#include "ClusterRelay.h"
+#include "TrafficCapture.h"
+#include "HotRestart.h"
 
 class NetworkServer {
 public:
     NetworkServer(int port, int max_connections = 1000, int thread_count = 4);
+    explicit NetworkServer(const ServerConfig& config);
     ~NetworkServer();
-    
+
     bool start();
     void stop();
     void run();
-    
+
     // Message handling
     void setMessageHandler(std::function<void(const std::string&, ConnectionHandler*)> handler);
+    // Zero-copy handler, takes precedence over setMessageHandler(). The view
+    // is only valid until the handler returns.
+    void setMessageViewHandler(std::function<void(std::string_view, ConnectionHandler*)> handler);
+    // Batched handler, takes precedence over both: called once per read
+    // with every message it completed. Pairs with flush_interval_ms.
+    void setMessageBatchHandler(std::function<void(MessageBatch, ConnectionHandler*)> handler);
+    // Typed handler, takes precedence over all of the above and sessions:
+    // every connection is a ConnectionHandlerT for its listener's codec
+    // with its own copy of handler, called as handler(view, connection)
+    // from the framing loop without any std::function in between
+    template<class Handler>
+    void setTypedMessageHandler(Handler handler);
+#ifdef HAVE_COROUTINES
+    // Start session(conn) as a coroutine on the owning reactor for every
+    // accepted connection; takes precedence over both message handlers
+    void setSessionHandler(std::function<Task(AsyncConnection)> session);
+
+    // Run task on the scheduler and co_await its result from a session:
+    //   std::string row = co_await server.offload([]() { return db.query(); });
+    template<class F>
+    auto offload(F&& task) -> Completion<decltype(task())>;
+#endif
+    // UDP side channel (udp_port): payloads of the datagrams a session's
+    // client sent, on the transport thread, and datagrams back to it.
+    // sendDatagram() is thread-safe and false when nothing was queued, e.g.
+    // before the client's first datagram told us its address.
+    void setDatagramHandler(std::function<void(std::string_view, ConnectionHandler*)> handler);
+    bool sendDatagram(ConnectionHandler* handler, const char* data, size_t length);
+    bool sendDatagram(ConnectionHandler* handler, const std::string& message);
+    
+    // In cluster mode (cluster_node_id), broadcasts and publishes also
+    // reach the clients of every other node, relayed once per node
     void broadcastMessage(const std::string& message);
-    void sendToClient(int client_fd, const std::string& message);
+    // Disconnected when no reactor has a connection on client_fd
+    SendStatus sendToClient(int client_fd, const std::string& message);
     void forceWriteEvent(int client_fd);
     
+    // Topic/room fan-out. Publishing costs one framed payload plus one
+    // reference per subscriber; returns the number of subscribers reached.
+    bool subscribe(ConnectionHandler* handler, const std::string& topic);
+    bool unsubscribe(ConnectionHandler* handler, const std::string& topic);
+    size_t publish(const std::string& topic, const std::string& message);
+    size_t getSubscriberCount(const std::string& topic) const;
+    
+    // Offload work (blocking calls, heavy computation) from a message handler
+    // onto the configured scheduler. No future is created. Throws
+    // std::runtime_error once the server has shut down.
+    template<class F>
+    void post(F&& task);
+
     // Connection management
     size_t getConnectionCount() const;
     void cleanupInactiveConnections(int timeout_seconds = 300);
-    
+    size_t getReactorCount() const { return reactors_.size(); }
+
+    // Prometheus text exposition served on the admin port
+    std::string renderMetrics();
+
+    // Apply the settings that can change while running: log level,
+    // timeouts, heartbeats, memory limit, accept batch, send watermarks and
+    // flush threshold, for live and new connections. The others are
+    // logged as needing a restart. Thread-safe; ignored unless running.
+    void reloadConfig(const ServerConfig& fresh);
+
 private:
-    int port_;
-    int max_connections_;
-    int server_fd_;
-    int epoll_fd_;
+    friend class Reactor;
+    friend class HotRestart;
+
+    ServerConfig config_;
+    // The settings of the last reload, so each change is reported once
+    ServerConfig last_loaded_;
+    // Held by reloadConfig() and shutdown(): a reload on the signal thread
+    // never walks reactors that are being torn down
+    std::mutex reload_mutex_;
     std::atomic<bool> running_;
+    std::atomic<bool> loop_active_;
+    std::vector<std::unique_ptr<ConnectionWorker>> workers_;
     std::unique_ptr<ThreadPool> thread_pool_;
-    std::unordered_map<int, std::unique_ptr<ConnectionHandler>> connections_;
+    std::unique_ptr<WorkStealingPool> work_stealing_pool_;
+    // Shared by the reactors' TLS listeners (tls_port), outlives their sessions
+    std::unique_ptr<TlsContext> tls_context_;
+    // Offered to length-prefixed connections (compression=zstd)
+    std::unique_ptr<MessageCompressor> compressor_;
+    // Inbound traffic recorder (capture_file), outlives every connection
+    std::unique_ptr<TrafficCapture> capture_;
+    std::vector<std::unique_ptr<Reactor>> reactors_;
     std::function<void(const std::string&, ConnectionHandler*)> message_handler_;
-    
-    bool setupServer();
-    bool setupEpoll();
-    void setNonBlocking(int fd);
-    void handleNewConnection();
-    void handleClientEvent(int client_fd, uint32_t events);
-    void cleanupConnection(int client_fd);
+    std::function<void(std::string_view, ConnectionHandler*)> message_view_handler_;
+    std::function<void(MessageBatch, ConnectionHandler*)> message_batch_handler_;
+    // Builds the ConnectionHandlerT of a typed handler, once per accept
+    std::function<std::unique_ptr<ConnectionHandler>(int, const PeerAddress&, FramingMode)> connection_factory_;
+    std::function<void(std::string_view, ConnectionHandler*)> datagram_handler_;
+#ifdef HAVE_COROUTINES
+    std::function<Task(AsyncConnection)> session_handler_;
+#endif
+    TopicRegistry topics_;
+    std::unique_ptr<AdminServer> admin_server_;
+    std::unique_ptr<UdpTransport> udp_;
+    std::unique_ptr<ClusterRelay> relay_;
+    // Takeover to and from other processes (hot_restart_socket)
+    std::unique_ptr<HotRestart> hot_restart_;
+    std::vector<HandoffSocket> inherited_;     // Taken over, not claimed by a reactor yet
+
+    int resolveReactorCount() const;
+    std::shared_ptr<const BroadcastPayload> frameForListeners(const std::string& message) const;
+    // Local fan-out only, also for records relayed from other nodes
+    void broadcastLocal(const std::string& message);
+    size_t publishLocal(const std::string& topic, const std::string& message);
+    // Hot restart: listeners to pass on, and giving way once they were taken
+    std::vector<HandoffSocket> handoffSockets() const;
+    void releaseToSuccessor();
+    int takeInheritedSocket(int port);
+    void closeInheritedSockets();
+    void shutdown();
 };
+
+template<class F>
+void NetworkServer::post(F&& task) {
+    if (work_stealing_pool_) {
+        work_stealing_pool_->post(std::forward<F>(task));
+    } else if (thread_pool_) {
+        thread_pool_->post(std::forward<F>(task));
+    } else {
+        throw std::runtime_error("post on a stopped NetworkServer");
+    }
+}
+
+template<class Handler>
+void NetworkServer::setTypedMessageHandler(Handler handler) {
+    connection_factory_ = [handler](int client_fd, const PeerAddress& peer,
+                                    FramingMode framing) -> std::unique_ptr<ConnectionHandler> {
+        switch (framing) {
+            case FramingMode::Length32:
+                return std::make_unique<ConnectionHandlerT<Length32Codec, Handler>>(client_fd, peer, handler);
+            case FramingMode::Varint:
+                return std::make_unique<ConnectionHandlerT<VarintCodec, Handler>>(client_fd, peer, handler);
+            case FramingMode::Newline:
+                break;
+        }
+        return std::make_unique<ConnectionHandlerT<NewlineCodec, Handler>>(client_fd, peer, handler);
+    };
+}
+
+#ifdef HAVE_COROUTINES
+template<class F>
+auto NetworkServer::offload(F&& task) -> Completion<decltype(task())> {
+    static_assert(!std::is_void<decltype(task())>::value, "offload() needs a task that returns a value");
+    Completion<decltype(task())> completion;
+    post([completion, task = std::forward<F>(task)]() mutable {
+        try {
+            completion.complete(task());
+        } catch (...) {
+            completion.fail(std::current_exception());
+        }
+    });
+    return completion;
+}
+#endif
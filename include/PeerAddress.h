@@ -0,0 +1,57 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+// A client's IPv4 address and port as returned by accept(), kept in binary
+// form and only turned into text when something prints it
+class PeerAddress {
+public:
+    // "255.255.255.255:65535"
+    static constexpr size_t MAX_TEXT_LENGTH = INET_ADDRSTRLEN + 6;
+
+    // Formatted address on the stack; converts to std::string_view so it can
+    // go straight into a log line without allocating
+    struct Text {
+        char data[MAX_TEXT_LENGTH];
+        size_t length;
+
+        operator std::string_view() const { return std::string_view(data, length); }
+        std::string str() const { return std::string(data, length); }
+    };
+
+    PeerAddress() { std::memset(&address_, 0, sizeof(address_)); }
+    explicit PeerAddress(const struct sockaddr_in& address) : address_(address) {}
+
+    const struct sockaddr_in& get() const { return address_; }
+    int port() const { return ntohs(address_.sin_port); }
+
+    Text toText() const {
+        Text text;
+        if (!inet_ntop(AF_INET, &address_.sin_addr, text.data, INET_ADDRSTRLEN)) {
+            std::strcpy(text.data, "?");
+        }
+        text.length = std::strlen(text.data);
+        text.data[text.length++] = ':';
+
+        // Port digits, most significant first
+        char digits[5];
+        size_t count = 0;
+        unsigned int value = static_cast<unsigned int>(port());
+        do {
+            digits[count++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+        while (count > 0) {
+            text.data[text.length++] = digits[--count];
+        }
+        return text;
+    }
+
+private:
+    struct sockaddr_in address_;
+};
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <netinet/in.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ConnectionHandler.h"
+#include "ConnectionSlab.h"
+#include "IoBackend.h"
+#include "HotRestart.h"
+#include "ServerConfig.h"
+#ifdef HAVE_COROUTINES
+#include <unordered_map>
+#include "Coroutine.h"
+#endif
+
+class NetworkServer;
+
+// One broadcast, framed once for each wire format in use and shared by
+// every connection's send queue. With compression enabled it is also
+// compressed once, for the length32 connections that negotiated it.
+struct BroadcastPayload {
+    std::shared_ptr<const SharedPayload> framed[Framing::MODE_COUNT];
+    std::shared_ptr<const SharedPayload> compressed;
+
+    // The form to queue on handler, nullptr if its framing was not built
+    const std::shared_ptr<const SharedPayload>& forConnection(const ConnectionHandler& handler) const {
+        if (compressed && handler.isCompressing()) {
+            return compressed;
+        }
+        return framed[static_cast<size_t>(handler.getFraming())];
+    }
+};
+
+// A single event loop.
+// Each reactor owns its listening socket, its I/O backend (epoll or
+// io_uring) and the connections it accepted, so several reactors can run
+// side by side without sharing any lock on the accept/read/write path.
+class Reactor {
+public:
+    Reactor(NetworkServer& server, int id, bool reuse_port, bool inline_io);
+    ~Reactor();
+
+    bool start();
+    void run();
+    void close();
+
+    // Run the event loop on a dedicated thread / wait for it to finish
+    void startThread();
+    void join();
+
+    // Cross-thread operations, safe to call from message handlers
+    // Disconnected when client_fd is not one of this reactor's connections
+    SendStatus sendToClient(int client_fd, const std::string& message);
+    bool forceWriteEvent(int client_fd);
+    // Queue payload on every connection; the fan-out runs on this reactor's thread
+    void broadcastMessage(std::shared_ptr<const BroadcastPayload> payload);
+
+    // Run task on the reactor thread at its next wakeup. Thread-safe.
+    void post(std::function<void()> task);
+
+    // Take the reloadable settings of fresh (see NetworkServer::reloadConfig)
+    // and reschedule every connection's timeouts; runs on the reactor thread
+    void applySettings(const ServerConfig& fresh);
+    // Hot restart: the listening sockets to hand over, and stop accepting on
+    // them once a successor did. They stay open until close().
+    void appendListeners(std::vector<HandoffSocket>& sockets) const;
+    void detachListeners();
+
+    size_t getConnectionCount() const;
+    // One-off sweep, runs on the reactor thread; routine expiry uses the timer wheel
+    void cleanupInactiveConnections(int timeout_seconds);
+    int getId() const { return id_; }
+    // CPU the event loop is pinned to, -1 when unpinned
+    int getCpu() const { return cpu_; }
+    const char* getBackendName() const { return backend_ ? backend_->name() : "none"; }
+
+#ifdef HAVE_COROUTINES
+    // Reactor whose event loop runs on the calling thread, nullptr elsewhere
+    static Reactor* current();
+    const CoroutineArena& getCoroutineArena() const { return arena_; }
+#endif
+
+private:
+    friend class EpollBackend;
+    friend class UringBackend;
+#ifdef HAVE_COROUTINES
+    friend class SleepAwaiter;
+    friend class AsyncConnection;
+#endif
+
+    // A listening socket and the framing of the connections it accepts
+    struct Listener {
+        int fd;
+        int port;
+        FramingMode framing;
+        bool tls;       // Connections start with a TLS handshake
+        bool detached;  // Handed to a successor process, no longer accepting
+    };
+
+    NetworkServer& server_;
+    // The server's settings; reloadable ones are updated on this thread
+    ServerConfig config_;
+    int id_;
+    int cpu_;           // From reactor_cpus, -1 when unpinned
+    bool reuse_port_;
+    bool inline_io_;    // Handle I/O on the reactor thread instead of connection workers
+    std::vector<Listener> listeners_;
+    std::unique_ptr<IoBackend> backend_;
+    int wake_fd_;       // eventfd used to hand connections and tasks to this thread
+    // Spare descriptor given up at the fd limit so a pending connection can
+    // be accepted and closed instead of staying readable on the listener
+    int reserve_fd_;
+    std::chrono::steady_clock::time_point last_fd_limit_warning_;
+    size_t next_worker_;
+    std::thread thread_;
+    std::atomic<std::thread::id> loop_thread_;  // Set once run() starts
+
+    // Guards connections_ against lookups from other threads.
+    // Only the reactor thread inserts or releases entries, so it reads the
+    // slab without the lock.
+    mutable std::mutex connections_mutex_;
+    ConnectionSlab connections_;
+
+    // Connections whose worker reported them closed, reaped on the reactor thread
+    std::mutex retired_mutex_;
+    std::vector<ConnectionHandle> retired_;
+
+    // Work posted from other threads, run on the reactor thread
+    std::mutex tasks_mutex_;
+    std::vector<std::function<void()>> tasks_;
+
+    // Per-connection idle/read/write/heartbeat deadlines, reactor thread only.
+    // I/O threads only store timestamps; an expiring entry re-checks them and
+    // is rescheduled if the connection was active in the meantime.
+    static constexpr int TIMER_TICK_MS = 100;
+    TimerWheel<ConnectionHandler> timers_;
+    uint64_t last_shed_tick_;   // Load shedding runs at most once per tick
+
+    // Tick flushing (flush_interval_ms > 0): deferred replies of every
+    // connection are written together once per interval
+    std::chrono::milliseconds flush_interval_;
+    std::chrono::steady_clock::time_point next_flush_;
+
+#ifdef HAVE_COROUTINES
+    // Session coroutines, reactor thread only. The arena is declared last
+    // so frames destroyed with it can still cancel their sleeps.
+    TimerWheel<SleepAwaiter> sleeps_;
+    std::unordered_map<ConnectionHandle, std::shared_ptr<AsyncConnection::Session>> sessions_;
+    CoroutineArena arena_;
+
+    // Route a new connection's messages to a session, then start its coroutine
+    void attachSession(ConnectionHandle handle, ConnectionHandler* handler);
+    void startSession(ConnectionHandle handle);
+    void scheduleSleep(SleepAwaiter* sleeper, std::chrono::steady_clock::time_point deadline);
+    void cancelSleep(SleepAwaiter* sleeper);
+#endif
+
+    bool setupServer();
+    bool setupListener(int port, FramingMode framing, bool tls = false);
+    // reuseport_steering: route connections to the reactor on the CPU that received them
+    void steerListener(int server_fd);
+    bool setupBackend();
+    void setNonBlocking(int fd);
+    bool inLoopThread() const { return std::this_thread::get_id() == loop_thread_.load(std::memory_order_relaxed); }
+    const Listener* findListener(int fd) const;
+    void addConnection(const Listener& listener, int client_fd, const PeerAddress& peer);
+    // Connections to accept per listener wakeup, 0 for no limit
+    size_t acceptBatch() const;
+    // At EMFILE/ENFILE: accept one pending connection on the reserve fd and
+    // drop it. Returns false when there was nothing to accept.
+    bool rejectPendingConnection(int listen_fd);
+    // Readiness events from the epoll backend
+    void handleClientEvent(ConnectionHandle handle, uint32_t events);
+    void cleanupConnection(ConnectionHandle handle);
+    void closeConnection(ConnectionHandle handle);
+    void retireConnection(ConnectionHandle handle);
+    void wake();
+    void handleWakeup();
+    void runTasks();
+    void reapRetiredConnections();
+    void deliverBroadcast(const BroadcastPayload& payload);
+    void sweepInactiveConnections(int timeout_seconds);
+    void shedLoad();
+    void flushIfDue(std::chrono::steady_clock::time_point now);
+    void scheduleTimeouts(ConnectionHandler* handler, std::chrono::steady_clock::time_point now);
+    void checkTimeouts(ConnectionHandler* handler);
+    static uint64_t toTick(std::chrono::steady_clock::time_point time, bool round_up);
+};
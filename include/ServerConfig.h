@@ -0,0 +1,129 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "BufferConfig.h"
+#include "Framing.h"
+#include "Logger.h"
+
+// One entry of the cluster membership list, "id@host:port"
+struct ClusterMember {
+    int id;
+    std::string host;
+    int port;
+};
+
+// Structure to hold configuration settings loaded from settings.config
+struct ServerConfig {
+    int port = 8080;
+    int max_connections = 1000;
+    // Connections a reactor accepts per listener wakeup before it serves
+    // established clients again; 0 drains the whole backlog every time
+    int accept_batch = 64;
+    int thread_count = 4;
+
+    // Number of independent epoll reactors.
+    // 1 keeps the classic single event loop that hands I/O to the thread pool,
+    // >1 gives every reactor its own SO_REUSEPORT listener, epoll fd and
+    // connection table, and handles I/O inline on the reactor thread.
+    // 0 means one reactor per hardware thread.
+    int reactor_count = 1;
+
+    // Socket I/O backend: "epoll" or "io_uring". io_uring (Linux 6.1+)
+    // handles I/O inline on every reactor thread, also with one reactor,
+    // and falls back to epoll when the kernel or build lacks support.
+    std::string io_backend = "epoll";
+
+    // Framing on the main port; newline keeps TestClient compatible
+    FramingMode framing = FramingMode::Newline;
+    // Optional second listener with its own framing, 0 disables it
+    int binary_port = 0;
+    FramingMode binary_framing = FramingMode::Length32;
+    // UDP side channel for loss-tolerant traffic, tied to the TCP sessions
+    // by token (see UdpTransport); 0 disables it
+    int udp_port = 0;
+    // TLS listener with the main port's framing, 0 disables it. The
+    // handshake runs in user space, then kernel TLS (kTLS) takes over the
+    // record layer, so the tls kernel module is required.
+    int tls_port = 0;
+    std::string tls_cert_file = "server.crt";   // PEM certificate chain
+    std::string tls_key_file = "server.key";    // PEM private key
+
+    // CPU placement (see CpuAffinity). Lists like "0-3,8"; thread i of a
+    // kind runs on entry i modulo the list length, and its connection
+    // state is allocated on that CPU's NUMA node. Empty leaves the threads
+    // to the scheduler.
+    std::vector<int> reactor_cpus;
+    std::vector<int> worker_cpus;       // ConnectionWorkers (reactor_count 1)
+    std::vector<int> scheduler_cpus;    // ThreadPool / WorkStealingPool
+    // With several reactors, hand each connection to the reactor pinned to
+    // the CPU that received it: "none", "incoming_cpu" (SO_INCOMING_CPU on
+    // each listener) or "cbpf" (SO_ATTACH_REUSEPORT_CBPF program)
+    std::string reuseport_steering = "none";
+
+    // Hot restart (see HotRestart): a process starting with the same path
+    // takes over the listening sockets of the one running, which then
+    // drains its connections for up to drain_timeout seconds. Empty
+    // disables it.
+    std::string hot_restart_socket;
+    int drain_timeout = 30;
+
+    // Cluster mode (see ClusterRelay): every node lists the same members
+    // and names itself by id; broadcasts and publishes are relayed to all
+    // other members. 0 disables it.
+    int cluster_node_id = 0;
+    std::vector<ClusterMember> cluster_nodes;
+
+    // Negotiated compression of server messages on length32 listeners:
+    // "none" or "zstd" (see MessageCompressor). Messages below min_size go
+    // out plain; the dictionary is a `zstd --train` file, empty for none.
+    std::string compression = "none";
+    int compression_level = 3;
+    size_t compression_min_size = 512;
+    std::string compression_dictionary;
+
+    // Scheduler behind NetworkServer::post() for application work:
+    // "threadpool" (single shared queue) or "workstealing"
+    std::string scheduler = "threadpool";
+    // Threads for that scheduler, 0 means thread_count
+    int scheduler_threads = 0;
+
+    // Per-connection timeouts in seconds, enforced by each reactor's timer
+    // wheel; 0 disables a timeout
+    int idle_timeout = 300;         // No bytes read or written
+    int read_timeout = 0;           // No bytes read
+    int write_timeout = 0;          // Queued data made no progress
+    int heartbeat_interval = 0;     // Send an empty message after this long without writing
+
+    // Backpressure: stop reading from a client once this many bytes wait in
+    // its send queue, resume at the low mark; 0 disables pausing
+    size_t send_high_watermark = BufferConfig::SEND_HIGH_WATERMARK;
+    size_t send_low_watermark = BufferConfig::SEND_LOW_WATERMARK;
+    // Tick flushing for game-loop style servers: replies are buffered and
+    // written once every flush_interval_ms, or as soon as flush_threshold
+    // bytes wait on a connection; 0 writes replies as they are queued
+    int flush_interval_ms = 0;
+    size_t flush_threshold = 64 * 1024;
+    // Process-wide buffer memory limit in MB (MemoryTracker). Above it new
+    // connections and queued data are refused and the slowest readers are
+    // disconnected; 0 disables the limit.
+    size_t max_memory_mb = BufferConfig::MAX_TOTAL_MEMORY_MB;
+
+    // Admin HTTP endpoint serving GET /metrics in Prometheus text format on
+    // its own thread; 0 disables it and everything it would measure
+    int admin_port = 0;
+    std::string admin_address = "127.0.0.1";
+
+    // Traffic capture (see TrafficCapture): every inbound message with its
+    // connection and read time, appended to a memory-mapped file of at most
+    // capture_max_mb, for LoadGenerator --replay. Empty disables it.
+    std::string capture_file;
+    size_t capture_max_mb = 1024;
+
+    // Minimum level written by the logger: debug, info, warn, error, off.
+    // Debug lines are compiled in only for Debug builds.
+    LogLevel log_level = LogLevel::Info;
+};
+
+// Read configuration from file, falling back to defaults for missing keys
+ServerConfig readConfig(const std::string& filename);
@@ -12,10 +12,16 @@
 
 class ThreadPool {
 public:
-    ThreadPool(size_t threads);
+    // on_thread_start(i) runs first on worker thread i, e.g. to pin it
+    ThreadPool(size_t threads, std::function<void(size_t)> on_thread_start = nullptr);
     template<class F, class... Args>
     auto enqueue(F&& f, Args&&... args) 
         -> std::future<typename std::result_of<F(Args...)>::type>;
+    // Fire-and-forget variant without packaged_task/future overhead
+    template<class F>
+    void post(F&& f);
+    // Tasks waiting for a free worker
+    size_t pending();
     ~ThreadPool();
     std::vector< std::thread > workers;
 
@@ -29,13 +35,16 @@ private:
 };
  
 // the constructor just launches some amount of workers
-inline ThreadPool::ThreadPool(size_t threads)
+inline ThreadPool::ThreadPool(size_t threads, std::function<void(size_t)> on_thread_start)
     :   stop(false)
 {
     for(size_t i = 0;i<threads;++i)
         workers.emplace_back(
-            [this]
+            [this, i, on_thread_start]
             {
+                if(on_thread_start)
+                    on_thread_start(i);
+
                 for(;;)
                 {
                     std::function<void()> task;
@@ -81,6 +90,26 @@ auto ThreadPool::enqueue(F&& f, Args&&... args)
     return res;
 }
 
+template<class F>
+void ThreadPool::post(F&& f)
+{
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+
+        if(stop)
+            throw std::runtime_error("post on stopped ThreadPool");
+
+        tasks.emplace(std::forward<F>(f));
+    }
+    condition.notify_one();
+}
+
+inline size_t ThreadPool::pending()
+{
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    return tasks.size();
+}
+
 // the destructor joins all threads
 inline ThreadPool::~ThreadPool()
 {
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Link embedded in objects scheduled on a TimerWheel
+template<class T>
+struct TimerNode {
+    TimerNode* prev = nullptr;
+    TimerNode* next = nullptr;
+    uint64_t expires = 0;       // Tick at which the timer fires
+    T* owner = nullptr;
+
+    bool isScheduled() const { return next != nullptr; }
+};
+
+// Hierarchical timing wheel (Varghese & Lauck).
+//
+// LEVELS wheels of SLOTS slots each; level l covers SLOTS^(l+1) ticks.
+// schedule() and cancel() are O(1), advance() touches only the slots that
+// become due, and nodes are cascaded into finer levels as they approach
+// expiry. Timers beyond the range of the wheel fire at its horizon.
+// Not thread-safe: owned by one event loop.
+template<class T>
+class TimerWheel {
+public:
+    static constexpr size_t SLOT_BITS = 6;
+    static constexpr size_t SLOTS = size_t(1) << SLOT_BITS;
+    static constexpr size_t LEVELS = 4;
+    static constexpr uint64_t HORIZON = (uint64_t(1) << (SLOT_BITS * LEVELS)) - 1;
+
+    explicit TimerWheel(uint64_t now = 0) : current_(now), count_(0) {
+        for (auto& level : slots_) {
+            for (auto& slot : level) {
+                slot.prev = &slot;
+                slot.next = &slot;
+            }
+        }
+    }
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    // (Re)schedule node to fire at tick expires; past ticks fire on the next advance
+    void schedule(TimerNode<T>* node, uint64_t expires) {
+        cancel(node);
+        if (expires <= current_) {
+            expires = current_ + 1;
+        } else if (expires - current_ > HORIZON) {
+            expires = current_ + HORIZON;
+        }
+        node->expires = expires;
+        insert(node);
+        ++count_;
+    }
+
+    void cancel(TimerNode<T>* node) {
+        if (!node->isScheduled()) {
+            return;
+        }
+        unlink(node);
+        --count_;
+    }
+
+    // Move time forward to now, calling expire(T*) for every timer that is
+    // due. The node is unscheduled before the call, so the callback may
+    // reschedule it or destroy its owner.
+    template<class Expire>
+    void advance(uint64_t now, Expire&& expire) {
+        while (current_ < now) {
+            ++current_;
+            cascade();
+
+            TimerNode<T>& slot = slots_[0][current_ & (SLOTS - 1)];
+            while (slot.next != &slot) {
+                TimerNode<T>* node = slot.next;
+                unlink(node);
+                --count_;
+                expire(node->owner);
+            }
+        }
+    }
+
+    uint64_t now() const { return current_; }
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+
+private:
+    TimerNode<T> slots_[LEVELS][SLOTS];    // Sentinels of circular lists
+    uint64_t current_;
+    size_t count_;
+
+    void insert(TimerNode<T>* node) {
+        uint64_t delta = node->expires - current_;
+        size_t level = 0;
+        while (level + 1 < LEVELS && delta >= (uint64_t(1) << (SLOT_BITS * (level + 1)))) {
+            ++level;
+        }
+
+        size_t index = (node->expires >> (SLOT_BITS * level)) & (SLOTS - 1);
+        TimerNode<T>& slot = slots_[level][index];
+        node->prev = slot.prev;
+        node->next = &slot;
+        slot.prev->next = node;
+        slot.prev = node;
+    }
+
+    void unlink(TimerNode<T>* node) {
+        node->prev->next = node->next;
+        node->next->prev = node->prev;
+        node->prev = nullptr;
+        node->next = nullptr;
+    }
+
+    // When a finer wheel wraps, redistribute the next slot of the coarser one
+    void cascade() {
+        for (size_t level = 1; level < LEVELS; ++level) {
+            if ((current_ & ((uint64_t(1) << (SLOT_BITS * level)) - 1)) != 0) {
+                break;
+            }
+
+            size_t index = (current_ >> (SLOT_BITS * level)) & (SLOTS - 1);
+            TimerNode<T>& slot = slots_[level][index];
+            while (slot.next != &slot) {
+                TimerNode<T>* node = slot.next;
+                unlink(node);
+                insert(node);
+            }
+        }
+    }
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+typedef struct ssl_st SSL;
+typedef struct ssl_ctx_st SSL_CTX;
+
+// Server side of one TLS handshake on a non-blocking socket.
+//
+// The handshake runs in user space on the connection's I/O thread. When it
+// completes, OpenSSL has installed the traffic keys in the kernel (kTLS,
+// TCP_ULP "tls") for both directions, so the socket reads and writes
+// plaintext from then on and the session is discarded: the usual recv(),
+// sendmsg() and io_uring paths work unchanged, and encryption happens in
+// the kernel or the NIC.
+class TlsSession {
+public:
+    enum class Status {
+        Pending,    // Waiting for the client, call handshake() once it is readable
+        WantWrite,  // The socket is full, call handshake() once it is writable
+        Done,       // Keys are in the kernel, the session can be destroyed
+        Failed      // See error()
+    };
+
+    explicit TlsSession(SSL* ssl) : ssl_(ssl) {}
+    ~TlsSession();
+
+    TlsSession(const TlsSession&) = delete;
+    TlsSession& operator=(const TlsSession&) = delete;
+
+    // Advance the handshake as far as the socket allows
+    Status handshake();
+    const std::string& error() const { return error_; }
+
+private:
+    SSL* ssl_;
+    std::string error_;
+};
+
+// Certificate, key and protocol settings shared by every TLS listener.
+//
+// Only what kTLS can carry is negotiated: AES-GCM or ChaCha20-Poly1305, no
+// renegotiation and no session tickets, which would otherwise be sent
+// after the keys moved to the kernel. With OpenSSL before 3.2 the kernel
+// receive path needs TLS 1.2, so TLS 1.3 is only offered from 3.2 on.
+// Records the kernel cannot decrypt as data (alerts, a TLS 1.3 KeyUpdate)
+// fail the read, and the connection is closed.
+class TlsContext {
+public:
+    TlsContext();
+    ~TlsContext();
+
+    TlsContext(const TlsContext&) = delete;
+    TlsContext& operator=(const TlsContext&) = delete;
+
+    // Load the PEM certificate chain and key and check that the kernel has
+    // TLS offload; false (logged) otherwise, or when built without OpenSSL
+    bool init(const std::string& cert_file, const std::string& key_file);
+
+    // Session for a freshly accepted socket, nullptr on failure. Thread-safe.
+    std::unique_ptr<TlsSession> accept(int client_fd);
+
+private:
+    SSL_CTX* ctx_;
+
+    static bool kernelTlsAvailable();
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ConnectionHandler.h"
+#include "Reactor.h"
+
+// Topic/room subscriptions for publish-subscribe fan-out.
+//
+// Each topic keeps a compact array of its members, so publishing walks only
+// the room and never the whole connection table. Publishers share the lock;
+// subscribe, unsubscribe and connection teardown take it exclusively, which
+// keeps every member pointer valid for the duration of a publish.
+class TopicRegistry {
+public:
+    TopicRegistry() = default;
+
+    TopicRegistry(const TopicRegistry&) = delete;
+    TopicRegistry& operator=(const TopicRegistry&) = delete;
+
+    // Returns false if the connection is closed or already subscribed
+    bool subscribe(ConnectionHandler* handler, const std::string& topic);
+    bool unsubscribe(ConnectionHandler* handler, const std::string& topic);
+
+    // Drop every subscription of a connection that is being torn down
+    void unsubscribeAll(ConnectionHandler* handler);
+
+    // Queue the pre-framed payload on every member and flush them.
+    // Returns the number of members it was queued on.
+    size_t publish(const std::string& topic, const BroadcastPayload& payload);
+
+    size_t getSubscriberCount(const std::string& topic) const;
+    size_t getTopicCount() const;
+
+private:
+    struct Topic {
+        std::string name;
+        std::vector<ConnectionHandler*> members;
+    };
+
+    mutable std::shared_mutex mutex_;
+    std::unordered_map<std::string, Topic> topics_;
+    // Reverse index for teardown, topics are node-based so pointers stay valid
+    std::unordered_map<ConnectionHandler*, std::vector<Topic*>> subscriptions_;
+
+    void removeMember(Topic& topic, ConnectionHandler* handler);
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "Framing.h"
+
+// Traffic capture file (capture_file), replayed by LoadGenerator --replay.
+//
+// A CaptureFileHeader is followed by records, each a CaptureRecord and its
+// payload, padded to RECORD_ALIGNMENT. Records appear in the order their
+// space was reserved, which is timestamp order per connection. A record's
+// size is stored last, so a zero size marks where the log ends, including
+// in the file of a process that did not exit cleanly.
+struct CaptureFileHeader {
+    char magic[8];                  // TrafficCapture::MAGIC
+    uint32_t version;
+    uint32_t header_size;           // Offset of the first record
+    uint64_t start_unix_ns;         // Wall clock when the capture started
+};
+
+enum class CaptureRecordType : uint8_t {
+    Open = 1,                       // Connection accepted
+    Message = 2,                    // One inbound message, as given to the handler
+    Close = 3                       // Connection released
+};
+
+struct CaptureRecord {
+    uint32_t size;                  // Header, payload and padding; 0 where the log ends
+    uint32_t connection;            // Capture-wide connection id, from 1
+    uint64_t timestamp_ns;          // Since the capture started; for messages, their read
+    uint8_t type;                   // CaptureRecordType
+    uint8_t framing;                // FramingMode of the connection's listener
+    uint16_t reserved;
+    uint32_t length;                // Payload bytes
+};
+static_assert(sizeof(CaptureRecord) == 24, "capture records are part of the file format");
+
+// Append-only capture of the inbound messages of every connection into a
+// memory-mapped file of at most max_bytes, reserved up front.
+//
+// Writers on any I/O thread reserve their record with one atomic add on
+// the write offset and copy it into the mapping: no lock, no syscall and
+// no buffering thread; the kernel writes the pages back. Once the file is
+// full further records are dropped and counted. The destructor trims the
+// file to what was written.
+class TrafficCapture {
+public:
+    static constexpr char MAGIC[8] = {'N', 'S', 'C', 'A', 'P', 'T', 'U', 'R'};
+    static constexpr uint32_t VERSION = 1;
+    static constexpr size_t RECORD_ALIGNMENT = 8;
+
+    TrafficCapture();
+    ~TrafficCapture();
+
+    TrafficCapture(const TrafficCapture&) = delete;
+    TrafficCapture& operator=(const TrafficCapture&) = delete;
+
+    // Create path, keeping an existing capture as path.prev; false (logged)
+    // if the file cannot be created or its space reserved
+    bool open(const std::string& path, size_t max_bytes);
+
+    // Thread-safe. Connection ids are never reused within a capture.
+    uint32_t openConnection(FramingMode framing);
+    void recordMessage(uint32_t connection, FramingMode framing, std::string_view message,
+                       std::chrono::steady_clock::rep read_time);
+    void closeConnection(uint32_t connection, FramingMode framing);
+
+    size_t getBytesWritten() const;
+
+private:
+    std::string path_;
+    int fd_;
+    char* map_;
+    size_t capacity_;
+    std::atomic<size_t> offset_;
+    std::atomic<uint32_t> next_connection_;
+    std::atomic<bool> full_;        // Warned once
+    std::chrono::steady_clock::time_point start_;
+
+    void append(CaptureRecordType type, uint32_t connection, FramingMode framing,
+                std::string_view payload, std::chrono::steady_clock::time_point time);
+};
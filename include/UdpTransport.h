@@ -0,0 +1,107 @@
+#pragma once
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "MessageBuffer.h"
+
+class ConnectionHandler;
+
+// UDP side channel for loss-tolerant, latency-sensitive traffic such as
+// position updates, next to the TCP listeners.
+//
+// Every TCP session gets a random 64-bit token; the application hands it to
+// its client over TCP (ConnectionHandler::getDatagramToken()). Client
+// datagrams start with that token in network byte order, followed by the
+// payload, and are delivered together with the session's ConnectionHandler.
+// The address a session's datagrams last came from is where its outgoing
+// datagrams go, so a client behind a rebinding NAT keeps working. Server
+// datagrams carry the payload only.
+//
+// One thread receives with recvmmsg() and sends with sendmmsg(); runs of
+// equal-sized datagrams to one client leave as a single UDP_SEGMENT (GSO)
+// message when the kernel supports it. Datagram buffers come from the
+// MessageBufferPool size classes, so payloads are limited to
+// MAX_DATAGRAM_SIZE.
+class UdpTransport {
+public:
+    static constexpr size_t TOKEN_SIZE = sizeof(uint64_t);
+    static constexpr size_t MAX_DATAGRAM_SIZE = MessageBufferPool::MAX_BUFFER_SIZE;
+    static constexpr size_t RECV_BATCH = 64;        // Datagrams per recvmmsg()
+    static constexpr size_t SEND_BATCH = 64;        // Messages per sendmmsg()
+    static constexpr size_t SEND_SEGMENTS = 256;    // Datagrams per sendmmsg()
+    static constexpr size_t MAX_GSO_SEGMENTS = 64;  // Kernel limit per UDP_SEGMENT message
+    static constexpr size_t MAX_GSO_SEGMENT_SIZE = 1472; // Fits a 1500-byte MTU
+    static constexpr size_t MAX_GSO_BYTES = 65000;  // One GSO message stays below the IP limit
+    static constexpr size_t SEND_QUEUE_LIMIT = 4096; // Datagrams waiting to be sent, more are dropped
+
+    using Handler = std::function<void(std::string_view, ConnectionHandler*)>;
+
+    UdpTransport(int port, Handler handler);
+    ~UdpTransport();
+
+    UdpTransport(const UdpTransport&) = delete;
+    UdpTransport& operator=(const UdpTransport&) = delete;
+
+    bool start();
+    // Close the socket; sessions may still call send(), which then fails,
+    // so a draining server can stop it early (hot restart)
+    void stop();
+
+    // Make a session reachable by datagrams carrying its new token, and
+    // unreachable again before the handler is destroyed. Waits for a
+    // datagram handler running on that session to return.
+    void registerSession(ConnectionHandler* handler);
+    void unregisterSession(ConnectionHandler* handler);
+
+    // Queue payload to the session's datagram endpoint. Thread-safe. False
+    // when no datagram arrived from the client yet, the payload is larger
+    // than MAX_DATAGRAM_SIZE, or the send queue or memory limit is full.
+    bool send(ConnectionHandler* handler, const char* data, size_t length);
+
+    bool isGsoEnabled() const { return gso_enabled_; }
+
+private:
+    struct Outgoing {
+        struct sockaddr_in peer;
+        std::unique_ptr<MessageBuffer> buffer;
+    };
+
+    int port_;
+    Handler handler_;
+    int socket_fd_;
+    int wake_fd_;       // eventfd for queued sends and stop()
+    std::atomic<bool> running_;
+    bool gso_enabled_;
+    std::thread thread_;
+
+    // Token -> session. Datagram handlers run under the shared lock, so a
+    // session cannot be unregistered and destroyed while one is using it.
+    std::shared_mutex sessions_mutex_;
+    std::unordered_map<uint64_t, ConnectionHandler*> sessions_;
+
+    // Filled by any thread, drained by the transport thread
+    std::mutex queue_mutex_;
+    std::vector<Outgoing> queued_;
+
+    // Transport thread only
+    std::vector<Outgoing> sending_;     // Taken from queued_, not sent yet
+    std::vector<std::unique_ptr<MessageBuffer>> receive_buffers_;
+
+    void run();
+    size_t receiveBatch();
+    void deliver(std::string_view datagram, const struct sockaddr_in& from);
+    // Send what is queued; false when the socket buffer is full
+    bool flushSends();
+    void releaseSent(size_t count);
+    bool onTransportThread() const { return std::this_thread::get_id() == thread_.get_id(); }
+};
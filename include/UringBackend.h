@@ -0,0 +1,145 @@
+#pragma once
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "IoBackend.h"
+
+class Reactor;
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct io_uring_buf_ring;
+
+// Completion-based backend on io_uring (Linux 6.1+), driven through the raw
+// syscalls so no liburing is needed.
+//
+// Each listener has one multishot accept and each connection one multishot
+// recv that picks buffers from a ring shared by the reactor's connections.
+// Received bytes are copied into the connection's read buffer and the
+// buffer goes straight back to the kernel, unless backpressure left no room
+// for them; then it is held until the connection resumes reading. TLS connections poll for
+// readability until their handshake is done and start receiving after. Sends are sendmsg() of the
+// gathered send queue, one in flight per connection. Everything that comes
+// up while completions are processed is submitted together with the next
+// wait, so the loop costs one io_uring_enter() per iteration however many
+// connections it serves. I/O always runs inline on the reactor thread.
+class UringBackend : public IoBackend {
+public:
+    static constexpr unsigned RING_ENTRIES = 1024;
+    static constexpr unsigned RECV_BUFFER_COUNT = 512;     // Power of two
+    static constexpr unsigned RECV_BUFFER_SIZE = 4096;
+    static constexpr size_t SEND_BATCH = 64;               // iovecs per sendmsg
+
+    explicit UringBackend(Reactor& reactor);
+    ~UringBackend() override;
+
+    // False when the kernel lacks a required feature; the reactor then
+    // falls back to epoll
+    bool init();
+
+    const char* name() const override { return "io_uring"; }
+
+    bool addListener(int listen_fd) override;
+    void removeListener(int listen_fd) override;
+    bool addWakeFd(int wake_fd) override;
+
+    bool addConnection(ConnectionHandle handle, ConnectionHandler* handler) override;
+    void removeConnection(ConnectionHandle handle, ConnectionHandler* handler) override;
+    void release(ConnectionHandle handle, std::unique_ptr<ConnectionHandler> handler) override;
+
+    void write(ConnectionHandle handle, ConnectionHandler* handler) override;
+    void requestWrite(ConnectionHandle handle, ConnectionHandler* handler) override;
+    void writeBlockedChanged(ConnectionHandle handle, ConnectionHandler* handler) override;
+    void resumeRead(ConnectionHandle handle, ConnectionHandler* handler) override;
+
+    bool poll(int timeout_ms) override;
+
+private:
+    struct HeldBuffer {
+        uint16_t buffer_id;
+        uint32_t length;
+    };
+
+    // Kernel-visible state of one connection; outlives its slab entry until
+    // every request that references it has completed
+    struct Connection {
+        ConnectionHandle handle;
+        ConnectionHandler* handler;
+        std::unique_ptr<ConnectionHandler> owned;   // Set once released
+        unsigned inflight = 0;
+        bool receiving = false;
+        bool handshaking = false;       // Polling for the client's next TLS flight
+        bool recv_cancelled = false;    // Paused by backpressure, cancel submitted
+        bool sending = false;
+        bool closing = false;
+        // Completions a paused connection could not take yet, oldest first
+        std::vector<HeldBuffer> held;
+        struct msghdr msg;
+        struct iovec iov[SEND_BATCH];
+    };
+
+    enum Op : uint64_t {
+        OP_ACCEPT = 1,
+        OP_WAKE,
+        OP_RECV,
+        OP_SEND,
+        OP_CANCEL,
+        OP_LISTEN_POLL, // Re-arms the accept once a client is pending
+        OP_HANDSHAKE    // TLS connection readable during its handshake
+    };
+
+    Reactor& reactor_;
+    int ring_fd_;
+    bool enabled_;
+
+    // Submission and completion rings, mapped from the kernel
+    void* ring_map_;
+    size_t ring_map_size_;
+    struct io_uring_sqe* sqes_;
+    size_t sqes_size_;
+    unsigned* sq_head_;
+    unsigned* sq_tail_;
+    unsigned sq_mask_;
+    unsigned* sq_array_;
+    unsigned* cq_head_;
+    unsigned* cq_tail_;
+    unsigned cq_mask_;
+    struct io_uring_cqe* cqes_;
+    unsigned sq_local_tail_;
+    unsigned to_submit_;
+
+    // Provided receive buffers
+    struct io_uring_buf_ring* buf_ring_;
+    size_t buf_ring_size_;
+    char* buffers_;
+    uint16_t buf_tail_;
+
+    int wake_fd_;
+    std::vector<std::unique_ptr<Connection>> connections_;  // By slab index
+    std::vector<std::unique_ptr<Connection>> closing_;      // Waiting for completions
+
+    bool setupRing();
+    bool setupBuffers();
+    struct io_uring_sqe* getSqe();
+    int enter(unsigned to_submit, unsigned min_complete, int timeout_ms);
+
+    Connection* lookup(ConnectionHandle handle) const;
+    void submitAccept(int listen_fd);
+    void submitWakePoll();
+    void submitListenPoll(int listen_fd);
+    void submitRecv(Connection* conn);
+    void submitHandshakePoll(Connection* conn);
+    void cancelRecv(Connection* conn);
+    void submitSend(Connection* conn);
+    void recycleBuffer(uint16_t buffer_id);
+    void recycleHeld(Connection* conn);
+
+    void handleCompletion(const struct io_uring_cqe& cqe);
+    void handleAccept(int listen_fd, int result, bool more);
+    void handleRecv(Connection* conn, int result, uint32_t flags);
+    void handleSend(Connection* conn, int result);
+    void handleHandshake(Connection* conn, int result);
+    void reapClosed();
+};
@@ -0,0 +1,452 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <atomic>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <type_traits>
+#include <stdexcept>
+
+// Type-erased, small-buffer-optimized task.
+// Callables up to INLINE_SIZE bytes are constructed in place, larger ones
+// fall back to the heap. Nodes are recycled through TaskNodeAllocator so a
+// posted task normally costs no allocation at all.
+struct TaskNode {
+    static constexpr size_t INLINE_SIZE = 48;
+
+    std::atomic<TaskNode*> next{nullptr};   // Intrusive link for inbox / free lists
+    void (*invoke)(TaskNode*) = nullptr;    // Runs and destroys the callable
+
+    alignas(std::max_align_t) unsigned char storage[INLINE_SIZE];
+
+    template<class F>
+    void emplace(F&& f) {
+        using Fn = typename std::decay<F>::type;
+        if (sizeof(Fn) <= INLINE_SIZE && alignof(Fn) <= alignof(std::max_align_t)) {
+            new (storage) Fn(std::forward<F>(f));
+            invoke = [](TaskNode* node) {
+                Fn* fn = std::launder(reinterpret_cast<Fn*>(node->storage));
+                (*fn)();
+                fn->~Fn();
+            };
+        } else {
+            Fn* heap_fn = new Fn(std::forward<F>(f));
+            std::memcpy(storage, &heap_fn, sizeof(heap_fn));
+            invoke = [](TaskNode* node) {
+                Fn* fn;
+                std::memcpy(&fn, node->storage, sizeof(fn));
+                std::unique_ptr<Fn> owner(fn);
+                (*fn)();
+            };
+        }
+    }
+
+    void run() { invoke(this); }
+};
+
+// Per-thread magazine of free TaskNodes backed by a shared depot.
+// The depot lock is only taken once per BATCH nodes.
+class TaskNodeAllocator {
+public:
+    static constexpr size_t BATCH = 64;
+
+    static TaskNode* allocate() {
+        Magazine& magazine = local();
+        if (magazine.nodes.empty()) {
+            depot().take(magazine.nodes, BATCH);
+        }
+        if (magazine.nodes.empty()) {
+            return new TaskNode();
+        }
+        TaskNode* node = magazine.nodes.back();
+        magazine.nodes.pop_back();
+        return node;
+    }
+
+    static void release(TaskNode* node) {
+        Magazine& magazine = local();
+        magazine.nodes.push_back(node);
+        if (magazine.nodes.size() >= BATCH * 4) {
+            depot().give(magazine.nodes, BATCH * 2);
+        }
+    }
+
+private:
+    struct Depot {
+        std::mutex mutex;
+        std::vector<TaskNode*> nodes;
+
+        void take(std::vector<TaskNode*>& into, size_t count) {
+            std::lock_guard<std::mutex> lock(mutex);
+            while (count-- > 0 && !nodes.empty()) {
+                into.push_back(nodes.back());
+                nodes.pop_back();
+            }
+        }
+
+        void give(std::vector<TaskNode*>& from, size_t count) {
+            std::lock_guard<std::mutex> lock(mutex);
+            while (count-- > 0 && !from.empty()) {
+                nodes.push_back(from.back());
+                from.pop_back();
+            }
+        }
+
+        ~Depot() {
+            for (TaskNode* node : nodes) {
+                delete node;
+            }
+        }
+    };
+
+    struct Magazine {
+        std::vector<TaskNode*> nodes;
+
+        ~Magazine() {
+            depot().give(nodes, nodes.size());
+        }
+    };
+
+    static Depot& depot() {
+        static Depot instance;
+        return instance;
+    }
+
+    static Magazine& local() {
+        static thread_local Magazine magazine;
+        return magazine;
+    }
+};
+
+// Chase-Lev work-stealing deque (Le, Pop, Cohen, Zappa Nardelli, PPoPP'13).
+// The owning worker pushes and pops at the bottom, thieves steal from the top.
+class ChaseLevDeque {
+public:
+    explicit ChaseLevDeque(size_t capacity)
+        : mask_(roundUp(capacity) - 1), top_(0), bottom_(0),
+          slots_(new std::atomic<TaskNode*>[mask_ + 1]) {
+    }
+
+    // Owner only. Returns false when full.
+    bool push(TaskNode* node) {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_acquire);
+        if (b - t > static_cast<int64_t>(mask_)) {
+            return false;
+        }
+        slots_[b & mask_].store(node, std::memory_order_relaxed);
+        bottom_.store(b + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Owner only, LIFO
+    TaskNode* pop() {
+        int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top_.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        TaskNode* node = slots_[b & mask_].load(std::memory_order_relaxed);
+        if (t == b) {
+            // Last element, race against thieves
+            if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                              std::memory_order_relaxed)) {
+                node = nullptr;
+            }
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+        return node;
+    }
+
+    // Any thread, FIFO
+    TaskNode* steal() {
+        int64_t t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom_.load(std::memory_order_acquire);
+
+        if (t >= b) {
+            return nullptr;
+        }
+
+        TaskNode* node = slots_[t & mask_].load(std::memory_order_relaxed);
+        if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                          std::memory_order_relaxed)) {
+            return nullptr; // Lost the race
+        }
+        return node;
+    }
+
+    bool empty() const {
+        return bottom_.load(std::memory_order_relaxed) <= top_.load(std::memory_order_relaxed);
+    }
+
+private:
+    static size_t roundUp(size_t value) {
+        size_t result = 1;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    const size_t mask_;
+    alignas(64) std::atomic<int64_t> top_;
+    alignas(64) std::atomic<int64_t> bottom_;
+    std::unique_ptr<std::atomic<TaskNode*>[]> slots_;
+};
+
+// Work-stealing alternative to ThreadPool.
+//
+// Each worker has a Chase-Lev deque for tasks it spawns itself and an
+// intrusive MPSC inbox for tasks posted from other threads, so there is no
+// single queue lock shared by all producers and consumers. Idle workers
+// steal from their peers before going to sleep.
+class WorkStealingPool {
+public:
+    static constexpr size_t DEQUE_CAPACITY = 4096;
+
+    // on_thread_start(i) runs first on worker thread i, e.g. to pin it
+    explicit WorkStealingPool(size_t threads, std::function<void(size_t)> on_thread_start = nullptr);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    // Fire-and-forget: no packaged_task, no future
+    template<class F>
+    void post(F&& f);
+
+    // ThreadPool-compatible interface for callers that need the result
+    template<class F, class... Args>
+    auto enqueue(F&& f, Args&&... args)
+        -> std::future<typename std::result_of<F(Args...)>::type>;
+
+    size_t size() const { return workers_.size(); }
+
+private:
+    struct Worker {
+        explicit Worker(size_t capacity) : deque(capacity), inbox_head(&stub), inbox_tail(&stub) {}
+
+        ChaseLevDeque deque;
+        std::atomic<TaskNode*> inbox_head;   // Producers swap here
+        TaskNode* inbox_tail;                // Owner only
+        TaskNode stub;
+        std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<size_t> next_inbox_;
+    std::atomic<bool> stop_;
+
+    // Sleep/wake for idle workers
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    std::atomic<int> sleepers_;
+
+    // Identifies the pool worker running on the current thread, if any
+    static inline thread_local WorkStealingPool* current_pool_ = nullptr;
+    static inline thread_local size_t current_index_ = 0;
+
+    void submit(TaskNode* node);
+    void pushInbox(Worker& worker, TaskNode* node);
+    TaskNode* popInbox(Worker& worker);
+    TaskNode* findTask(size_t index);
+    bool hasVisibleWork() const;
+    void workerLoop(size_t index);
+    static void execute(TaskNode* node);
+};
+
+inline WorkStealingPool::WorkStealingPool(size_t threads, std::function<void(size_t)> on_thread_start)
+    : next_inbox_(0), stop_(false), sleepers_(0) {
+    if (threads == 0) {
+        threads = 1;
+    }
+
+    for (size_t i = 0; i < threads; ++i) {
+        workers_.push_back(std::make_unique<Worker>(DEQUE_CAPACITY));
+    }
+
+    // Start threads only after every deque exists, thieves scan all of them
+    for (size_t i = 0; i < threads; ++i) {
+        workers_[i]->thread = std::thread([this, i, on_thread_start]() {
+            if (on_thread_start) {
+                on_thread_start(i);
+            }
+            workerLoop(i);
+        });
+    }
+}
+
+inline WorkStealingPool::~WorkStealingPool() {
+    stop_ = true;
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        wake_.notify_all();
+    }
+    for (auto& worker : workers_) {
+        worker->thread.join();
+    }
+}
+
+template<class F>
+void WorkStealingPool::post(F&& f) {
+    if (stop_) {
+        throw std::runtime_error("post on stopped WorkStealingPool");
+    }
+
+    TaskNode* node = TaskNodeAllocator::allocate();
+    node->emplace(std::forward<F>(f));
+    submit(node);
+}
+
+template<class F, class... Args>
+auto WorkStealingPool::enqueue(F&& f, Args&&... args)
+    -> std::future<typename std::result_of<F(Args...)>::type>
+{
+    using return_type = typename std::result_of<F(Args...)>::type;
+
+    auto task = std::make_shared< std::packaged_task<return_type()> >(
+            std::bind(std::forward<F>(f), std::forward<Args>(args)...)
+        );
+
+    std::future<return_type> res = task->get_future();
+    post([task]() { (*task)(); });
+    return res;
+}
+
+inline void WorkStealingPool::submit(TaskNode* node) {
+    // Tasks spawned by a worker stay on its own deque, hot in its cache
+    if (current_pool_ == this && workers_[current_index_]->deque.push(node)) {
+        // fall through to wake a potential thief
+    } else {
+        size_t index = next_inbox_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+        pushInbox(*workers_[index], node);
+    }
+
+    if (sleepers_.load() > 0) {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        wake_.notify_one();
+    }
+}
+
+inline void WorkStealingPool::pushInbox(Worker& worker, TaskNode* node) {
+    node->next.store(nullptr, std::memory_order_relaxed);
+    TaskNode* previous = worker.inbox_head.exchange(node);
+    previous->next.store(node, std::memory_order_release);
+}
+
+inline TaskNode* WorkStealingPool::popInbox(Worker& worker) {
+    TaskNode* tail = worker.inbox_tail;
+    TaskNode* next = tail->next.load(std::memory_order_acquire);
+
+    if (tail == &worker.stub) {
+        if (!next) {
+            return nullptr;
+        }
+        worker.inbox_tail = next;
+        tail = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+
+    if (next) {
+        worker.inbox_tail = next;
+        return tail;
+    }
+
+    if (tail != worker.inbox_head.load()) {
+        return nullptr; // Producer mid-push
+    }
+
+    pushInbox(worker, &worker.stub);
+    next = tail->next.load(std::memory_order_acquire);
+    if (next) {
+        worker.inbox_tail = next;
+        return tail;
+    }
+    return nullptr;
+}
+
+inline TaskNode* WorkStealingPool::findTask(size_t index) {
+    Worker& self = *workers_[index];
+
+    if (TaskNode* node = self.deque.pop()) {
+        return node;
+    }
+
+    if (TaskNode* node = popInbox(self)) {
+        // Move a batch of the inbox onto the deque so idle peers can steal it
+        for (int i = 0; i < 32; ++i) {
+            TaskNode* extra = popInbox(self);
+            if (!extra) {
+                break;
+            }
+            if (!self.deque.push(extra)) {
+                execute(extra);
+            }
+        }
+        return node;
+    }
+
+    // Steal, starting after ourselves so victims are spread out
+    for (size_t i = 1; i < workers_.size(); ++i) {
+        Worker& victim = *workers_[(index + i) % workers_.size()];
+        if (TaskNode* node = victim.deque.steal()) {
+            return node;
+        }
+    }
+
+    return nullptr;
+}
+
+inline bool WorkStealingPool::hasVisibleWork() const {
+    for (auto& worker : workers_) {
+        if (!worker->deque.empty() || worker->inbox_head.load() != &worker->stub) {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline void WorkStealingPool::execute(TaskNode* node) {
+    node->run();
+    TaskNodeAllocator::release(node);
+}
+
+inline void WorkStealingPool::workerLoop(size_t index) {
+    current_pool_ = this;
+    current_index_ = index;
+
+    for (;;) {
+        if (TaskNode* node = findTask(index)) {
+            execute(node);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        sleepers_.fetch_add(1);
+        if (stop_ && !hasVisibleWork()) {
+            sleepers_.fetch_sub(1);
+            break;
+        }
+        if (!hasVisibleWork()) {
+            wake_.wait_for(lock, std::chrono::milliseconds(100));
+        }
+        sleepers_.fetch_sub(1);
+    }
+
+    current_pool_ = nullptr;
+}
@@ -0,0 +1,183 @@
+#include "AdminServer.h"
+#include "Logger.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+AdminServer::AdminServer(const std::string& address, int port, std::function<std::string()> render_metrics)
+    : address_(address), port_(port), render_metrics_(std::move(render_metrics)),
+      listen_fd_(-1), wake_fd_(-1), running_(false) {
+}
+
+AdminServer::~AdminServer() {
+    stop();
+}
+
+bool AdminServer::start() {
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port_);
+    if (inet_pton(AF_INET, address_.c_str(), &address.sin_addr) != 1) {
+        LOG_ERROR("Invalid admin address: " << address_);
+        return false;
+    }
+
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd_ == -1) {
+        LOG_ERROR("Failed to create admin socket: " << strerror(errno));
+        return false;
+    }
+
+    int opt = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    if (bind(listen_fd_, (struct sockaddr*)&address, sizeof(address)) == -1) {
+        LOG_ERROR("Failed to bind admin port " << port_ << ": " << strerror(errno));
+        stop();
+        return false;
+    }
+
+    if (listen(listen_fd_, 16) == -1) {
+        LOG_ERROR("Failed to listen on admin port: " << strerror(errno));
+        stop();
+        return false;
+    }
+
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ == -1) {
+        LOG_ERROR("Failed to create eventfd: " << strerror(errno));
+        stop();
+        return false;
+    }
+
+    running_ = true;
+    thread_ = std::thread([this]() { run(); });
+    LOG_INFO("Admin endpoint on " << address_ << ":" << port_ << " (GET /metrics)");
+    return true;
+}
+
+void AdminServer::stop() {
+    if (running_.exchange(false)) {
+        uint64_t one = 1;
+        ssize_t ignored = ::write(wake_fd_, &one, sizeof(one));
+        (void)ignored;
+    }
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+
+    if (listen_fd_ != -1) {
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+    }
+    if (wake_fd_ != -1) {
+        ::close(wake_fd_);
+        wake_fd_ = -1;
+    }
+}
+
+void AdminServer::run() {
+    struct pollfd fds[2];
+    fds[0].fd = listen_fd_;
+    fds[0].events = POLLIN;
+    fds[1].fd = wake_fd_;
+    fds[1].events = POLLIN;
+
+    while (running_) {
+        if (::poll(fds, 2, -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR("Admin poll error: " << strerror(errno));
+            break;
+        }
+        if (fds[1].revents & POLLIN) {
+            break;
+        }
+        if (!(fds[0].revents & POLLIN)) {
+            continue;
+        }
+
+        int client_fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client_fd == -1) {
+            if (errno != EINTR && errno != ECONNABORTED) {
+                LOG_ERROR("Failed to accept admin connection: " << strerror(errno));
+            }
+            continue;
+        }
+        serve(client_fd);
+        ::close(client_fd);
+    }
+}
+
+void AdminServer::serve(int client_fd) {
+    // One request per connection; a client that stalls is dropped
+    struct timeval timeout;
+    timeout.tv_sec = REQUEST_TIMEOUT_MS / 1000;
+    timeout.tv_usec = (REQUEST_TIMEOUT_MS % 1000) * 1000;
+    setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos) {
+        if (request.size() >= MAX_REQUEST_SIZE) {
+            sendResponse(client_fd, "431 Request Header Fields Too Large", "text/plain", "Request too large\n");
+            return;
+        }
+        ssize_t received = recv(client_fd, buffer, sizeof(buffer), 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return;
+        }
+        request.append(buffer, static_cast<size_t>(received));
+    }
+
+    // Request line: METHOD SP TARGET SP VERSION
+    size_t method_end = request.find(' ');
+    size_t target_end = method_end == std::string::npos ? std::string::npos : request.find(' ', method_end + 1);
+    if (target_end == std::string::npos) {
+        sendResponse(client_fd, "400 Bad Request", "text/plain", "Bad request\n");
+        return;
+    }
+    std::string method = request.substr(0, method_end);
+    std::string target = request.substr(method_end + 1, target_end - method_end - 1);
+
+    if (target != "/metrics") {
+        sendResponse(client_fd, "404 Not Found", "text/plain", "Not found\n");
+    } else if (method != "GET") {
+        sendResponse(client_fd, "405 Method Not Allowed", "text/plain", "Method not allowed\n");
+    } else {
+        sendResponse(client_fd, "200 OK", "text/plain; version=0.0.4", render_metrics_());
+    }
+}
+
+void AdminServer::sendResponse(int client_fd, const char* status, const char* content_type, const std::string& body) {
+    std::string response = "HTTP/1.1 ";
+    response += status;
+    response += "\r\nContent-Type: ";
+    response += content_type;
+    response += "\r\nContent-Length: " + std::to_string(body.size());
+    response += "\r\nConnection: close\r\n\r\n";
+    response += body;
+
+    size_t sent = 0;
+    while (sent < response.size()) {
+        ssize_t result = send(client_fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            return;
+        }
+        sent += static_cast<size_t>(result);
+    }
+}
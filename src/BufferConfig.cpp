@@ -22,7 +22,8 @@ void MemoryTracker::deallocate(size_t bytes) {
 }
 
 bool MemoryTracker::isMemoryLimitExceeded() const {
-    return current_usage_.load() > MAX_MEMORY_BYTES;
+    size_t limit = limit_bytes_.load(std::memory_order_relaxed);
+    return limit > 0 && current_usage_.load(std::memory_order_relaxed) > limit;
 }
 
 void MemoryTracker::reset() {
@@ -0,0 +1,532 @@
+#include "ClusterRelay.h"
+#include "Logger.h"
+#include "Metrics.h"
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace {
+
+constexpr size_t FRAME_HEADER_SIZE = sizeof(uint32_t);
+constexpr size_t PUBLISH_HEADER_SIZE = 1 + sizeof(uint16_t);
+constexpr size_t MAX_FRAME_SIZE = PUBLISH_HEADER_SIZE + ClusterRelay::MAX_TOPIC_SIZE + ClusterRelay::MAX_RECORD_SIZE;
+
+void writeBigEndian32(uint32_t value, char* out) {
+    out[0] = static_cast<char>(value >> 24);
+    out[1] = static_cast<char>(value >> 16);
+    out[2] = static_cast<char>(value >> 8);
+    out[3] = static_cast<char>(value);
+}
+
+uint32_t readBigEndian32(const char* data) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+    return (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) | (uint32_t(bytes[2]) << 8) | uint32_t(bytes[3]);
+}
+
+bool resolve(const ClusterMember& member, struct sockaddr_in& address) {
+    struct addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* result = nullptr;
+    int error = getaddrinfo(member.host.c_str(), nullptr, &hints, &result);
+    if (error != 0 || !result) {
+        LOG_ERROR("Cannot resolve cluster node " << member.id << " '" << member.host << "': "
+                  << gai_strerror(error));
+        return false;
+    }
+    std::memcpy(&address, result->ai_addr, sizeof(address));
+    address.sin_port = htons(static_cast<uint16_t>(member.port));
+    freeaddrinfo(result);
+    return true;
+}
+
+} // namespace
+
+ClusterRelay::ClusterRelay(int node_id, const std::vector<ClusterMember>& members, Handler handler)
+    : node_id_(node_id), members_(members), handler_(std::move(handler)), listen_port_(0),
+      listen_fd_(-1), wake_fd_(-1), running_(false) {
+}
+
+ClusterRelay::~ClusterRelay() {
+    stop();
+    if (wake_fd_ != -1) {
+        ::close(wake_fd_);
+    }
+}
+
+bool ClusterRelay::start() {
+    for (const ClusterMember& member : members_) {
+        if (member.id == node_id_) {
+            listen_port_ = member.port;
+            continue;
+        }
+        auto peer = std::make_unique<Peer>();
+        peer->id = member.id;
+        peer->name = member.host + ":" + std::to_string(member.port);
+        if (!resolve(member, peer->address)) {
+            return false;
+        }
+        peers_.push_back(std::move(peer));
+    }
+    if (listen_port_ == 0) {
+        LOG_ERROR("Cluster node id " << node_id_ << " is not in cluster_nodes");
+        return false;
+    }
+
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ == -1) {
+        LOG_ERROR("Failed to create cluster socket: " << strerror(errno));
+        return false;
+    }
+    int opt = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(static_cast<uint16_t>(listen_port_));
+    if (bind(listen_fd_, (struct sockaddr*)&address, sizeof(address)) == -1 ||
+        listen(listen_fd_, static_cast<int>(members_.size()) * 2) == -1) {
+        LOG_ERROR("Failed to listen on cluster port " << listen_port_ << ": " << strerror(errno));
+        stop();
+        return false;
+    }
+
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ == -1) {
+        LOG_ERROR("Failed to create eventfd: " << strerror(errno));
+        stop();
+        return false;
+    }
+
+    running_ = true;
+    thread_ = std::thread([this]() { run(); });
+    LOG_INFO("Cluster relay: node " << node_id_ << " on port " << listen_port_ << ", "
+             << peers_.size() << " peer(s)");
+    return true;
+}
+
+void ClusterRelay::stop() {
+    if (running_.exchange(false)) {
+        uint64_t one = 1;
+        ssize_t ignored = ::write(wake_fd_, &one, sizeof(one));
+        (void)ignored;
+    }
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+
+    for (auto& peer : peers_) {
+        if (peer->fd != -1) {
+            ::close(peer->fd);
+            peer->fd = -1;
+        }
+        peer->connected = false;
+    }
+    for (Link& link : links_) {
+        ::close(link.fd);
+    }
+    links_.clear();
+    if (listen_fd_ != -1) {
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+    }
+}
+
+void ClusterRelay::broadcast(std::string_view payload) {
+    char header = RECORD_BROADCAST;
+    enqueue(&header, 1, std::string_view(), payload);
+}
+
+void ClusterRelay::publish(std::string_view topic, std::string_view payload) {
+    if (topic.size() > MAX_TOPIC_SIZE) {
+        Metrics::add(Counter::RelayRecordsDropped, peers_.size());
+        return;
+    }
+    char header[PUBLISH_HEADER_SIZE];
+    header[0] = RECORD_PUBLISH;
+    header[1] = static_cast<char>(topic.size() >> 8);
+    header[2] = static_cast<char>(topic.size());
+    enqueue(header, sizeof(header), topic, payload);
+}
+
+size_t ClusterRelay::getConnectedPeerCount() const {
+    return static_cast<size_t>(std::count_if(peers_.begin(), peers_.end(),
+        [](const std::unique_ptr<Peer>& peer) { return peer->connected.load(); }));
+}
+
+void ClusterRelay::enqueue(const char* header, size_t header_size, std::string_view topic, std::string_view payload) {
+    if (payload.size() > MAX_RECORD_SIZE) {
+        Metrics::add(Counter::RelayRecordsDropped, peers_.size());
+        return;
+    }
+
+    // Framed once, then copied into each peer's batch
+    char frame_header[FRAME_HEADER_SIZE];
+    writeBigEndian32(static_cast<uint32_t>(header_size + topic.size() + payload.size()), frame_header);
+    size_t frame_size = FRAME_HEADER_SIZE + header_size + topic.size() + payload.size();
+
+    bool wake = false;
+    for (auto& peer : peers_) {
+        if (!peer->connected.load(std::memory_order_acquire)) {
+            Metrics::add(Counter::RelayRecordsDropped);
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(peer->queue_mutex);
+        if (peer->queued.size() + frame_size > SEND_BUFFER_LIMIT) {
+            // The peer stopped reading; shed load rather than grow without bound
+            Metrics::add(Counter::RelayRecordsDropped);
+            continue;
+        }
+        wake |= peer->queued.empty();
+        peer->queued.append(frame_header, FRAME_HEADER_SIZE);
+        peer->queued.append(header, header_size);
+        peer->queued.append(topic.data(), topic.size());
+        peer->queued.append(payload.data(), payload.size());
+        ++peer->queued_records;
+        Metrics::add(Counter::RelayRecordsSent);
+    }
+
+    // One wakeup per batch: later records join the buffer until it is written
+    if (wake) {
+        uint64_t one = 1;
+        if (::write(wake_fd_, &one, sizeof(one)) == -1 && errno != EAGAIN) {
+            LOG_ERROR("Failed to wake cluster relay: " << strerror(errno));
+        }
+    }
+}
+
+void ClusterRelay::run() {
+    std::vector<struct pollfd> fds;
+
+    for (auto& peer : peers_) {
+        dial(*peer);
+    }
+
+    while (running_) {
+        // wake_fd, listener, one entry per peer, then the incoming links
+        fds.clear();
+        fds.push_back({wake_fd_, POLLIN, 0});
+        fds.push_back({listen_fd_, POLLIN, 0});
+
+        auto now = std::chrono::steady_clock::now();
+        int timeout_ms = -1;
+        for (auto& peer : peers_) {
+            short events = 0;
+            if (peer->connecting) {
+                events = POLLOUT;
+            } else if (peer->connected) {
+                events = POLLIN | (peer->sent < peer->sending.size() ? POLLOUT : 0);
+            } else {
+                auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(peer->next_attempt - now).count();
+                int wait_ms = static_cast<int>(std::max<long long>(wait, 0));
+                timeout_ms = timeout_ms < 0 ? wait_ms : std::min(timeout_ms, wait_ms);
+            }
+            fds.push_back({events ? peer->fd : -1, events, 0});
+        }
+        for (const Link& link : links_) {
+            fds.push_back({link.fd, POLLIN, 0});
+        }
+
+        if (::poll(fds.data(), fds.size(), timeout_ms) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR("Cluster relay poll error: " << strerror(errno));
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            uint64_t count;
+            while (::read(wake_fd_, &count, sizeof(count)) > 0) {
+                // Drain the eventfd counter
+            }
+        }
+        if (!running_) {
+            break;
+        }
+
+        now = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < peers_.size(); ++i) {
+            Peer& peer = *peers_[i];
+            short revents = fds[2 + i].revents;
+            if (peer.connecting) {
+                if (revents) {
+                    int error = 0;
+                    socklen_t length = sizeof(error);
+                    getsockopt(peer.fd, SOL_SOCKET, SO_ERROR, &error, &length);
+                    if (error == 0) {
+                        onConnected(peer);
+                    } else {
+                        disconnect(peer, strerror(error));
+                    }
+                }
+            } else if (peer.connected) {
+                // Peers never write on our link: readable means closed
+                if (revents & (POLLIN | POLLERR | POLLHUP)) {
+                    char discard[256];
+                    ssize_t received = recv(peer.fd, discard, sizeof(discard), MSG_DONTWAIT);
+                    if (received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+                        disconnect(peer, received == 0 ? "closed by peer" : strerror(errno));
+                    }
+                }
+            } else if (now >= peer.next_attempt) {
+                dial(peer);
+            }
+
+            // A full socket buffer leaves the rest to POLLOUT
+            if (peer.connected) {
+                flush(peer);
+            }
+        }
+
+        // Links accepted below are polled from the next round on
+        size_t link_count = links_.size();
+        size_t kept = 0;
+        for (size_t i = 0; i < link_count; ++i) {
+            Link& link = links_[i];
+            short revents = fds[2 + peers_.size() + i].revents;
+            if (revents && !readLink(link)) {
+                LOG_INFO("Cluster link from node " << link.node_id << " closed");
+                ::close(link.fd);
+                continue;
+            }
+            if (kept != i) {
+                links_[kept] = std::move(link);
+            }
+            ++kept;
+        }
+        links_.erase(links_.begin() + static_cast<std::ptrdiff_t>(kept),
+                     links_.begin() + static_cast<std::ptrdiff_t>(link_count));
+
+        if (fds[1].revents & POLLIN) {
+            acceptLinks();
+        }
+    }
+}
+
+void ClusterRelay::dial(Peer& peer) {
+    peer.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (peer.fd == -1) {
+        disconnect(peer, strerror(errno));
+        return;
+    }
+    // Batches are written whole, so Nagle would only add latency
+    int opt = 1;
+    setsockopt(peer.fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+
+    if (connect(peer.fd, (struct sockaddr*)&peer.address, sizeof(peer.address)) == 0) {
+        onConnected(peer);
+    } else if (errno == EINPROGRESS) {
+        peer.connecting = true;
+    } else {
+        disconnect(peer, strerror(errno));
+    }
+}
+
+void ClusterRelay::onConnected(Peer& peer) {
+    peer.connecting = false;
+    peer.backoff_ms = RECONNECT_MIN_MS;
+
+    // The hello goes out before any record queued after connected is set
+    char hello[FRAME_HEADER_SIZE + HELLO_SIZE];
+    writeBigEndian32(static_cast<uint32_t>(HELLO_SIZE), hello);
+    std::memcpy(hello + FRAME_HEADER_SIZE, HELLO_MAGIC, sizeof(HELLO_MAGIC));
+    writeBigEndian32(static_cast<uint32_t>(node_id_), hello + FRAME_HEADER_SIZE + sizeof(HELLO_MAGIC));
+    peer.sending.assign(hello, sizeof(hello));
+    peer.sending_records = 0;
+    peer.sent = 0;
+    peer.connected.store(true, std::memory_order_release);
+    LOG_INFO("Cluster link to node " << peer.id << " (" << peer.name << ") established");
+}
+
+void ClusterRelay::disconnect(Peer& peer, const char* reason) {
+    if (peer.connected) {
+        LOG_WARN("Cluster link to node " << peer.id << " (" << peer.name << ") lost: " << reason);
+    } else {
+        LOG_DEBUG("Cluster node " << peer.id << " (" << peer.name << ") unreachable: " << reason);
+    }
+    if (peer.fd != -1) {
+        ::close(peer.fd);
+        peer.fd = -1;
+    }
+    peer.connecting = false;
+    peer.connected.store(false, std::memory_order_release);
+
+    // What the peer did not get is lost with the link
+    size_t lost = peer.sent < peer.sending.size() ? peer.sending_records : 0;
+    {
+        std::lock_guard<std::mutex> lock(peer.queue_mutex);
+        lost += peer.queued_records;
+        peer.queued.clear();
+        peer.queued_records = 0;
+    }
+    Metrics::add(Counter::RelayRecordsDropped, lost);
+    peer.sending.clear();
+    peer.sending_records = 0;
+    peer.sent = 0;
+
+    peer.next_attempt = std::chrono::steady_clock::now() + std::chrono::milliseconds(peer.backoff_ms);
+    peer.backoff_ms = std::min(peer.backoff_ms * 2, RECONNECT_MAX_MS);
+}
+
+bool ClusterRelay::flush(Peer& peer) {
+    while (true) {
+        if (peer.sent == peer.sending.size()) {
+            peer.sending.clear();
+            peer.sending_records = 0;
+            peer.sent = 0;
+            std::lock_guard<std::mutex> lock(peer.queue_mutex);
+            if (peer.queued.empty()) {
+                return true;
+            }
+            // Everything queued since the last write leaves in one batch
+            peer.sending.swap(peer.queued);
+            peer.sending_records = peer.queued_records;
+            peer.queued_records = 0;
+        }
+
+        ssize_t written = send(peer.fd, peer.sending.data() + peer.sent, peer.sending.size() - peer.sent,
+                               MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return false;
+            }
+            disconnect(peer, strerror(errno));
+            return true;
+        }
+        peer.sent += static_cast<size_t>(written);
+    }
+}
+
+void ClusterRelay::acceptLinks() {
+    while (true) {
+        struct sockaddr_in from = {};
+        socklen_t length = sizeof(from);
+        int fd = accept4(listen_fd_, (struct sockaddr*)&from, &length, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                LOG_ERROR("Cluster accept failed: " << strerror(errno));
+            }
+            return;
+        }
+        // Every member dials once; more links than that are stale or strays
+        if (links_.size() >= members_.size() * 2) {
+            ::close(fd);
+            continue;
+        }
+        Link link;
+        link.fd = fd;
+        link.address = from.sin_addr.s_addr;
+        links_.push_back(std::move(link));
+    }
+}
+
+bool ClusterRelay::readLink(Link& link) {
+    // Framing after every chunk bounds the buffer to one partial frame plus
+    // a chunk; poll() is level-triggered, so whatever is left is read next round
+    for (size_t chunk = 0; chunk < RECV_CHUNKS_PER_ROUND; ++chunk) {
+        size_t used = link.buffer.size();
+        link.buffer.resize(used + RECV_CHUNK);
+        ssize_t received = recv(link.fd, &link.buffer[used], RECV_CHUNK, MSG_DONTWAIT);
+        link.buffer.resize(used + static_cast<size_t>(std::max<ssize_t>(received, 0)));
+        if (received == 0) {
+            return false;
+        }
+        if (received < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return false;
+        }
+        if (!frameLink(link)) {
+            return false;
+        }
+        if (static_cast<size_t>(received) < RECV_CHUNK) {
+            break;
+        }
+    }
+    return true;
+}
+
+bool ClusterRelay::frameLink(Link& link) {
+    size_t offset = 0;
+    while (link.buffer.size() - offset >= FRAME_HEADER_SIZE) {
+        size_t length = readBigEndian32(link.buffer.data() + offset);
+        if (length > MAX_FRAME_SIZE) {
+            LOG_WARN("Cluster link from node " << link.node_id << " sent an oversized frame");
+            return false;
+        }
+        if (link.buffer.size() - offset < FRAME_HEADER_SIZE + length) {
+            break;
+        }
+        if (!deliver(link, std::string_view(link.buffer.data() + offset + FRAME_HEADER_SIZE, length))) {
+            return false;
+        }
+        offset += FRAME_HEADER_SIZE + length;
+    }
+    link.buffer.erase(0, offset);
+    return true;
+}
+
+bool ClusterRelay::deliver(Link& link, std::string_view frame) {
+    if (link.node_id == 0) {
+        // Only members may relay, and only from the address they are listed with
+        if (frame.size() != HELLO_SIZE || std::memcmp(frame.data(), HELLO_MAGIC, sizeof(HELLO_MAGIC)) != 0) {
+            LOG_WARN("Cluster link without hello refused");
+            return false;
+        }
+        int node_id = static_cast<int>(readBigEndian32(frame.data() + sizeof(HELLO_MAGIC)));
+        auto peer = std::find_if(peers_.begin(), peers_.end(),
+            [node_id](const std::unique_ptr<Peer>& candidate) { return candidate->id == node_id; });
+        if (peer == peers_.end() || (*peer)->address.sin_addr.s_addr != link.address) {
+            LOG_WARN("Cluster link from unknown node " << node_id << " refused");
+            return false;
+        }
+        link.node_id = node_id;
+        LOG_INFO("Cluster link from node " << node_id << " accepted");
+        return true;
+    }
+
+    if (frame.empty()) {
+        return false;
+    }
+    char kind = frame[0];
+    std::string_view topic;
+    std::string_view payload;
+    if (kind == RECORD_BROADCAST) {
+        payload = frame.substr(1);
+    } else if (kind == RECORD_PUBLISH && frame.size() >= PUBLISH_HEADER_SIZE) {
+        size_t topic_size = (static_cast<size_t>(static_cast<unsigned char>(frame[1])) << 8) |
+                            static_cast<unsigned char>(frame[2]);
+        if (frame.size() < PUBLISH_HEADER_SIZE + topic_size) {
+            return false;
+        }
+        topic = frame.substr(PUBLISH_HEADER_SIZE, topic_size);
+        payload = frame.substr(PUBLISH_HEADER_SIZE + topic_size);
+    } else {
+        LOG_WARN("Cluster link from node " << link.node_id << " sent an unknown record");
+        return false;
+    }
+
+    Metrics::add(Counter::RelayRecordsReceived);
+    try {
+        handler_(kind, topic, payload);
+    } catch (const std::exception& e) {
+        LOG_ERROR("Relayed record from node " << link.node_id << " failed: " << e.what());
+    }
+    return true;
+}
@@ -0,0 +1,151 @@
+#include "Compression.h"
+#include "Logger.h"
+#include "Metrics.h"
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace {
+
+uint32_t readBigEndian32(const char* data) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+    return (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) | (uint32_t(bytes[2]) << 8) | uint32_t(bytes[3]);
+}
+
+void writeBigEndian32(uint32_t value, char* out) {
+    out[0] = static_cast<char>(value >> 24);
+    out[1] = static_cast<char>(value >> 16);
+    out[2] = static_cast<char>(value >> 8);
+    out[3] = static_cast<char>(value);
+}
+
+}
+
+bool MessageCompressor::parseHello(std::string_view frame, uint32_t& dictionary_id) {
+    if (frame.size() != HELLO_SIZE || std::memcmp(frame.data(), HELLO_MAGIC, MAGIC_SIZE) != 0) {
+        return false;
+    }
+    dictionary_id = readBigEndian32(frame.data() + MAGIC_SIZE);
+    return true;
+}
+
+size_t MessageCompressor::encodeDecline(char* out) {
+    std::memcpy(out, DECLINE_MAGIC, MAGIC_SIZE);
+    return MAGIC_SIZE;
+}
+
+size_t MessageCompressor::encodeAccept(char* out) const {
+    std::memcpy(out, HELLO_MAGIC, MAGIC_SIZE);
+    writeBigEndian32(dictionary_id_, out + MAGIC_SIZE);
+    return HELLO_SIZE;
+}
+
+#ifdef HAVE_ZSTD
+
+#include <zstd.h>
+
+namespace {
+
+// One compression context and output buffer per thread, for every
+// compressor; both keep their size across messages
+struct ThreadCompressionState {
+    ZSTD_CCtx* context = nullptr;
+    std::vector<char> output;
+
+    ~ThreadCompressionState() {
+        ZSTD_freeCCtx(context);
+    }
+};
+
+thread_local ThreadCompressionState thread_state;
+
+}
+
+MessageCompressor::MessageCompressor()
+    : level_(ZSTD_CLEVEL_DEFAULT), min_size_(0), dictionary_id_(0), cdict_(nullptr) {
+}
+
+MessageCompressor::~MessageCompressor() {
+    ZSTD_freeCDict(cdict_);
+}
+
+bool MessageCompressor::init(int level, const std::string& dictionary_file, size_t min_size) {
+    level_ = level;
+    min_size_ = min_size;
+
+    if (!dictionary_file.empty()) {
+        std::ifstream file(dictionary_file, std::ios::binary);
+        if (!file.is_open()) {
+            LOG_ERROR("Cannot open compression dictionary '" << dictionary_file << "'");
+            return false;
+        }
+        dictionary_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+        // Digested once; compressing with it is read-only, so all threads share it
+        cdict_ = ZSTD_createCDict(dictionary_.data(), dictionary_.size(), level_);
+        if (!cdict_) {
+            LOG_ERROR("Invalid compression dictionary '" << dictionary_file << "'");
+            return false;
+        }
+        dictionary_id_ = ZSTD_getDictID_fromDict(dictionary_.data(), dictionary_.size());
+        if (dictionary_id_ == 0) {
+            LOG_ERROR("Compression dictionary '" << dictionary_file << "' has no id, "
+                      "train it with zstd --train");
+            return false;
+        }
+    }
+
+    LOG_INFO("Compression: zstd level " << level_ << ", messages from " << min_size_ << " bytes"
+             << (cdict_ ? ", dictionary " + std::to_string(dictionary_id_) : std::string()));
+    return true;
+}
+
+bool MessageCompressor::compress(const char* data, size_t length, std::string_view& out) const {
+    if (length < min_size_ || length == 0) {
+        return false;
+    }
+
+    ThreadCompressionState& state = thread_state;
+    if (!state.context) {
+        state.context = ZSTD_createCCtx();
+        if (!state.context) {
+            return false;
+        }
+    }
+    size_t bound = ZSTD_compressBound(length);
+    if (state.output.size() < bound) {
+        state.output.resize(bound);
+    }
+
+    size_t size = cdict_
+        ? ZSTD_compress_usingCDict(state.context, state.output.data(), bound, data, length, cdict_)
+        : ZSTD_compressCCtx(state.context, state.output.data(), bound, data, length, level_);
+    if (ZSTD_isError(size) || size >= length) {
+        return false; // Incompressible, the plain frame is smaller
+    }
+
+    Metrics::add(Counter::MessagesCompressed);
+    Metrics::add(Counter::CompressionSavedBytes, length - size);
+    out = std::string_view(state.output.data(), size);
+    return true;
+}
+
+#else // !HAVE_ZSTD
+
+// Built without zstd: init() fails and the server offers no compression
+
+MessageCompressor::MessageCompressor() : level_(0), min_size_(0), dictionary_id_(0), cdict_(nullptr) {
+}
+
+MessageCompressor::~MessageCompressor() = default;
+
+bool MessageCompressor::init(int, const std::string&, size_t) {
+    LOG_WARN("Compression requested, but the server was built without zstd; messages are sent uncompressed");
+    return false;
+}
+
+bool MessageCompressor::compress(const char*, size_t, std::string_view&) const {
+    return false;
+}
+
+#endif // HAVE_ZSTD
@@ -1,24 +1,58 @@
 #include "ConnectionHandler.h"
-#include <iostream>
+#include "ConnectionHandlerT.h"
+#include "Logger.h"
+#include "Metrics.h"
+#include "TlsContext.h"
+#include "Compression.h"
+#include "TrafficCapture.h"
 #include <sstream>
 #include <chrono>
 #include <iomanip>
 #include <cstring>
 #include <cerrno>
 
-ConnectionHandler::ConnectionHandler(int client_fd, const std::string& client_ip, int client_port)
-    : client_fd_(client_fd), client_ip_(client_ip), client_port_(client_port), 
-      connected_(true), last_activity_(std::chrono::steady_clock::now()) {
-    // Pre-allocate temporary buffer for common operations
-    temp_buffer_ = std::make_unique<MessageBuffer>(MAX_MESSAGE_SIZE);
+ConnectionHandler::ConnectionHandler(int client_fd, const PeerAddress& peer)
+    : client_fd_(client_fd), connected_(true), socket_open_(true), close_requested_(false),
+      write_blocked_(false), write_watched_(false), read_paused_(false), deferred_flush_(false),
+      framing_(FramingMode::Newline), worker_(nullptr), pending_events_(0),
+      peer_(peer), compressor_(nullptr), compressing_(false), hello_pending_(false),
+      capture_(nullptr), capture_connection_(0),
+      datagram_token_(0), datagram_peer_(0),
+      last_activity_(std::chrono::steady_clock::now().time_since_epoch().count()),
+      last_read_(last_activity_.load()), last_write_(last_activity_.load()),
+      queued_since_(0), dispatch_read_time_(last_activity_.load()),
+      send_high_watermark_(BufferConfig::SEND_HIGH_WATERMARK),
+      send_low_watermark_(BufferConfig::SEND_LOW_WATERMARK), flush_threshold_(0),
+      read_buffer_(READ_BUFFER_LIMIT), scan_offset_(0),
+      frame_header_ready_(false), frame_header_size_(0), frame_payload_length_(0) {
+    ready_link_.owner = this;
+    timer_node_.owner = this;
 }
 
 ConnectionHandler::~ConnectionHandler() {
     close();
+    if (capture_) {
+        capture_->closeConnection(capture_connection_, framing_);
+    }
+}
+
+void ConnectionHandler::setCapture(TrafficCapture* capture) {
+    capture_ = capture;
+    if (capture_) {
+        capture_connection_ = capture_->openConnection(framing_);
+    }
 }
 
 void ConnectionHandler::handleRead() {
-    if (!connected_) return;
+    // A paused connection leaves its input in the kernel, which in turn
+    // throttles the client; onReadResumed() restarts the read
+    if (!connected_ || read_paused_) return;
+    
+    if (tls_) {
+        continueHandshake();
+        if (tls_ || !connected_) return;
+        // Application data may have followed the client's Finished
+    }
     
     try {
         bool data_received = false;
@@ -26,147 +60,435 @@ void ConnectionHandler::handleRead() {
         // Keep reading until no more data available (EAGAIN)
         // This is crucial for edge-triggered epoll
         while (true) {
-            char buffer[4096];
-            ssize_t bytes_received = recv(client_fd_, buffer, sizeof(buffer), 0);
-            
-            if (bytes_received <= 0) {
-                if (bytes_received == 0) {
-                    // Client disconnected gracefully
-                    std::cout << "Client " << getClientInfo() << " disconnected gracefully" << std::endl;
+            if (!read_buffer_.ensureWritable(RECV_CHUNK_SIZE)) {
+                // Deliver complete messages to free space before giving up
+                markRead();
+                extractMessages();
+                updateReadPause();
+                if (read_paused_) {
+                    // Their replies filled the send queue, stop here
+                    break;
+                }
+                if (!read_buffer_.ensureWritable(RECV_CHUNK_SIZE)) {
+                    LOG_WARN("Read buffer too large for " << getClientInfo()
+                             << ", disconnecting");
                     handleDisconnection();
                     return;
-                } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                }
+            }
+            
+            // Receive straight into the read buffer, no intermediate copy
+            size_t space = read_buffer_.writable();
+            ssize_t bytes_received = recv(client_fd_, read_buffer_.writePtr(), space, 0);
+            Metrics::add(Counter::SyscallRecv);
+            
+            if (bytes_received <= 0) {
+                if (bytes_received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
                     // No more data available - this is normal for non-blocking sockets
                     break;
-                } else {
-                    // Real error occurred
-                    std::cerr << "Error receiving data from " << getClientInfo() << ": " << strerror(errno) << std::endl;
-                    handleDisconnection();
-                    return;
                 }
+                handleReceiveError(bytes_received == 0 ? 0 : errno);
+                return;
             }
             
-            // Append received data to read buffer
-            read_buffer_.append(buffer, bytes_received);
+            read_buffer_.commit(bytes_received);
+            Metrics::add(Counter::BytesReceived, static_cast<uint64_t>(bytes_received));
             data_received = true;
             
             // If we received less than buffer size, likely no more data
-            if (bytes_received < static_cast<ssize_t>(sizeof(buffer))) {
+            if (bytes_received < static_cast<ssize_t>(space)) {
                 break;
             }
         }
         
         // Only update activity and process if we actually received data
         if (data_received) {
-            updateActivity();
-            processIncomingData();
+            noteReceived();
+            updateReadPause();
+        }
+        
+    } catch (const std::exception& e) {
+        LOG_ERROR("Error handling read from " << getClientInfo() 
+                  << ": " << e.what());
+        handleDisconnection();
+    }
+}
+
+bool ConnectionHandler::handleReceived(const char* data, size_t length) {
+    if (!connected_) return true;
+    
+    try {
+        if (!read_buffer_.ensureWritable(length)) {
+            // Deliver complete messages to free space before giving up
+            markRead();
+            extractMessages();
+            if (!read_buffer_.ensureWritable(length)) {
+                if (read_paused_) {
+                    // Framing waits for the replies to drain, the backend
+                    // offers the bytes again after onReadResumed()
+                    return false;
+                }
+                LOG_WARN("Read buffer too large for " << getClientInfo()
+                         << ", disconnecting");
+                handleDisconnection();
+                return true;
+            }
         }
         
+        std::memcpy(read_buffer_.writePtr(), data, length);
+        read_buffer_.commit(length);
+        Metrics::add(Counter::BytesReceived, length);
+        noteReceived();
+        updateReadPause();
+        
     } catch (const std::exception& e) {
-        std::cerr << "Error handling read from " << getClientInfo() 
-                  << ": " << e.what() << std::endl;
+        LOG_ERROR("Error handling read from " << getClientInfo() 
+                  << ": " << e.what());
         handleDisconnection();
     }
+    return true;
+}
+
+void ConnectionHandler::handleReceiveError(int error) {
+    if (error == 0) {
+        // Client disconnected gracefully
+        LOG_INFO("Client " << getClientInfo() << " disconnected gracefully");
+    } else {
+        LOG_ERROR("Error receiving data from " << getClientInfo() << ": " << strerror(error));
+    }
+    handleDisconnection();
+}
+
+void ConnectionHandler::noteReceived() {
+    auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+    last_read_.store(now, std::memory_order_relaxed);
+    dispatch_read_time_ = now;
+    updateActivity(now);
+    processIncomingData();
 }
 
 void ConnectionHandler::handleWrite() {
-    if (!connected_ || !hasMessagesToSend()) return;
+    if (!connected_) return;
+    if (tls_) {
+        // A handshake flight that did not fit continues once writable
+        if (write_blocked_) {
+            continueHandshake();
+        }
+        // Nothing may reach the socket in plaintext before kTLS took over
+        if (tls_ || !connected_) return;
+    }
+    if (!hasMessagesToSend()) return;
     
     try {
-        while (!send_queue_.empty()) {
-            MessageBuffer* buffer = send_queue_.front();
-            if (!buffer) break;
+        // Coalesce the whole queue into as few sendmsg() calls as possible
+        struct iovec iov[MAX_WRITE_BATCH];
+        bool blocked = false;
+        
+        while (true) {
+            size_t count = send_queue_.gather(iov, MAX_WRITE_BATCH);
+            if (count == 0) break;
+            
+            size_t bytes_queued = 0;
+            for (size_t i = 0; i < count; ++i) {
+                bytes_queued += iov[i].iov_len;
+            }
+            
+            struct msghdr msg = {};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = count;
             
-            ssize_t bytes_sent = buffer->sendPartial(client_fd_, buffer->getOffset());
+            // More queued than one batch holds: let the kernel fill full
+            // segments across the calls instead of pushing a short one
+            int flags = MSG_NOSIGNAL;
+            if (count == MAX_WRITE_BATCH && send_queue_.bytes() > bytes_queued) {
+                flags |= MSG_MORE;
+            }
+            
+            ssize_t bytes_sent = sendmsg(client_fd_, &msg, flags);
+            Metrics::add(Counter::SyscallSend);
             
             if (bytes_sent < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
                 if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                    // Socket buffer full, try again later
-                    std::cout << "Socket buffer full for " << getClientInfo() << ", will retry later" << std::endl;
+                    // Socket buffer full, EPOLLOUT will resume the flush
+                    blocked = true;
                     break;
-                } else {
-                    std::cerr << "Error sending data to " << getClientInfo() 
-                              << ": " << strerror(errno) << std::endl;
-                    handleDisconnection();
-                    return;
                 }
-            } else if (bytes_sent == 0) {
-                // No data sent, try again later
-                std::cout << "No data sent to " << getClientInfo() << ", will retry later" << std::endl;
+                LOG_ERROR("Error sending data to " << getClientInfo() 
+                          << ": " << strerror(errno));
+                handleDisconnection();
+                return;
+            }
+            
+            noteSent(bytes_sent);
+            if (!connected_) {
+                return; // A request framed after resuming was rejected
+            }
+            
+            if (static_cast<size_t>(bytes_sent) < bytes_queued) {
+                // Kernel took only part of the batch, the socket is full
+                blocked = true;
                 break;
-            } else if (buffer->isComplete()) {
-                // Complete message sent
-                std::cout << "Message sent successfully to " << getClientInfo() << " (" << bytes_sent << " bytes)" << std::endl;
-                send_queue_.pop();
-                updateActivity();
-            } else {
-                // Partial send
-                std::cout << "Partial send to " << getClientInfo() << " (" << bytes_sent << " bytes), will retry" << std::endl;
             }
         }
         
+        if (blocked) {
+            Metrics::add(Counter::PartialWrites);
+        }
+        setWriteBlocked(blocked);
+        
     } catch (const std::exception& e) {
-        std::cerr << "Error handling write to " << getClientInfo() 
-                  << ": " << e.what() << std::endl;
+        LOG_ERROR("Error handling write to " << getClientInfo() 
+                  << ": " << e.what());
+        handleDisconnection();
+    }
+}
+
+size_t ConnectionHandler::prepareSend(struct iovec* iov, size_t max_count) {
+    if (!connected_ || tls_) return 0;
+    return send_queue_.gather(iov, max_count);
+}
+
+void ConnectionHandler::handleSent(ssize_t result) {
+    if (result < 0) {
+        LOG_ERROR("Error sending data to " << getClientInfo() 
+                  << ": " << strerror(static_cast<int>(-result)));
         handleDisconnection();
+        return;
+    }
+    noteSent(static_cast<size_t>(result));
+}
+
+void ConnectionHandler::setWriteBlocked(bool blocked) {
+    // Readiness backends watch for EPOLLOUT only while a write is blocked
+    if (blocked != write_blocked_) {
+        write_blocked_ = blocked;
+        if (onWriteBlockedChanged) {
+            onWriteBlockedChanged(this);
+        }
+    }
+}
+
+void ConnectionHandler::noteSent(size_t bytes) {
+    send_queue_.consume(bytes);
+    auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+    last_write_.store(now, std::memory_order_relaxed);
+    updateActivity(now);
+    
+    Metrics::add(Counter::BytesSent, bytes);
+    if (send_queue_.empty() && Metrics::getInstance().isEnabled()) {
+        auto since = queued_since_.exchange(0, std::memory_order_relaxed);
+        if (since != 0) {
+            Metrics::record(Histogram::HandlerToFlush, elapsedNanoseconds(since, now));
+        }
+    }
+    
+    if (read_paused_ && send_queue_.bytes() <= send_low_watermark_.load(std::memory_order_relaxed) &&
+        send_queue_.size() <= send_queue_.capacity() / 2) {
+        resumeFraming();
+    }
+}
+
+void ConnectionHandler::updateReadPause() {
+    // Replies the client is not reading stop us from reading more requests
+    if (!read_paused_ && isSendBacklogged()) {
+        pauseReading();
+    }
+}
+
+void ConnectionHandler::pauseReading() {
+    read_paused_ = true;
+    LOG_DEBUG("Paused reading from " << getClientInfo() << ", "
+              << send_queue_.bytes() << " bytes in " << send_queue_.size() << " buffers queued");
+}
+
+void ConnectionHandler::resumeFraming() {
+    read_paused_ = false;
+    LOG_DEBUG("Resumed reading from " << getClientInfo());
+    
+    // Requests framed before the pause still wait in the read buffer; only
+    // once they are handled without pausing again is the socket read
+    try {
+        extractMessages();
+    } catch (const std::exception& e) {
+        LOG_ERROR("Error handling read from " << getClientInfo() 
+                  << ": " << e.what());
+        handleDisconnection();
+        return;
+    }
+    if (connected_ && !read_paused_ && onReadResumed) {
+        onReadResumed(this);
     }
 }
 
 void ConnectionHandler::processMessages() {
-    if (!connected_) return;
+    if (!connected_ || read_paused_) return;
     
     // Extract complete messages from read buffer
     extractMessages();
 }
 
-void ConnectionHandler::sendMessage(const std::string& message) {
-    if (!connected_) return;
-    
-    // Use pre-allocated buffer to avoid string allocations
-    temp_buffer_->reset();
-    temp_buffer_->append(message);
-    temp_buffer_->append(MESSAGE_DELIMITER);
+SendStatus ConnectionHandler::sendMessage(const std::string& message) {
+    if (!connected_) return SendStatus::Disconnected;
     
-    send_queue_.enqueue(temp_buffer_->data(), temp_buffer_->size());
+    SendStatus status = queueFramed(message.data(), message.size());
     
     // Debug output
-    std::cout << "Queued message for " << getClientInfo() << ": " << message << std::endl;
+    LOG_DEBUG("Queued message for " << getClientInfo() << ": " << message);
+    return status;
 }
 
-void ConnectionHandler::sendMessage(const char* data, size_t length) {
-    if (!connected_) return;
+SendStatus ConnectionHandler::sendMessage(const char* data, size_t length) {
+    if (!connected_) return SendStatus::Disconnected;
     
-    // Use pre-allocated buffer to avoid string allocations
-    temp_buffer_->reset();
-    temp_buffer_->append(data, length);
-    temp_buffer_->append(MESSAGE_DELIMITER);
+    return queueFramed(data, length);
+}
+
+SendStatus ConnectionHandler::queueFramed(const char* data, size_t length) {
+    // Frame straight into the pooled send buffer: no intermediate copy and
+    // no shared scratch buffer, so any thread may send concurrently
+    struct iovec parts[Framing::MAX_FRAME_PARTS];
+    char header[Framing::MAX_HEADER_SIZE];
+    size_t count;
+    std::string_view compressed;
+    if (isCompressing() && compressor_->compress(data, length, compressed)) {
+        // Compressed into this thread's output buffer, copied by enqueue()
+        count = Framing::frameParts(framing_, compressed.data(), compressed.size(), header, parts);
+        header[0] |= static_cast<char>(MessageCompressor::COMPRESSED_FLAG >> 24);
+    } else {
+        count = Framing::frameParts(framing_, data, length, header, parts);
+    }
     
-    send_queue_.enqueue(temp_buffer_->data(), temp_buffer_->size());
+    bool was_empty = send_queue_.empty();
+    SendStatus status = send_queue_.enqueue(parts, count);
+    if (status != SendStatus::Queued) {
+        Metrics::add(Counter::MessagesDropped);
+        LOG_WARN("Send queue rejected message for " << getClientInfo() << " ("
+                 << (status == SendStatus::MemoryLimit ? "memory limit" : "queue full") << "), dropped");
+        return status;
+    }
+    noteQueued(was_empty);
+    return status;
 }
 
-void ConnectionHandler::sendMessage(const MessageBuffer& buffer) {
-    if (!connected_) return;
+SendStatus ConnectionHandler::sendMessage(const MessageBuffer& buffer) {
+    if (!connected_) return SendStatus::Disconnected;
     
     // Direct enqueue without additional formatting
-    send_queue_.enqueue(buffer.data(), buffer.size());
+    bool was_empty = send_queue_.empty();
+    SendStatus status = send_queue_.enqueue(buffer.data(), buffer.size());
+    if (status != SendStatus::Queued) {
+        Metrics::add(Counter::MessagesDropped);
+        return status;
+    }
+    noteQueued(was_empty);
+    return status;
+}
+
+SendStatus ConnectionHandler::sendMessage(std::shared_ptr<const SharedPayload> payload) {
+    if (!connected_) return SendStatus::Disconnected;
+    
+    // Already framed; the queue only references the shared bytes
+    bool was_empty = send_queue_.empty();
+    SendStatus status = send_queue_.enqueue(std::move(payload));
+    if (status != SendStatus::Queued) {
+        Metrics::add(Counter::MessagesDropped);
+        LOG_WARN("Send queue rejected shared message for " << getClientInfo() << " ("
+                 << (status == SendStatus::MemoryLimit ? "memory limit" : "queue full") << "), dropped");
+        return status;
+    }
+    noteQueued(was_empty);
+    return status;
 }
 
 bool ConnectionHandler::hasMessagesToSend() const {
     return !send_queue_.empty();
 }
 
+void ConnectionHandler::startTls(std::unique_ptr<TlsSession> session) {
+    tls_ = std::move(session);
+}
+
+void ConnectionHandler::continueHandshake() {
+    if (!tls_ || !connected_) return;
+    
+    switch (tls_->handshake()) {
+        case TlsSession::Status::Pending:
+            setWriteBlocked(false);
+            return;
+        case TlsSession::Status::WantWrite:
+            // The backend watches for writability and handleWrite() continues
+            setWriteBlocked(true);
+            return;
+        case TlsSession::Status::Done:
+            tls_.reset();
+            setWriteBlocked(false);
+            Metrics::add(Counter::TlsHandshakes);
+            updateActivity(std::chrono::steady_clock::now().time_since_epoch().count());
+            LOG_DEBUG("TLS handshake with " << getClientInfo() << " complete");
+            return;
+        case TlsSession::Status::Failed:
+            Metrics::add(Counter::TlsHandshakeFailures);
+            LOG_WARN("TLS handshake with " << getClientInfo() << " failed: " << tls_->error());
+            tls_.reset();
+            handleDisconnection();
+            return;
+    }
+}
+
+void ConnectionHandler::requestFlush() {
+    if (!isFlushDue()) {
+        return; // The reactor's flush tick picks it up
+    }
+    if (worker_) {
+        worker_->post(this, ConnectionWorker::EVENT_WRITE);
+    } else if (onFlushRequested) {
+        onFlushRequested(this);
+    }
+}
+
+namespace {
+constexpr uint64_t DATAGRAM_PEER_VALID = uint64_t(1) << 48;
+}
+
+bool ConnectionHandler::getDatagramPeer(PeerAddress& peer) const {
+    uint64_t packed = datagram_peer_.load(std::memory_order_acquire);
+    if (!(packed & DATAGRAM_PEER_VALID)) {
+        return false;
+    }
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = static_cast<uint32_t>(packed >> 16);
+    address.sin_port = static_cast<uint16_t>(packed);
+    peer = PeerAddress(address);
+    return true;
+}
+
+void ConnectionHandler::setDatagramPeer(const PeerAddress& peer) {
+    // Both fields stay in network byte order
+    uint64_t packed = DATAGRAM_PEER_VALID | (uint64_t(peer.get().sin_addr.s_addr) << 16) | peer.get().sin_port;
+    if (datagram_peer_.load(std::memory_order_relaxed) != packed) {
+        datagram_peer_.store(packed, std::memory_order_release);
+    }
+}
+
 bool ConnectionHandler::isConnected() const {
     return connected_;
 }
 
 void ConnectionHandler::close() {
-    if (connected_) {
+    // The socket is closed even after a disconnect was detected, otherwise
+    // the descriptor leaks once connected_ has been cleared
+    if (socket_open_) {
         // Clear send queue to free memory
         send_queue_.clear();
         
         ::close(client_fd_);
+        socket_open_ = false;
         connected_ = false;
-        std::cout << "Closed connection to " << getClientInfo() << std::endl;
+        LOG_DEBUG("Closed connection to " << getClientInfo());
     }
 }
 
@@ -174,19 +496,40 @@ void ConnectionHandler::setDisconnected() {
     connected_ = false;
 }
 
-std::string ConnectionHandler::getClientInfo() const {
-    return client_ip_ + ":" + std::to_string(client_port_);
+void ConnectionHandler::noteQueued(bool was_empty) {
+    Metrics::add(Counter::MessagesSent);
+    
+    // A write stall is measured from the moment data started waiting, not
+    // from the last send before an idle period
+    if (was_empty) {
+        auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+        last_write_.store(now, std::memory_order_relaxed);
+        queued_since_.store(now, std::memory_order_relaxed);
+    }
+}
+
+void ConnectionHandler::markRead() {
+    // Messages framed before noteReceived() still count from their read
+    if (Metrics::getInstance().isEnabled()) {
+        dispatch_read_time_ = std::chrono::steady_clock::now().time_since_epoch().count();
+    }
 }
 
-void ConnectionHandler::updateActivity() {
-    last_activity_ = std::chrono::steady_clock::now();
+uint64_t ConnectionHandler::elapsedNanoseconds(std::chrono::steady_clock::rep since,
+                                               std::chrono::steady_clock::rep now) {
+    auto elapsed = std::chrono::steady_clock::duration(now > since ? now - since : 0);
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
+
+void ConnectionHandler::updateActivity(std::chrono::steady_clock::rep now) {
+    last_activity_.store(now, std::memory_order_relaxed);
 }
 
 void ConnectionHandler::processIncomingData() {
     // Check if read buffer is getting too large
-    if (read_buffer_.size() > MAX_MESSAGE_SIZE * 10) {
-        std::cerr << "Read buffer too large for " << getClientInfo() 
-                  << ", disconnecting" << std::endl;
+    if (read_buffer_.readable() > READ_BUFFER_LIMIT) {
+        LOG_WARN("Read buffer too large for " << getClientInfo() 
+                 << ", disconnecting");
         handleDisconnection();
         return;
     }
@@ -196,29 +539,100 @@ void ConnectionHandler::processIncomingData() {
 }
 
 void ConnectionHandler::extractMessages() {
-    size_t pos = 0;
+    // One branch per read picks the loop compiled for the listener's codec
+    auto dispatch = [this](std::string_view message) { dispatchMessage(message); };
+    switch (framing_) {
+        case FramingMode::Newline:
+            frameMessages<NewlineCodec>(dispatch);
+            break;
+        case FramingMode::Length32:
+            frameMessages<Length32Codec>(dispatch);
+            break;
+        case FramingMode::Varint:
+            frameMessages<VarintCodec>(dispatch);
+            break;
+    }
+    deliverBatch();
+}
+
+void ConnectionHandler::rejectFrame(const char* reason) {
+    LOG_WARN("Rejected frame from " << getClientInfo() << " (" << reason << "), disconnecting");
+    handleDisconnection();
+}
+
+bool ConnectionHandler::negotiateCompression(std::string_view frame) {
+    hello_pending_ = false;
     
-    while ((pos = read_buffer_.find(MESSAGE_DELIMITER)) != std::string::npos) {
-        std::string message = read_buffer_.substr(0, pos);
-        read_buffer_.erase(0, pos + 1); // Remove message and delimiter
-        
-        // Skip empty messages
-        if (message.empty()) continue;
-        
-        // Call message handler if set
-        if (onMessageReceived) {
-            onMessageReceived(message, this);
-        } else {
-            // Default echo behavior
-            std::string response = "Echo: " + message;
-            sendMessage(response);
+    uint32_t dictionary_id = 0;
+    if (!MessageCompressor::parseHello(frame, dictionary_id)) {
+        return false;
+    }
+    
+    // Compressed frames are marked in the length32 header; on varint
+    // listeners, or with a different dictionary, the client keeps plain frames
+    bool accepted = framing_ == FramingMode::Length32 && dictionary_id == compressor_->getDictionaryId();
+    char reply[MessageCompressor::HELLO_SIZE];
+    size_t reply_size = accepted ? compressor_->encodeAccept(reply) : MessageCompressor::encodeDecline(reply);
+    
+    // The reply is queued plain before any compressed frame can follow it
+    queueFramed(reply, reply_size);
+    if (accepted) {
+        compressing_.store(true, std::memory_order_release);
+        LOG_DEBUG("Compression enabled for " << getClientInfo());
+    }
+    return true;
+}
+
+void ConnectionHandler::dispatchMessage(std::string_view message) {
+    noteMessage(message);
+    if (onMessageBatch) {
+        // Consumed bytes stay in place until the next write into the buffer
+        batch_.push_back(message);
+        if (batch_.size() >= MAX_BATCH_MESSAGES) {
+            deliverBatch();
+        }
+        return;
+    }
+    noteHandlerLatency();
+    
+    if (onMessageView) {
+        onMessageView(message, this);
+    } else if (onMessageReceived) {
+        onMessageReceived(std::string(message), this);
+    } else {
+        // Default echo behavior
+        std::string response = "Echo: ";
+        response.append(message.data(), message.size());
+        sendMessage(response);
+    }
+}
+
+void ConnectionHandler::deliverBatch() {
+    if (batch_.empty()) {
+        return;
+    }
+    
+    if (Metrics::getInstance().isEnabled()) {
+        auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+        uint64_t elapsed = elapsedNanoseconds(dispatch_read_time_, now);
+        for (size_t i = 0; i < batch_.size(); ++i) {
+            Metrics::record(Histogram::ReadToHandler, elapsed);
         }
     }
+    
+    // Never leave views behind that a later read would invalidate
+    try {
+        onMessageBatch(MessageBatch{batch_.data(), batch_.size()}, this);
+    } catch (...) {
+        batch_.clear();
+        throw;
+    }
+    batch_.clear();
 }
 
 void ConnectionHandler::handleDisconnection() {
     connected_ = false;
-    std::cout << "Connection lost: " << getClientInfo() << std::endl;
+    LOG_INFO("Connection lost: " << getClientInfo());
 }
 
 std::string ConnectionHandler::formatMessage(const std::string& message) {
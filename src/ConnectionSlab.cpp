@@ -0,0 +1,79 @@
+#include "ConnectionSlab.h"
+#include <algorithm>
+
+ConnectionSlab::ConnectionSlab(size_t initial_slots, size_t max_slots)
+    : free_head_(NO_SLOT), size_(0),
+      max_slots_(std::min<size_t>(std::max<size_t>(max_slots, 1), NO_SLOT)) {
+    slots_.reserve(std::min(std::max<size_t>(initial_slots, 1), max_slots_));
+    grow();
+}
+
+ConnectionSlab::~ConnectionSlab() {
+    clear();
+}
+
+ConnectionHandle ConnectionSlab::insert(std::unique_ptr<ConnectionHandler> handler) {
+    if (free_head_ == NO_SLOT && !grow()) {
+        return INVALID_HANDLE;
+    }
+
+    uint32_t index = free_head_;
+    Slot& slot = slots_[index];
+    free_head_ = slot.next_free;
+
+    int fd = handler->getClientFd();
+    slot.fd = fd;
+    slot.handler = std::move(handler);
+    slot.next_free = NO_SLOT;
+    ++size_;
+
+    if (static_cast<size_t>(fd) >= fd_slots_.size()) {
+        fd_slots_.resize(std::max<size_t>(fd + 1, fd_slots_.size() * 2), NO_SLOT);
+    }
+    fd_slots_[fd] = index;
+
+    return makeHandle(index);
+}
+
+std::unique_ptr<ConnectionHandler> ConnectionSlab::release(ConnectionHandle handle) {
+    if (!get(handle)) {
+        return nullptr;
+    }
+
+    uint32_t index = static_cast<uint32_t>(handle);
+    Slot& slot = slots_[index];
+    fd_slots_[slot.fd] = NO_SLOT;
+
+    // Invalidate every outstanding handle to this slot; 0 is never issued
+    if (++slot.generation == 0) {
+        slot.generation = 1;
+    }
+    slot.fd = -1;
+    slot.next_free = free_head_;
+    free_head_ = index;
+    --size_;
+
+    return std::move(slot.handler);
+}
+
+void ConnectionSlab::clear() {
+    forEach([this](ConnectionHandle handle, ConnectionHandler*) { release(handle); });
+}
+
+bool ConnectionSlab::grow() {
+    size_t old_size = slots_.size();
+    if (old_size >= max_slots_) {
+        return false;
+    }
+
+    // First call fills the preallocated capacity, later ones double
+    size_t new_size = old_size == 0 ? slots_.capacity() : std::min(old_size * 2, max_slots_);
+    slots_.resize(new_size);
+
+    // Push in reverse so the lowest free index is handed out first
+    for (size_t i = new_size; i-- > old_size;) {
+        slots_[i].next_free = free_head_;
+        free_head_ = static_cast<uint32_t>(i);
+    }
+    return true;
+}
@@ -0,0 +1,114 @@
+#include "ConnectionWorker.h"
+#include "ConnectionHandler.h"
+#include "CpuAffinity.h"
+#include <chrono>
+
+ConnectionWorker::ConnectionWorker(int id, int cpu)
+    : id_(id), cpu_(cpu), running_(false), sleeping_(false) {
+}
+
+ConnectionWorker::~ConnectionWorker() {
+    stop();
+}
+
+void ConnectionWorker::start() {
+    running_ = true;
+    thread_ = std::thread([this]() { run(); });
+}
+
+void ConnectionWorker::stop() {
+    if (!thread_.joinable()) {
+        return;
+    }
+
+    running_ = false;
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        wake_.notify_one();
+    }
+    thread_.join();
+}
+
+void ConnectionWorker::post(ConnectionHandler* handler, uint32_t events) {
+    uint32_t previous = handler->pending_events_.fetch_or(events | EVENT_SCHEDULED);
+    if (previous & EVENT_SCHEDULED) {
+        return; // Already queued, the worker will pick up the new bits
+    }
+
+    ready_.push(&handler->ready_link_);
+
+    if (sleeping_.load()) {
+        std::lock_guard<std::mutex> lock(sleep_mutex_);
+        wake_.notify_one();
+    }
+}
+
+void ConnectionWorker::run() {
+    CpuAffinity::pinCurrentThread(cpu_, ("Connection worker " + std::to_string(id_)).c_str());
+
+    while (running_) {
+        ConnectionHandler* handler = ready_.pop();
+        if (handler) {
+            process(handler);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        sleeping_.store(true);
+        if (running_ && ready_.idle()) {
+            wake_.wait_for(lock, std::chrono::milliseconds(100));
+        }
+        sleeping_.store(false);
+    }
+
+    drain();
+}
+
+void ConnectionWorker::process(ConnectionHandler* handler) {
+    // Clearing EVENT_SCHEDULED first lets producers re-queue the connection
+    // while we work on it; only this thread ever pops it, so there is no overlap
+    uint32_t events = handler->pending_events_.exchange(0);
+
+    if (events & EVENT_DESTROY) {
+        delete handler;
+        return;
+    }
+
+    if (events & EVENT_READ) {
+        handler->handleRead();
+        handler->processMessages();
+    }
+
+    if (events & EVENT_CLOSE) {
+        handler->setDisconnected();
+    }
+
+    // Flush replies produced while processing as well as EPOLLOUT wakeups;
+    // deferred replies wait for the reactor's flush tick
+    if ((events & EVENT_WRITE) || (handler->hasMessagesToSend() && handler->isFlushDue())) {
+        handler->handleWrite();
+    }
+
+    if (!handler->isConnected() && !handler->close_requested_) {
+        handler->close_requested_ = true;
+        if (handler->onClosed) {
+            handler->onClosed(handler);
+        }
+    }
+}
+
+void ConnectionWorker::drain() {
+    // Only honour ownership hand-offs on shutdown; live connections are
+    // still owned by their reactor and are destroyed there
+    while (!ready_.idle()) {
+        ConnectionHandler* handler = ready_.pop();
+        if (!handler) {
+            continue;
+        }
+
+        uint32_t events = handler->pending_events_.exchange(0);
+        if (events & EVENT_DESTROY) {
+            delete handler;
+        }
+    }
+}
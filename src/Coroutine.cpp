@@ -0,0 +1,314 @@
+#include "Coroutine.h"
+
+#ifdef HAVE_COROUTINES
+
+#include "ConnectionHandler.h"
+#include "Logger.h"
+#include "Reactor.h"
+#include <new>
+#include <stdexcept>
+
+namespace {
+
+thread_local CoroutineArena* current_arena = nullptr;
+
+// Every frame starts with the arena it came from (nullptr: general heap),
+// padded so the frame itself stays maximally aligned
+struct FrameHeader {
+    CoroutineArena* arena;
+};
+constexpr size_t HEADER_SIZE = alignof(std::max_align_t);
+static_assert(sizeof(FrameHeader) <= HEADER_SIZE, "frame header does not fit");
+
+size_t sizeClass(size_t total) {
+    return (total + CoroutineArena::GRANULE - 1) / CoroutineArena::GRANULE;
+}
+
+// How long close() waits for queued replies to reach the socket
+constexpr auto CLOSE_LINGER = std::chrono::seconds(5);
+constexpr auto CLOSE_POLL_INTERVAL = std::chrono::milliseconds(100);
+
+// Continue at the reactor's next wakeup, outside the caller's stack
+struct Reschedule {
+    Reactor* reactor;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) { coroutine_detail::resumeOn(reactor, handle); }
+    void await_resume() noexcept {}
+};
+
+} // namespace
+
+Task AsyncConnection::closeWhenFlushed(std::shared_ptr<Session> session) {
+    Reactor* reactor = session->reactor;
+    co_await Reschedule{reactor};
+
+    // The flush runs on the connection's I/O thread; give it a moment
+    auto deadline = std::chrono::steady_clock::now() + CLOSE_LINGER;
+    while (session->handler && session->handler->hasMessagesToSend() &&
+           std::chrono::steady_clock::now() < deadline) {
+        co_await sleepFor(CLOSE_POLL_INTERVAL);
+    }
+    if (session->handler) {
+        reactor->closeConnection(session->handle);
+    }
+}
+
+CoroutineArena::CoroutineArena() : roots_(nullptr), live_frames_(0), cached_frames_(0) {
+    for (auto& list : free_) {
+        list = nullptr;
+    }
+}
+
+CoroutineArena::~CoroutineArena() {
+    destroyRoots();
+    for (auto& list : free_) {
+        while (list) {
+            FreeBlock* block = list;
+            list = block->next;
+            ::operator delete(block);
+        }
+    }
+}
+
+CoroutineArena* CoroutineArena::current() {
+    return current_arena;
+}
+
+void CoroutineArena::setCurrent(CoroutineArena* arena) {
+    current_arena = arena;
+}
+
+void* CoroutineArena::allocateFrame(size_t size) {
+    size_t total = size + HEADER_SIZE;
+    size_t index = sizeClass(total);
+    CoroutineArena* arena = current_arena;
+    if (index >= CLASS_COUNT) {
+        arena = nullptr;
+    }
+
+    void* block;
+    if (arena && arena->free_[index]) {
+        FreeBlock* reused = arena->free_[index];
+        arena->free_[index] = reused->next;
+        --arena->cached_frames_;
+        block = reused;
+    } else {
+        // Pooled blocks are rounded up so any frame of the class fits on reuse
+        block = ::operator new(arena ? index * GRANULE : total);
+    }
+    if (arena) {
+        ++arena->live_frames_;
+    }
+
+    static_cast<FrameHeader*>(block)->arena = arena;
+    return static_cast<char*>(block) + HEADER_SIZE;
+}
+
+void CoroutineArena::deallocateFrame(void* frame, size_t size) {
+    void* block = static_cast<char*>(frame) - HEADER_SIZE;
+    CoroutineArena* arena = static_cast<FrameHeader*>(block)->arena;
+    if (!arena) {
+        ::operator delete(block);
+        return;
+    }
+
+    // Frames die on the thread that created them, see Coroutine.h
+    size_t index = sizeClass(size + HEADER_SIZE);
+    FreeBlock* freed = static_cast<FreeBlock*>(block);
+    freed->next = arena->free_[index];
+    arena->free_[index] = freed;
+    --arena->live_frames_;
+    ++arena->cached_frames_;
+}
+
+void CoroutineArena::addRoot(RootLink* link) {
+    link->prev = nullptr;
+    link->next = roots_;
+    if (roots_) {
+        roots_->prev = link;
+    }
+    roots_ = link;
+}
+
+void CoroutineArena::removeRoot(RootLink* link) {
+    if (link->prev) {
+        link->prev->next = link->next;
+    } else {
+        roots_ = link->next;
+    }
+    if (link->next) {
+        link->next->prev = link->prev;
+    }
+    link->prev = nullptr;
+    link->next = nullptr;
+}
+
+void CoroutineArena::destroyRoots() {
+    // Each destroy() runs the promise destructor, which unlinks the root
+    while (roots_) {
+        roots_->handle.destroy();
+    }
+}
+
+namespace coroutine_detail {
+
+void resumeOn(Reactor* reactor, std::coroutine_handle<> handle) {
+    reactor->post([handle]() { handle.resume(); });
+}
+
+Reactor* requireReactor() {
+    Reactor* reactor = Reactor::current();
+    if (!reactor) {
+        throw std::logic_error("coroutine suspended outside a reactor thread");
+    }
+    return reactor;
+}
+
+} // namespace coroutine_detail
+
+Task::promise_type::promise_type() : arena(CoroutineArena::current()) {
+    root.handle = std::coroutine_handle<promise_type>::from_promise(*this);
+    if (arena) {
+        arena->addRoot(&root);
+    }
+}
+
+Task::promise_type::~promise_type() {
+    if (arena) {
+        arena->removeRoot(&root);
+    }
+}
+
+void Task::promise_type::unhandled_exception() noexcept {
+    try {
+        throw;
+    } catch (const std::exception& e) {
+        LOG_ERROR("Coroutine ended with an exception: " << e.what());
+    } catch (...) {
+        LOG_ERROR("Coroutine ended with an unknown exception");
+    }
+}
+
+SleepAwaiter::~SleepAwaiter() {
+    // Destroyed while suspended (reactor shutdown): leave the wheel clean
+    if (reactor_) {
+        reactor_->cancelSleep(this);
+    }
+}
+
+void SleepAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    handle_ = handle;
+    reactor_ = coroutine_detail::requireReactor();
+    reactor_->scheduleSleep(this, std::chrono::steady_clock::now() + duration_);
+}
+
+namespace {
+constexpr size_t INITIAL_INBOX_SIZE = 4;
+}
+
+AsyncConnection::Session::Session() : current(std::make_unique<std::string>()) {
+    inbox.reserve(INITIAL_INBOX_SIZE);
+    for (size_t i = 0; i < INITIAL_INBOX_SIZE; ++i) {
+        inbox.push_back(std::make_unique<std::string>());
+    }
+}
+
+void AsyncConnection::Session::deliver(std::string_view message) {
+    if (closed) {
+        return;
+    }
+    queue(message);
+    wake();
+}
+
+bool AsyncConnection::Session::queue(std::string_view message) {
+    std::lock_guard<std::mutex> lock(inbox_mutex);
+    if (inbox_count == inbox.size()) {
+        // Grows only while the session falls behind, oldest first again
+        std::vector<std::unique_ptr<std::string>> grown;
+        grown.reserve(inbox.size() * 2);
+        for (size_t i = 0; i < inbox.size(); ++i) {
+            grown.push_back(std::move(inbox[(inbox_head + i) % inbox.size()]));
+        }
+        while (grown.size() < grown.capacity()) {
+            grown.push_back(std::make_unique<std::string>());
+        }
+        inbox.swap(grown);
+        inbox_head = 0;
+    }
+    inbox[(inbox_head + inbox_count) % inbox.size()]->assign(message.data(), message.size());
+    ++inbox_count;
+    return !std::exchange(wake_posted, true);
+}
+
+void AsyncConnection::Session::wake() {
+    {
+        std::lock_guard<std::mutex> lock(inbox_mutex);
+        wake_posted = false;
+        // A read that did not suspend may have taken the messages already
+        if (inbox_count == 0) {
+            return;
+        }
+    }
+    if (reader) {
+        std::exchange(reader, nullptr).resume();
+    }
+}
+
+bool AsyncConnection::Session::hasMessage() {
+    std::lock_guard<std::mutex> lock(inbox_mutex);
+    return inbox_count > 0;
+}
+
+void AsyncConnection::Session::detach() {
+    closed = true;
+    handler = nullptr;
+    if (reader) {
+        // Called while the reactor tears the connection down
+        coroutine_detail::resumeOn(reactor, std::exchange(reader, nullptr));
+    }
+}
+
+void AsyncConnection::ReadAwaiter::await_suspend(std::coroutine_handle<> handle) {
+    if (session->reader) {
+        throw std::logic_error("concurrent read() on one connection");
+    }
+    session->reader = handle;
+}
+
+std::optional<std::string_view> AsyncConnection::ReadAwaiter::await_resume() {
+    std::lock_guard<std::mutex> lock(session->inbox_mutex);
+    if (session->inbox_count == 0) {
+        return std::nullopt;
+    }
+    // The previous message's string takes the freed slot
+    std::swap(session->current, session->inbox[session->inbox_head]);
+    session->inbox_head = (session->inbox_head + 1) % session->inbox.size();
+    --session->inbox_count;
+    return std::string_view(*session->current);
+}
+
+SendStatus AsyncConnection::send(const std::string& message) const {
+    ConnectionHandler* handler = session_->handler;
+    if (!handler) {
+        return SendStatus::Disconnected;
+    }
+    SendStatus status = handler->sendMessage(message);
+    if (status == SendStatus::Queued) {
+        handler->requestFlush();
+    }
+    return status;
+}
+
+void AsyncConnection::close() const {
+    if (session_->closed || session_->closing) {
+        return;
+    }
+    // Never tear the handler down under the caller, which may be running
+    // inside its message dispatch, and let queued replies go out first
+    session_->closing = true;
+    closeWhenFlushed(session_);
+}
+
+#endif // HAVE_COROUTINES
@@ -0,0 +1,107 @@
+#include "CpuAffinity.h"
+#include "Logger.h"
+#include <dirent.h>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+namespace CpuAffinity {
+
+bool parseCpuList(const std::string& text, std::vector<int>& cpus) {
+    std::vector<int> parsed;
+    size_t position = 0;
+    while (position < text.size()) {
+        size_t end = text.find(',', position);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        std::string item = text.substr(position, end - position);
+        position = end + 1;
+        if (item.empty()) {
+            return false;
+        }
+
+        // "a" or "a-b"
+        char* rest = nullptr;
+        long first = std::strtol(item.c_str(), &rest, 10);
+        long last = first;
+        if (*rest == '-') {
+            last = std::strtol(rest + 1, &rest, 10);
+        }
+        if (*rest != '\0' || rest == item.c_str() || first < 0 || last < first || last >= CPU_SETSIZE) {
+            return false;
+        }
+        for (long cpu = first; cpu <= last; ++cpu) {
+            parsed.push_back(static_cast<int>(cpu));
+        }
+    }
+
+    cpus.swap(parsed);
+    return true;
+}
+
+bool pinCurrentThread(int cpu, const char* who) {
+    if (cpu < 0) {
+        return true;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (error != 0) {
+        LOG_WARN(who << ": cannot pin to CPU " << cpu << ": " << strerror(error));
+        return false;
+    }
+    LOG_INFO(who << " pinned to CPU " << cpu << " (node " << nodeOfCpu(cpu) << ")");
+    return true;
+}
+
+int nodeOfCpu(int cpu) {
+    // /sys/devices/system/cpu/cpuN/ holds a nodeM link on NUMA kernels
+    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR* directory = opendir(path.c_str());
+    if (!directory) {
+        return 0;
+    }
+
+    int node = 0;
+    while (struct dirent* entry = readdir(directory)) {
+        if (std::strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9') {
+            node = std::atoi(entry->d_name + 4);
+            break;
+        }
+    }
+    closedir(directory);
+    return node;
+}
+
+ScopedNodePreference::ScopedNodePreference(int cpu) : active_(false) {
+    if (cpu < 0) {
+        return;
+    }
+
+    int node = nodeOfCpu(cpu);
+    unsigned long mask[(1024 + 8 * sizeof(unsigned long) - 1) / (8 * sizeof(unsigned long))] = {};
+    if (node < 0 || node >= 1024) {
+        return;
+    }
+    mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+
+    // No libnuma needed; fails with ENOSYS on kernels without NUMA support,
+    // where there is nothing to prefer anyway
+    active_ = syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, 1024 + 1) == 0;
+}
+
+ScopedNodePreference::~ScopedNodePreference() {
+    if (active_) {
+        syscall(SYS_set_mempolicy, MPOL_DEFAULT, nullptr, 0);
+    }
+}
+
+} // namespace CpuAffinity
@@ -0,0 +1,259 @@
+#include "EpollBackend.h"
+#include "Reactor.h"
+#include "Logger.h"
+#include "Metrics.h"
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <unistd.h>
+
+EpollBackend::EpollBackend(Reactor& reactor)
+    : reactor_(reactor), epoll_fd_(-1), wake_fd_(-1) {
+}
+
+EpollBackend::~EpollBackend() {
+    if (epoll_fd_ != -1) {
+        ::close(epoll_fd_);
+    }
+}
+
+bool EpollBackend::init() {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ == -1) {
+        LOG_ERROR("Failed to create epoll: " << strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool EpollBackend::addListener(int listen_fd) {
+    // Descriptors that are not connections use generation-0 tokens
+    struct epoll_event event;
+    event.data.u64 = static_cast<uint64_t>(listen_fd);
+    // Level-triggered, so a capped accept batch is resumed on the next wait
+    event.events = EPOLLIN;
+
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd, &event) == -1) {
+        LOG_ERROR("Failed to add server socket to epoll: " << strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void EpollBackend::removeListener(int listen_fd) {
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, listen_fd, nullptr) == -1) {
+        LOG_ERROR("Failed to remove server socket from epoll: " << strerror(errno));
+    }
+}
+
+bool EpollBackend::addWakeFd(int wake_fd) {
+    struct epoll_event event;
+    event.data.u64 = static_cast<uint64_t>(wake_fd);
+    event.events = EPOLLIN;
+
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd, &event) == -1) {
+        LOG_ERROR("Failed to add eventfd to epoll: " << strerror(errno));
+        return false;
+    }
+    wake_fd_ = wake_fd;
+    return true;
+}
+
+bool EpollBackend::addConnection(ConnectionHandle handle, ConnectionHandler* handler) {
+    // Read events only; EPOLLOUT is added while a write is blocked
+    struct epoll_event event;
+    event.data.u64 = handle;
+    event.events = EPOLLIN | EPOLLET | EPOLLRDHUP;
+
+    Metrics::add(Counter::SyscallEpollCtl);
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, handler->getClientFd(), &event) == -1) {
+        LOG_ERROR("Failed to add client to epoll: " << strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void EpollBackend::removeConnection(ConnectionHandle, ConnectionHandler* handler) {
+    // Remove from epoll before the handler closes the socket
+    Metrics::add(Counter::SyscallEpollCtl);
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, handler->getClientFd(), nullptr);
+}
+
+void EpollBackend::release(ConnectionHandle, std::unique_ptr<ConnectionHandler> handler) {
+    // Nothing is in flight once the socket left epoll
+    handler->close();
+}
+
+void EpollBackend::write(ConnectionHandle, ConnectionHandler* handler) {
+    handler->handleWrite();
+}
+
+void EpollBackend::requestWrite(ConnectionHandle handle, ConnectionHandler* handler) {
+    if (ConnectionWorker* worker = handler->getWorker()) {
+        // The worker writes inline and watches EPOLLOUT itself if the socket fills
+        worker->post(handler, ConnectionWorker::EVENT_WRITE);
+        return;
+    }
+
+    if (reactor_.inLoopThread()) {
+        // Written before the next wait, together with other queued replies
+        pending_.push_back(handle);
+        return;
+    }
+
+    reactor_.post([this, handle]() { pending_.push_back(handle); });
+}
+
+void EpollBackend::writeBlockedChanged(ConnectionHandle handle, ConnectionHandler* handler) {
+    if (handler->getWorker()) {
+        // Called on the worker, the only thread doing this connection's I/O
+        updateInterest(handle, handler);
+        return;
+    }
+
+    pending_.push_back(handle);
+}
+
+void EpollBackend::resumeRead(ConnectionHandle handle, ConnectionHandler* handler) {
+    if (ConnectionWorker* worker = handler->getWorker()) {
+        worker->post(handler, ConnectionWorker::EVENT_READ);
+        return;
+    }
+
+    // No new edge will come for data already waiting in the socket
+    resumed_.push_back(handle);
+}
+
+void EpollBackend::flushPending() {
+    size_t flushed = 0;
+    do {
+        // Resumed connections read what the kernel held back
+        while (!resumed_.empty()) {
+            std::vector<ConnectionHandle> resumed;
+            resumed.swap(resumed_);
+            for (ConnectionHandle handle : resumed) {
+                reactor_.handleClientEvent(handle, EPOLLIN);
+            }
+        }
+
+        // Writes next: a write that blocks or drains appends to pending_
+        // again, and one that drains a paused queue resumes its reader
+        for (; flushed < pending_.size(); ++flushed) {
+            ConnectionHandle handle = pending_[flushed];
+            ConnectionHandler* handler = reactor_.connections_.get(handle);
+            // A blocked write resumes on EPOLLOUT instead
+            if (!handler || handler->isWriteBlocked() || !handler->hasMessagesToSend()) {
+                continue;
+            }
+
+            handler->handleWrite();
+            if (!handler->isConnected()) {
+                reactor_.cleanupConnection(handle);
+            }
+        }
+    } while (!resumed_.empty());
+
+    // Then one interest update per connection whose state differs from epoll's
+    for (ConnectionHandle handle : pending_) {
+        if (ConnectionHandler* handler = reactor_.connections_.get(handle)) {
+            updateInterest(handle, handler);
+        }
+    }
+    pending_.clear();
+}
+
+void EpollBackend::updateInterest(ConnectionHandle handle, ConnectionHandler* handler) {
+    bool watch = handler->isWriteBlocked() && handler->isConnected();
+    if (watch == handler->isWriteWatched()) {
+        return;
+    }
+
+    struct epoll_event event;
+    event.data.u64 = handle;
+    event.events = EPOLLIN | EPOLLET | EPOLLRDHUP;
+    if (watch) {
+        event.events |= EPOLLOUT;
+    }
+
+    // Adding EPOLLOUT reports a socket that became writable in the meantime
+    Metrics::add(Counter::SyscallEpollCtl);
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, handler->getClientFd(), &event) == -1) {
+        if (errno != ENOENT) { // Already removed by the reactor
+            LOG_ERROR("Failed to update epoll interest for " << handler->getClientInfo()
+                      << ": " << strerror(errno));
+        }
+        return;
+    }
+    handler->setWriteWatched(watch);
+}
+
+bool EpollBackend::poll(int timeout_ms) {
+    flushPending();
+
+    struct epoll_event events[MAX_EVENTS];
+    int num_events = epoll_wait(epoll_fd_, events, MAX_EVENTS, timeout_ms);
+    Metrics::add(Counter::SyscallEpollWait);
+
+    if (num_events == -1) {
+        if (errno == EINTR) {
+            return true; // Interrupted by signal
+        }
+        LOG_ERROR("Reactor " << reactor_.getId() << ": epoll_wait error: " << strerror(errno));
+        return false;
+    }
+
+    for (int i = 0; i < num_events; ++i) {
+        uint64_t token = events[i].data.u64;
+
+        if (ConnectionSlab::isConnection(token)) {
+            // Client event
+            reactor_.handleClientEvent(token, events[i].events);
+            continue;
+        }
+
+        int fd = static_cast<int>(token);
+        if (fd == wake_fd_) {
+            // Posted tasks or connections handed back by workers
+            reactor_.handleWakeup();
+        } else {
+            // New connection
+            acceptConnections(fd);
+        }
+    }
+    return true;
+}
+
+void EpollBackend::acceptConnections(int listen_fd) {
+    const Reactor::Listener* listener = reactor_.findListener(listen_fd);
+    if (!listener) {
+        return;
+    }
+
+    // Bounded batch: whatever is left stays readable on the level-triggered
+    // listener and is picked up after the ready clients have been served
+    size_t limit = reactor_.acceptBatch();
+    for (size_t attempts = 0; limit == 0 || attempts < limit; ++attempts) {
+        struct sockaddr_in client_addr;
+        socklen_t client_len = sizeof(client_addr);
+        // Readiness-driven I/O needs non-blocking sockets
+        int client_fd = accept4(listen_fd, (struct sockaddr*)&client_addr, &client_len,
+                                SOCK_NONBLOCK | SOCK_CLOEXEC);
+        Metrics::add(Counter::SyscallAccept);
+        if (client_fd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if ((errno == EMFILE || errno == ENFILE) && reactor_.rejectPendingConnection(listen_fd)) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                // Out of descriptors or memory: retry on the next wakeup
+                // rather than spinning here
+                LOG_ERROR("Failed to accept connection: " << strerror(errno));
+            }
+            break;
+        }
+
+        reactor_.addConnection(*listener, client_fd, PeerAddress(client_addr));
+    }
+}
@@ -0,0 +1,315 @@
+#include "HotRestart.h"
+#include "NetworkServer.h"
+#include "Logger.h"
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+namespace {
+
+// Sequenced packets keep the socket count, every batch and the one-byte
+// steps apart without any framing of our own
+bool makeAddress(const std::string& path, struct sockaddr_un& address) {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        LOG_ERROR("hot_restart_socket path too long: " << path);
+        return false;
+    }
+    std::memcpy(address.sun_path, path.data(), path.size());
+    return true;
+}
+
+bool sendByte(int fd, char byte) {
+    return send(fd, &byte, 1, MSG_NOSIGNAL) == 1;
+}
+
+bool receiveByte(int fd, char expected) {
+    char byte = 0;
+    return recv(fd, &byte, 1, 0) == 1 && byte == expected;
+}
+
+} // namespace
+
+HotRestart::HotRestart(NetworkServer& server, const std::string& path)
+    : server_(server), path_(path), predecessor_fd_(-1), listen_fd_(-1), wake_fd_(-1),
+      running_(false), draining_(false) {
+}
+
+HotRestart::~HotRestart() {
+    stop();
+    if (predecessor_fd_ != -1) {
+        ::close(predecessor_fd_);   // Without a confirm the predecessor keeps serving
+    }
+    if (wake_fd_ != -1) {
+        ::close(wake_fd_);
+    }
+}
+
+bool HotRestart::takeOver(std::vector<HandoffSocket>& sockets) {
+    struct sockaddr_un address;
+    if (!makeAddress(path_, address)) {
+        return false;
+    }
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        LOG_ERROR("Failed to create hot restart socket: " << strerror(errno));
+        return false;
+    }
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) == -1) {
+        // Nobody to take over from: the first process on this path
+        LOG_DEBUG("No process to take over on " << path_ << ": " << strerror(errno));
+        ::close(fd);
+        return false;
+    }
+
+    struct timeval timeout = {STEP_TIMEOUT_MS / 1000, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    uint32_t count = 0;
+    if (send(fd, TAKEOVER_REQUEST, sizeof(TAKEOVER_REQUEST), MSG_NOSIGNAL) != sizeof(TAKEOVER_REQUEST) ||
+        recv(fd, &count, sizeof(count), 0) != sizeof(count) || count > MAX_SOCKETS) {
+        LOG_ERROR("Takeover on " << path_ << " refused by the running process");
+        ::close(fd);
+        return false;
+    }
+
+    std::vector<HandoffSocket> received;
+    while (received.size() < count) {
+        int ports[SOCKETS_PER_MESSAGE];
+        union {
+            char buffer[CMSG_SPACE(sizeof(int) * SOCKETS_PER_MESSAGE)];
+            struct cmsghdr align;
+        } control;
+        struct iovec iov = {ports, sizeof(ports)};
+        struct msghdr message = {};
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = control.buffer;
+        message.msg_controllen = sizeof(control.buffer);
+
+        ssize_t length = recvmsg(fd, &message, MSG_CMSG_CLOEXEC);
+        struct cmsghdr* cmsg = length > 0 ? CMSG_FIRSTHDR(&message) : nullptr;
+        if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+            (message.msg_flags & MSG_CTRUNC)) {
+            LOG_ERROR("Takeover on " << path_ << " failed: listening sockets not received");
+            for (const HandoffSocket& socket : received) {
+                ::close(socket.fd);
+            }
+            ::close(fd);
+            return false;
+        }
+
+        // One port per descriptor, in the same order
+        size_t fds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        int descriptors[SOCKETS_PER_MESSAGE];
+        std::memcpy(descriptors, CMSG_DATA(cmsg), fds * sizeof(int));
+        for (size_t i = 0; i < fds; ++i) {
+            received.push_back({ports[i], descriptors[i]});
+        }
+        if (static_cast<size_t>(length) != fds * sizeof(int)) {
+            LOG_ERROR("Takeover on " << path_ << " failed: malformed socket list");
+            for (const HandoffSocket& socket : received) {
+                ::close(socket.fd);
+            }
+            ::close(fd);
+            return false;
+        }
+    }
+
+    predecessor_fd_ = fd;
+    sockets.insert(sockets.end(), received.begin(), received.end());
+    LOG_INFO("Took over " << count << " listening socket(s) from the running process on " << path_);
+    return true;
+}
+
+bool HotRestart::confirmTakeover() {
+    if (predecessor_fd_ == -1) {
+        return true;
+    }
+    bool released = sendByte(predecessor_fd_, CONFIRM) && receiveByte(predecessor_fd_, RELEASED);
+    if (!released) {
+        LOG_ERROR("Predecessor did not release its ports: " << strerror(errno));
+    }
+    ::close(predecessor_fd_);
+    predecessor_fd_ = -1;
+    return released;
+}
+
+bool HotRestart::listen() {
+    struct sockaddr_un address;
+    if (!makeAddress(path_, address)) {
+        return false;
+    }
+
+    listen_fd_ = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (listen_fd_ == -1) {
+        LOG_ERROR("Failed to create hot restart socket: " << strerror(errno));
+        return false;
+    }
+    // The path is ours now; a predecessor has already let go of it
+    ::unlink(path_.c_str());
+    if (bind(listen_fd_, (struct sockaddr*)&address, sizeof(address)) == -1 ||
+        ::listen(listen_fd_, 1) == -1) {
+        LOG_ERROR("Failed to listen on hot restart socket " << path_ << ": " << strerror(errno));
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+        return false;
+    }
+
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ == -1) {
+        LOG_ERROR("Failed to create eventfd: " << strerror(errno));
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+        return false;
+    }
+
+    running_ = true;
+    thread_ = std::thread([this]() { run(); });
+    LOG_INFO("Hot restart: successors take over through " << path_);
+    return true;
+}
+
+void HotRestart::stop() {
+    if (running_.exchange(false)) {
+        uint64_t one = 1;
+        ssize_t ignored = ::write(wake_fd_, &one, sizeof(one));
+        (void)ignored;
+    }
+    if (thread_.joinable()) {
+        if (thread_.get_id() == std::this_thread::get_id()) {
+            thread_.detach();   // stop() from the drain ended up here
+        } else {
+            thread_.join();
+        }
+    }
+
+    if (listen_fd_ != -1) {
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+        // A successor rebinds the path; only a process that kept it removes it
+        if (!draining_) {
+            ::unlink(path_.c_str());
+        }
+    }
+}
+
+void HotRestart::run() {
+    while (running_) {
+        if (!waitReadable(listen_fd_, -1)) {
+            break;
+        }
+        int successor_fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (successor_fd == -1) {
+            if (errno != EINTR && errno != EAGAIN) {
+                LOG_ERROR("Hot restart accept failed: " << strerror(errno));
+            }
+            continue;
+        }
+
+        bool taken_over = serveTakeover(successor_fd);
+        ::close(successor_fd);
+        if (taken_over) {
+            drain();
+            return;
+        }
+    }
+}
+
+bool HotRestart::serveTakeover(int successor_fd) {
+    char request[sizeof(TAKEOVER_REQUEST)];
+    if (!waitReadable(successor_fd, STEP_TIMEOUT_MS) ||
+        recv(successor_fd, request, sizeof(request), 0) != sizeof(request) ||
+        std::memcmp(request, TAKEOVER_REQUEST, sizeof(request)) != 0) {
+        LOG_WARN("Hot restart: ignoring a connection without a takeover request");
+        return false;
+    }
+
+    std::vector<HandoffSocket> sockets = server_.handoffSockets();
+    uint32_t count = static_cast<uint32_t>(sockets.size());
+    if (send(successor_fd, &count, sizeof(count), MSG_NOSIGNAL) != sizeof(count)) {
+        return false;
+    }
+
+    // Duplicates travel; this process keeps accepting on its own copies
+    for (size_t first = 0; first < sockets.size(); first += SOCKETS_PER_MESSAGE) {
+        size_t batch = std::min(SOCKETS_PER_MESSAGE, sockets.size() - first);
+        int ports[SOCKETS_PER_MESSAGE];
+        int descriptors[SOCKETS_PER_MESSAGE];
+        for (size_t i = 0; i < batch; ++i) {
+            ports[i] = sockets[first + i].port;
+            descriptors[i] = sockets[first + i].fd;
+        }
+
+        union {
+            char buffer[CMSG_SPACE(sizeof(int) * SOCKETS_PER_MESSAGE)];
+            struct cmsghdr align;
+        } control;
+        std::memset(&control, 0, sizeof(control));
+        struct iovec iov = {ports, batch * sizeof(int)};
+        struct msghdr message = {};
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = control.buffer;
+        message.msg_controllen = CMSG_SPACE(sizeof(int) * batch);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * batch);
+        std::memcpy(CMSG_DATA(cmsg), descriptors, sizeof(int) * batch);
+
+        if (sendmsg(successor_fd, &message, MSG_NOSIGNAL) == -1) {
+            LOG_ERROR("Hot restart: failed to pass listening sockets: " << strerror(errno));
+            return false;
+        }
+    }
+
+    // The successor confirms once its listeners run on the sockets
+    if (!waitReadable(successor_fd, STEP_TIMEOUT_MS) || !receiveByte(successor_fd, CONFIRM)) {
+        LOG_ERROR("Hot restart: successor did not start, still serving");
+        return false;
+    }
+
+    draining_ = true;
+    server_.releaseToSuccessor();
+    if (!sendByte(successor_fd, RELEASED)) {
+        LOG_WARN("Hot restart: successor left before its ports were released");
+    }
+    return true;
+}
+
+void HotRestart::drain() {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(server_.config_.drain_timeout);
+    size_t remaining = server_.getConnectionCount();
+    LOG_INFO("Taken over by a new process, draining " << remaining << " connection(s)");
+
+    while (running_ && remaining > 0 && std::chrono::steady_clock::now() < deadline) {
+        waitReadable(wake_fd_, 100);
+        remaining = server_.getConnectionCount();
+    }
+    if (remaining > 0) {
+        LOG_INFO("Drain timeout, closing " << remaining << " connection(s)");
+    }
+    server_.stop();
+}
+
+bool HotRestart::waitReadable(int fd, int timeout_ms) {
+    struct pollfd fds[2];
+    fds[0] = {fd, POLLIN, 0};
+    fds[1] = {wake_fd_, POLLIN, 0};
+    while (running_) {
+        int ready = ::poll(fds, fd == wake_fd_ ? 1 : 2, timeout_ms);
+        if (ready == -1 && errno == EINTR) {
+            continue;
+        }
+        return ready > 0 && (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) && running_;
+    }
+    return false;
+}
@@ -0,0 +1,232 @@
+#include "Logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+
+// Returns the calling thread's ring to the logger when the thread exits
+struct LogRingHandle {
+    Logger::Ring* ring = nullptr;
+
+    ~LogRingHandle() {
+        if (ring) {
+            ring->in_use.store(false, std::memory_order_release);
+        }
+    }
+};
+
+Logger& Logger::getInstance() {
+    static Logger instance;
+    return instance;
+}
+
+Logger::Logger()
+    : level_(LogLevel::Info), dropped_(0), reported_dropped_(0),
+      ring_count_(0), stopping_(false) {
+    thread_ = std::thread([this]() { run(); });
+}
+
+Logger::~Logger() {
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+    drain();
+}
+
+void Logger::write(LogLevel level, const char* text, size_t length) {
+    length = std::min(length, MAX_LINE);
+
+    Ring* ring = localRing();
+    if (!ring) {
+        // Out of rings, keep the line rather than lose it
+        std::string line(text, length);
+        line += '\n';
+        writeAll(level >= LogLevel::Warn ? STDERR_FILENO : STDOUT_FILENO, line.data(), line.size());
+        return;
+    }
+
+    size_t head = ring->head.load(std::memory_order_relaxed);
+    if (head - ring->tail.load(std::memory_order_acquire) >= RING_CAPACITY) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Record& record = ring->records[head % RING_CAPACITY];
+    record.level = level;
+    record.length = static_cast<uint32_t>(length);
+    std::memcpy(record.text, text, length);
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+void Logger::flush() {
+    drain();
+}
+
+Logger::Ring* Logger::localRing() {
+    static thread_local LogRingHandle handle;
+    if (!handle.ring) {
+        handle.ring = acquireRing();
+    }
+    return handle.ring;
+}
+
+Logger::Ring* Logger::acquireRing() {
+    std::lock_guard<std::mutex> lock(rings_mutex_);
+
+    // Reuse the ring of a thread that has exited; its unread lines stay in
+    // order ahead of the new owner's
+    size_t count = ring_count_.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < count; ++i) {
+        bool expected = false;
+        if (rings_[i]->in_use.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+            return rings_[i].get();
+        }
+    }
+
+    if (count == MAX_RINGS) {
+        return nullptr;
+    }
+
+    rings_[count] = std::make_unique<Ring>();
+    rings_[count]->in_use.store(true, std::memory_order_relaxed);
+    ring_count_.store(count + 1, std::memory_order_release);
+    return rings_[count].get();
+}
+
+void Logger::run() {
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    while (!stopping_) {
+        wake_.wait_for(lock, std::chrono::milliseconds(10));
+        lock.unlock();
+        drain();
+        lock.lock();
+    }
+}
+
+void Logger::drain() {
+    std::lock_guard<std::mutex> lock(drain_mutex_);
+
+    // Batch every pending line into one write per stream
+    std::string out;
+    std::string err;
+
+    size_t count = ring_count_.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; ++i) {
+        Ring& ring = *rings_[i];
+        size_t tail = ring.tail.load(std::memory_order_relaxed);
+        size_t head = ring.head.load(std::memory_order_acquire);
+
+        for (; tail != head; ++tail) {
+            const Record& record = ring.records[tail % RING_CAPACITY];
+            std::string& target = record.level >= LogLevel::Warn ? err : out;
+            target.append(record.text, record.length);
+            target += '\n';
+        }
+        ring.tail.store(tail, std::memory_order_release);
+    }
+
+    size_t dropped = dropped_.load(std::memory_order_relaxed);
+    if (dropped != reported_dropped_) {
+        err += "Logger dropped " + std::to_string(dropped - reported_dropped_) + " lines\n";
+        reported_dropped_ = dropped;
+    }
+
+    if (!out.empty()) {
+        writeAll(STDOUT_FILENO, out.data(), out.size());
+    }
+    if (!err.empty()) {
+        writeAll(STDERR_FILENO, err.data(), err.size());
+    }
+}
+
+void Logger::writeAll(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t written = ::write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return; // Nowhere left to report it
+        }
+        data += written;
+        length -= static_cast<size_t>(written);
+    }
+}
+
+bool Logger::parseLevel(const std::string& value, LogLevel& level) {
+    if (value == "debug") {
+        level = LogLevel::Debug;
+    } else if (value == "info") {
+        level = LogLevel::Info;
+    } else if (value == "warn") {
+        level = LogLevel::Warn;
+    } else if (value == "error") {
+        level = LogLevel::Error;
+    } else if (value == "off") {
+        level = LogLevel::Off;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* Logger::levelName(LogLevel level) {
+    switch (level) {
+        case LogLevel::Debug: return "debug";
+        case LogLevel::Warn: return "warn";
+        case LogLevel::Error: return "error";
+        case LogLevel::Off: return "off";
+        default: return "info";
+    }
+}
+
+// LogLine Implementation
+LogLine& LogLine::append(const char* data, size_t length) {
+    size_t room = Logger::MAX_LINE - length_;
+    length = std::min(length, room);
+    std::memcpy(buffer_ + length_, data, length);
+    length_ += length;
+    return *this;
+}
+
+LogLine& LogLine::appendSigned(long long value) {
+    if (value < 0) {
+        append("-", 1);
+        // Negate in unsigned arithmetic so LLONG_MIN works too
+        return appendUnsigned(0ULL - static_cast<unsigned long long>(value));
+    }
+    return appendUnsigned(static_cast<unsigned long long>(value));
+}
+
+LogLine& LogLine::appendUnsigned(unsigned long long value) {
+    char digits[20];
+    size_t count = 0;
+    do {
+        digits[count++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value);
+
+    char text[20];
+    for (size_t i = 0; i < count; ++i) {
+        text[i] = digits[count - 1 - i];
+    }
+    return append(text, count);
+}
+
+LogLine& LogLine::operator<<(double value) {
+    char text[32];
+    int length = std::snprintf(text, sizeof(text), "%g", value);
+    return append(text, length > 0 ? static_cast<size_t>(length) : 0);
+}
+
+LogLine& LogLine::operator<<(const void* pointer) {
+    char text[24];
+    int length = std::snprintf(text, sizeof(text), "%p", pointer);
+    return append(text, length > 0 ? static_cast<size_t>(length) : 0);
+}
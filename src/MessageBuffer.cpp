@@ -1,64 +1,185 @@
 #include "MessageBuffer.h"
-#include <iostream>
+#include "Metrics.h"
 #include <algorithm>
 #include <sys/socket.h>
 
+// SharedPayload Implementation
+SharedPayload::SharedPayload(size_t size)
+    : data_(std::make_unique<char[]>(size)), size_(size) {
+    MemoryTracker::getInstance().allocate(size_);
+}
+
+SharedPayload::~SharedPayload() {
+    MemoryTracker::getInstance().deallocate(size_);
+}
+
+std::shared_ptr<const SharedPayload> SharedPayload::create(const struct iovec* parts, size_t count) {
+    size_t total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        total += parts[i].iov_len;
+    }
+    
+    std::shared_ptr<SharedPayload> payload(new SharedPayload(total));
+    char* out = payload->data_.get();
+    for (size_t i = 0; i < count; ++i) {
+        std::memcpy(out, parts[i].iov_base, parts[i].iov_len);
+        out += parts[i].iov_len;
+    }
+    return payload;
+}
+
 // MessageBufferPool Implementation
-MessageBufferPool::MessageBufferPool(size_t buffer_size) 
-    : buffer_size_(buffer_size), pool_size_(0), active_buffers_(0) {
-    // Pre-allocate some buffers
-    for (int i = 0; i < 10; ++i) {
-        available_buffers_.push_back(std::make_unique<MessageBuffer>(buffer_size_));
-        pool_size_.fetch_add(1);
+
+// Per-thread cache, one vector per size class. Buffers left in it when the
+// thread exits go back to the depots.
+struct BufferMagazine {
+    std::vector<MessageBuffer*> buffers[MessageBufferPool::CLASS_COUNT];
+    
+    ~BufferMagazine() {
+        MessageBufferPool& pool = MessageBufferPool::getInstance();
+        for (size_t i = 0; i < MessageBufferPool::CLASS_COUNT; ++i) {
+            pool.flush(static_cast<int>(i), buffers[i], buffers[i].size());
+        }
     }
+};
+
+static BufferMagazine& localMagazine() {
+    static thread_local BufferMagazine magazine;
+    return magazine;
+}
+
+MessageBufferPool& MessageBufferPool::getInstance() {
+    static MessageBufferPool instance;
+    return instance;
+}
+
+MessageBufferPool::MessageBufferPool()
+    : allocated_buffers_(0), pooled_buffers_(0) {
+    // Buffers report to the tracker when the depots are freed at exit, so
+    // make sure it outlives this instance
+    MemoryTracker::getInstance();
+    
+    classes_[0].buffer_size = BufferConfig::SMALL_MESSAGE_SIZE;
+    classes_[0].depot_limit = BufferConfig::SMALL_POOL_SIZE;
+    classes_[1].buffer_size = BufferConfig::MEDIUM_MESSAGE_SIZE;
+    classes_[1].depot_limit = BufferConfig::MEDIUM_POOL_SIZE;
+    classes_[2].buffer_size = BufferConfig::LARGE_MESSAGE_SIZE;
+    classes_[2].depot_limit = BufferConfig::LARGE_POOL_SIZE;
+    classes_[SHARED_CLASS].buffer_size = 0;
+    classes_[SHARED_CLASS].depot_limit = BufferConfig::SHARED_REF_POOL_SIZE;
 }
 
 MessageBufferPool::~MessageBufferPool() {
-    available_buffers_.clear();
+    for (SizeClass& size_class : classes_) {
+        for (MessageBuffer* buffer : size_class.depot) {
+            delete buffer;
+        }
+        size_class.depot.clear();
+    }
 }
 
-std::unique_ptr<MessageBuffer> MessageBufferPool::acquire() {
-    std::lock_guard<std::mutex> lock(pool_mutex_);
+int MessageBufferPool::classIndex(size_t length) {
+    if (length <= BufferConfig::SMALL_MESSAGE_SIZE) return 0;
+    if (length <= BufferConfig::MEDIUM_MESSAGE_SIZE) return 1;
+    if (length <= BufferConfig::LARGE_MESSAGE_SIZE) return 2;
+    return -1;
+}
+
+std::unique_ptr<MessageBuffer> MessageBufferPool::acquire(size_t length) {
+    return std::unique_ptr<MessageBuffer>(take(classIndex(std::min(length, MAX_BUFFER_SIZE))));
+}
+
+std::unique_ptr<MessageBuffer> MessageBufferPool::acquireShared(std::shared_ptr<const SharedPayload> payload) {
+    std::unique_ptr<MessageBuffer> buffer(take(SHARED_CLASS));
+    buffer->share(std::move(payload));
+    return buffer;
+}
+
+MessageBuffer* MessageBufferPool::take(int index) {
+    std::vector<MessageBuffer*>& cached = localMagazine().buffers[index];
     
-    if (!available_buffers_.empty()) {
-        auto buffer = std::move(available_buffers_.back());
-        available_buffers_.pop_back();
-        pool_size_.fetch_sub(1);
-        active_buffers_.fetch_add(1);
-        buffer->reset();
-        return buffer;
+    if (cached.empty()) {
+        refill(index, cached);
     }
     
-    // Create new buffer if pool is empty
-    if (active_buffers_.load() < MAX_POOL_SIZE) {
-        active_buffers_.fetch_add(1);
-        return std::make_unique<MessageBuffer>(buffer_size_);
+    if (!cached.empty()) {
+        MessageBuffer* buffer = cached.back();
+        cached.pop_back();
+        Metrics::add(Counter::PoolHits);
+        return buffer;
     }
     
-    return nullptr; // Pool exhausted
+    // Pool is empty, grow it; requests are never refused
+    Metrics::add(Counter::PoolMisses);
+    allocated_buffers_.fetch_add(1);
+    return new MessageBuffer(classes_[index].buffer_size);
 }
 
 void MessageBufferPool::release(std::unique_ptr<MessageBuffer> buffer) {
     if (!buffer) return;
     
-    std::lock_guard<std::mutex> lock(pool_mutex_);
+    int index = buffer->capacity() == 0 ? SHARED_CLASS : classIndex(buffer->capacity());
+    if (index < 0 || classes_[index].buffer_size != buffer->capacity()) {
+        return; // Not one of ours, let the unique_ptr free it
+    }
+    
+    // Drops any shared payload reference right away
+    buffer->reset();
     
-    if (available_buffers_.size() < MAX_POOL_SIZE) {
-        buffer->reset();
-        available_buffers_.push_back(std::move(buffer));
-        pool_size_.fetch_add(1);
+    std::vector<MessageBuffer*>& cached = localMagazine().buffers[index];
+    cached.push_back(buffer.release());
+    if (cached.size() >= MAGAZINE_BATCH * 4) {
+        flush(index, cached, MAGAZINE_BATCH * 2);
     }
+}
+
+void MessageBufferPool::refill(int index, std::vector<MessageBuffer*>& into) {
+    SizeClass& size_class = classes_[index];
+    std::lock_guard<std::mutex> lock(size_class.mutex);
     
-    active_buffers_.fetch_sub(1);
+    size_t count = std::min(MAGAZINE_BATCH, size_class.depot.size());
+    into.insert(into.end(), size_class.depot.end() - count, size_class.depot.end());
+    size_class.depot.resize(size_class.depot.size() - count);
+    pooled_buffers_.fetch_sub(count);
+}
+
+void MessageBufferPool::flush(int index, std::vector<MessageBuffer*>& from, size_t count) {
+    SizeClass& size_class = classes_[index];
+    std::lock_guard<std::mutex> lock(size_class.mutex);
+    
+    while (count-- > 0 && !from.empty()) {
+        MessageBuffer* buffer = from.back();
+        from.pop_back();
+        if (size_class.depot.size() < size_class.depot_limit) {
+            size_class.depot.push_back(buffer);
+            pooled_buffers_.fetch_add(1);
+        } else {
+            destroy(buffer);
+        }
+    }
+}
+
+void MessageBufferPool::destroy(MessageBuffer* buffer) {
+    allocated_buffers_.fetch_sub(1);
+    delete buffer;
 }
 
 // MessageBuffer Implementation
 MessageBuffer::MessageBuffer(size_t capacity) 
     : capacity_(capacity), size_(0), offset_(0) {
-    buffer_ = std::make_unique<char[]>(capacity_);
+    queue_link_.owner = this;
+    if (capacity_ > 0) {
+        buffer_ = std::make_unique<char[]>(capacity_);
+    }
     MemoryTracker::getInstance().allocate(capacity_);
 }
 
+void MessageBuffer::share(std::shared_ptr<const SharedPayload> payload) {
+    size_ = payload->size();
+    offset_ = 0;
+    shared_ = std::move(payload);
+}
+
 bool MessageBuffer::append(const char* data, size_t length) {
     if (size_ + length > capacity_) {
         return false; // Not enough space
@@ -78,7 +199,7 @@ bool MessageBuffer::append(const MessageBuffer& other) {
         return false; // Not enough space
     }
     
-    std::memcpy(buffer_.get() + size_, other.buffer_.get(), other.size_);
+    std::memcpy(buffer_.get() + size_, other.data(), other.size_);
     size_ += other.size_;
     return true;
 }
@@ -89,7 +210,7 @@ ssize_t MessageBuffer::sendPartial(int socket_fd, size_t start_offset) {
     }
     
     size_t bytes_to_send = size_ - start_offset;
-    ssize_t bytes_sent = send(socket_fd, buffer_.get() + start_offset, bytes_to_send, 0);
+    ssize_t bytes_sent = send(socket_fd, data() + start_offset, bytes_to_send, MSG_NOSIGNAL);
     
     if (bytes_sent > 0) {
         offset_ = start_offset + bytes_sent;
@@ -101,6 +222,7 @@ ssize_t MessageBuffer::sendPartial(int socket_fd, size_t start_offset) {
 void MessageBuffer::reset() {
     size_ = 0;
     offset_ = 0;
+    shared_.reset();
 }
 
 std::unique_ptr<MessageBuffer> MessageBuffer::splitAt(size_t position) {
@@ -111,7 +233,7 @@ std::unique_ptr<MessageBuffer> MessageBuffer::splitAt(size_t position) {
     auto new_buffer = std::make_unique<MessageBuffer>(capacity_);
     size_t remaining_size = size_ - position;
     
-    if (new_buffer->append(buffer_.get() + position, remaining_size)) {
+    if (new_buffer->append(data() + position, remaining_size)) {
         size_ = position; // Truncate current buffer
         return new_buffer;
     }
@@ -124,61 +246,223 @@ MessageBuffer::~MessageBuffer() {
     MemoryTracker::getInstance().deallocate(capacity_);
 }
 
+// ReadBuffer Implementation
+ReadBuffer::ReadBuffer(size_t max_capacity)
+    : capacity_(0), max_capacity_(max_capacity), read_pos_(0), write_pos_(0) {
+    // Storage is allocated on first use, idle connections cost nothing
+}
+
+ReadBuffer::~ReadBuffer() {
+    MemoryTracker::getInstance().deallocate(capacity_);
+}
+
+bool ReadBuffer::ensureWritable(size_t min_bytes) {
+    if (writable() >= min_bytes) {
+        return true;
+    }
+
+    // Reclaim consumed bytes first, one memmove for the whole backlog
+    if (read_pos_ > 0) {
+        size_t pending = readable();
+        std::memmove(data_.get(), data_.get() + read_pos_, pending);
+        read_pos_ = 0;
+        write_pos_ = pending;
+        if (writable() >= min_bytes) {
+            return true;
+        }
+    }
+
+    size_t needed = write_pos_ + min_bytes;
+    if (needed > max_capacity_) {
+        return false;
+    }
+
+    size_t new_capacity = capacity_ ? capacity_ : BufferConfig::READ_BUFFER_RESERVE;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    new_capacity = std::min(new_capacity, max_capacity_);
+
+    auto new_data = std::make_unique<char[]>(new_capacity);
+    if (write_pos_ > 0) {
+        std::memcpy(new_data.get(), data_.get(), write_pos_);
+    }
+    data_ = std::move(new_data);
+
+    MemoryTracker::getInstance().allocate(new_capacity);
+    MemoryTracker::getInstance().deallocate(capacity_);
+    capacity_ = new_capacity;
+    return true;
+}
+
+void ReadBuffer::consume(size_t length) {
+    read_pos_ += std::min(length, readable());
+    if (read_pos_ == write_pos_) {
+        // Fully drained, rewind for free
+        read_pos_ = 0;
+        write_pos_ = 0;
+    }
+}
+
+void ReadBuffer::clear() {
+    read_pos_ = 0;
+    write_pos_ = 0;
+}
+
 // MessageQueue Implementation
-MessageQueue::MessageQueue() : buffer_pool_(MessageBufferPool::DEFAULT_BUFFER_SIZE) {
+MessageQueue::MessageQueue(size_t capacity)
+    : messages_(capacity), queued_bytes_(0) {
 }
 
-bool MessageQueue::enqueue(const char* data, size_t length) {
-    auto buffer = buffer_pool_.acquire();
-    if (!buffer) {
-        return false; // Pool exhausted
+MessageQueue::~MessageQueue() {
+    clear();
+}
+
+SendStatus MessageQueue::enqueue(const char* data, size_t length) {
+    struct iovec part;
+    part.iov_base = const_cast<char*>(data);
+    part.iov_len = length;
+    return enqueue(&part, 1);
+}
+
+SendStatus MessageQueue::enqueue(const struct iovec* parts, size_t count) {
+    if (MemoryTracker::getInstance().isMemoryLimitExceeded()) {
+        return SendStatus::MemoryLimit;
     }
     
-    if (!buffer->append(data, length)) {
-        buffer_pool_.release(std::move(buffer));
-        return false; // Message too large
+    MessageBufferPool& pool = MessageBufferPool::getInstance();
+    
+    size_t total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        total += parts[i].iov_len;
     }
     
-    std::lock_guard<std::mutex> lock(queue_mutex_);
-    messages_.push_back(std::move(buffer));
-    return true;
+    // Copy the parts into the smallest buffer that fits, or into a chain
+    // of LARGE buffers plus one right-sized tail
+    MessageBuffer* first = nullptr;
+    MessageBuffer* last = nullptr;
+    size_t buffers = 0;
+    size_t part = 0;
+    size_t part_offset = 0;
+    size_t remaining = total;
+    
+    do {
+        MessageBuffer* buffer = pool.acquire(remaining).release();
+        while (part < count && buffer->remaining() > 0) {
+            size_t length = std::min(parts[part].iov_len - part_offset, buffer->remaining());
+            buffer->append(static_cast<const char*>(parts[part].iov_base) + part_offset, length);
+            part_offset += length;
+            if (part_offset == parts[part].iov_len) {
+                ++part;
+                part_offset = 0;
+            }
+        }
+        remaining -= buffer->size();
+        
+        if (last) {
+            last->queue_link_.next.store(&buffer->queue_link_, std::memory_order_relaxed);
+        } else {
+            first = buffer;
+        }
+        last = buffer;
+        ++buffers;
+    } while (remaining > 0);
+    
+    // Counted before the push so the consumer never sees more sent than queued
+    queued_bytes_.fetch_add(total, std::memory_order_relaxed);
+    if (!messages_.tryPush(&first->queue_link_, &last->queue_link_, buffers)) {
+        queued_bytes_.fetch_sub(total, std::memory_order_relaxed);
+        // Queue full, hand the whole chain back
+        while (first) {
+            MessageBuffer* next = first == last ? nullptr :
+                first->queue_link_.next.load(std::memory_order_relaxed)->owner;
+            pool.release(std::unique_ptr<MessageBuffer>(first));
+            first = next;
+        }
+        return SendStatus::QueueFull;
+    }
+    
+    // Owned by the queue until the consumer pops it
+    return SendStatus::Queued;
+}
+
+SendStatus MessageQueue::enqueue(std::shared_ptr<const SharedPayload> payload) {
+    if (MemoryTracker::getInstance().isMemoryLimitExceeded()) {
+        return SendStatus::MemoryLimit;
+    }
+    
+    MessageBufferPool& pool = MessageBufferPool::getInstance();
+    size_t length = payload->size();
+    std::unique_ptr<MessageBuffer> buffer = pool.acquireShared(std::move(payload));
+    
+    queued_bytes_.fetch_add(length, std::memory_order_relaxed);
+    if (!messages_.tryPush(&buffer->queue_link_)) {
+        queued_bytes_.fetch_sub(length, std::memory_order_relaxed);
+        pool.release(std::move(buffer));
+        return SendStatus::QueueFull;
+    }
+    
+    buffer.release();
+    return SendStatus::Queued;
 }
 
-bool MessageQueue::enqueue(const std::string& message) {
+SendStatus MessageQueue::enqueue(const std::string& message) {
     return enqueue(message.c_str(), message.length());
 }
 
 MessageBuffer* MessageQueue::front() {
-    std::lock_guard<std::mutex> lock(queue_mutex_);
-    if (messages_.empty()) {
-        return nullptr;
-    }
-    return messages_.front().get();
+    return messages_.front();
 }
 
-void MessageQueue::pop() {
-    std::lock_guard<std::mutex> lock(queue_mutex_);
-    if (!messages_.empty()) {
-        auto buffer = std::move(messages_.front());
-        messages_.erase(messages_.begin());
-        buffer_pool_.release(std::move(buffer));
+bool MessageQueue::pop() {
+    MessageBuffer* buffer = messages_.pop();
+    if (!buffer) {
+        return false;
     }
+    queued_bytes_.fetch_sub(buffer->unsent(), std::memory_order_relaxed);
+    MessageBufferPool::getInstance().release(std::unique_ptr<MessageBuffer>(buffer));
+    return true;
 }
 
 bool MessageQueue::empty() const {
-    std::lock_guard<std::mutex> lock(queue_mutex_);
     return messages_.empty();
 }
 
-size_t MessageQueue::size() const {
-    std::lock_guard<std::mutex> lock(queue_mutex_);
-    return messages_.size();
+size_t MessageQueue::gather(struct iovec* iov, size_t max_count) {
+    size_t count = 0;
+    messages_.peek([&](MessageBuffer* buffer) {
+        iov[count].iov_base = const_cast<char*>(buffer->data() + buffer->getOffset());
+        iov[count].iov_len = buffer->unsent();
+        ++count;
+    }, max_count);
+    return count;
+}
+
+void MessageQueue::consume(size_t bytes) {
+    while (MessageBuffer* buffer = messages_.front()) {
+        size_t unsent = buffer->unsent();
+        if (bytes < unsent) {
+            // Partial write ends inside this message, resume from here next time
+            buffer->markSent(bytes);
+            queued_bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+            break;
+        }
+        
+        bytes -= unsent;
+        buffer->markSent(unsent);
+        queued_bytes_.fetch_sub(unsent, std::memory_order_relaxed);
+        
+        // A fully sent buffer whose successor is still being linked by a
+        // producer stays queued with nothing left to send; it is released
+        // on the next flush
+        if (!pop()) {
+            break;
+        }
+    }
 }
 
 void MessageQueue::clear() {
-    std::lock_guard<std::mutex> lock(queue_mutex_);
-    for (auto& buffer : messages_) {
-        buffer_pool_.release(std::move(buffer));
+    while (pop()) {
+        // Release every queued buffer back to the pool
     }
-    messages_.clear();
 }
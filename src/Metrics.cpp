@@ -0,0 +1,287 @@
+#include "Metrics.h"
+#include <cstdio>
+
+namespace {
+
+struct CounterInfo {
+    const char* name;
+    const char* labels;     // Inside the braces, or nullptr
+    const char* help;       // Given once per name
+};
+
+// Indexed by Counter; entries sharing a name must be adjacent
+const CounterInfo COUNTERS[] = {
+    {"netserver_accepts_total", nullptr, "Connections accepted"},
+    {"netserver_accepts_rejected_total", nullptr, "Connections refused by the memory or connection limit"},
+    {"netserver_connections_closed_total", nullptr, "Connections closed"},
+    {"netserver_messages_received_total", nullptr, "Messages passed to the message handler"},
+    {"netserver_messages_sent_total", nullptr, "Messages queued for sending"},
+    {"netserver_messages_dropped_total", nullptr, "Messages refused by a full send queue or the memory limit"},
+    {"netserver_received_bytes_total", nullptr, "Bytes read from client sockets"},
+    {"netserver_sent_bytes_total", nullptr, "Bytes written to client sockets"},
+    {"netserver_partial_writes_total", nullptr, "Writes that left data queued because the socket was full"},
+    {"netserver_buffer_pool_hits_total", nullptr, "Message buffers served from the pool"},
+    {"netserver_buffer_pool_misses_total", nullptr, "Message buffers newly allocated"},
+    {"netserver_datagrams_received_total", nullptr, "UDP datagrams passed to the datagram handler"},
+    {"netserver_datagrams_sent_total", nullptr, "UDP datagrams sent"},
+    {"netserver_datagrams_dropped_total", nullptr, "UDP datagrams dropped: unknown token, truncated or send queue full"},
+    {"netserver_tls_handshakes_total", nullptr, "TLS handshakes completed and handed to kernel TLS"},
+    {"netserver_tls_handshake_failures_total", nullptr, "TLS handshakes that failed or could not enable kernel TLS"},
+    {"netserver_messages_compressed_total", nullptr, "Messages sent as zstd frames, broadcasts counted once"},
+    {"netserver_compression_saved_bytes_total", nullptr, "Payload bytes saved by compression"},
+    {"netserver_relay_records_sent_total", nullptr, "Broadcasts and publishes relayed to peer nodes, per peer"},
+    {"netserver_relay_records_received_total", nullptr, "Broadcasts and publishes relayed from peer nodes"},
+    {"netserver_relay_records_dropped_total", nullptr, "Relay records lost to unreachable or slow peer nodes"},
+    {"netserver_capture_records_total", nullptr, "Connection events and inbound messages written to the traffic capture"},
+    {"netserver_capture_records_dropped_total", nullptr, "Traffic capture records dropped because the capture file was full"},
+    {"netserver_syscalls_total", "call=\"accept\"", "System calls on the I/O path"},
+    {"netserver_syscalls_total", "call=\"recv\"", nullptr},
+    {"netserver_syscalls_total", "call=\"sendmsg\"", nullptr},
+    {"netserver_syscalls_total", "call=\"epoll_wait\"", nullptr},
+    {"netserver_syscalls_total", "call=\"epoll_ctl\"", nullptr},
+    {"netserver_syscalls_total", "call=\"io_uring_enter\"", nullptr},
+    {"netserver_syscalls_total", "call=\"recvmmsg\"", nullptr},
+    {"netserver_syscalls_total", "call=\"sendmmsg\"", nullptr},
+};
+static_assert(sizeof(COUNTERS) / sizeof(COUNTERS[0]) == static_cast<size_t>(Counter::Count),
+              "every counter needs an exposition entry");
+
+struct HistogramInfo {
+    const char* name;       // Without the _seconds unit
+    const char* help;
+};
+
+const HistogramInfo HISTOGRAMS[] = {
+    {"netserver_read_to_handler", "Time from receiving a message's bytes to running its handler"},
+    {"netserver_handler_to_flush", "Time from queueing a reply to the send queue draining"},
+};
+static_assert(sizeof(HISTOGRAMS) / sizeof(HISTOGRAMS[0]) == static_cast<size_t>(Histogram::Count),
+              "every histogram needs an exposition entry");
+
+const double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+
+// Buckets below this upper bound are folded into the first exported one
+constexpr uint64_t EXPORT_MIN_NS = 1000;
+
+void appendHeader(std::string& out, const char* name, const char* help, const char* type) {
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+}
+
+void appendNumber(std::string& out, double value) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.9g", value);
+    out += text;
+}
+
+void appendNumber(std::string& out, uint64_t value) {
+    out += std::to_string(value);
+}
+
+} // namespace
+
+// Returns the calling thread's shard to the pool when the thread exits
+struct MetricsShardHandle {
+    Metrics::Shard* shard = nullptr;
+
+    ~MetricsShardHandle() {
+        if (shard && !shard->shared) {
+            shard->in_use.store(false, std::memory_order_release);
+        }
+    }
+};
+
+Metrics::Shard::Shard() {
+    for (auto& counter : counters) {
+        counter.store(0, std::memory_order_relaxed);
+    }
+    for (auto& histogram : histograms) {
+        for (auto& bucket : histogram.buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        histogram.sum.store(0, std::memory_order_relaxed);
+    }
+}
+
+void Metrics::Shard::record(size_t index, uint64_t value) {
+    HistogramData& histogram = histograms[index];
+    bump(histogram.buckets[bucketIndex(value)], 1);
+    bump(histogram.sum, value);
+}
+
+Metrics& Metrics::getInstance() {
+    static Metrics instance;
+    return instance;
+}
+
+Metrics::Metrics() : enabled_(false), shard_count_(0) {
+    overflow_.shared = true;
+}
+
+Metrics::Shard* Metrics::localShard() {
+    static thread_local MetricsShardHandle handle;
+    if (!handle.shard) {
+        handle.shard = acquireShard();
+    }
+    return handle.shard;
+}
+
+Metrics::Shard* Metrics::acquireShard() {
+    std::lock_guard<std::mutex> lock(shards_mutex_);
+
+    // Take over the shard of a thread that has exited, totals carry on
+    size_t count = shard_count_.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < count; ++i) {
+        bool expected = false;
+        if (shards_[i]->in_use.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+            return shards_[i].get();
+        }
+    }
+
+    if (count == MAX_SHARDS) {
+        return &overflow_;
+    }
+
+    shards_[count] = std::make_unique<Shard>();
+    shards_[count]->in_use.store(true, std::memory_order_relaxed);
+    shard_count_.store(count + 1, std::memory_order_release);
+    return shards_[count].get();
+}
+
+size_t Metrics::bucketIndex(uint64_t value) {
+    if (value < SUB_BUCKETS) {
+        return static_cast<size_t>(value);
+    }
+
+    size_t exponent = 63 - static_cast<size_t>(__builtin_clzll(value));
+    if (exponent > MAX_EXPONENT) {
+        return BUCKET_COUNT - 1;
+    }
+
+    // The SUB_BUCKET_BITS bits below the leading one pick the linear bucket
+    size_t sub = static_cast<size_t>(value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+    return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+uint64_t Metrics::bucketUpperBound(size_t index) {
+    size_t group = index / SUB_BUCKETS;
+    uint64_t sub = index % SUB_BUCKETS;
+    if (group == 0) {
+        return sub;
+    }
+
+    size_t shift = group - 1;
+    return ((SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+void Metrics::writePrometheus(std::string& out) const {
+    size_t count = shard_count_.load(std::memory_order_acquire);
+
+    // Merge the shards
+    uint64_t counters[COUNTER_COUNT] = {};
+    uint64_t buckets[HISTOGRAM_COUNT][BUCKET_COUNT] = {};
+    uint64_t sums[HISTOGRAM_COUNT] = {};
+    auto merge = [&](const Shard& shard) {
+        for (size_t i = 0; i < COUNTER_COUNT; ++i) {
+            counters[i] += shard.counters[i].load(std::memory_order_relaxed);
+        }
+        for (size_t h = 0; h < HISTOGRAM_COUNT; ++h) {
+            for (size_t b = 0; b < BUCKET_COUNT; ++b) {
+                buckets[h][b] += shard.histograms[h].buckets[b].load(std::memory_order_relaxed);
+            }
+            sums[h] += shard.histograms[h].sum.load(std::memory_order_relaxed);
+        }
+    };
+    for (size_t i = 0; i < count; ++i) {
+        merge(*shards_[i]);
+    }
+    merge(overflow_);
+
+    for (size_t i = 0; i < COUNTER_COUNT; ++i) {
+        const CounterInfo& info = COUNTERS[i];
+        if (info.help) {
+            appendHeader(out, info.name, info.help, "counter");
+        }
+        out += info.name;
+        if (info.labels) {
+            out += '{';
+            out += info.labels;
+            out += '}';
+        }
+        out += ' ';
+        appendNumber(out, counters[i]);
+        out += '\n';
+    }
+
+    for (size_t h = 0; h < HISTOGRAM_COUNT; ++h) {
+        const HistogramInfo& info = HISTOGRAMS[h];
+        std::string name = std::string(info.name) + "_seconds";
+        appendHeader(out, name.c_str(), info.help, "histogram");
+
+        // Exported at every power of two; the sub-buckets feed the quantiles
+        uint64_t total = 0;
+        for (size_t b = 0; b < BUCKET_COUNT; ++b) {
+            total += buckets[h][b];
+            bool group_end = b % SUB_BUCKETS == SUB_BUCKETS - 1;
+            uint64_t bound = bucketUpperBound(b);
+            if (!group_end || bound < EXPORT_MIN_NS || b == BUCKET_COUNT - 1) {
+                continue;
+            }
+            out += name;
+            out += "_bucket{le=\"";
+            appendNumber(out, static_cast<double>(bound) / 1e9);
+            out += "\"} ";
+            appendNumber(out, total);
+            out += '\n';
+        }
+        out += name;
+        out += "_bucket{le=\"+Inf\"} ";
+        appendNumber(out, total);
+        out += '\n';
+        out += name;
+        out += "_sum ";
+        appendNumber(out, static_cast<double>(sums[h]) / 1e9);
+        out += '\n';
+        out += name;
+        out += "_count ";
+        appendNumber(out, total);
+        out += '\n';
+
+        // Quantiles since start, to the precision of the sub-buckets
+        std::string quantile_name = std::string(info.name) + "_quantile_seconds";
+        appendHeader(out, quantile_name.c_str(), "Latency quantiles since start (upper bucket bound)", "gauge");
+        for (double quantile : QUANTILES) {
+            uint64_t rank = static_cast<uint64_t>(quantile * static_cast<double>(total));
+            uint64_t seen = 0;
+            uint64_t value = 0;
+            for (size_t b = 0; b < BUCKET_COUNT && total > 0; ++b) {
+                seen += buckets[h][b];
+                if (seen > rank) {
+                    value = bucketUpperBound(b);
+                    break;
+                }
+            }
+            out += quantile_name;
+            out += "{quantile=\"";
+            appendNumber(out, quantile);
+            out += "\"} ";
+            appendNumber(out, static_cast<double>(value) / 1e9);
+            out += '\n';
+        }
+    }
+}
+
+void Metrics::appendGauge(std::string& out, const char* name, const char* help, double value) {
+    appendHeader(out, name, help, "gauge");
+    out += name;
+    out += ' ';
+    appendNumber(out, value);
+    out += '\n';
+}
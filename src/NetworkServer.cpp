@@ -1,17 +1,52 @@
 #include "NetworkServer.h"
-#include <iostream>
+#include "Logger.h"
+#include "Metrics.h"
+#include "CpuAffinity.h"
 #include <cstring>
 #include <chrono>
 #include <sys/epoll.h>
 
 
 NetworkServer::NetworkServer(int port, int max_connections, int thread_count)
-    : port_(port), max_connections_(max_connections), server_fd_(-1), 
-      epoll_fd_(-1), running_(false) {
-    
-    // Initialize thread pool
-    thread_pool_ = std::make_unique<ThreadPool>(thread_count);
-    
+    : NetworkServer([&]() {
+          ServerConfig config;
+          config.port = port;
+          config.max_connections = max_connections;
+          config.thread_count = thread_count;
+          return config;
+      }()) {
+}
+
+NetworkServer::NetworkServer(const ServerConfig& config)
+    : config_(config), last_loaded_(config), running_(false), loop_active_(false) {
+
+    MemoryTracker::getInstance().setMemoryLimit(config_.max_memory_mb * 1024 * 1024);
+    // Counting costs nothing while no one can scrape it
+    Metrics::getInstance().setEnabled(config_.admin_port > 0);
+
+    // Initialize connection workers, each one owns a share of the connections
+    int worker_count = config_.thread_count > 0 ? config_.thread_count : 1;
+    for (int i = 0; i < worker_count; ++i) {
+        int cpu = CpuAffinity::cpuFor(config_.worker_cpus, i);
+        CpuAffinity::ScopedNodePreference local(cpu);
+        workers_.push_back(std::make_unique<ConnectionWorker>(i, cpu));
+    }
+
+    // Scheduler for work posted by application handlers
+    size_t scheduler_threads = config_.scheduler_threads > 0 ? config_.scheduler_threads : worker_count;
+    std::function<void(size_t)> pin_scheduler;
+    if (!config_.scheduler_cpus.empty()) {
+        pin_scheduler = [cpus = config_.scheduler_cpus](size_t index) {
+            CpuAffinity::pinCurrentThread(CpuAffinity::cpuFor(cpus, index),
+                                          ("Scheduler thread " + std::to_string(index)).c_str());
+        };
+    }
+    if (config_.scheduler == "workstealing") {
+        work_stealing_pool_ = std::make_unique<WorkStealingPool>(scheduler_threads, pin_scheduler);
+    } else {
+        thread_pool_ = std::make_unique<ThreadPool>(scheduler_threads, pin_scheduler);
+    }
+
 }
 
 NetworkServer::~NetworkServer() {
@@ -19,313 +54,473 @@ NetworkServer::~NetworkServer() {
 }
 
 bool NetworkServer::start() {
-    if (!setupServer()) {
-        std::cerr << "Failed to setup server" << std::endl;
-        return false;
+    int reactor_count = resolveReactorCount();
+    bool multi_reactor = reactor_count > 1;
+    // io_uring completes I/O on the reactor thread, so it never uses workers
+    bool inline_io = multi_reactor || config_.io_backend == "io_uring";
+
+    // Optional, so a missing dictionary or zstd only costs bandwidth
+    if (config_.compression == "zstd") {
+        compressor_ = std::make_unique<MessageCompressor>();
+        if (!compressor_->init(config_.compression_level, config_.compression_dictionary,
+                               config_.compression_min_size)) {
+            LOG_WARN("Compression disabled");
+            compressor_.reset();
+        }
     }
-    
-    if (!setupEpoll()) {
-        std::cerr << "Failed to setup epoll" << std::endl;
-        return false;
+
+    // Optional as well: a capture is a diagnostic, never a reason not to serve
+    if (!config_.capture_file.empty()) {
+        capture_ = std::make_unique<TrafficCapture>();
+        if (!capture_->open(config_.capture_file, config_.capture_max_mb << 20)) {
+            LOG_WARN("Traffic capture disabled");
+            capture_.reset();
+        }
     }
-    
-    running_ = true;
-    std::cout << "Server started on port " << port_ << std::endl;
-    std::cout << "Max connections: " << max_connections_ << std::endl;
-    std::cout << "Thread pool size: " << thread_pool_->workers.size() << std::endl;
-    
-    return true;
-}
 
-void NetworkServer::stop() {
-    if (running_) {
-        running_ = false;
-        
-        // Close all client connections
-        for (auto& pair : connections_) {
-            pair.second->close();
+    if (config_.tls_port > 0) {
+        tls_context_ = std::make_unique<TlsContext>();
+        if (!tls_context_->init(config_.tls_cert_file, config_.tls_key_file)) {
+            LOG_ERROR("Failed to setup TLS listener");
+            tls_context_.reset();
+            return false;
         }
-        connections_.clear();
-        
-        // Close server socket
-        if (server_fd_ != -1) {
-            close(server_fd_);
-            server_fd_ = -1;
+    }
+
+    // Listening sockets of the process being replaced, taken up by the
+    // reactors below instead of binding new ones
+    if (!config_.hot_restart_socket.empty()) {
+        hot_restart_ = std::make_unique<HotRestart>(*this, config_.hot_restart_socket);
+        hot_restart_->takeOver(inherited_);
+    }
+
+    for (int i = 0; i < reactor_count; ++i) {
+        // With several reactors every one accepts on its own SO_REUSEPORT
+        // listener and runs its connections' I/O on its own thread. Its
+        // slab, backend rings and buffers come from its own NUMA node.
+        CpuAffinity::ScopedNodePreference local(CpuAffinity::cpuFor(config_.reactor_cpus, i));
+        auto reactor = std::make_unique<Reactor>(*this, i, multi_reactor, inline_io);
+        if (!reactor->start()) {
+            LOG_ERROR("Failed to setup server");
+            reactors_.clear();
+            closeInheritedSockets();
+            hot_restart_.reset();
+            return false;
         }
-        
-        // Close epoll
-        if (epoll_fd_ != -1) {
-            close(epoll_fd_);
-            epoll_fd_ = -1;
+        reactors_.push_back(std::move(reactor));
+    }
+
+    // Sockets no reactor took (the predecessor ran more reactors) close
+    // once the predecessor stops accepting; their queued clients retry
+    if (hot_restart_) {
+        hot_restart_->confirmTakeover();
+        closeInheritedSockets();
+    }
+
+    // Workers are only needed when a single reactor hands I/O off
+    if (!inline_io) {
+        for (auto& worker : workers_) {
+            worker->start();
         }
-        
-        std::cout << "Server stopped" << std::endl;
     }
-}
 
-void NetworkServer::run() {
-    const int MAX_EVENTS = 100;
-    struct epoll_event events[MAX_EVENTS];
-    
-    // For periodic cleanup of inactive connections
-    auto last_cleanup = std::chrono::steady_clock::now();
-    const auto cleanup_interval = std::chrono::minutes(5); // Cleanup every 5 minutes
-    
-    while (running_) {
-        int num_events = epoll_wait(epoll_fd_, events, MAX_EVENTS, 1000); // 1 second timeout
-        
-        if (num_events == -1) {
-            if (errno == EINTR) {
-                continue; // Interrupted by signal
-            }
-            std::cerr << "epoll_wait error: " << strerror(errno) << std::endl;
-            break;
+    if (config_.admin_port > 0) {
+        admin_server_ = std::make_unique<AdminServer>(config_.admin_address, config_.admin_port,
+                                                      [this]() { return renderMetrics(); });
+        if (!admin_server_->start()) {
+            LOG_ERROR("Failed to setup admin endpoint");
+            admin_server_.reset();
+            reactors_.clear();
+            return false;
         }
-        
-        for (int i = 0; i < num_events; ++i) {
-            int fd = events[i].data.fd;
-            uint32_t event_mask = events[i].events;
-            
-            if (fd == server_fd_) {
-                // New connection
-                handleNewConnection();
-            } else {
-                // Client event
-                handleClientEvent(fd, event_mask);
-            }
+    }
+
+    // Sessions register with it as they are accepted, so it exists before
+    // the first reactor runs
+    if (config_.udp_port > 0) {
+        udp_ = std::make_unique<UdpTransport>(config_.udp_port,
+            [this](std::string_view payload, ConnectionHandler* handler) {
+                if (datagram_handler_) {
+                    datagram_handler_(payload, handler);
+                }
+            });
+        if (!udp_->start()) {
+            LOG_ERROR("Failed to setup UDP transport");
+            udp_.reset();
+            admin_server_.reset();
+            reactors_.clear();
+            return false;
         }
-        
-        // Periodic cleanup of inactive connections
-        auto now = std::chrono::steady_clock::now();
-        if (now - last_cleanup >= cleanup_interval) {
-            cleanupInactiveConnections(300); // 5 minutes timeout
-            last_cleanup = now;
-            std::cout << "Performed periodic cleanup. Active connections: " 
-                      << getConnectionCount() << std::endl;
+    }
+
+    if (config_.cluster_node_id > 0) {
+        relay_ = std::make_unique<ClusterRelay>(config_.cluster_node_id, config_.cluster_nodes,
+            [this](char kind, std::string_view topic, std::string_view payload) {
+                if (kind == ClusterRelay::RECORD_PUBLISH) {
+                    publishLocal(std::string(topic), std::string(payload));
+                } else {
+                    broadcastLocal(std::string(payload));
+                }
+            });
+        if (!relay_->start()) {
+            LOG_ERROR("Failed to setup cluster relay");
+            relay_.reset();
+            udp_.reset();
+            admin_server_.reset();
+            reactors_.clear();
+            return false;
         }
     }
-}
 
-bool NetworkServer::setupServer() {
-    // Create socket
-    server_fd_ = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_fd_ == -1) {
-        std::cerr << "Failed to create socket: " << strerror(errno) << std::endl;
-        return false;
+    // From now on a successor can take over from this process
+    if (hot_restart_ && !hot_restart_->listen()) {
+        LOG_WARN("Hot restart unavailable for this process");
     }
-    
-    // Set socket options
-    int opt = 1;
-    if (setsockopt(server_fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) == -1) {
-        std::cerr << "Failed to set SO_REUSEADDR: " << strerror(errno) << std::endl;
-        return false;
+
+    running_ = true;
+    LOG_INFO("Server started on port " << config_.port);
+    if (config_.binary_port > 0) {
+        LOG_INFO("Binary listener on port " << config_.binary_port
+                 << " (" << Framing::modeName(config_.binary_framing) << " framing)");
     }
-    
-    // Set non-blocking
-    setNonBlocking(server_fd_);
-    
-    // Bind socket
-    struct sockaddr_in address;
-    address.sin_family = AF_INET;
-    address.sin_addr.s_addr = INADDR_ANY;
-    address.sin_port = htons(port_);
-    
-    if (bind(server_fd_, (struct sockaddr*)&address, sizeof(address)) == -1) {
-        std::cerr << "Failed to bind socket: " << strerror(errno) << std::endl;
-        return false;
+    if (config_.tls_port > 0) {
+        LOG_INFO("TLS listener on port " << config_.tls_port << " (kernel TLS)");
     }
-    
-    // Listen
-    if (listen(server_fd_, max_connections_) == -1) {
-        std::cerr << "Failed to listen: " << strerror(errno) << std::endl;
-        return false;
+    LOG_INFO("Max connections: " << config_.max_connections);
+    LOG_INFO("Memory limit: " << (config_.max_memory_mb ? std::to_string(config_.max_memory_mb) + " MB" : "none"));
+    LOG_INFO("Reactors: " << reactors_.size() << " (" << reactors_[0]->getBackendName() << ")");
+    LOG_INFO("Connection workers: " << (inline_io ? 0 : workers_.size()));
+    LOG_INFO("Scheduler: " << config_.scheduler << " ("
+             << (work_stealing_pool_ ? work_stealing_pool_->size() : thread_pool_->workers.size())
+             << " threads)");
+    if (multi_reactor && config_.reuseport_steering != "none") {
+        LOG_INFO("Accept steering: " << config_.reuseport_steering);
     }
-    
+    if (config_.flush_interval_ms > 0) {
+        LOG_INFO("Tick flushing: every " << config_.flush_interval_ms << " ms or at "
+                 << config_.flush_threshold << " queued bytes");
+    }
+
     return true;
 }
 
-bool NetworkServer::setupEpoll() {
-    epoll_fd_ = epoll_create1(0);
-    if (epoll_fd_ == -1) {
-        std::cerr << "Failed to create epoll: " << strerror(errno) << std::endl;
-        return false;
+void NetworkServer::stop() {
+    if (running_) {
+        running_ = false;
+
+        // While run() is active the reactors notice running_ within one
+        // epoll_wait timeout and run() performs the teardown itself
+        if (!loop_active_) {
+            shutdown();
+        }
     }
+}
+
+void NetworkServer::shutdown() {
+    std::lock_guard<std::mutex> lock(reload_mutex_);
     
-    // Add server socket to epoll
-    struct epoll_event event;
-    event.data.fd = server_fd_;
-    event.events = EPOLLIN | EPOLLET; // Edge-triggered
-    
-    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, server_fd_, &event) == -1) {
-        std::cerr << "Failed to add server socket to epoll: " << strerror(errno) << std::endl;
-        return false;
+    // No successor may take sockets that are about to close
+    hot_restart_.reset();
+
+    // Scrapes read the reactors, stop them first
+    admin_server_.reset();
+    // Relayed records fan out to the reactors as well
+    relay_.reset();
+
+    for (auto& reactor : reactors_) {
+        reactor->join();
     }
-    
-    return true;
+
+    // No datagram handler may run once connections start to go away
+    udp_.reset();
+
+    // Stop workers before the reactors free the connections they work on
+    for (auto& worker : workers_) {
+        worker->stop();
+    }
+
+    // Finish posted work while the reactors it may report back to still exist
+    work_stealing_pool_.reset();
+    thread_pool_.reset();
+
+    for (auto& reactor : reactors_) {
+        reactor->close();
+    }
+    reactors_.clear();
+    tls_context_.reset();
+    compressor_.reset();
+    capture_.reset();
+
+    LOG_INFO("Server stopped");
 }
 
-void NetworkServer::setNonBlocking(int fd) {
-    int flags = fcntl(fd, F_GETFL, 0);
-    if (flags == -1) {
-        std::cerr << "Failed to get socket flags: " << strerror(errno) << std::endl;
+void NetworkServer::reloadConfig(const ServerConfig& fresh) {
+    // shutdown() clears running_ before it takes the lock
+    std::lock_guard<std::mutex> lock(reload_mutex_);
+    if (!running_) {
+        LOG_WARN("Server not running, configuration reload ignored");
         return;
     }
     
-    if (fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
-        std::cerr << "Failed to set socket non-blocking: " << strerror(errno) << std::endl;
+    // Settings read on the reactor threads are applied there
+    for (auto& reactor : reactors_) {
+        reactor->applySettings(fresh);
+    }
+    Logger::getInstance().setLevel(fresh.log_level);
+    MemoryTracker::getInstance().setMemoryLimit(fresh.max_memory_mb * 1024 * 1024);
+
+    LOG_INFO("Configuration reloaded: log level " << Logger::levelName(fresh.log_level)
+             << ", timeouts idle/read/write " << fresh.idle_timeout << "/" << fresh.read_timeout
+             << "/" << fresh.write_timeout << " s, memory limit "
+             << (fresh.max_memory_mb ? std::to_string(fresh.max_memory_mb) + " MB" : "none"));
+
+    bool restart_needed = fresh.port != last_loaded_.port || fresh.binary_port != last_loaded_.binary_port ||
+                          fresh.tls_port != last_loaded_.tls_port || fresh.udp_port != last_loaded_.udp_port ||
+                          fresh.admin_port != last_loaded_.admin_port || fresh.reactor_count != last_loaded_.reactor_count ||
+                          fresh.max_connections != last_loaded_.max_connections ||
+                          fresh.thread_count != last_loaded_.thread_count || fresh.io_backend != last_loaded_.io_backend ||
+                          fresh.framing != last_loaded_.framing || fresh.binary_framing != last_loaded_.binary_framing ||
+                          fresh.cluster_node_id != last_loaded_.cluster_node_id ||
+                          fresh.compression != last_loaded_.compression ||
+                          fresh.capture_file != last_loaded_.capture_file ||
+                          fresh.flush_interval_ms != last_loaded_.flush_interval_ms;
+    if (restart_needed) {
+        LOG_WARN("Listener, thread and protocol settings changed; they take effect after a (hot) restart");
     }
+    last_loaded_ = fresh;
 }
 
-void NetworkServer::handleNewConnection() {
-    struct sockaddr_in client_addr;
-    socklen_t client_len = sizeof(client_addr);
-    
-    while (true) {
-        int client_fd = accept(server_fd_, (struct sockaddr*)&client_addr, &client_len);
-        if (client_fd == -1) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                // No more connections
-                break;
-            }
-            std::cerr << "Failed to accept connection: " << strerror(errno) << std::endl;
-            continue;
-        }
-        
-        // Set non-blocking
-        setNonBlocking(client_fd);
-        
-        // Get client info
-        std::string client_ip = inet_ntoa(client_addr.sin_addr);
-        int client_port = ntohs(client_addr.sin_port);
-        
-        std::cout << "New connection from " << client_ip << ":" << client_port << std::endl;
-        
-        // Create connection handler
-        auto handler = std::make_unique<ConnectionHandler>(client_fd, client_ip, client_port);
-        
-        // Set up message handler
-        handler->onMessageReceived = [this](const std::string& message, ConnectionHandler* handler) {
-            if (message_handler_) {
-                message_handler_(message, handler);
-            }
-        };
-        
-        // Add to epoll with both read and write events
-        struct epoll_event event;
-        event.data.fd = client_fd;
-        event.events = EPOLLIN | EPOLLOUT | EPOLLET | EPOLLRDHUP;
-        
-        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, client_fd, &event) == -1) {
-            std::cerr << "Failed to add client to epoll: " << strerror(errno) << std::endl;
-            close(client_fd);
-            continue;
+std::vector<HandoffSocket> NetworkServer::handoffSockets() const {
+    std::vector<HandoffSocket> sockets;
+    for (auto& reactor : reactors_) {
+        reactor->appendListeners(sockets);
+    }
+    return sockets;
+}
+
+void NetworkServer::releaseToSuccessor() {
+    for (auto& reactor : reactors_) {
+        reactor->detachListeners();
+    }
+    // The successor binds these ports next. Draining connections keep TCP
+    // only: their datagrams and relayed records go to the new process.
+    admin_server_.reset();
+    if (udp_) {
+        udp_->stop();
+    }
+    if (relay_) {
+        relay_->stop();
+    }
+}
+
+int NetworkServer::takeInheritedSocket(int port) {
+    for (auto it = inherited_.begin(); it != inherited_.end(); ++it) {
+        if (it->port == port) {
+            int fd = it->fd;
+            inherited_.erase(it);
+            return fd;
         }
-        
-        // Store connection
-        connections_[client_fd] = std::move(handler);
     }
+    return -1;
 }
 
-void NetworkServer::handleClientEvent(int client_fd, uint32_t events) {
-    auto it = connections_.find(client_fd);
-    if (it == connections_.end()) {
-        return;
+void NetworkServer::closeInheritedSockets() {
+    for (const HandoffSocket& socket : inherited_) {
+        LOG_INFO("Closing inherited listener for port " << socket.port << ", not used by this process");
+        ::close(socket.fd);
     }
-    
-    if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
-        // Client disconnected or error
-        cleanupConnection(client_fd);
+    inherited_.clear();
+}
+
+void NetworkServer::run() {
+    if (reactors_.empty()) {
         return;
     }
-    
-    auto& handler = it->second;
-    
-    if (events & EPOLLIN) {
-        // Data available to read
-        thread_pool_->enqueue([&handler]() {
-            handler->handleRead();
-            handler->processMessages();
-            
-            // After processing messages, try to send any queued responses
-            if (handler->hasMessagesToSend()) {
-                handler->handleWrite();
-            }
-        });
+
+    loop_active_ = true;
+
+    // Extra reactors get their own threads, the first one runs on the caller's
+    for (size_t i = 1; i < reactors_.size(); ++i) {
+        reactors_[i]->startThread();
     }
-    
-    if (events & EPOLLOUT) {
-        // Socket ready for writing
-        thread_pool_->enqueue([&handler]() {
-            handler->handleWrite();
-        });
+    reactors_[0]->run();
+
+    for (auto& reactor : reactors_) {
+        reactor->join();
     }
+
+    loop_active_ = false;
+    running_ = false;
+    shutdown();
 }
 
-void NetworkServer::cleanupConnection(int client_fd) {
-    auto it = connections_.find(client_fd);
-    if (it != connections_.end()) {
-        std::cout << "Cleaning up connection: " << it->second->getClientInfo() << std::endl;
-        it->second->close();
-        connections_.erase(it);
+int NetworkServer::resolveReactorCount() const {
+    if (config_.reactor_count > 0) {
+        return config_.reactor_count;
     }
-    
-    // Remove from epoll
-    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, client_fd, nullptr);
-    close(client_fd);
-}
 
+    unsigned int cores = std::thread::hardware_concurrency();
+    return cores > 0 ? static_cast<int>(cores) : 1;
+}
 
 void NetworkServer::setMessageHandler(std::function<void(const std::string&, ConnectionHandler*)> handler) {
     message_handler_ = handler;
 }
 
+void NetworkServer::setMessageViewHandler(std::function<void(std::string_view, ConnectionHandler*)> handler) {
+    message_view_handler_ = handler;
+}
+
+void NetworkServer::setDatagramHandler(std::function<void(std::string_view, ConnectionHandler*)> handler) {
+    datagram_handler_ = std::move(handler);
+}
+
+bool NetworkServer::sendDatagram(ConnectionHandler* handler, const char* data, size_t length) {
+    return udp_ && udp_->send(handler, data, length);
+}
+
+bool NetworkServer::sendDatagram(ConnectionHandler* handler, const std::string& message) {
+    return sendDatagram(handler, message.data(), message.size());
+}
+
+void NetworkServer::setMessageBatchHandler(std::function<void(MessageBatch, ConnectionHandler*)> handler) {
+    message_batch_handler_ = std::move(handler);
+}
+
+#ifdef HAVE_COROUTINES
+void NetworkServer::setSessionHandler(std::function<Task(AsyncConnection)> session) {
+    session_handler_ = std::move(session);
+}
+#endif
+
 void NetworkServer::broadcastMessage(const std::string& message) {
-    for (auto& pair : connections_) {
-        if (pair.second->isConnected()) {
-            pair.second->sendMessage(message);
+    if (relay_) {
+        relay_->broadcast(message);
+    }
+    broadcastLocal(message);
+}
+
+void NetworkServer::broadcastLocal(const std::string& message) {
+    auto payload = frameForListeners(message);
+    for (auto& reactor : reactors_) {
+        reactor->broadcastMessage(payload);
+    }
+}
+
+bool NetworkServer::subscribe(ConnectionHandler* handler, const std::string& topic) {
+    return topics_.subscribe(handler, topic);
+}
+
+bool NetworkServer::unsubscribe(ConnectionHandler* handler, const std::string& topic) {
+    return topics_.unsubscribe(handler, topic);
+}
+
+size_t NetworkServer::publish(const std::string& topic, const std::string& message) {
+    // Peers filter by their own subscribers, an empty room here is no reason to skip them
+    if (relay_) {
+        relay_->publish(topic, message);
+    }
+    return publishLocal(topic, message);
+}
+
+size_t NetworkServer::publishLocal(const std::string& topic, const std::string& message) {
+    if (topics_.getSubscriberCount(topic) == 0) {
+        return 0; // Skip framing for empty rooms
+    }
+    return topics_.publish(topic, *frameForListeners(message));
+}
+
+size_t NetworkServer::getSubscriberCount(const std::string& topic) const {
+    return topics_.getSubscriberCount(topic);
+}
+
+std::shared_ptr<const BroadcastPayload> NetworkServer::frameForListeners(const std::string& message) const {
+    // Frame once per listener format; every connection shares these bytes
+    auto payload = std::make_shared<BroadcastPayload>();
+    FramingMode modes[] = {config_.framing, config_.binary_framing};
+    size_t mode_count = config_.binary_port > 0 ? 2 : 1;
+
+    for (size_t i = 0; i < mode_count; ++i) {
+        auto& framed = payload->framed[static_cast<size_t>(modes[i])];
+        if (!framed) {
+            struct iovec parts[Framing::MAX_FRAME_PARTS];
+            char header[Framing::MAX_HEADER_SIZE];
+            size_t count = Framing::frameParts(modes[i], message.data(), message.size(), header, parts);
+            framed = SharedPayload::create(parts, count);
         }
     }
+
+    // Compressed once for every connection that negotiated it
+    std::string_view compressed;
+    if (compressor_ && compressor_->compress(message.data(), message.size(), compressed)) {
+        struct iovec parts[Framing::MAX_FRAME_PARTS];
+        char header[Framing::MAX_HEADER_SIZE];
+        size_t count = Framing::frameParts(FramingMode::Length32, compressed.data(), compressed.size(),
+                                           header, parts);
+        header[0] |= static_cast<char>(MessageCompressor::COMPRESSED_FLAG >> 24);
+        payload->compressed = SharedPayload::create(parts, count);
+    }
+    return payload;
 }
 
-void NetworkServer::sendToClient(int client_fd, const std::string& message) {
-    auto it = connections_.find(client_fd);
-    if (it != connections_.end() && it->second->isConnected()) {
-        it->second->sendMessage(message);
-        forceWriteEvent(client_fd);
+SendStatus NetworkServer::sendToClient(int client_fd, const std::string& message) {
+    for (auto& reactor : reactors_) {
+        SendStatus status = reactor->sendToClient(client_fd, message);
+        if (status == SendStatus::Queued) {
+            reactor->forceWriteEvent(client_fd);
+            return status;
+        }
+        if (status != SendStatus::Disconnected) {
+            return status; // Found, but the send queue refused it
+        }
     }
+    return SendStatus::Disconnected;
 }
 
 void NetworkServer::forceWriteEvent(int client_fd) {
-    auto it = connections_.find(client_fd);
-    if (it != connections_.end() && it->second->isConnected()) {
-        // Force epoll to monitor write events for this client
-        struct epoll_event event;
-        event.data.fd = client_fd;
-        event.events = EPOLLIN | EPOLLOUT | EPOLLET | EPOLLRDHUP;
-        
-        epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, client_fd, &event);
+    for (auto& reactor : reactors_) {
+        if (reactor->forceWriteEvent(client_fd)) {
+            return;
+        }
     }
 }
 
 size_t NetworkServer::getConnectionCount() const {
-    return connections_.size();
+    size_t count = 0;
+    for (auto& reactor : reactors_) {
+        count += reactor->getConnectionCount();
+    }
+    return count;
 }
 
-void NetworkServer::cleanupInactiveConnections(int timeout_seconds) {
-    auto now = std::chrono::steady_clock::now();
-    auto timeout = std::chrono::seconds(timeout_seconds);
-    
-    std::vector<int> to_remove;
-    
-    for (auto& pair : connections_) {
-        auto last_activity = pair.second->getLastActivity();
-        if (now - last_activity > timeout) {
-            to_remove.push_back(pair.first);
-        }
+std::string NetworkServer::renderMetrics() {
+    std::string out;
+    Metrics::getInstance().writePrometheus(out);
+
+    // Gauges sampled at scrape time
+    MemoryTracker& memory = MemoryTracker::getInstance();
+    MessageBufferPool& pool = MessageBufferPool::getInstance();
+    Metrics::appendGauge(out, "netserver_connections", "Open client connections",
+                         static_cast<double>(getConnectionCount()));
+    Metrics::appendGauge(out, "netserver_buffer_memory_bytes", "Bytes held by message buffers",
+                         static_cast<double>(memory.getCurrentUsage()));
+    Metrics::appendGauge(out, "netserver_buffer_memory_peak_bytes", "Peak bytes held by message buffers",
+                         static_cast<double>(memory.getPeakUsage()));
+    Metrics::appendGauge(out, "netserver_buffer_memory_limit_bytes", "Buffer memory limit, 0 if unlimited",
+                         static_cast<double>(memory.getMemoryLimit()));
+    Metrics::appendGauge(out, "netserver_buffer_pool_idle", "Message buffers idle in the pool",
+                         static_cast<double>(pool.getPoolSize()));
+    Metrics::appendGauge(out, "netserver_buffer_pool_active", "Message buffers in use or cached by threads",
+                         static_cast<double>(pool.getActiveBuffers()));
+    if (thread_pool_) {
+        Metrics::appendGauge(out, "netserver_thread_pool_queue_depth", "Posted tasks waiting for a worker",
+                             static_cast<double>(thread_pool_->pending()));
     }
-    
-    for (int fd : to_remove) {
-        std::cout << "Cleaning up inactive connection: " << fd << std::endl;
-        cleanupConnection(fd);
+    return out;
+}
+
+void NetworkServer::cleanupInactiveConnections(int timeout_seconds) {
+    for (auto& reactor : reactors_) {
+        reactor->cleanupInactiveConnections(timeout_seconds);
     }
 }
@@ -0,0 +1,958 @@
+#include "Reactor.h"
+#include "NetworkServer.h"
+#include "Logger.h"
+#include "Metrics.h"
+#include "EpollBackend.h"
+#include "UringBackend.h"
+#include "CpuAffinity.h"
+#include "TlsContext.h"
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+#include <vector>
+#include <fcntl.h>
+#include <linux/filter.h>
+#include <sys/eventfd.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#ifdef HAVE_COROUTINES
+namespace {
+thread_local Reactor* current_reactor_instance = nullptr;
+}
+#endif
+
+Reactor::Reactor(NetworkServer& server, int id, bool reuse_port, bool inline_io)
+    : server_(server), config_(server.config_), id_(id),
+      cpu_(CpuAffinity::cpuFor(server.config_.reactor_cpus, id)),
+      reuse_port_(reuse_port), inline_io_(inline_io),
+      wake_fd_(-1), reserve_fd_(-1), next_worker_(0), loop_thread_(std::thread::id()),
+      connections_(BufferConfig::PREALLOCATED_CONNECTIONS,
+                   static_cast<size_t>(std::max(server.config_.max_connections, 1))),
+      timers_(toTick(std::chrono::steady_clock::now(), false)), last_shed_tick_(0),
+      flush_interval_(server.config_.flush_interval_ms),
+      next_flush_(std::chrono::steady_clock::now() + flush_interval_)
+#ifdef HAVE_COROUTINES
+      , sleeps_(toTick(std::chrono::steady_clock::now(), false))
+#endif
+{
+}
+
+Reactor::~Reactor() {
+    join();
+    close();
+}
+
+bool Reactor::start() {
+    if (!setupServer()) {
+        LOG_ERROR("Reactor " << id_ << ": failed to setup server socket");
+        return false;
+    }
+
+    if (!setupBackend()) {
+        LOG_ERROR("Reactor " << id_ << ": failed to setup I/O backend");
+        return false;
+    }
+
+    reserve_fd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if (reserve_fd_ == -1) {
+        LOG_WARN("Reactor " << id_ << ": no reserve descriptor, connections cannot be "
+                 "refused cleanly at the fd limit: " << strerror(errno));
+    }
+
+    return true;
+}
+
+void Reactor::close() {
+#ifdef HAVE_COROUTINES
+    // Suspended sessions never resume once the loop stopped; their frames
+    // hold handler pointers, so they go before the connections
+    arena_.destroyRoots();
+    sessions_.clear();
+#endif
+
+    {
+        std::lock_guard<std::mutex> lock(connections_mutex_);
+        // Make the connections unreachable for publishers, then stop all
+        // kernel I/O before the handlers go; io_uring may still reference
+        // their buffers
+        connections_.forEach([this](ConnectionHandle, ConnectionHandler* handler) {
+            timers_.cancel(&handler->getTimerNode());
+            server_.topics_.unsubscribeAll(handler);
+        });
+        backend_.reset();
+
+        // Close all client connections
+        connections_.forEach([](ConnectionHandle, ConnectionHandler* handler) {
+            handler->close();
+        });
+        connections_.clear();
+    }
+
+    // Close listening sockets
+    for (auto& listener : listeners_) {
+        ::close(listener.fd);
+    }
+    listeners_.clear();
+
+    if (wake_fd_ != -1) {
+        ::close(wake_fd_);
+        wake_fd_ = -1;
+    }
+    if (reserve_fd_ != -1) {
+        ::close(reserve_fd_);
+        reserve_fd_ = -1;
+    }
+}
+
+void Reactor::startThread() {
+    thread_ = std::thread([this]() { run(); });
+}
+
+void Reactor::join() {
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void Reactor::run() {
+    loop_thread_.store(std::this_thread::get_id(), std::memory_order_relaxed);
+    CpuAffinity::pinCurrentThread(cpu_, ("Reactor " + std::to_string(id_)).c_str());
+#ifdef HAVE_COROUTINES
+    current_reactor_instance = this;
+    CoroutineArena::setCurrent(&arena_);
+#endif
+
+    while (server_.running_) {
+        // Wake once per wheel tick while any connection has a deadline
+        bool timers_empty = timers_.empty();
+#ifdef HAVE_COROUTINES
+        timers_empty = timers_empty && sleeps_.empty();
+#endif
+        int timeout_ms = timers_empty ? 1000 : TIMER_TICK_MS;
+        if (flush_interval_.count() > 0) {
+            auto until_flush = std::chrono::duration_cast<std::chrono::milliseconds>(
+                next_flush_ - std::chrono::steady_clock::now()).count();
+            timeout_ms = static_cast<int>(std::clamp<long long>(until_flush, 0, timeout_ms));
+        }
+        if (!backend_->poll(timeout_ms)) {
+            break;
+        }
+
+        if (flush_interval_.count() > 0) {
+            flushIfDue(std::chrono::steady_clock::now());
+        }
+
+        // Expire connection deadlines that are due, O(1) per timer
+        uint64_t tick = toTick(std::chrono::steady_clock::now(), false);
+        timers_.advance(tick, [this](ConnectionHandler* handler) { checkTimeouts(handler); });
+#ifdef HAVE_COROUTINES
+        sleeps_.advance(tick, [](SleepAwaiter* sleeper) { sleeper->fire(); });
+#endif
+
+        if (tick != last_shed_tick_ && MemoryTracker::getInstance().isMemoryLimitExceeded()) {
+            last_shed_tick_ = tick;
+            shedLoad();
+        }
+    }
+}
+
+bool Reactor::setupServer() {
+    if (!setupListener(config_.port, config_.framing)) {
+        return false;
+    }
+
+    if (config_.binary_port > 0 &&
+        !setupListener(config_.binary_port, config_.binary_framing)) {
+        return false;
+    }
+
+    if (config_.tls_port > 0 &&
+        !setupListener(config_.tls_port, config_.framing, true)) {
+        return false;
+    }
+
+    return true;
+}
+
+bool Reactor::setupListener(int port, FramingMode framing, bool tls) {
+    // A listener taken over from the previous process is already bound
+    int server_fd = server_.takeInheritedSocket(port);
+    if (server_fd != -1) {
+        listeners_.push_back({server_fd, port, framing, tls, false});
+        setNonBlocking(server_fd);
+        // Picks up this process's backlog; the accept queue is kept
+        if (listen(server_fd, config_.max_connections) == -1) {
+            LOG_ERROR("Failed to listen on inherited socket for port " << port << ": " << strerror(errno));
+            return false;
+        }
+        if (reuse_port_) {
+            steerListener(server_fd);
+        }
+        return true;
+    }
+
+    // Create socket
+    server_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (server_fd == -1) {
+        LOG_ERROR("Failed to create socket: " << strerror(errno));
+        return false;
+    }
+
+    // Owned by the reactor from here on, close() releases it on failure
+    listeners_.push_back({server_fd, port, framing, tls, false});
+
+    // Set socket options
+    int opt = 1;
+    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) == -1) {
+        LOG_ERROR("Failed to set SO_REUSEADDR: " << strerror(errno));
+        return false;
+    }
+
+    // Let the kernel shard incoming connections across every reactor's listener
+    if (reuse_port_ && setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) == -1) {
+        LOG_ERROR("Failed to set SO_REUSEPORT: " << strerror(errno));
+        return false;
+    }
+
+    // Set non-blocking
+    setNonBlocking(server_fd);
+
+    // Bind socket
+    struct sockaddr_in address;
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(port);
+
+    if (bind(server_fd, (struct sockaddr*)&address, sizeof(address)) == -1) {
+        LOG_ERROR("Failed to bind port " << port << ": " << strerror(errno));
+        return false;
+    }
+
+    // Listen
+    if (listen(server_fd, config_.max_connections) == -1) {
+        LOG_ERROR("Failed to listen: " << strerror(errno));
+        return false;
+    }
+
+    // Programs attached before bind() would give the socket a reuseport
+    // group of its own, so steering is set up once it has joined the port's
+    if (reuse_port_) {
+        steerListener(server_fd);
+    }
+
+    return true;
+}
+
+void Reactor::steerListener(int server_fd) {
+    const std::string& steering = config_.reuseport_steering;
+    if (steering == "incoming_cpu") {
+        // The kernel prefers the group member whose incoming CPU matches the
+        // CPU that took the SYN
+        if (cpu_ >= 0 && setsockopt(server_fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu_, sizeof(cpu_)) == -1) {
+            LOG_WARN("Reactor " << id_ << ": SO_INCOMING_CPU failed: " << strerror(errno));
+        }
+    } else if (steering == "cbpf") {
+        // The program picks the socket index in the reuseport group, which
+        // is the reactor id since reactors bind in order:
+        //   A = cpu; if A == cpu(i) return i; ...; return A % reactors
+        // Every listener carries the same program, so it does not matter
+        // which one the group keeps
+        std::vector<struct sock_filter> code;
+        code.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU)));
+        int reactor_count = server_.resolveReactorCount();
+        for (int i = 0; i < reactor_count; ++i) {
+            int cpu = CpuAffinity::cpuFor(config_.reactor_cpus, i);
+            if (cpu >= 0) {
+                code.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, static_cast<uint32_t>(cpu), 0, 1));
+                code.push_back(BPF_STMT(BPF_RET | BPF_K, static_cast<uint32_t>(i)));
+            }
+        }
+        code.push_back(BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, static_cast<uint32_t>(reactor_count)));
+        code.push_back(BPF_STMT(BPF_RET | BPF_A, 0));
+
+        struct sock_fprog program;
+        program.len = static_cast<unsigned short>(code.size());
+        program.filter = code.data();
+        if (setsockopt(server_fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program, sizeof(program)) == -1) {
+            LOG_WARN("Reactor " << id_ << ": SO_ATTACH_REUSEPORT_CBPF failed: " << strerror(errno));
+        }
+    }
+}
+
+const Reactor::Listener* Reactor::findListener(int fd) const {
+    for (auto& listener : listeners_) {
+        if (listener.fd == fd) {
+            return &listener;
+        }
+    }
+    return nullptr;
+}
+
+bool Reactor::setupBackend() {
+    // io_uring runs every connection's I/O on this thread; without kernel
+    // support the reactor keeps the epoll loop
+    if (config_.io_backend == "io_uring" && inline_io_) {
+        auto uring = std::make_unique<UringBackend>(*this);
+        if (uring->init()) {
+            backend_ = std::move(uring);
+        } else {
+            LOG_WARN("Reactor " << id_ << ": io_uring unavailable, falling back to epoll");
+        }
+    }
+
+    if (!backend_) {
+        auto epoll = std::make_unique<EpollBackend>(*this);
+        if (!epoll->init()) {
+            return false;
+        }
+        backend_ = std::move(epoll);
+    }
+
+    for (auto& listener : listeners_) {
+        if (!backend_->addListener(listener.fd)) {
+            return false;
+        }
+    }
+
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ == -1) {
+        LOG_ERROR("Failed to create eventfd: " << strerror(errno));
+        return false;
+    }
+
+    return backend_->addWakeFd(wake_fd_);
+}
+
+void Reactor::setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags == -1) {
+        LOG_ERROR("Failed to get socket flags: " << strerror(errno));
+        return;
+    }
+
+    if (fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+        LOG_ERROR("Failed to set socket non-blocking: " << strerror(errno));
+    }
+}
+
+size_t Reactor::acceptBatch() const {
+    return static_cast<size_t>(config_.accept_batch);
+}
+
+bool Reactor::rejectPendingConnection(int listen_fd) {
+    if (reserve_fd_ == -1) {
+        return false;
+    }
+
+    // Free one descriptor, take the oldest pending connection with it and
+    // close it: the client sees a reset instead of hanging in the backlog,
+    // and a level-triggered listener stops firing for it
+    ::close(reserve_fd_);
+    int client_fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    Metrics::add(Counter::SyscallAccept);
+    if (client_fd != -1) {
+        ::close(client_fd);
+        Metrics::add(Counter::AcceptsRejected);
+    }
+    reserve_fd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_fd_limit_warning_ >= std::chrono::seconds(1)) {
+        last_fd_limit_warning_ = now;
+        LOG_WARN("Reactor " << id_ << ": file descriptor limit reached, refusing connections");
+    }
+    return client_fd != -1;
+}
+
+void Reactor::addConnection(const Listener& listener, int client_fd, const PeerAddress& peer) {
+    // Admission control: buffers already exceed the memory limit
+    if (MemoryTracker::getInstance().isMemoryLimitExceeded()) {
+        LOG_WARN("Reactor " << id_ << ": memory limit reached, rejected " << peer.toText());
+        Metrics::add(Counter::AcceptsRejected);
+        ::close(client_fd);
+        return;
+    }
+
+    LOG_INFO("Reactor " << id_ << ": new connection from " << peer.toText());
+
+    // Create connection handler, typed for its codec when the server has a typed handler
+    auto handler = server_.connection_factory_ ? server_.connection_factory_(client_fd, peer, listener.framing)
+                                               : std::make_unique<ConnectionHandler>(client_fd, peer);
+    ConnectionHandler* connection = handler.get();
+    handler->setFraming(listener.framing);
+    if (listener.framing != FramingMode::Newline) {
+        handler->setCompressor(server_.compressor_.get());
+    }
+    handler->setCapture(server_.capture_.get());
+    if (listener.tls) {
+        auto session = server_.tls_context_->accept(client_fd);
+        if (!session) {
+            Metrics::add(Counter::AcceptsRejected);
+            return; // The handler closes the socket
+        }
+        handler->startTls(std::move(session));
+    }
+    handler->setSendWatermarks(config_.send_high_watermark, config_.send_low_watermark);
+    if (flush_interval_.count() > 0) {
+        handler->setDeferredFlush(config_.flush_threshold);
+    }
+
+    // Set up message handler
+    NetworkServer& server = server_;
+    handler->onMessageView = [&server](std::string_view message, ConnectionHandler* handler) {
+        if (server.message_view_handler_) {
+            server.message_view_handler_(message, handler);
+        } else if (server.message_handler_) {
+            server.message_handler_(std::string(message), handler);
+        }
+    };
+
+    if (server_.message_batch_handler_) {
+        handler->onMessageBatch = [&server](MessageBatch batch, ConnectionHandler* handler) {
+            server.message_batch_handler_(batch, handler);
+        };
+    }
+
+    // Pin the connection to one worker for its whole life
+    if (!inline_io_) {
+        auto& workers = server_.workers_;
+        handler->setWorker(workers[next_worker_++ % workers.size()].get());
+    }
+
+    // Store connection before it can produce events
+    ConnectionHandle handle;
+    {
+        std::lock_guard<std::mutex> lock(connections_mutex_);
+        handle = connections_.insert(std::move(handler));
+    }
+    if (handle == ConnectionSlab::INVALID_HANDLE) {
+        // The rejected handler has already closed the socket
+        LOG_WARN("Reactor " << id_ << ": connection limit (" << connections_.maxSize()
+                 << ") reached, rejected " << peer.toText());
+        Metrics::add(Counter::AcceptsRejected);
+        return;
+    }
+
+    // Reachable by datagrams before its first message can hand out the token
+    if (server_.udp_) {
+        server_.udp_->registerSession(connection);
+    }
+
+    // Nothing else can reach the handler before the backend watches it
+    connection->onWriteBlockedChanged = [this, handle](ConnectionHandler* handler) {
+        backend_->writeBlockedChanged(handle, handler);
+    };
+    connection->onReadResumed = [this, handle](ConnectionHandler* handler) {
+        backend_->resumeRead(handle, handler);
+    };
+    if (inline_io_) {
+        connection->onFlushRequested = [this, handle](ConnectionHandler* handler) {
+            backend_->requestWrite(handle, handler);
+        };
+    } else {
+        connection->onClosed = [this, handle](ConnectionHandler*) {
+            retireConnection(handle);
+        };
+    }
+#ifdef HAVE_COROUTINES
+    if (server_.session_handler_ && !server_.connection_factory_) {
+        attachSession(handle, connection);
+    }
+#endif
+
+    if (!backend_->addConnection(handle, connection)) {
+#ifdef HAVE_COROUTINES
+        sessions_.erase(handle);
+#endif
+        if (server_.udp_) {
+            server_.udp_->unregisterSession(connection);
+        }
+        std::lock_guard<std::mutex> lock(connections_mutex_);
+        connections_.release(handle); // Handler closes the socket
+        return;
+    }
+
+    Metrics::add(Counter::Accepts);
+    scheduleTimeouts(connection, std::chrono::steady_clock::now());
+#ifdef HAVE_COROUTINES
+    if (server_.session_handler_ && !server_.connection_factory_) {
+        startSession(handle);
+    }
+#endif
+}
+
+#ifdef HAVE_COROUTINES
+Reactor* Reactor::current() {
+    return current_reactor_instance;
+}
+
+void Reactor::attachSession(ConnectionHandle handle, ConnectionHandler* handler) {
+    auto session = std::make_shared<AsyncConnection::Session>();
+    session->reactor = this;
+    session->handle = handle;
+    session->handler = handler;
+    session->peer = handler->getPeerAddress();
+    sessions_[handle] = session;
+    handler->onMessageBatch = nullptr;
+
+    // Messages reach the coroutine on this thread. A connection worker
+    // copies them into the session's inbox and posts one wake-up per batch.
+    handler->onMessageView = [this, session, handle](std::string_view message, ConnectionHandler*) {
+        if (inLoopThread()) {
+            session->deliver(message);
+        } else if (session->queue(message)) {
+            post([this, handle]() {
+                auto it = sessions_.find(handle);
+                if (it != sessions_.end()) {
+                    it->second->wake();
+                }
+            });
+        }
+    };
+}
+
+void Reactor::startSession(ConnectionHandle handle) {
+    auto it = sessions_.find(handle);
+    if (it == sessions_.end()) {
+        return;
+    }
+    // Runs until its first suspension; the frame then lives in arena_
+    try {
+        server_.session_handler_(AsyncConnection(it->second));
+    } catch (const std::exception& e) {
+        LOG_ERROR("Reactor " << id_ << ": session handler failed: " << e.what());
+    }
+}
+
+void Reactor::scheduleSleep(SleepAwaiter* sleeper, std::chrono::steady_clock::time_point deadline) {
+    TimerNode<SleepAwaiter>& node = sleeper->getTimerNode();
+    node.owner = sleeper;
+    sleeps_.schedule(&node, toTick(deadline, true));
+}
+
+void Reactor::cancelSleep(SleepAwaiter* sleeper) {
+    sleeps_.cancel(&sleeper->getTimerNode());
+}
+#endif
+
+void Reactor::flushIfDue(std::chrono::steady_clock::time_point now) {
+    if (now < next_flush_) {
+        return;
+    }
+    // Keep the cadence, but never try to catch up on missed ticks
+    next_flush_ += flush_interval_;
+    if (next_flush_ <= now) {
+        next_flush_ = now + flush_interval_;
+    }
+
+    // One write per connection with everything queued since the last tick;
+    // inline connections are written before the next wait, worker-owned
+    // ones by their worker
+    connections_.forEach([this](ConnectionHandle handle, ConnectionHandler* handler) {
+        if (handler->hasMessagesToSend()) {
+            backend_->requestWrite(handle, handler);
+        }
+    });
+}
+
+void Reactor::handleClientEvent(ConnectionHandle handle, uint32_t events) {
+    // Only this thread changes the slab, so dispatch needs no lock; the
+    // generation check drops events for connections closed earlier
+    ConnectionHandler* handler = connections_.get(handle);
+    if (!handler) {
+        return;
+    }
+
+    if (inline_io_) {
+        if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+            // Client disconnected or error
+            cleanupConnection(handle);
+            return;
+        }
+
+        // This reactor is the only thread that erases connections, so the
+        // handler stays valid without holding the lock during I/O
+        if (events & EPOLLIN) {
+            handler->handleRead();
+            handler->processMessages();
+        }
+
+        if ((events & EPOLLOUT) || (handler->hasMessagesToSend() && handler->isFlushDue())) {
+            handler->handleWrite();
+        }
+
+        if (!handler->isConnected()) {
+            cleanupConnection(handle);
+        }
+        return;
+    }
+
+    // Hand the events to the connection's worker; read before close so
+    // data that arrived together with the hang-up is still delivered
+    uint32_t pending = 0;
+    if (events & EPOLLIN) {
+        pending |= ConnectionWorker::EVENT_READ;
+    }
+    if (events & EPOLLOUT) {
+        pending |= ConnectionWorker::EVENT_WRITE;
+    }
+    if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+        pending |= ConnectionWorker::EVENT_CLOSE;
+    }
+    handler->getWorker()->post(handler, pending);
+}
+
+void Reactor::cleanupConnection(ConnectionHandle handle) {
+    // Datagram handlers may call back into this reactor, so the session is
+    // unregistered before taking connections_mutex_; only this thread
+    // releases slab entries, so the read needs no lock
+    if (server_.udp_) {
+        if (ConnectionHandler* handler = connections_.get(handle)) {
+            server_.udp_->unregisterSession(handler);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    ConnectionHandler* handler = connections_.get(handle);
+    if (!handler) {
+        return;
+    }
+
+    LOG_INFO("Cleaning up connection: " << handler->getClientInfo());
+    Metrics::add(Counter::ConnectionsClosed);
+
+    // Publishers may hold the pointer until this returns
+    server_.topics_.unsubscribeAll(handler);
+    timers_.cancel(&handler->getTimerNode());
+
+#ifdef HAVE_COROUTINES
+    auto session = sessions_.find(handle);
+    if (session != sessions_.end()) {
+        session->second->detach();
+        sessions_.erase(session);
+    }
+#endif
+
+    backend_->removeConnection(handle, handler);
+
+    std::unique_ptr<ConnectionHandler> owned = connections_.release(handle);
+    ConnectionWorker* worker = handler->getWorker();
+    if (worker) {
+        // The worker may still hold queued events for this handler, so it
+        // performs the final delete; the fd stays open until then and
+        // cannot be reused by a new accept in the meantime
+        worker->post(owned.release(), ConnectionWorker::EVENT_DESTROY);
+        return;
+    }
+
+    backend_->release(handle, std::move(owned));
+}
+
+void Reactor::closeConnection(ConnectionHandle handle) {
+    {
+        std::lock_guard<std::mutex> lock(connections_mutex_);
+        ConnectionHandler* handler = connections_.get(handle);
+        if (!handler) {
+            return;
+        }
+
+        // Worker-owned connections are always torn down through the worker,
+        // which reports back exactly once via retireConnection()
+        ConnectionWorker* worker = handler->getWorker();
+        if (worker) {
+            worker->post(handler, ConnectionWorker::EVENT_CLOSE);
+            return;
+        }
+    }
+
+    cleanupConnection(handle);
+}
+
+void Reactor::retireConnection(ConnectionHandle handle) {
+    {
+        std::lock_guard<std::mutex> lock(retired_mutex_);
+        retired_.push_back(handle);
+    }
+    wake();
+}
+
+void Reactor::applySettings(const ServerConfig& fresh) {
+    post([this, fresh]() {
+        config_.idle_timeout = fresh.idle_timeout;
+        config_.read_timeout = fresh.read_timeout;
+        config_.write_timeout = fresh.write_timeout;
+        config_.heartbeat_interval = fresh.heartbeat_interval;
+        config_.accept_batch = fresh.accept_batch;
+        config_.send_high_watermark = fresh.send_high_watermark;
+        config_.send_low_watermark = fresh.send_low_watermark;
+        config_.flush_threshold = fresh.flush_threshold;
+
+        // Deadlines scheduled under the old timeouts may be too late or
+        // missing altogether. The send settings are atomics read by the
+        // connection's I/O thread, so worker-owned connections take them too.
+        auto now = std::chrono::steady_clock::now();
+        connections_.forEach([this, now](ConnectionHandle, ConnectionHandler* handler) {
+            timers_.cancel(&handler->getTimerNode());
+            scheduleTimeouts(handler, now);
+            handler->setSendWatermarks(config_.send_high_watermark, config_.send_low_watermark);
+            if (flush_interval_.count() > 0) {
+                handler->setFlushThreshold(config_.flush_threshold);
+            }
+        });
+    });
+}
+
+void Reactor::appendListeners(std::vector<HandoffSocket>& sockets) const {
+    for (const Listener& listener : listeners_) {
+        sockets.push_back({listener.port, listener.fd});
+    }
+}
+
+void Reactor::detachListeners() {
+    post([this]() {
+        // The successor shares these sockets, so closing our descriptors
+        // would leave epoll watching them; stop watching instead
+        for (Listener& listener : listeners_) {
+            if (!listener.detached) {
+                listener.detached = true;
+                backend_->removeListener(listener.fd);
+            }
+        }
+        LOG_INFO("Reactor " << id_ << ": stopped accepting, draining "
+                 << connections_.size() << " connection(s)");
+    });
+}
+
+void Reactor::post(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(tasks_mutex_);
+        tasks_.push_back(std::move(task));
+    }
+    wake();
+}
+
+void Reactor::wake() {
+    uint64_t one = 1;
+    if (write(wake_fd_, &one, sizeof(one)) == -1 && errno != EAGAIN) {
+        LOG_ERROR("Failed to wake reactor " << id_ << ": " << strerror(errno));
+    }
+}
+
+void Reactor::handleWakeup() {
+    uint64_t count;
+    while (read(wake_fd_, &count, sizeof(count)) > 0) {
+        // Drain the eventfd counter
+    }
+
+    runTasks();
+    reapRetiredConnections();
+}
+
+void Reactor::runTasks() {
+    std::vector<std::function<void()>> tasks;
+    {
+        std::lock_guard<std::mutex> lock(tasks_mutex_);
+        tasks.swap(tasks_);
+    }
+
+    for (auto& task : tasks) {
+        task();
+    }
+}
+
+void Reactor::reapRetiredConnections() {
+    std::vector<ConnectionHandle> retired;
+    {
+        std::lock_guard<std::mutex> lock(retired_mutex_);
+        retired.swap(retired_);
+    }
+
+    for (ConnectionHandle handle : retired) {
+        cleanupConnection(handle);
+    }
+}
+
+SendStatus Reactor::sendToClient(int client_fd, const std::string& message) {
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    ConnectionHandler* handler = connections_.get(connections_.find(client_fd));
+    if (!handler) {
+        return SendStatus::Disconnected;
+    }
+    return handler->sendMessage(message);
+}
+
+bool Reactor::forceWriteEvent(int client_fd) {
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    ConnectionHandle handle = connections_.find(client_fd);
+    ConnectionHandler* handler = connections_.get(handle);
+    if (!handler) {
+        return false;
+    }
+
+    // Tick flushing writes it with everything else queued this tick
+    if (handler->isConnected() && handler->isFlushDue()) {
+        backend_->requestWrite(handle, handler);
+    }
+    return true;
+}
+
+void Reactor::broadcastMessage(std::shared_ptr<const BroadcastPayload> payload) {
+    // Each reactor walks its own connections on its own thread, so a
+    // broadcast fans out in parallel and the caller never blocks on the
+    // connection maps
+    post([this, payload]() { deliverBroadcast(*payload); });
+}
+
+void Reactor::deliverBroadcast(const BroadcastPayload& payload) {
+    // Only this thread inserts or releases connections, so walking the slab
+    // here needs no lock
+    std::vector<ConnectionHandle> disconnected;
+
+    connections_.forEach([&](ConnectionHandle handle, ConnectionHandler* handler) {
+        const auto& framed = payload.forConnection(*handler);
+        if (!framed || handler->sendMessage(framed) != SendStatus::Queued || !handler->isFlushDue()) {
+            return;
+        }
+
+        if (inline_io_) {
+            backend_->write(handle, handler);
+            if (!handler->isConnected()) {
+                disconnected.push_back(handle);
+            }
+        } else {
+            handler->getWorker()->post(handler, ConnectionWorker::EVENT_WRITE);
+        }
+    });
+
+    for (ConnectionHandle handle : disconnected) {
+        cleanupConnection(handle);
+    }
+}
+
+size_t Reactor::getConnectionCount() const {
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    return connections_.size();
+}
+
+void Reactor::cleanupInactiveConnections(int timeout_seconds) {
+    // Closing connections erases them, which only the reactor thread may do
+    post([this, timeout_seconds]() { sweepInactiveConnections(timeout_seconds); });
+}
+
+void Reactor::sweepInactiveConnections(int timeout_seconds) {
+    auto now = std::chrono::steady_clock::now();
+    auto timeout = std::chrono::seconds(timeout_seconds);
+
+    std::vector<ConnectionHandle> to_remove;
+
+    connections_.forEach([&](ConnectionHandle handle, ConnectionHandler* handler) {
+        if (now - handler->getLastActivity() > timeout) {
+            LOG_INFO("Cleaning up inactive connection: " << handler->getClientInfo());
+            to_remove.push_back(handle);
+        }
+    });
+
+    for (ConnectionHandle handle : to_remove) {
+        closeConnection(handle);
+    }
+}
+
+void Reactor::shedLoad() {
+    MemoryTracker& tracker = MemoryTracker::getInstance();
+    size_t usage = tracker.getCurrentUsage();
+    size_t limit = tracker.getMemoryLimit();
+    if (usage <= limit) {
+        return;
+    }
+
+    // Every reactor sheds its share, starting with the clients that fell
+    // furthest behind; their send queues are most of what can be freed
+    size_t target = (usage - limit) / std::max<size_t>(server_.reactors_.size(), 1) + 1;
+
+    std::vector<std::pair<size_t, ConnectionHandle>> backlog;
+    connections_.forEach([&](ConnectionHandle handle, ConnectionHandler* handler) {
+        size_t queued = handler->getQueuedBytes();
+        if (queued > 0 && handler->isConnected()) {
+            backlog.emplace_back(queued, handle);
+        }
+    });
+    std::sort(backlog.begin(), backlog.end(), std::greater<>());
+
+    size_t freed = 0;
+    for (auto& [queued, handle] : backlog) {
+        if (freed >= target) {
+            break;
+        }
+        LOG_WARN("Reactor " << id_ << ": memory limit exceeded, disconnecting "
+                 << connections_.get(handle)->getClientInfo() << " (" << queued << " bytes queued)");
+        freed += queued;
+        closeConnection(handle);
+    }
+}
+
+uint64_t Reactor::toTick(std::chrono::steady_clock::time_point time, bool round_up) {
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+    if (round_up) {
+        ms += TIMER_TICK_MS - 1;
+    }
+    return static_cast<uint64_t>(ms / TIMER_TICK_MS);
+}
+
+void Reactor::scheduleTimeouts(ConnectionHandler* handler, std::chrono::steady_clock::time_point now) {
+    const ServerConfig& config = config_;
+    bool pending = handler->hasMessagesToSend();
+    auto deadline = std::chrono::steady_clock::time_point::max();
+
+    auto consider = [&deadline](std::chrono::steady_clock::time_point since, int seconds) {
+        if (seconds > 0) {
+            deadline = std::min(deadline, since + std::chrono::seconds(seconds));
+        }
+    };
+
+    consider(handler->getLastActivity(), config.idle_timeout);
+    consider(handler->getLastRead(), config.read_timeout);
+    // Nothing queued: no stall can start before one more period has passed
+    consider(pending ? handler->getLastWrite() : now, config.write_timeout);
+    // Heartbeats only go out on an empty queue
+    consider(pending ? now : handler->getLastWrite(), config.heartbeat_interval);
+
+    if (deadline != std::chrono::steady_clock::time_point::max()) {
+        timers_.schedule(&handler->getTimerNode(), toTick(deadline, true));
+    }
+}
+
+void Reactor::checkTimeouts(ConnectionHandler* handler) {
+    if (!handler->isConnected()) {
+        return; // Teardown already under way
+    }
+
+    const ServerConfig& config = config_;
+    auto now = std::chrono::steady_clock::now();
+    auto expired = [&now](std::chrono::steady_clock::time_point since, int seconds) {
+        return seconds > 0 && now - since >= std::chrono::seconds(seconds);
+    };
+
+    bool pending = handler->hasMessagesToSend();
+    const char* reason = nullptr;
+    if (expired(handler->getLastActivity(), config.idle_timeout)) {
+        reason = "idle";
+    } else if (expired(handler->getLastRead(), config.read_timeout)) {
+        reason = "read";
+    } else if (pending && expired(handler->getLastWrite(), config.write_timeout)) {
+        reason = "write";
+    }
+
+    if (reason) {
+        LOG_INFO("Closing connection " << handler->getClientInfo() << ": " << reason << " timeout");
+        closeConnection(connections_.find(handler->getClientFd()));
+        return;
+    }
+
+    if (!pending && expired(handler->getLastWrite(), config.heartbeat_interval)) {
+        handler->sendMessage("", 0);
+        handler->requestFlush();
+    }
+
+    scheduleTimeouts(handler, now);
+}
@@ -0,0 +1,207 @@
+#include "ServerConfig.h"
+#include "CpuAffinity.h"
+#include "Logger.h"
+#include <fstream>
+#include <set>
+#include <sstream>
+
+namespace {
+
+// "1@10.0.0.1:9100,2@node-b:9100"; throws on a malformed or repeated entry
+std::vector<ClusterMember> parseClusterNodes(const std::string& text) {
+    std::vector<ClusterMember> members;
+    std::set<int> ids;
+    std::stringstream list(text);
+    std::string entry;
+    while (std::getline(list, entry, ',')) {
+        size_t at = entry.find('@');
+        size_t colon = entry.rfind(':');
+        if (at == std::string::npos || colon == std::string::npos || colon < at + 2) {
+            throw std::invalid_argument("cluster node is not id@host:port");
+        }
+        ClusterMember member{std::stoi(entry.substr(0, at)), entry.substr(at + 1, colon - at - 1),
+                             std::stoi(entry.substr(colon + 1))};
+        if (member.id <= 0 || member.port <= 0 || member.port > 65535 || !ids.insert(member.id).second) {
+            throw std::invalid_argument("bad or repeated cluster node");
+        }
+        members.push_back(std::move(member));
+    }
+    return members;
+}
+
+} // namespace
+
+ServerConfig readConfig(const std::string& filename) {
+    ServerConfig config;
+    std::ifstream file(filename);
+
+    if (!file.is_open()) {
+        LOG_INFO("Config file '" << filename << "' not found. Using default values.");
+        return config;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        // Skip empty lines and comments
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        // Find the '=' separator
+        size_t pos = line.find('=');
+        if (pos == std::string::npos) {
+            continue; // Skip invalid lines
+        }
+
+        std::string key = line.substr(0, pos);
+        std::string value = line.substr(pos + 1);
+
+        // Parse the configuration values
+        try {
+            if (key == "port") {
+                config.port = std::stoi(value);
+            } else if (key == "max_connections") {
+                config.max_connections = std::stoi(value);
+            } else if (key == "accept_batch") {
+                int batch = std::stoi(value);
+                if (batch < 0) {
+                    throw std::invalid_argument("negative accept batch");
+                }
+                config.accept_batch = batch;
+            } else if (key == "thread_count") {
+                config.thread_count = std::stoi(value);
+            } else if (key == "reactor_count") {
+                config.reactor_count = std::stoi(value);
+            } else if (key == "io_backend") {
+                if (value != "epoll" && value != "io_uring") {
+                    throw std::invalid_argument("unknown I/O backend");
+                }
+                config.io_backend = value;
+            } else if (key == "framing") {
+                if (!Framing::parseMode(value, config.framing)) {
+                    throw std::invalid_argument("unknown framing");
+                }
+            } else if (key == "udp_port") {
+                config.udp_port = std::stoi(value);
+            } else if (key == "tls_port") {
+                config.tls_port = std::stoi(value);
+            } else if (key == "tls_cert_file") {
+                config.tls_cert_file = value;
+            } else if (key == "tls_key_file") {
+                config.tls_key_file = value;
+            } else if (key == "binary_port") {
+                config.binary_port = std::stoi(value);
+            } else if (key == "binary_framing") {
+                if (!Framing::parseMode(value, config.binary_framing)) {
+                    throw std::invalid_argument("unknown framing");
+                }
+            } else if (key == "reactor_cpus") {
+                if (!CpuAffinity::parseCpuList(value, config.reactor_cpus)) {
+                    throw std::invalid_argument("invalid CPU list");
+                }
+            } else if (key == "worker_cpus") {
+                if (!CpuAffinity::parseCpuList(value, config.worker_cpus)) {
+                    throw std::invalid_argument("invalid CPU list");
+                }
+            } else if (key == "scheduler_cpus") {
+                if (!CpuAffinity::parseCpuList(value, config.scheduler_cpus)) {
+                    throw std::invalid_argument("invalid CPU list");
+                }
+            } else if (key == "reuseport_steering") {
+                if (value != "none" && value != "incoming_cpu" && value != "cbpf") {
+                    throw std::invalid_argument("unknown steering mode");
+                }
+                config.reuseport_steering = value;
+            } else if (key == "hot_restart_socket") {
+                config.hot_restart_socket = value;
+            } else if (key == "drain_timeout") {
+                int timeout = std::stoi(value);
+                if (timeout < 0) {
+                    throw std::invalid_argument("negative drain timeout");
+                }
+                config.drain_timeout = timeout;
+            } else if (key == "cluster_node_id") {
+                int id = std::stoi(value);
+                if (id < 0) {
+                    throw std::invalid_argument("negative cluster node id");
+                }
+                config.cluster_node_id = id;
+            } else if (key == "cluster_nodes") {
+                config.cluster_nodes = parseClusterNodes(value);
+            } else if (key == "compression") {
+                if (value != "none" && value != "zstd") {
+                    throw std::invalid_argument("unknown compression");
+                }
+                config.compression = value;
+            } else if (key == "compression_level") {
+                int level = std::stoi(value);
+                if (level < 1 || level > 22) {
+                    throw std::invalid_argument("compression level out of range");
+                }
+                config.compression_level = level;
+            } else if (key == "compression_min_size") {
+                config.compression_min_size = std::stoul(value);
+            } else if (key == "compression_dictionary") {
+                config.compression_dictionary = value;
+            } else if (key == "scheduler") {
+                if (value != "threadpool" && value != "workstealing") {
+                    throw std::invalid_argument("unknown scheduler");
+                }
+                config.scheduler = value;
+            } else if (key == "scheduler_threads") {
+                config.scheduler_threads = std::stoi(value);
+            } else if (key == "idle_timeout") {
+                config.idle_timeout = std::stoi(value);
+            } else if (key == "read_timeout") {
+                config.read_timeout = std::stoi(value);
+            } else if (key == "write_timeout") {
+                config.write_timeout = std::stoi(value);
+            } else if (key == "heartbeat_interval") {
+                config.heartbeat_interval = std::stoi(value);
+            } else if (key == "send_high_watermark") {
+                config.send_high_watermark = std::stoul(value);
+            } else if (key == "send_low_watermark") {
+                config.send_low_watermark = std::stoul(value);
+            } else if (key == "flush_interval_ms") {
+                int interval = std::stoi(value);
+                if (interval < 0) {
+                    throw std::invalid_argument("negative flush interval");
+                }
+                config.flush_interval_ms = interval;
+            } else if (key == "flush_threshold") {
+                config.flush_threshold = std::stoul(value);
+            } else if (key == "max_memory_mb") {
+                config.max_memory_mb = std::stoul(value);
+            } else if (key == "admin_port") {
+                config.admin_port = std::stoi(value);
+            } else if (key == "admin_address") {
+                config.admin_address = value;
+            } else if (key == "capture_file") {
+                config.capture_file = value;
+            } else if (key == "capture_max_mb") {
+                size_t size = std::stoul(value);
+                if (size == 0) {
+                    throw std::invalid_argument("empty capture size");
+                }
+                config.capture_max_mb = size;
+            } else if (key == "log_level") {
+                if (!Logger::parseLevel(value, config.log_level)) {
+                    throw std::invalid_argument("unknown log level");
+                }
+            }
+        } catch (const std::exception& e) {
+            LOG_WARN("Warning: Invalid value for '" << key << "': " << value);
+        }
+    }
+
+    file.close();
+
+    if (config.send_low_watermark > config.send_high_watermark) {
+        LOG_WARN("Warning: send_low_watermark above send_high_watermark, using "
+                 << config.send_high_watermark);
+        config.send_low_watermark = config.send_high_watermark;
+    }
+
+    LOG_INFO("Configuration loaded from '" << filename << "'");
+    return config;
+}
@@ -0,0 +1,191 @@
+#include "TlsContext.h"
+#include "Logger.h"
+
+TlsContext::TlsContext() : ctx_(nullptr) {
+}
+
+#ifdef HAVE_OPENSSL
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+namespace {
+
+// Oldest OpenSSL whose kTLS receive path handles TLS 1.3
+constexpr long KTLS_TLS13_RX_VERSION = 0x30200000L;
+
+// Ciphers the kernel TLS module implements
+const char* const TLS12_CIPHERS = "ECDHE+AESGCM:ECDHE+CHACHA20";
+const char* const TLS13_CIPHERSUITES =
+    "TLS_AES_128_GCM_SHA256:TLS_AES_256_GCM_SHA384:TLS_CHACHA20_POLY1305_SHA256";
+
+std::string takeError(const char* fallback) {
+    unsigned long code = ERR_get_error();
+    ERR_clear_error();
+    if (code == 0) {
+        return fallback;
+    }
+    char text[256];
+    ERR_error_string_n(code, text, sizeof(text));
+    return text;
+}
+
+}
+
+TlsSession::~TlsSession() {
+    // The socket BIO does not own the descriptor, and no close_notify is
+    // sent: after the hand-off the kernel owns the record layer
+    SSL_free(ssl_);
+}
+
+TlsSession::Status TlsSession::handshake() {
+    // SSL_get_error() reads this thread's error queue, start from a clean one
+    ERR_clear_error();
+    int result = SSL_do_handshake(ssl_);
+    if (result == 1) {
+        if (!BIO_get_ktls_send(SSL_get_wbio(ssl_)) || !BIO_get_ktls_recv(SSL_get_rbio(ssl_))) {
+            error_ = std::string("kernel TLS not enabled for ") + SSL_get_version(ssl_) + " "
+                     + SSL_get_cipher_name(ssl_);
+            return Status::Failed;
+        }
+        return Status::Done;
+    }
+
+    switch (SSL_get_error(ssl_, result)) {
+        case SSL_ERROR_WANT_READ:
+            return Status::Pending;
+        case SSL_ERROR_WANT_WRITE:
+            // A large certificate chain can outgrow a small send buffer
+            return Status::WantWrite;
+        case SSL_ERROR_ZERO_RETURN:
+            error_ = "closed by peer during handshake";
+            break;
+        case SSL_ERROR_SYSCALL:
+            error_ = errno ? strerror(errno) : takeError("closed by peer during handshake");
+            break;
+        default:
+            error_ = takeError("handshake failed");
+            break;
+    }
+    return Status::Failed;
+}
+
+TlsContext::~TlsContext() {
+    SSL_CTX_free(ctx_);
+}
+
+bool TlsContext::init(const std::string& cert_file, const std::string& key_file) {
+    if (!kernelTlsAvailable()) {
+        LOG_ERROR("Kernel TLS is not available (load the tls module: modprobe tls)");
+        return false;
+    }
+
+    ctx_ = SSL_CTX_new(TLS_server_method());
+    if (!ctx_) {
+        LOG_ERROR("Failed to create TLS context: " << takeError("out of memory"));
+        return false;
+    }
+
+    if (SSL_CTX_use_certificate_chain_file(ctx_, cert_file.c_str()) != 1) {
+        LOG_ERROR("Failed to load TLS certificate '" << cert_file << "': " << takeError("unknown error"));
+        return false;
+    }
+    if (SSL_CTX_use_PrivateKey_file(ctx_, key_file.c_str(), SSL_FILETYPE_PEM) != 1 ||
+        SSL_CTX_check_private_key(ctx_) != 1) {
+        LOG_ERROR("Failed to load TLS key '" << key_file << "': " << takeError("unknown error"));
+        return false;
+    }
+
+    SSL_CTX_set_min_proto_version(ctx_, TLS1_2_VERSION);
+    if (OpenSSL_version_num() < static_cast<unsigned long>(KTLS_TLS13_RX_VERSION)) {
+        SSL_CTX_set_max_proto_version(ctx_, TLS1_2_VERSION);
+    }
+    SSL_CTX_set_cipher_list(ctx_, TLS12_CIPHERS);
+    SSL_CTX_set_ciphersuites(ctx_, TLS13_CIPHERSUITES);
+    SSL_CTX_set_options(ctx_, SSL_OP_ENABLE_KTLS | SSL_OP_NO_RENEGOTIATION | SSL_OP_NO_TICKET |
+                              SSL_OP_CIPHER_SERVER_PREFERENCE);
+    SSL_CTX_set_num_tickets(ctx_, 0);
+
+    LOG_INFO("TLS certificate loaded from '" << cert_file << "', kernel TLS offload enabled");
+    return true;
+}
+
+std::unique_ptr<TlsSession> TlsContext::accept(int client_fd) {
+    SSL* ssl = SSL_new(ctx_);
+    if (!ssl) {
+        LOG_ERROR("Failed to create TLS session: " << takeError("out of memory"));
+        return nullptr;
+    }
+    if (SSL_set_fd(ssl, client_fd) != 1) {
+        LOG_ERROR("Failed to attach TLS session: " << takeError("unknown error"));
+        SSL_free(ssl);
+        return nullptr;
+    }
+    SSL_set_accept_state(ssl);
+    return std::make_unique<TlsSession>(ssl);
+}
+
+bool TlsContext::kernelTlsAvailable() {
+    // The ULP can only be attached to an established socket, so probe on a
+    // loopback connection; the kernel loads the module on demand
+    int listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int client_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    bool available = false;
+
+    struct sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+
+    if (listen_fd != -1 && client_fd != -1 &&
+        bind(listen_fd, (struct sockaddr*)&address, sizeof(address)) == 0 &&
+        listen(listen_fd, 1) == 0 &&
+        getsockname(listen_fd, (struct sockaddr*)&address, &length) == 0 &&
+        connect(client_fd, (struct sockaddr*)&address, sizeof(address)) == 0) {
+        available = setsockopt(client_fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) == 0;
+    }
+
+    if (client_fd != -1) {
+        ::close(client_fd);
+    }
+    if (listen_fd != -1) {
+        ::close(listen_fd);
+    }
+    return available;
+}
+
+#else // !HAVE_OPENSSL
+
+// Built without OpenSSL: init() fails, so TLS listeners cannot be enabled
+
+TlsSession::~TlsSession() = default;
+
+TlsSession::Status TlsSession::handshake() {
+    error_ = "built without OpenSSL";
+    return Status::Failed;
+}
+
+TlsContext::~TlsContext() = default;
+
+bool TlsContext::init(const std::string&, const std::string&) {
+    LOG_ERROR("TLS requested, but the server was built without OpenSSL");
+    return false;
+}
+
+std::unique_ptr<TlsSession> TlsContext::accept(int) {
+    return nullptr;
+}
+
+bool TlsContext::kernelTlsAvailable() {
+    return false;
+}
+
+#endif // HAVE_OPENSSL
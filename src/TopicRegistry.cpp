@@ -0,0 +1,113 @@
+#include "TopicRegistry.h"
+#include <algorithm>
+#include <mutex>
+
+bool TopicRegistry::subscribe(ConnectionHandler* handler, const std::string& topic) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+
+    // A closed connection may already have been unsubscribed by its teardown
+    if (!handler->isConnected()) {
+        return false;
+    }
+
+    Topic& entry = topics_[topic];
+    if (entry.name.empty()) {
+        entry.name = topic;
+    }
+    auto& members = entry.members;
+    if (std::find(members.begin(), members.end(), handler) != members.end()) {
+        return false;
+    }
+
+    members.push_back(handler);
+    subscriptions_[handler].push_back(&entry);
+    return true;
+}
+
+bool TopicRegistry::unsubscribe(ConnectionHandler* handler, const std::string& topic) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+
+    auto topic_it = topics_.find(topic);
+    auto subs_it = subscriptions_.find(handler);
+    if (topic_it == topics_.end() || subs_it == subscriptions_.end()) {
+        return false;
+    }
+
+    auto& subscribed = subs_it->second;
+    auto found = std::find(subscribed.begin(), subscribed.end(), &topic_it->second);
+    if (found == subscribed.end()) {
+        return false;
+    }
+
+    *found = subscribed.back();
+    subscribed.pop_back();
+    if (subscribed.empty()) {
+        subscriptions_.erase(subs_it);
+    }
+
+    removeMember(topic_it->second, handler);
+    if (topic_it->second.members.empty()) {
+        topics_.erase(topic_it);
+    }
+    return true;
+}
+
+void TopicRegistry::unsubscribeAll(ConnectionHandler* handler) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+
+    auto subs_it = subscriptions_.find(handler);
+    if (subs_it == subscriptions_.end()) {
+        return;
+    }
+
+    for (Topic* topic : subs_it->second) {
+        removeMember(*topic, handler);
+        if (topic->members.empty()) {
+            // Drop rooms that became empty
+            std::string name = topic->name;
+            topics_.erase(name);
+        }
+    }
+    subscriptions_.erase(subs_it);
+}
+
+size_t TopicRegistry::publish(const std::string& topic, const BroadcastPayload& payload) {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+
+    auto it = topics_.find(topic);
+    if (it == topics_.end()) {
+        return 0;
+    }
+
+    size_t delivered = 0;
+    for (ConnectionHandler* handler : it->second.members) {
+        const auto& framed = payload.forConnection(*handler);
+        if (framed && handler->sendMessage(framed) == SendStatus::Queued) {
+            handler->requestFlush();
+            ++delivered;
+        }
+    }
+    return delivered;
+}
+
+size_t TopicRegistry::getSubscriberCount(const std::string& topic) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = topics_.find(topic);
+    return it == topics_.end() ? 0 : it->second.members.size();
+}
+
+size_t TopicRegistry::getTopicCount() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return topics_.size();
+}
+
+void TopicRegistry::removeMember(Topic& topic, ConnectionHandler* handler) {
+    // Swap-remove keeps the member array dense; delivery order is not part
+    // of the contract
+    auto& members = topic.members;
+    auto found = std::find(members.begin(), members.end(), handler);
+    if (found != members.end()) {
+        *found = members.back();
+        members.pop_back();
+    }
+}
@@ -0,0 +1,135 @@
+#include "TrafficCapture.h"
+#include "Logger.h"
+#include "Metrics.h"
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+TrafficCapture::TrafficCapture()
+    : fd_(-1), map_(nullptr), capacity_(0), offset_(0), next_connection_(1), full_(false),
+      start_(std::chrono::steady_clock::now()) {
+}
+
+TrafficCapture::~TrafficCapture() {
+    if (map_) {
+        ::munmap(map_, capacity_);
+    }
+    if (fd_ != -1) {
+        // Records past the capacity were dropped and never written
+        size_t used = std::min(offset_.load(), capacity_);
+        if (::ftruncate(fd_, static_cast<off_t>(used)) == -1) {
+            LOG_WARN("Failed to trim capture " << path_ << ": " << strerror(errno));
+        }
+        ::close(fd_);
+        LOG_INFO("Capture " << path_ << " closed, " << used << " bytes");
+    }
+}
+
+bool TrafficCapture::open(const std::string& path, size_t max_bytes) {
+    path_ = path;
+    if (max_bytes < sizeof(CaptureFileHeader) + sizeof(CaptureRecord)) {
+        LOG_ERROR("Capture size too small for " << path);
+        return false;
+    }
+
+    // A process being replaced (hot restart) may still write its capture;
+    // renaming leaves its mapping intact where truncating would fault it
+    if (::rename(path.c_str(), (path + ".prev").c_str()) == -1 && errno != ENOENT) {
+        LOG_WARN("Failed to keep previous capture " << path << ": " << strerror(errno));
+    }
+
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ == -1) {
+        LOG_ERROR("Failed to create capture " << path << ": " << strerror(errno));
+        return false;
+    }
+
+    // Reserving the blocks up front means a full disk fails here instead
+    // of raising SIGBUS on a mapped page
+    int error = ::posix_fallocate(fd_, 0, static_cast<off_t>(max_bytes));
+    if (error != 0) {
+        LOG_ERROR("Failed to reserve " << max_bytes << " bytes for capture " << path << ": " << strerror(error));
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+
+    void* map = ::mmap(nullptr, max_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (map == MAP_FAILED) {
+        LOG_ERROR("Failed to map capture " << path << ": " << strerror(errno));
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+    ::madvise(map, max_bytes, MADV_SEQUENTIAL);
+    map_ = static_cast<char*>(map);
+    capacity_ = max_bytes;
+
+    CaptureFileHeader header = {};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.header_size = sizeof(CaptureFileHeader);
+    header.start_unix_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+    std::memcpy(map_, &header, sizeof(header));
+
+    start_ = std::chrono::steady_clock::now();
+    offset_.store(sizeof(CaptureFileHeader));
+    LOG_INFO("Capturing inbound traffic to " << path << " (" << (max_bytes >> 20) << " MB)");
+    return true;
+}
+
+uint32_t TrafficCapture::openConnection(FramingMode framing) {
+    uint32_t connection = next_connection_.fetch_add(1, std::memory_order_relaxed);
+    append(CaptureRecordType::Open, connection, framing, std::string_view(), std::chrono::steady_clock::now());
+    return connection;
+}
+
+void TrafficCapture::recordMessage(uint32_t connection, FramingMode framing, std::string_view message,
+                                   std::chrono::steady_clock::rep read_time) {
+    std::chrono::steady_clock::time_point time{std::chrono::steady_clock::duration(read_time)};
+    append(CaptureRecordType::Message, connection, framing, message, time);
+}
+
+void TrafficCapture::closeConnection(uint32_t connection, FramingMode framing) {
+    append(CaptureRecordType::Close, connection, framing, std::string_view(), std::chrono::steady_clock::now());
+}
+
+size_t TrafficCapture::getBytesWritten() const {
+    return std::min(offset_.load(std::memory_order_relaxed), capacity_);
+}
+
+void TrafficCapture::append(CaptureRecordType type, uint32_t connection, FramingMode framing,
+                            std::string_view payload, std::chrono::steady_clock::time_point time) {
+    size_t size = (sizeof(CaptureRecord) + payload.size() + RECORD_ALIGNMENT - 1) & ~(RECORD_ALIGNMENT - 1);
+    size_t offset = offset_.fetch_add(size, std::memory_order_relaxed);
+    if (offset + size > capacity_) {
+        Metrics::add(Counter::CaptureRecordsDropped);
+        if (!full_.exchange(true, std::memory_order_relaxed)) {
+            LOG_WARN("Capture " << path_ << " is full, dropping further records");
+        }
+        return;
+    }
+
+    CaptureRecord record = {};
+    record.connection = connection;
+    record.timestamp_ns = time > start_ ? static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(time - start_).count()) : 0;
+    record.type = static_cast<uint8_t>(type);
+    record.framing = static_cast<uint8_t>(framing);
+    record.length = static_cast<uint32_t>(payload.size());
+
+    char* target = map_ + offset;
+    std::memcpy(target + sizeof(record.size), reinterpret_cast<const char*>(&record) + sizeof(record.size),
+                sizeof(record) - sizeof(record.size));
+    if (!payload.empty()) {
+        std::memcpy(target + sizeof(record), payload.data(), payload.size());
+    }
+    // Published last: a reader never sees a size before the bytes it covers
+    __atomic_store_n(reinterpret_cast<uint32_t*>(target), static_cast<uint32_t>(size), __ATOMIC_RELEASE);
+    Metrics::add(Counter::CaptureRecords);
+}
@@ -0,0 +1,398 @@
+#include "UdpTransport.h"
+#include "ConnectionHandler.h"
+#include "Logger.h"
+#include "Metrics.h"
+#include <endian.h>
+#include <netinet/udp.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/random.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <random>
+
+namespace {
+
+// recvmmsg() calls per wakeup before queued sends get their turn
+constexpr int RECV_ROUNDS = 4;
+
+bool samePeer(const struct sockaddr_in& a, const struct sockaddr_in& b) {
+    return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port;
+}
+
+// Tokens are handed to clients, so they must not be predictable from the
+// ones a client has seen
+uint64_t randomToken() {
+    uint64_t token = 0;
+    if (getrandom(&token, sizeof(token), 0) != static_cast<ssize_t>(sizeof(token))) {
+        std::random_device device;
+        token = (static_cast<uint64_t>(device()) << 32) ^ device();
+    }
+    return token;
+}
+
+} // namespace
+
+UdpTransport::UdpTransport(int port, Handler handler)
+    : port_(port), handler_(std::move(handler)), socket_fd_(-1), wake_fd_(-1),
+      running_(false), gso_enabled_(false) {
+}
+
+UdpTransport::~UdpTransport() {
+    stop();
+    if (wake_fd_ != -1) {
+        ::close(wake_fd_);
+    }
+}
+
+bool UdpTransport::start() {
+    socket_fd_ = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (socket_fd_ == -1) {
+        LOG_ERROR("Failed to create UDP socket: " << strerror(errno));
+        return false;
+    }
+
+    int opt = 1;
+    setsockopt(socket_fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(port_);
+    if (bind(socket_fd_, (struct sockaddr*)&address, sizeof(address)) == -1) {
+        LOG_ERROR("Failed to bind UDP port " << port_ << ": " << strerror(errno));
+        stop();
+        return false;
+    }
+
+#ifdef UDP_SEGMENT
+    // Readable on kernels that take UDP_SEGMENT (Linux 4.18+)
+    int segment = 0;
+    socklen_t length = sizeof(segment);
+    gso_enabled_ = getsockopt(socket_fd_, IPPROTO_UDP, UDP_SEGMENT, &segment, &length) == 0;
+#endif
+
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ == -1) {
+        LOG_ERROR("Failed to create eventfd: " << strerror(errno));
+        stop();
+        return false;
+    }
+
+    // Received datagrams are handed out as views, one pooled buffer each
+    MessageBufferPool& pool = MessageBufferPool::getInstance();
+    for (size_t i = 0; i < RECV_BATCH; ++i) {
+        receive_buffers_.push_back(pool.acquire(MAX_DATAGRAM_SIZE));
+    }
+
+    running_ = true;
+    thread_ = std::thread([this]() { run(); });
+    LOG_INFO("UDP transport on port " << port_ << (gso_enabled_ ? " (GSO)" : ""));
+    return true;
+}
+
+void UdpTransport::stop() {
+    if (running_.exchange(false)) {
+        uint64_t one = 1;
+        ssize_t ignored = ::write(wake_fd_, &one, sizeof(one));
+        (void)ignored;
+    }
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+
+    if (socket_fd_ != -1) {
+        ::close(socket_fd_);
+        socket_fd_ = -1;
+    }
+
+    MessageBufferPool& pool = MessageBufferPool::getInstance();
+    for (auto& buffer : receive_buffers_) {
+        pool.release(std::move(buffer));
+    }
+    receive_buffers_.clear();
+    releaseSent(sending_.size());
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    for (auto& outgoing : queued_) {
+        pool.release(std::move(outgoing.buffer));
+    }
+    queued_.clear();
+}
+
+void UdpTransport::registerSession(ConnectionHandler* handler) {
+    std::unique_lock<std::shared_mutex> lock(sessions_mutex_);
+    uint64_t token;
+    do {
+        token = randomToken();
+    } while (token == 0 || sessions_.count(token) != 0);
+    sessions_.emplace(token, handler);
+    handler->setDatagramToken(token);
+}
+
+void UdpTransport::unregisterSession(ConnectionHandler* handler) {
+    std::unique_lock<std::shared_mutex> lock(sessions_mutex_);
+    auto it = sessions_.find(handler->getDatagramToken());
+    if (it != sessions_.end() && it->second == handler) {
+        sessions_.erase(it);
+    }
+}
+
+bool UdpTransport::send(ConnectionHandler* handler, const char* data, size_t length) {
+    PeerAddress peer;
+    if (!running_ || !handler->getDatagramPeer(peer)) {
+        return false;
+    }
+    if (length > MAX_DATAGRAM_SIZE || MemoryTracker::getInstance().isMemoryLimitExceeded()) {
+        Metrics::add(Counter::DatagramsDropped);
+        return false;
+    }
+
+    MessageBufferPool& pool = MessageBufferPool::getInstance();
+    std::unique_ptr<MessageBuffer> buffer = pool.acquire(length);
+    buffer->append(data, length);
+
+    bool was_empty;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        if (queued_.size() >= SEND_QUEUE_LIMIT) {
+            was_empty = false;
+        } else {
+            was_empty = queued_.empty();
+            queued_.push_back({peer.get(), std::move(buffer)});
+        }
+    }
+    if (buffer) {
+        // Loss-tolerant traffic: drop rather than queue without bound
+        Metrics::add(Counter::DatagramsDropped);
+        pool.release(std::move(buffer));
+        return false;
+    }
+
+    // The transport thread flushes after every batch it handled anyway
+    if (was_empty && !onTransportThread()) {
+        uint64_t one = 1;
+        if (::write(wake_fd_, &one, sizeof(one)) == -1 && errno != EAGAIN) {
+            LOG_ERROR("Failed to wake UDP transport: " << strerror(errno));
+        }
+    }
+    return true;
+}
+
+void UdpTransport::run() {
+    struct pollfd fds[2];
+    fds[0].fd = socket_fd_;
+    fds[1].fd = wake_fd_;
+    fds[1].events = POLLIN;
+    bool blocked = false;
+
+    while (running_) {
+        fds[0].events = POLLIN | (blocked ? POLLOUT : 0);
+        if (::poll(fds, 2, -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR("UDP poll error: " << strerror(errno));
+            break;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            uint64_t count;
+            while (::read(wake_fd_, &count, sizeof(count)) > 0) {
+                // Drain the eventfd counter
+            }
+        }
+        if (!running_) {
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            for (int round = 0; round < RECV_ROUNDS && receiveBatch() == RECV_BATCH; ++round) {
+                // A full batch means more datagrams are probably waiting
+            }
+        }
+
+        // Replies produced by the handlers above leave in one sendmmsg()
+        blocked = !flushSends();
+    }
+}
+
+size_t UdpTransport::receiveBatch() {
+    struct mmsghdr messages[RECV_BATCH];
+    struct iovec iov[RECV_BATCH];
+    struct sockaddr_in from[RECV_BATCH];
+
+    std::memset(messages, 0, sizeof(messages));
+    for (size_t i = 0; i < RECV_BATCH; ++i) {
+        MessageBuffer& buffer = *receive_buffers_[i];
+        buffer.reset();
+        iov[i].iov_base = buffer.writePtr();
+        iov[i].iov_len = buffer.capacity();
+        messages[i].msg_hdr.msg_name = &from[i];
+        messages[i].msg_hdr.msg_namelen = sizeof(from[i]);
+        messages[i].msg_hdr.msg_iov = &iov[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    int count = recvmmsg(socket_fd_, messages, RECV_BATCH, MSG_DONTWAIT, nullptr);
+    Metrics::add(Counter::SyscallRecvmmsg);
+    if (count <= 0) {
+        if (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            LOG_ERROR("UDP receive failed: " << strerror(errno));
+        }
+        return 0;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        if (messages[i].msg_hdr.msg_flags & MSG_TRUNC) {
+            // Larger than any pooled buffer, the tail is already lost
+            Metrics::add(Counter::DatagramsDropped);
+            continue;
+        }
+        MessageBuffer& buffer = *receive_buffers_[i];
+        buffer.commit(messages[i].msg_len);
+        Metrics::add(Counter::BytesReceived, messages[i].msg_len);
+        deliver(std::string_view(buffer.data(), buffer.size()), from[i]);
+    }
+    return static_cast<size_t>(count);
+}
+
+void UdpTransport::deliver(std::string_view datagram, const struct sockaddr_in& from) {
+    if (datagram.size() < TOKEN_SIZE) {
+        Metrics::add(Counter::DatagramsDropped);
+        return;
+    }
+    uint64_t token;
+    std::memcpy(&token, datagram.data(), TOKEN_SIZE);
+    token = be64toh(token);
+
+    std::shared_lock<std::shared_mutex> lock(sessions_mutex_);
+    auto it = sessions_.find(token);
+    if (it == sessions_.end()) {
+        // Stale session or a stray sender; never reveal which
+        Metrics::add(Counter::DatagramsDropped);
+        return;
+    }
+
+    // Replies follow the client to wherever its NAT mapped it last
+    ConnectionHandler* handler = it->second;
+    handler->setDatagramPeer(PeerAddress(from));
+    Metrics::add(Counter::DatagramsReceived);
+
+    try {
+        handler_(datagram.substr(TOKEN_SIZE), handler);
+    } catch (const std::exception& e) {
+        LOG_ERROR("Datagram handler failed for " << handler->getClientInfo() << ": " << e.what());
+    }
+}
+
+bool UdpTransport::flushSends() {
+    if (sending_.empty()) {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        sending_.swap(queued_);
+    }
+
+    size_t sent = 0;
+    while (sent < sending_.size()) {
+        struct mmsghdr messages[SEND_BATCH];
+        struct iovec iov[SEND_SEGMENTS];
+        size_t segments_per_message[SEND_BATCH];
+        union {
+            char buffer[CMSG_SPACE(sizeof(uint16_t))];
+            struct cmsghdr align;
+        } control[SEND_BATCH];
+
+        // One message per destination run; with GSO a run of equal-sized
+        // datagrams (the last may be shorter) becomes a single message
+        size_t message_count = 0;
+        size_t segment_count = 0;
+        size_t next = sent;
+        while (next < sending_.size() && message_count < SEND_BATCH && segment_count < SEND_SEGMENTS) {
+            const Outgoing& first = sending_[next];
+            size_t segment_size = first.buffer->size();
+            size_t segments = 0;
+            size_t bytes = 0;
+            do {
+                const Outgoing& outgoing = sending_[next + segments];
+                iov[segment_count + segments].iov_base = const_cast<char*>(outgoing.buffer->data());
+                iov[segment_count + segments].iov_len = outgoing.buffer->size();
+                bytes += outgoing.buffer->size();
+                ++segments;
+                if (outgoing.buffer->size() < segment_size) {
+                    break;      // Only the last segment may be shorter
+                }
+            } while (gso_enabled_ && segment_size > 0 && segment_size <= MAX_GSO_SEGMENT_SIZE &&
+                     next + segments < sending_.size() && segments < MAX_GSO_SEGMENTS &&
+                     segment_count + segments < SEND_SEGMENTS &&
+                     samePeer(sending_[next + segments].peer, first.peer) &&
+                     sending_[next + segments].buffer->size() <= segment_size &&
+                     sending_[next + segments].buffer->size() > 0 &&
+                     bytes + sending_[next + segments].buffer->size() <= MAX_GSO_BYTES);
+
+            struct msghdr& header = messages[message_count].msg_hdr;
+            std::memset(&header, 0, sizeof(header));
+            header.msg_name = const_cast<struct sockaddr_in*>(&first.peer);
+            header.msg_namelen = sizeof(first.peer);
+            header.msg_iov = &iov[segment_count];
+            header.msg_iovlen = segments;
+#ifdef UDP_SEGMENT
+            if (segments > 1) {
+                header.msg_control = control[message_count].buffer;
+                header.msg_controllen = sizeof(control[message_count].buffer);
+                struct cmsghdr* cmsg = CMSG_FIRSTHDR(&header);
+                cmsg->cmsg_level = IPPROTO_UDP;
+                cmsg->cmsg_type = UDP_SEGMENT;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                uint16_t gso_size = static_cast<uint16_t>(segment_size);
+                std::memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(gso_size));
+            }
+#endif
+            segments_per_message[message_count++] = segments;
+            segment_count += segments;
+            next += segments;
+        }
+
+        int count = sendmmsg(socket_fd_, messages, static_cast<unsigned int>(message_count), MSG_DONTWAIT);
+        Metrics::add(Counter::SyscallSendmmsg);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) {
+                // POLLOUT resumes the flush
+                releaseSent(sent);
+                return false;
+            }
+            if ((errno == EIO || errno == EINVAL) && segments_per_message[0] > 1) {
+                // No checksum offload on the route or a smaller MTU
+                LOG_WARN("UDP GSO refused (" << strerror(errno) << "), sending datagrams one by one");
+                gso_enabled_ = false;
+                continue;
+            }
+            // Refused for this destination (firewall, unreachable): drop it
+            LOG_DEBUG("UDP send failed: " << strerror(errno));
+            Metrics::add(Counter::DatagramsDropped, segments_per_message[0]);
+            sent += segments_per_message[0];
+            continue;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            for (size_t segment = 0; segment < segments_per_message[i]; ++segment) {
+                Metrics::add(Counter::BytesSent, sending_[sent + segment].buffer->size());
+            }
+            Metrics::add(Counter::DatagramsSent, segments_per_message[i]);
+            sent += segments_per_message[i];
+        }
+    }
+
+    releaseSent(sent);
+    return true;
+}
+
+void UdpTransport::releaseSent(size_t count) {
+    MessageBufferPool& pool = MessageBufferPool::getInstance();
+    for (size_t i = 0; i < count; ++i) {
+        pool.release(std::move(sending_[i].buffer));
+    }
+    sending_.erase(sending_.begin(), sending_.begin() + static_cast<std::ptrdiff_t>(count));
+}
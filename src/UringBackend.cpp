@@ -0,0 +1,787 @@
+#include "UringBackend.h"
+#include "Reactor.h"
+#include "Logger.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+UringBackend::UringBackend(Reactor& reactor)
+    : reactor_(reactor), ring_fd_(-1), enabled_(false),
+      ring_map_(nullptr), ring_map_size_(0),
+      sqes_(nullptr), sqes_size_(0), sq_head_(nullptr), sq_tail_(nullptr), sq_mask_(0),
+      sq_array_(nullptr), cq_head_(nullptr), cq_tail_(nullptr), cq_mask_(0), cqes_(nullptr),
+      sq_local_tail_(0), to_submit_(0),
+      buf_ring_(nullptr), buf_ring_size_(0), buffers_(nullptr), buf_tail_(0),
+      wake_fd_(-1) {
+}
+
+#ifdef HAVE_IO_URING
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint16_t BUFFER_GROUP = 0;
+constexpr unsigned OP_SHIFT = 56;
+constexpr uint64_t PAYLOAD_MASK = (uint64_t(1) << OP_SHIFT) - 1;
+
+// user_data: operation in the top byte, fd or Connection* below it
+uint64_t encode(uint64_t op, uint64_t payload) {
+    return (op << OP_SHIFT) | (payload & PAYLOAD_MASK);
+}
+
+// io_uring requests on an O_NONBLOCK socket fail with EAGAIN instead of
+// waiting, so only a TLS handshake, which OpenSSL drives with direct
+// reads and writes, runs with it set
+bool setNonBlocking(int fd, bool non_blocking) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags == -1) {
+        return false;
+    }
+    flags = non_blocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+    return fcntl(fd, F_SETFL, flags) != -1;
+}
+
+}
+
+UringBackend::~UringBackend() {
+    // Closing the ring cancels everything still in flight
+    if (ring_fd_ != -1) {
+        ::close(ring_fd_);
+    }
+    if (sqes_) {
+        munmap(sqes_, sqes_size_);
+    }
+    if (ring_map_) {
+        munmap(ring_map_, ring_map_size_);
+    }
+    if (buf_ring_) {
+        munmap(buf_ring_, buf_ring_size_);
+    }
+    if (buffers_) {
+        munmap(buffers_, size_t(RECV_BUFFER_COUNT) * RECV_BUFFER_SIZE);
+    }
+
+    // Released connections still waiting for completions
+    for (auto& conn : closing_) {
+        if (conn->owned) {
+            conn->owned->close();
+        }
+    }
+}
+
+bool UringBackend::init() {
+    return setupRing() && setupBuffers();
+}
+
+bool UringBackend::setupRing() {
+    struct io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+
+    // Completions are only processed inside our own io_uring_enter() on the
+    // reactor thread, which becomes the single issuer once run() enables the ring
+    params.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN |
+                   IORING_SETUP_R_DISABLED | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_CQSIZE;
+    params.cq_entries = RING_ENTRIES * 4;   // Multishot requests post many completions
+
+    ring_fd_ = static_cast<int>(syscall(__NR_io_uring_setup, RING_ENTRIES, &params));
+    if (ring_fd_ == -1) {
+        LOG_WARN("io_uring_setup failed: " << strerror(errno));
+        return false;
+    }
+
+    const uint32_t required = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+    if ((params.features & required) != required) {
+        LOG_WARN("io_uring lacks required features");
+        return false;
+    }
+
+    // One mapping serves both rings (IORING_FEAT_SINGLE_MMAP)
+    ring_map_size_ = std::max<size_t>(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                                      params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe));
+    void* rings = mmap(nullptr, ring_map_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       ring_fd_, IORING_OFF_SQ_RING);
+    if (rings == MAP_FAILED) {
+        LOG_WARN("Failed to map io_uring rings: " << strerror(errno));
+        return false;
+    }
+    ring_map_ = rings;
+
+    sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring_fd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        LOG_WARN("Failed to map io_uring SQEs: " << strerror(errno));
+        return false;
+    }
+    sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(ring_map_);
+    sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sq_local_tail_ = *sq_tail_;
+
+    // SQEs are used in ring order, so the indirection array stays the identity
+    for (unsigned i = 0; i <= sq_mask_; ++i) {
+        sq_array_[i] = i;
+    }
+
+    char* cq = static_cast<char*>(ring_map_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    return true;
+}
+
+bool UringBackend::setupBuffers() {
+    buf_ring_size_ = RECV_BUFFER_COUNT * sizeof(struct io_uring_buf);
+    void* ring = mmap(nullptr, buf_ring_size_, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED) {
+        LOG_WARN("Failed to allocate io_uring buffer ring: " << strerror(errno));
+        return false;
+    }
+    buf_ring_ = static_cast<struct io_uring_buf_ring*>(ring);
+
+    void* buffers = mmap(nullptr, size_t(RECV_BUFFER_COUNT) * RECV_BUFFER_SIZE,
+                         PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffers == MAP_FAILED) {
+        LOG_WARN("Failed to allocate io_uring receive buffers: " << strerror(errno));
+        return false;
+    }
+    buffers_ = static_cast<char*>(buffers);
+
+    struct io_uring_buf_reg reg;
+    std::memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring_);
+    reg.ring_entries = RECV_BUFFER_COUNT;
+    reg.bgid = BUFFER_GROUP;
+    if (syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) == -1) {
+        LOG_WARN("io_uring provided buffer rings unavailable: " << strerror(errno));
+        return false;
+    }
+
+    for (unsigned i = 0; i < RECV_BUFFER_COUNT; ++i) {
+        recycleBuffer(static_cast<uint16_t>(i));
+    }
+    return true;
+}
+
+struct io_uring_sqe* UringBackend::getSqe() {
+    unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    if (sq_local_tail_ - head > sq_mask_) {
+        // Full: hand what is queued to the kernel without waiting
+        if (!enabled_ || enter(to_submit_, 0, 0) < 0) {
+            return nullptr;
+        }
+        head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+        if (sq_local_tail_ - head > sq_mask_) {
+            return nullptr;
+        }
+    }
+
+    struct io_uring_sqe* sqe = &sqes_[sq_local_tail_ & sq_mask_];
+    std::memset(sqe, 0, sizeof(*sqe));
+    ++sq_local_tail_;
+    ++to_submit_;
+    return sqe;
+}
+
+int UringBackend::enter(unsigned to_submit, unsigned min_complete, int timeout_ms) {
+    __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+
+    unsigned flags = IORING_ENTER_GETEVENTS;
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    std::memset(&arg, 0, sizeof(arg));
+    if (min_complete > 0 && timeout_ms >= 0) {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = static_cast<long long>(timeout_ms % 1000) * 1000000;
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+    }
+    flags |= IORING_ENTER_EXT_ARG;
+
+    long ret = syscall(__NR_io_uring_enter, ring_fd_, to_submit, min_complete, flags,
+                       &arg, sizeof(arg));
+    Metrics::add(Counter::SyscallUringEnter);
+    int error = ret < 0 ? errno : 0;
+
+    // Whatever the kernel consumed is submitted, even if the wait failed
+    to_submit_ = sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+
+    if (ret < 0 && error != ETIME && error != EINTR && error != EBUSY && error != EAGAIN) {
+        return -error;
+    }
+    return 0;
+}
+
+bool UringBackend::addListener(int listen_fd) {
+    submitAccept(listen_fd);
+    return true;
+}
+
+void UringBackend::removeListener(int listen_fd) {
+    // Ends the multishot accept or the poll waiting to re-arm it; the
+    // detached listener is never re-armed
+    if (struct io_uring_sqe* sqe = getSqe()) {
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = listen_fd;
+        sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+        sqe->user_data = encode(OP_CANCEL, 0);
+    } else {
+        LOG_ERROR("Reactor " << reactor_.getId() << ": io_uring submission queue full, accept not cancelled");
+    }
+}
+
+bool UringBackend::addWakeFd(int wake_fd) {
+    wake_fd_ = wake_fd;
+    submitWakePoll();
+    return true;
+}
+
+bool UringBackend::addConnection(ConnectionHandle handle, ConnectionHandler* handler) {
+    size_t index = static_cast<uint32_t>(handle);
+    if (index >= connections_.size()) {
+        connections_.resize(std::max(index + 1, connections_.size() * 2));
+    }
+
+    auto conn = std::make_unique<Connection>();
+    conn->handle = handle;
+    conn->handler = handler;
+    // The handshake reads the socket itself, the multishot recv would
+    // swallow its records
+    if (handler->isHandshaking()) {
+        if (!setNonBlocking(handler->getClientFd(), true)) {
+            LOG_ERROR("Failed to make " << handler->getClientInfo() << " non-blocking: " << strerror(errno));
+            return false;
+        }
+        submitHandshakePoll(conn.get());
+    } else {
+        submitRecv(conn.get());
+    }
+    if (!conn->receiving && !conn->handshaking) {
+        return false;
+    }
+
+    connections_[index] = std::move(conn);
+    return true;
+}
+
+void UringBackend::removeConnection(ConnectionHandle handle, ConnectionHandler* handler) {
+    Connection* conn = lookup(handle);
+    if (!conn) {
+        return;
+    }
+
+    conn->closing = true;
+    recycleHeld(conn);
+    if (conn->inflight > 0) {
+        // Ends the multishot recv and any send still waiting for buffer space
+        if (struct io_uring_sqe* sqe = getSqe()) {
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = handler->getClientFd();
+            sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+            sqe->user_data = encode(OP_CANCEL, 0);
+        }
+    }
+
+    // The slot may be reused right away; this state lives on until the
+    // kernel has finished with it
+    closing_.push_back(std::move(connections_[static_cast<uint32_t>(handle)]));
+}
+
+void UringBackend::release(ConnectionHandle handle, std::unique_ptr<ConnectionHandler> handler) {
+    for (auto it = closing_.rbegin(); it != closing_.rend(); ++it) {
+        if ((*it)->handle == handle) {
+            (*it)->owned = std::move(handler);
+            return;
+        }
+    }
+    handler->close();
+}
+
+void UringBackend::write(ConnectionHandle handle, ConnectionHandler*) {
+    if (Connection* conn = lookup(handle)) {
+        submitSend(conn);
+    }
+}
+
+void UringBackend::requestWrite(ConnectionHandle handle, ConnectionHandler* handler) {
+    // The ring has a single issuer; other threads go through the reactor's mailbox
+    if (reactor_.inLoopThread()) {
+        write(handle, handler);
+        return;
+    }
+
+    reactor_.post([this, handle]() {
+        if (ConnectionHandler* handler = reactor_.connections_.get(handle)) {
+            write(handle, handler);
+        }
+    });
+}
+
+void UringBackend::writeBlockedChanged(ConnectionHandle, ConnectionHandler*) {
+    // Never reported: sends complete in the kernel, nothing to watch for
+}
+
+void UringBackend::resumeRead(ConnectionHandle handle, ConnectionHandler* handler) {
+    Connection* conn = lookup(handle);
+    if (!conn || conn->closing) {
+        return;
+    }
+
+    // Held bytes go first and may pause the connection again
+    size_t delivered = 0;
+    while (delivered < conn->held.size() && handler->isConnected()) {
+        const HeldBuffer& held = conn->held[delivered];
+        if (!handler->handleReceived(buffers_ + size_t(held.buffer_id) * RECV_BUFFER_SIZE, held.length)) {
+            break;
+        }
+        recycleBuffer(held.buffer_id);
+        ++delivered;
+    }
+    conn->held.erase(conn->held.begin(), conn->held.begin() + delivered);
+
+    // A recv still being cancelled re-arms itself when its last completion
+    // arrives; a disconnect is cleaned up by the caller's completion
+    if (conn->held.empty() && handler->isConnected() && !handler->isReadPaused() &&
+        !conn->receiving && !conn->handshaking) {
+        submitRecv(conn);
+    }
+}
+
+bool UringBackend::poll(int timeout_ms) {
+    if (!enabled_) {
+        // The thread that enables the ring becomes its only submitter
+        if (syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_ENABLE_RINGS, nullptr, 0) == -1) {
+            LOG_ERROR("Reactor " << reactor_.getId() << ": failed to enable io_uring: " << strerror(errno));
+            return false;
+        }
+        enabled_ = true;
+    }
+
+    // Submit everything queued since the last wait and sleep only if no
+    // completion is already waiting
+    unsigned ready = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE) - *cq_head_;
+    int result = enter(to_submit_, ready > 0 ? 0 : 1, timeout_ms);
+    if (result < 0) {
+        LOG_ERROR("Reactor " << reactor_.getId() << ": io_uring_enter error: " << strerror(-result));
+        return false;
+    }
+
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        struct io_uring_cqe cqe = cqes_[head & cq_mask_];
+        ++head;
+        // Free the slot before handling, which may queue more work
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+        handleCompletion(cqe);
+    }
+
+    reapClosed();
+    return true;
+}
+
+UringBackend::Connection* UringBackend::lookup(ConnectionHandle handle) const {
+    size_t index = static_cast<uint32_t>(handle);
+    if (index >= connections_.size() || !connections_[index] || connections_[index]->handle != handle) {
+        return nullptr;
+    }
+    return connections_[index].get();
+}
+
+void UringBackend::submitAccept(int listen_fd) {
+    struct io_uring_sqe* sqe = getSqe();
+    if (!sqe) {
+        LOG_ERROR("Reactor " << reactor_.getId() << ": io_uring submission queue full, accept not armed");
+        return;
+    }
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listen_fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = encode(OP_ACCEPT, static_cast<uint32_t>(listen_fd));
+}
+
+void UringBackend::submitWakePoll() {
+    struct io_uring_sqe* sqe = getSqe();
+    if (!sqe) {
+        LOG_ERROR("Reactor " << reactor_.getId() << ": io_uring submission queue full, wakeups not armed");
+        return;
+    }
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = wake_fd_;
+    sqe->poll32_events = POLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = encode(OP_WAKE, 0);
+}
+
+void UringBackend::submitListenPoll(int listen_fd) {
+    struct io_uring_sqe* sqe = getSqe();
+    if (!sqe) {
+        LOG_ERROR("Reactor " << reactor_.getId() << ": io_uring submission queue full, accept not armed");
+        return;
+    }
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = listen_fd;
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = encode(OP_LISTEN_POLL, static_cast<uint32_t>(listen_fd));
+}
+
+void UringBackend::submitRecv(Connection* conn) {
+    struct io_uring_sqe* sqe = getSqe();
+    if (!sqe) {
+        LOG_ERROR("io_uring submission queue full, receive not armed for "
+                  << conn->handler->getClientInfo());
+        return;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = conn->handler->getClientFd();
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUFFER_GROUP;
+    sqe->user_data = encode(OP_RECV, reinterpret_cast<uintptr_t>(conn));
+    conn->receiving = true;
+    ++conn->inflight;
+}
+
+void UringBackend::submitHandshakePoll(Connection* conn) {
+    struct io_uring_sqe* sqe = getSqe();
+    if (!sqe) {
+        LOG_ERROR("io_uring submission queue full, handshake not armed for "
+                  << conn->handler->getClientInfo());
+        return;
+    }
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = conn->handler->getClientFd();
+    // A flight that did not fit in the socket waits for it to drain
+    sqe->poll32_events = (conn->handler->isWriteBlocked() ? POLLOUT : POLLIN) | POLLRDHUP;
+    sqe->user_data = encode(OP_HANDSHAKE, reinterpret_cast<uintptr_t>(conn));
+    conn->handshaking = true;
+    ++conn->inflight;
+}
+
+void UringBackend::cancelRecv(Connection* conn) {
+    if (!conn->receiving || conn->recv_cancelled) {
+        return;
+    }
+
+    struct io_uring_sqe* sqe = getSqe();
+    if (!sqe) {
+        return; // Retried on the next completion
+    }
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = encode(OP_RECV, reinterpret_cast<uintptr_t>(conn));
+    sqe->user_data = encode(OP_CANCEL, 0);
+    conn->recv_cancelled = true;
+}
+
+void UringBackend::submitSend(Connection* conn) {
+    if (conn->sending || conn->closing) {
+        return; // The completion of the current send continues the flush
+    }
+
+    size_t count = conn->handler->prepareSend(conn->iov, SEND_BATCH);
+    if (count == 0) {
+        return;
+    }
+
+    struct io_uring_sqe* sqe = getSqe();
+    if (!sqe) {
+        LOG_ERROR("io_uring submission queue full, send deferred for "
+                  << conn->handler->getClientInfo());
+        return;
+    }
+
+    std::memset(&conn->msg, 0, sizeof(conn->msg));
+    conn->msg.msg_iov = conn->iov;
+    conn->msg.msg_iovlen = count;
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = conn->handler->getClientFd();
+    sqe->addr = reinterpret_cast<uint64_t>(&conn->msg);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    // The completion sends the rest right away, see handleWrite()
+    size_t gathered = 0;
+    for (size_t i = 0; i < count; ++i) {
+        gathered += conn->iov[i].iov_len;
+    }
+    if (count == SEND_BATCH && conn->handler->getQueuedBytes() > gathered) {
+        sqe->msg_flags |= MSG_MORE;
+    }
+    sqe->user_data = encode(OP_SEND, reinterpret_cast<uintptr_t>(conn));
+    conn->sending = true;
+    ++conn->inflight;
+}
+
+void UringBackend::recycleBuffer(uint16_t buffer_id) {
+    // Entries start at the ring base, overlapping the tail header. Indexed by
+    // hand because C++ places the header's flexible bufs[] member 8 bytes in
+    struct io_uring_buf& buf =
+        reinterpret_cast<struct io_uring_buf*>(buf_ring_)[buf_tail_ & (RECV_BUFFER_COUNT - 1)];
+    buf.addr = reinterpret_cast<uint64_t>(buffers_ + size_t(buffer_id) * RECV_BUFFER_SIZE);
+    buf.len = RECV_BUFFER_SIZE;
+    buf.bid = buffer_id;
+    ++buf_tail_;
+    __atomic_store_n(&buf_ring_->tail, buf_tail_, __ATOMIC_RELEASE);
+}
+
+void UringBackend::recycleHeld(Connection* conn) {
+    for (const HeldBuffer& held : conn->held) {
+        recycleBuffer(held.buffer_id);
+    }
+    conn->held.clear();
+}
+
+void UringBackend::handleCompletion(const struct io_uring_cqe& cqe) {
+    uint64_t payload = cqe.user_data & PAYLOAD_MASK;
+    bool more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+
+    switch (cqe.user_data >> OP_SHIFT) {
+        case OP_ACCEPT:
+            handleAccept(static_cast<int>(payload), cqe.res, more);
+            break;
+        case OP_WAKE:
+            if (!more) {
+                submitWakePoll();
+            }
+            // Posted tasks or connections handed back
+            reactor_.handleWakeup();
+            break;
+        case OP_RECV:
+            handleRecv(reinterpret_cast<Connection*>(payload), cqe.res, cqe.flags);
+            break;
+        case OP_SEND:
+            handleSend(reinterpret_cast<Connection*>(payload), cqe.res);
+            break;
+        case OP_LISTEN_POLL:
+            if (const Reactor::Listener* listener = reactor_.findListener(static_cast<int>(payload));
+                listener && !listener->detached) {
+                submitAccept(static_cast<int>(payload));
+            }
+            break;
+        case OP_HANDSHAKE:
+            handleHandshake(reinterpret_cast<Connection*>(payload), cqe.res);
+            break;
+        default:
+            break;
+    }
+}
+
+void UringBackend::handleAccept(int listen_fd, int result, bool more) {
+    const Reactor::Listener* listener = reactor_.findListener(listen_fd);
+    if (!listener) {
+        if (result >= 0) {
+            ::close(result);
+        }
+        return;
+    }
+
+    if (result == -EMFILE || result == -ENFILE) {
+        // io_uring reserves the descriptor before it looks at the backlog,
+        // so an accept re-armed now would fail again at once. Drop the
+        // waiting client and re-arm only when the next one arrives.
+        reactor_.rejectPendingConnection(listen_fd);
+        if (!more && !listener->detached) {
+            submitListenPoll(listen_fd);
+        }
+        return;
+    }
+
+    if (!more && !listener->detached) {
+        submitAccept(listen_fd); // The multishot accept ended, re-arm it
+    }
+
+    if (result < 0) {
+        if (result != -ECANCELED) {
+            LOG_ERROR("Failed to accept connection: " << strerror(-result));
+        }
+        return;
+    }
+
+    // Blocking is fine: io_uring never blocks the reactor on a socket and
+    // this connection is never read or written directly, except during a
+    // TLS handshake, which addConnection() makes non-blocking
+    struct sockaddr_in client_addr;
+    socklen_t client_len = sizeof(client_addr);
+    std::memset(&client_addr, 0, sizeof(client_addr));
+    getpeername(result, (struct sockaddr*)&client_addr, &client_len);
+    reactor_.addConnection(*listener, result, PeerAddress(client_addr));
+}
+
+void UringBackend::handleRecv(Connection* conn, int result, uint32_t flags) {
+    if (!(flags & IORING_CQE_F_MORE)) {
+        conn->receiving = false;
+        conn->recv_cancelled = false;
+        --conn->inflight;
+    }
+
+    if (flags & IORING_CQE_F_BUFFER) {
+        uint16_t buffer_id = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+        if (result > 0 && !conn->closing &&
+            (!conn->held.empty() ||
+             !conn->handler->handleReceived(buffers_ + size_t(buffer_id) * RECV_BUFFER_SIZE, result))) {
+            // No room while paused; kept behind any earlier held bytes
+            conn->held.push_back({buffer_id, static_cast<uint32_t>(result)});
+        } else {
+            recycleBuffer(buffer_id);
+        }
+    }
+
+    if (conn->closing) {
+        return;
+    }
+
+    ConnectionHandler* handler = conn->handler;
+    if (result == 0) {
+        handler->handleReceiveError(0);
+    } else if (result < 0 && result != -ENOBUFS && result != -ECANCELED) {
+        // ENOBUFS: every buffer was in use; they are back now, so just re-arm.
+        // ECANCELED: stopped for backpressure below.
+        handler->handleReceiveError(-result);
+    }
+
+    if (!handler->isConnected()) {
+        reactor_.cleanupConnection(conn->handle);
+        return;
+    }
+
+    // Backpressure stops the multishot recv; what is already in flight is
+    // still delivered and resumeRead() arms a new one
+    if (handler->isReadPaused()) {
+        cancelRecv(conn);
+    } else if (!conn->receiving) {
+        submitRecv(conn);
+    }
+
+    // Replies to what was just read go out with the next submission,
+    // or with the reactor's flush tick
+    if (handler->hasMessagesToSend() && handler->isFlushDue()) {
+        submitSend(conn);
+    }
+}
+
+void UringBackend::handleSend(Connection* conn, int result) {
+    conn->sending = false;
+    --conn->inflight;
+
+    if (conn->closing) {
+        return;
+    }
+
+    if (result == -EAGAIN || result == -EINTR) {
+        result = 0; // Nothing was sent, try again
+    }
+
+    if (result >= 0) {
+        size_t gathered = 0;
+        for (size_t i = 0; i < conn->msg.msg_iovlen; ++i) {
+            gathered += conn->iov[i].iov_len;
+        }
+        if (static_cast<size_t>(result) < gathered) {
+            Metrics::add(Counter::PartialWrites);
+        }
+    }
+
+    ConnectionHandler* handler = conn->handler;
+    handler->handleSent(result);
+
+    if (!handler->isConnected()) {
+        reactor_.cleanupConnection(conn->handle);
+        return;
+    }
+
+    if (handler->hasMessagesToSend()) {
+        submitSend(conn);
+    }
+}
+
+void UringBackend::handleHandshake(Connection* conn, int result) {
+    conn->handshaking = false;
+    --conn->inflight;
+
+    if (conn->closing) {
+        return;
+    }
+
+    ConnectionHandler* handler = conn->handler;
+    if (result < 0) {
+        handler->handleReceiveError(-result);
+    } else {
+        handler->continueHandshake();
+    }
+
+    if (!handler->isConnected()) {
+        reactor_.cleanupConnection(conn->handle);
+        return;
+    }
+
+    if (handler->isHandshaking()) {
+        submitHandshakePoll(conn);
+        return;
+    }
+
+    // kTLS carries the socket now; replies queued during the handshake go
+    // out with the next submission
+    if (!setNonBlocking(handler->getClientFd(), false)) {
+        LOG_ERROR("Failed to make " << handler->getClientInfo() << " blocking: " << strerror(errno));
+        handler->setDisconnected();
+        reactor_.cleanupConnection(conn->handle);
+        return;
+    }
+    submitRecv(conn);
+    if (handler->hasMessagesToSend() && handler->isFlushDue()) {
+        submitSend(conn);
+    }
+}
+
+void UringBackend::reapClosed() {
+    for (size_t i = 0; i < closing_.size();) {
+        Connection& conn = *closing_[i];
+        if (conn.inflight == 0 && conn.owned) {
+            conn.owned->close();
+            closing_[i] = std::move(closing_.back());
+            closing_.pop_back();
+        } else {
+            ++i;
+        }
+    }
+}
+
+#else // !HAVE_IO_URING
+
+// Built without io_uring headers: init() fails and the reactor uses epoll
+
+UringBackend::~UringBackend() = default;
+
+bool UringBackend::init() {
+    LOG_WARN("Built without io_uring support");
+    return false;
+}
+
+bool UringBackend::addListener(int) { return false; }
+void UringBackend::removeListener(int) {}
+bool UringBackend::addWakeFd(int) { return false; }
+bool UringBackend::addConnection(ConnectionHandle, ConnectionHandler*) { return false; }
+void UringBackend::removeConnection(ConnectionHandle, ConnectionHandler*) {}
+void UringBackend::release(ConnectionHandle, std::unique_ptr<ConnectionHandler> handler) { handler->close(); }
+void UringBackend::write(ConnectionHandle, ConnectionHandler*) {}
+void UringBackend::requestWrite(ConnectionHandle, ConnectionHandler*) {}
+void UringBackend::writeBlockedChanged(ConnectionHandle, ConnectionHandler*) {}
+void UringBackend::resumeRead(ConnectionHandle, ConnectionHandler*) {}
+bool UringBackend::poll(int) { return false; }
+
+#endif // HAVE_IO_URING
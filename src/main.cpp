@@ -1,174 +1,138 @@
 #include "NetworkServer.h"
+#include "ServerConfig.h"
+#include "Logger.h"
 #include <iostream>
-#include <string>
 #include <fstream>
-#include <sstream>
-#include <map>
+#include <string>
 #include <csignal>
 #include <atomic>
+#include <functional>
+#include <thread>
+#include <pthread.h>
 #include <unistd.h>
 
 // Global variables for signal handling
 std::atomic<bool> g_shutdown_requested(false);
-NetworkServer* g_server_instance = nullptr;
-
-// Signal handler function
-void signalHandler(int signal) {
-    const char* signal_name = "UNKNOWN";
-    
-    switch (signal) {
-        case SIGINT:
-            signal_name = "SIGINT (Ctrl+C)";
-            break;
-        case SIGTERM:
-            signal_name = "SIGTERM";
-            break;
-        case SIGUSR1:
-            signal_name = "SIGUSR1 (Background stop)";
-            break;
-#ifdef SIGQUIT
-        case SIGQUIT:
-            signal_name = "SIGQUIT";
-            break;
-#endif
-#ifdef SIGHUP
-        case SIGHUP:
-            signal_name = "SIGHUP";
-            break;
-#endif
-        default:
-            break;
-    }
-    
-    std::cout << "\nReceived signal " << signal << " (" << signal_name << ")" << std::endl;
-    std::cout << "Initiating graceful shutdown..." << std::endl;
-    
-    g_shutdown_requested.store(true);
-    
-    // If we have a server instance, stop it
-    if (g_server_instance) {
-        g_server_instance->stop();
-    }
-}
-
-// Function to register signal handlers
-void setupSignalHandlers() {
-    std::signal(SIGINT, signalHandler);   // Ctrl+C
-    std::signal(SIGTERM, signalHandler);  // Termination request
-    
-#ifdef SIGQUIT
-    std::signal(SIGQUIT, signalHandler);  // Quit signal (Ctrl+\)
-#endif
-
-#ifdef SIGHUP
-    std::signal(SIGHUP, signalHandler);   // Hangup signal
-#endif
+std::atomic<bool> g_server_done(false);
 
-    // For background processes, also handle SIGUSR1 for graceful shutdown
-    std::signal(SIGUSR1, signalHandler);  // User-defined signal 1
+namespace {
 
-    std::cout << "Signal handlers registered for graceful shutdown" << std::endl;
-    std::cout << "For background mode, use 'kill -SIGUSR1 <pid>' to stop server" << std::endl;
+// Signals the server reacts to. They are blocked in every thread and taken
+// by one thread with sigwait(), so stop() and reloadConfig() run in normal
+// thread context rather than inside a signal handler.
+sigset_t handledSignals() {
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);    // Ctrl+C
+    sigaddset(&signals, SIGTERM);   // Termination request
+    sigaddset(&signals, SIGQUIT);   // Quit signal (Ctrl+\)
+    sigaddset(&signals, SIGUSR1);   // Background stop
+    sigaddset(&signals, SIGHUP);    // Reload settings.config
+    return signals;
 }
 
-// Structure to hold configuration settings
-struct ServerConfig {
-    int port = 8080;
-    int max_connections = 1000;
-    int thread_count = 4;
-};
-
-// Function to read configuration from file
-ServerConfig readConfig(const std::string& filename) {
-    ServerConfig config;
-    std::ifstream file(filename);
-    
-    if (!file.is_open()) {
-        std::cout << "Config file '" << filename << "' not found. Using default values." << std::endl;
-        return config;
+const char* signalName(int signal) {
+    switch (signal) {
+        case SIGINT:  return "SIGINT (Ctrl+C)";
+        case SIGTERM: return "SIGTERM";
+        case SIGUSR1: return "SIGUSR1 (Background stop)";
+        case SIGQUIT: return "SIGQUIT";
+        default:      return "UNKNOWN";
     }
-    
-    std::string line;
-    while (std::getline(file, line)) {
-        // Skip empty lines and comments
-        if (line.empty() || line[0] == '#') {
+}
+
+// Runs until main() is done with the server and wakes it for the last time
+void handleSignals(NetworkServer& server, sigset_t signals) {
+    while (true) {
+        int signal = 0;
+        if (sigwait(&signals, &signal) != 0) {
             continue;
         }
-        
-        // Find the '=' separator
-        size_t pos = line.find('=');
-        if (pos == std::string::npos) {
-            continue; // Skip invalid lines
+        if (g_server_done.load()) {
+            return;
         }
-        
-        std::string key = line.substr(0, pos);
-        std::string value = line.substr(pos + 1);
-        
-        // Parse the configuration values
-        try {
-            if (key == "port") {
-                config.port = std::stoi(value);
-            } else if (key == "max_connections") {
-                config.max_connections = std::stoi(value);
-            } else if (key == "thread_count") {
-                config.thread_count = std::stoi(value);
+
+        if (signal == SIGHUP) {
+            std::cout << "Received SIGHUP, reloading settings.config" << std::endl;
+            // readConfig() falls back to defaults, which would silently
+            // reset the running settings
+            if (!std::ifstream("settings.config").is_open()) {
+                LOG_WARN("Cannot open settings.config, configuration reload skipped");
+                continue;
             }
-        } catch (const std::exception& e) {
-            std::cerr << "Warning: Invalid value for '" << key << "': " << value << std::endl;
+            server.reloadConfig(readConfig("settings.config"));
+            continue;
         }
+
+        std::cout << "\nReceived signal " << signal << " (" << signalName(signal) << ")" << std::endl;
+        std::cout << "Initiating graceful shutdown..." << std::endl;
+        g_shutdown_requested.store(true);
+        server.stop();
     }
-    
-    file.close();
-    std::cout << "Configuration loaded from '" << filename << "'" << std::endl;
-    return config;
 }
 
+// Owns the signal thread for the lifetime of one server
+class SignalThread {
+public:
+    SignalThread(NetworkServer& server, const sigset_t& signals)
+        : thread_(handleSignals, std::ref(server), signals) {}
+    ~SignalThread() {
+        g_server_done.store(true);
+        pthread_kill(thread_.native_handle(), SIGTERM);
+        thread_.join();
+    }
+
+private:
+    std::thread thread_;
+};
+
+} // namespace
+
 int main() {
-    // Setup signal handlers first
-    setupSignalHandlers();
-    
-    // Force stdout to be unbuffered for background execution
-    std::cout.setf(std::ios::unitbuf);
-    std::cerr.setf(std::ios::unitbuf);
+    // Block the handled signals before any thread exists, so every thread
+    // inherits the mask and only the signal thread receives them
+    sigset_t signals = handledSignals();
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
     
     // Load configuration from file
     ServerConfig config = readConfig("settings.config");
-    
-    // Use config values
-    int port = config.port;
-    int max_connections = config.max_connections;
-    int thread_count = config.thread_count;
+    Logger::getInstance().setLevel(config.log_level);
+    Logger::getInstance().flush();
     
     // Get process ID for background mode reference
     pid_t pid = getpid();
 
     std::cout << "Starting Network Server..." << std::endl;
     std::cout << "Process ID: " << pid << std::endl;
-    std::cout << "Port: " << port << std::endl;
-    std::cout << "Max connections: " << max_connections << std::endl;
-    std::cout << "Thread count: " << thread_count << std::endl;
+    std::cout << "Port: " << config.port << std::endl;
+    std::cout << "Max connections: " << config.max_connections << std::endl;
+    std::cout << "Thread count: " << config.thread_count << std::endl;
+    std::cout << "Reactor count: " << config.reactor_count << std::endl;
+    std::cout << "Log level: " << Logger::levelName(config.log_level) << std::endl;
     std::cout << "Configuration loaded from settings.config" << std::endl;
     std::cout << "Edit settings.config to modify server parameters" << std::endl;
     std::cout << "Press Ctrl+C to stop the server (foreground mode)" << std::endl;
     std::cout << "Use 'kill -SIGUSR1 " << pid << "' to stop server (background mode)" << std::endl;
+    std::cout << "Use 'kill -HUP " << pid << "' to reload settings.config" << std::endl;
     std::cout << "----------------------------------------" << std::endl;
     
     try {
-        NetworkServer server(port, max_connections, thread_count);
+        NetworkServer server(config);
         
-        // Set global server instance for signal handler
-        g_server_instance = &server;
+        // Signals reach the server from here on
+        SignalThread signal_thread(server, signals);
         
         // Set up custom message handler
         server.setMessageHandler([&server](const std::string& message, ConnectionHandler* handler) {
-            std::cout << "Received from " << handler->getClientInfo() 
-                      << ": " << message << std::endl;
+            LOG_DEBUG("Received from " << handler->getClientInfo() 
+                      << ": " << message);
             
             // Example: Echo the message back
             std::string response = "Server received: " + message;
             handler->sendMessage(response);
             
-            // Force epoll to monitor write events for this client
+            // Ask for the reply to be flushed; it is written inline, and
+            // EPOLLOUT is only watched if the socket buffer is full
             server.forceWriteEvent(handler->getClientFd());
             
             // Example: Broadcast to all clients (optional)
@@ -176,9 +140,11 @@ int main() {
         });
         
         if (!server.start()) {
+            Logger::getInstance().flush();
             std::cerr << "Failed to start server" << std::endl;
             return 1;
         }
+        Logger::getInstance().flush();
         
         std::cout << "TCP Server is running. Clients can send messages ending with '\\n'" << std::endl;
         std::cout << "Use TestClient to connect and send messages" << std::endl;
@@ -186,12 +152,12 @@ int main() {
         // Run the server
         server.run();
         
-        // Clear global server instance
-        g_server_instance = nullptr;
+        // Let queued log lines land before the final status
+        Logger::getInstance().flush();
         
     } catch (const std::exception& e) {
+        Logger::getInstance().flush();
         std::cerr << "Server error: " << e.what() << std::endl;
-        g_server_instance = nullptr;
         return 1;
     }
     
@@ -0,0 +1,1318 @@
+// Load generator for NetworkServer.
+//
+// Every thread drives its share of the connections from its own epoll loop.
+// Each connection follows a send schedule: with --rate, request i is due at
+// start + i * connections / rate, and its latency is measured from that
+// intended time rather than from when it actually went out. A stalled
+// server therefore shows up as latency instead of silently lowering the
+// offered load (coordinated omission).
+//
+//   closed  at most --pipeline requests in flight per connection; without
+//           --rate the next request goes out as soon as a reply arrives
+//   open    requests leave on schedule whatever is outstanding (--rate required)
+//
+// Results are printed and, with --json, written as one JSON object so runs
+// of different server modes can be compared.
+//
+//   replay  --replay feeds a traffic capture (capture_file) back instead:
+//           every captured connection is opened, fed its messages at the
+//           captured times (scaled by --speed; 0 = as fast as possible)
+//           and closed, and the send lag behind that schedule is reported
+
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "Framing.h"
+#include "TrafficCapture.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+uint64_t nowNs() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count());
+}
+
+struct Options {
+    std::string host = "127.0.0.1";
+    int port = 8080;
+    int connections = 100;
+    int threads = 0;                // 0 = hardware threads, at most connections
+    double duration = 10.0;         // Measured seconds, after warmup
+    double warmup = 2.0;
+    size_t message_size = 64;
+    int pipeline = 1;
+    double rate = 0.0;              // Requests per second over all connections, 0 = unthrottled
+    bool open_loop = false;
+    int max_inflight = 10000;       // Open-loop safety cap per connection
+    double drain_timeout = 2.0;     // Wait for outstanding replies after the run
+    FramingMode framing = FramingMode::Newline;
+    std::string json_path;
+    std::string label;
+    std::string replay_path;        // Capture to replay instead of generating load
+    double speed = 1.0;             // Replay pace: 1 = as captured, 0 = as fast as possible
+    int binary_port = 0;            // Replay: port for length-prefixed connections, 0 = --port
+};
+
+// Log-linear latency histogram in nanoseconds, 2^-SUB_BUCKET_BITS relative precision
+class LatencyHistogram {
+public:
+    static constexpr size_t SUB_BUCKET_BITS = 7;
+    static constexpr size_t SUB_BUCKETS = size_t(1) << SUB_BUCKET_BITS;
+    static constexpr size_t MAX_EXPONENT = 40;
+    static constexpr size_t BUCKET_COUNT = (MAX_EXPONENT - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+
+    LatencyHistogram() : counts_(BUCKET_COUNT, 0), total_(0), sum_(0), min_(UINT64_MAX), max_(0) {}
+
+    void record(uint64_t value, uint64_t count = 1) {
+        counts_[bucketIndex(value)] += count;
+        total_ += count;
+        sum_ += static_cast<double>(value) * static_cast<double>(count);
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+    }
+
+    // HdrHistogram's after-the-fact correction for a loop without a
+    // schedule: a request that took k expected intervals hid the k - 1
+    // requests that would have been sent meanwhile, with latencies
+    // stepping down by one interval each
+    LatencyHistogram corrected(uint64_t expected_interval) const {
+        LatencyHistogram result;
+        result.merge(*this);
+        if (expected_interval == 0) {
+            return result;
+        }
+        for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+            if (counts_[i] == 0) {
+                continue;
+            }
+            uint64_t value = std::min(bucketUpperBound(i), max_);
+            for (uint64_t missing = value; missing >= 2 * expected_interval; ) {
+                missing -= expected_interval;
+                result.record(missing, counts_[i]);
+            }
+        }
+        return result;
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+            counts_[i] += other.counts_[i];
+        }
+        total_ += other.total_;
+        sum_ += other.sum_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+
+    uint64_t count() const { return total_; }
+    uint64_t min() const { return total_ ? min_ : 0; }
+    uint64_t max() const { return max_; }
+    double mean() const { return total_ ? sum_ / static_cast<double>(total_) : 0.0; }
+
+    uint64_t percentile(double quantile) const {
+        if (total_ == 0) {
+            return 0;
+        }
+        uint64_t rank = static_cast<uint64_t>(std::ceil(quantile * static_cast<double>(total_)));
+        rank = std::max<uint64_t>(rank, 1);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+            seen += counts_[i];
+            if (seen >= rank) {
+                return std::min(bucketUpperBound(i), max_);
+            }
+        }
+        return max_;
+    }
+
+private:
+    std::vector<uint64_t> counts_;
+    uint64_t total_;
+    double sum_;
+    uint64_t min_;
+    uint64_t max_;
+
+    static size_t bucketIndex(uint64_t value) {
+        if (value < SUB_BUCKETS) {
+            return static_cast<size_t>(value);
+        }
+        size_t exponent = 63 - static_cast<size_t>(__builtin_clzll(value));
+        if (exponent > MAX_EXPONENT) {
+            return BUCKET_COUNT - 1;
+        }
+        size_t sub = static_cast<size_t>(value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+        return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+    }
+
+    static uint64_t bucketUpperBound(size_t index) {
+        size_t group = index / SUB_BUCKETS;
+        uint64_t sub = index % SUB_BUCKETS;
+        if (group == 0) {
+            return sub;
+        }
+        return ((SUB_BUCKETS + sub + 1) << (group - 1)) - 1;
+    }
+};
+
+struct Outstanding {
+    uint64_t intended;      // Scheduled send time
+    uint64_t issued;        // When it was actually written to the send buffer
+};
+
+struct Connection {
+    int fd = -1;
+    bool open = false;
+    bool write_watched = false;
+    bool scheduled = false;         // Has an entry in the timer heap
+    uint64_t next_send = 0;         // Intended time of the next request
+    std::string out;
+    size_t out_offset = 0;
+    std::string in;                 // Unparsed reply bytes (length-prefixed framing)
+    std::deque<Outstanding> inflight;
+};
+
+struct ThreadResult {
+    LatencyHistogram latency;       // From intended send time
+    LatencyHistogram uncorrected;   // From actual send time
+    uint64_t requests = 0;          // Issued in the measured window
+    uint64_t responses = 0;         // Replies to those requests
+    uint64_t errors = 0;            // Requests lost to connection errors
+    uint64_t timeouts = 0;          // Still unanswered after the drain timeout
+    uint64_t connect_failures = 0;
+    uint64_t sent_bytes = 0;
+    uint64_t received_bytes = 0;
+};
+
+class LoadThread {
+public:
+    LoadThread(const Options& options, int connection_count, const std::string& frame)
+        : options_(options), connections_(static_cast<size_t>(connection_count)), epoll_fd_(-1),
+          start_(0), warmup_end_(0), end_(0), frame_(frame) {
+        // Per-connection spacing so the whole run offers --rate in total
+        interval_ = options_.rate > 0 ? static_cast<uint64_t>(1e9 * options_.connections / options_.rate) : 0;
+        window_ = options_.open_loop ? static_cast<size_t>(options_.max_inflight)
+                                     : static_cast<size_t>(options_.pipeline);
+    }
+
+    ~LoadThread() {
+        for (auto& conn : connections_) {
+            if (conn.fd != -1) {
+                ::close(conn.fd);
+            }
+        }
+        if (epoll_fd_ != -1) {
+            ::close(epoll_fd_);
+        }
+    }
+
+    bool connectAll();
+    // Runs the schedule from start; first_index staggers the connections
+    void run(uint64_t start, size_t first_index);
+    const ThreadResult& result() const { return result_; }
+
+private:
+    using TimerEntry = std::pair<uint64_t, size_t>;
+
+    const Options& options_;
+    std::vector<Connection> connections_;
+    int epoll_fd_;
+    uint64_t start_;
+    uint64_t warmup_end_;
+    uint64_t end_;
+    uint64_t interval_;
+    size_t window_;
+    const std::string& frame_;
+    std::priority_queue<TimerEntry, std::vector<TimerEntry>, std::greater<TimerEntry>> timers_;
+    ThreadResult result_;
+
+    void pump(size_t index, uint64_t now);
+    void flush(Connection& conn);
+    void watchWrite(size_t index, bool watch);
+    void handleReadable(size_t index);
+    void complete(Connection& conn, uint64_t now);
+    void fail(Connection& conn);
+    size_t outstanding() const;
+};
+
+bool LoadThread::connectAll() {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ == -1) {
+        std::cerr << "epoll_create1: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(options_.port);
+    if (inet_pton(AF_INET, options_.host.c_str(), &address.sin_addr) != 1) {
+        std::cerr << "Invalid address: " << options_.host << std::endl;
+        return false;
+    }
+
+    for (size_t i = 0; i < connections_.size(); ++i) {
+        Connection& conn = connections_[i];
+        conn.fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (conn.fd == -1 || ::connect(conn.fd, (struct sockaddr*)&address, sizeof(address)) == -1) {
+            ++result_.connect_failures;
+            if (conn.fd != -1) {
+                ::close(conn.fd);
+                conn.fd = -1;
+            }
+            continue;
+        }
+
+        int one = 1;
+        setsockopt(conn.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        fcntl(conn.fd, F_SETFL, fcntl(conn.fd, F_GETFL, 0) | O_NONBLOCK);
+
+        struct epoll_event event = {};
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.u64 = i;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, conn.fd, &event);
+        conn.open = true;
+    }
+    return true;
+}
+
+void LoadThread::run(uint64_t start, size_t first_index) {
+    start_ = start;
+    warmup_end_ = start_ + static_cast<uint64_t>(options_.warmup * 1e9);
+    end_ = warmup_end_ + static_cast<uint64_t>(options_.duration * 1e9);
+
+    for (size_t i = 0; i < connections_.size(); ++i) {
+        Connection& conn = connections_[i];
+        if (!conn.open) {
+            continue;
+        }
+        // Stagger the schedules so the connections do not send in lockstep
+        size_t global_index = first_index + i;
+        conn.next_send = start_ + (interval_ ? interval_ * global_index / options_.connections : 0);
+        timers_.push({conn.next_send, i});
+        conn.scheduled = true;
+    }
+
+    struct epoll_event events[256];
+    uint64_t drain_deadline = end_ + static_cast<uint64_t>(options_.drain_timeout * 1e9);
+
+    while (true) {
+        uint64_t now = nowNs();
+        if (now >= end_ && (outstanding() == 0 || now >= drain_deadline)) {
+            break;
+        }
+
+        // Requests that came due
+        while (!timers_.empty() && timers_.top().first <= now) {
+            size_t index = timers_.top().second;
+            timers_.pop();
+            connections_[index].scheduled = false;
+            pump(index, now);
+        }
+
+        int timeout_ms = 10;
+        if (!timers_.empty()) {
+            uint64_t wait = timers_.top().first > now ? timers_.top().first - now : 0;
+            timeout_ms = static_cast<int>(std::min<uint64_t>((wait + 999999) / 1000000, 10));
+        }
+
+        int count = epoll_wait(epoll_fd_, events, 256, timeout_ms);
+        if (count == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "epoll_wait: " << strerror(errno) << std::endl;
+            break;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            size_t index = static_cast<size_t>(events[i].data.u64);
+            Connection& conn = connections_[index];
+            if (!conn.open) {
+                continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)) {
+                handleReadable(index);
+            }
+            if (conn.open && (events[i].events & EPOLLOUT)) {
+                flush(conn);
+                watchWrite(index, conn.out_offset < conn.out.size());
+            }
+        }
+    }
+
+    for (auto& conn : connections_) {
+        for (auto& request : conn.inflight) {
+            if (request.intended >= warmup_end_) {
+                ++result_.timeouts;
+            }
+        }
+    }
+}
+
+size_t LoadThread::outstanding() const {
+    size_t total = 0;
+    for (auto& conn : connections_) {
+        total += conn.inflight.size();
+    }
+    return total;
+}
+
+void LoadThread::pump(size_t index, uint64_t now) {
+    Connection& conn = connections_[index];
+    if (!conn.open) {
+        return;
+    }
+
+    // Issue everything that is due and fits the window
+    while (conn.next_send <= now && conn.next_send < end_ && conn.inflight.size() < window_) {
+        uint64_t intended = interval_ ? conn.next_send : now;
+        conn.inflight.push_back({intended, now});
+        conn.out += frame_;
+        if (intended >= warmup_end_) {
+            ++result_.requests;
+        }
+        conn.next_send = interval_ ? conn.next_send + interval_ : now;
+    }
+
+    flush(conn);
+    if (!conn.open) {
+        return;
+    }
+    watchWrite(index, conn.out_offset < conn.out.size());
+
+    // A full window is reopened by the next reply instead of a timer
+    if (interval_ && !conn.scheduled && conn.next_send < end_ && conn.inflight.size() < window_) {
+        timers_.push({conn.next_send, index});
+        conn.scheduled = true;
+    }
+}
+
+void LoadThread::flush(Connection& conn) {
+    while (conn.out_offset < conn.out.size()) {
+        ssize_t sent = send(conn.fd, conn.out.data() + conn.out_offset,
+                            conn.out.size() - conn.out_offset, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            fail(conn);
+            return;
+        }
+        conn.out_offset += static_cast<size_t>(sent);
+        result_.sent_bytes += static_cast<uint64_t>(sent);
+    }
+
+    if (conn.out_offset == conn.out.size()) {
+        conn.out.clear();
+        conn.out_offset = 0;
+    } else if (conn.out_offset > 65536) {
+        conn.out.erase(0, conn.out_offset);
+        conn.out_offset = 0;
+    }
+}
+
+void LoadThread::watchWrite(size_t index, bool watch) {
+    Connection& conn = connections_[index];
+    if (watch == conn.write_watched) {
+        return;
+    }
+    struct epoll_event event = {};
+    event.events = EPOLLIN | EPOLLRDHUP;
+    if (watch) {
+        event.events |= EPOLLOUT;
+    }
+    event.data.u64 = index;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, conn.fd, &event);
+    conn.write_watched = watch;
+}
+
+void LoadThread::handleReadable(size_t index) {
+    Connection& conn = connections_[index];
+    char buffer[65536];
+
+    while (conn.open) {
+        ssize_t received = recv(conn.fd, buffer, sizeof(buffer), 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (received <= 0) {
+            fail(conn);
+            return;
+        }
+        result_.received_bytes += static_cast<uint64_t>(received);
+        uint64_t now = nowNs();
+
+        if (options_.framing == FramingMode::Newline) {
+            // Replies never contain the delimiter, one per line
+            for (const char* p = buffer; (p = static_cast<const char*>(
+                     std::memchr(p, Framing::DELIMITER, buffer + received - p))); ++p) {
+                complete(conn, now);
+            }
+        } else {
+            conn.in.append(buffer, static_cast<size_t>(received));
+            size_t offset = 0;
+            while (true) {
+                size_t header_size = 0;
+                size_t payload_length = 0;
+                Framing::HeaderStatus status = Framing::decodeHeader(
+                    options_.framing, conn.in.data() + offset, conn.in.size() - offset,
+                    header_size, payload_length);
+                if (status == Framing::HeaderStatus::Invalid) {
+                    fail(conn);
+                    return;
+                }
+                if (status == Framing::HeaderStatus::NeedMore ||
+                    conn.in.size() - offset < header_size + payload_length) {
+                    break;
+                }
+                offset += header_size + payload_length;
+                complete(conn, now);
+            }
+            conn.in.erase(0, offset);
+        }
+
+        if (static_cast<size_t>(received) < sizeof(buffer)) {
+            break;
+        }
+    }
+
+    // Replies free window slots
+    if (conn.open) {
+        pump(index, nowNs());
+    }
+}
+
+void LoadThread::complete(Connection& conn, uint64_t now) {
+    if (conn.inflight.empty()) {
+        return; // Not a reply to us (heartbeat)
+    }
+    Outstanding request = conn.inflight.front();
+    conn.inflight.pop_front();
+
+    if (request.intended < warmup_end_ || request.intended >= end_) {
+        return;
+    }
+    ++result_.responses;
+    result_.latency.record(now - request.intended);
+    result_.uncorrected.record(now - request.issued);
+}
+
+void LoadThread::fail(Connection& conn) {
+    for (auto& request : conn.inflight) {
+        if (request.intended >= warmup_end_ && request.intended < end_) {
+            ++result_.errors;
+        }
+    }
+    conn.inflight.clear();
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, conn.fd, nullptr);
+    ::close(conn.fd);
+    conn.fd = -1;
+    conn.open = false;
+}
+
+// A capture written by the server (capture_file), mapped read-only. The
+// format is described in include/TrafficCapture.h.
+struct CaptureLog {
+    void* map = nullptr;
+    size_t map_size = 0;
+    const char* begin = nullptr;    // First record
+    const char* end = nullptr;
+    uint64_t records = 0;
+    uint64_t messages = 0;
+    uint64_t connections = 0;
+    uint64_t duration_ns = 0;       // Timestamp of the last record
+
+    ~CaptureLog() {
+        if (map) {
+            munmap(map, map_size);
+        }
+    }
+
+    // The record at cursor, nullptr where the log ends
+    const CaptureRecord* peek(const char* cursor) const {
+        if (static_cast<size_t>(end - cursor) < sizeof(CaptureRecord)) {
+            return nullptr;
+        }
+        const CaptureRecord* record = reinterpret_cast<const CaptureRecord*>(cursor);
+        if (record->size < sizeof(CaptureRecord) || record->size > static_cast<size_t>(end - cursor) ||
+            record->length > record->size - sizeof(CaptureRecord)) {
+            return nullptr;
+        }
+        return record;
+    }
+};
+
+bool mapCapture(const std::string& path, CaptureLog& log) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if (fd == -1 || fstat(fd, &info) == -1) {
+        std::cerr << "Cannot open capture " << path << ": " << strerror(errno) << std::endl;
+        if (fd != -1) {
+            ::close(fd);
+        }
+        return false;
+    }
+
+    log.map_size = static_cast<size_t>(info.st_size);
+    if (log.map_size >= sizeof(CaptureFileHeader)) {
+        log.map = mmap(nullptr, log.map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+    if (!log.map || log.map == MAP_FAILED) {
+        log.map = nullptr;
+        std::cerr << "Cannot map capture " << path << std::endl;
+        return false;
+    }
+
+    CaptureFileHeader header;
+    std::memcpy(&header, log.map, sizeof(header));
+    if (std::memcmp(header.magic, TrafficCapture::MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != TrafficCapture::VERSION || header.header_size < sizeof(header) ||
+        header.header_size > log.map_size) {
+        std::cerr << path << " is not a traffic capture of this version" << std::endl;
+        return false;
+    }
+    log.begin = static_cast<const char*>(log.map) + header.header_size;
+    log.end = static_cast<const char*>(log.map) + log.map_size;
+
+    // Trim to the last complete record once, so the threads need not check
+    const char* cursor = log.begin;
+    while (const CaptureRecord* record = log.peek(cursor)) {
+        ++log.records;
+        log.messages += record->type == static_cast<uint8_t>(CaptureRecordType::Message);
+        log.connections += record->type == static_cast<uint8_t>(CaptureRecordType::Open);
+        log.duration_ns = std::max(log.duration_ns, record->timestamp_ns);
+        cursor += record->size;
+    }
+    log.end = cursor;
+    return true;
+}
+
+struct ReplayConnection {
+    int fd = -1;
+    bool open = false;
+    bool closing = false;           // Closed in the capture, shut down once out is sent
+    bool shut = false;              // Write side shut down
+    bool write_watched = false;
+    FramingMode framing = FramingMode::Newline;
+    std::string out;
+    size_t out_offset = 0;
+};
+
+struct ReplayResult {
+    LatencyHistogram lag;           // Sent this long after the captured schedule
+    uint64_t connections = 0;
+    uint64_t messages = 0;
+    uint64_t skipped = 0;           // For a connection that failed or was not open
+    uint64_t connect_failures = 0;
+    uint64_t server_closes = 0;     // Closed by the server before the capture did
+    uint64_t sent_bytes = 0;
+    uint64_t received_bytes = 0;
+};
+
+// Replays the connections of one capture whose id falls to this thread,
+// each on its own socket. Every thread walks the whole log and skips the
+// records of other threads, so no record is copied or handed over.
+class ReplayThread {
+public:
+    ReplayThread(const Options& options, const CaptureLog& log, uint32_t index, uint32_t count)
+        : options_(options), log_(log), index_(index), count_(count), epoll_fd_(-1), open_count_(0) {}
+
+    ~ReplayThread() {
+        for (auto& conn : connections_) {
+            if (conn.fd != -1) {
+                ::close(conn.fd);
+            }
+        }
+        if (epoll_fd_ != -1) {
+            ::close(epoll_fd_);
+        }
+    }
+
+    bool init();
+    void run(uint64_t start);
+    const ReplayResult& result() const { return result_; }
+
+private:
+    // Records applied per loop iteration at full speed, so replies are
+    // still read while the log is fed in
+    static constexpr size_t RECORD_BUDGET = 1024;
+
+    const Options& options_;
+    const CaptureLog& log_;
+    uint32_t index_;
+    uint32_t count_;
+    int epoll_fd_;
+    size_t open_count_;
+    std::unordered_map<uint32_t, size_t> ids_;
+    std::vector<ReplayConnection> connections_;
+    ReplayResult result_;
+
+    void apply(const CaptureRecord& record, uint64_t now, uint64_t due);
+    void connect(uint32_t id, FramingMode framing);
+    void flush(size_t index);
+    void watchWrite(size_t index, bool watch);
+    void handleReadable(size_t index);
+    void closeConnection(size_t index);
+};
+
+bool ReplayThread::init() {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ == -1) {
+        std::cerr << "epoll_create1: " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void ReplayThread::run(uint64_t start) {
+    const char* cursor = log_.begin;
+    bool fed = false;
+    uint64_t drain_deadline = 0;
+    struct epoll_event events[256];
+
+    while (true) {
+        uint64_t now = nowNs();
+        uint64_t next_due = 0;
+
+        for (size_t budget = RECORD_BUDGET; !fed && budget > 0; ) {
+            const CaptureRecord* record = log_.peek(cursor);
+            if (!record) {
+                // The capture ended with these still open: close them as well
+                fed = true;
+                drain_deadline = now + static_cast<uint64_t>(options_.drain_timeout * 1e9);
+                for (size_t i = 0; i < connections_.size(); ++i) {
+                    if (connections_[i].open) {
+                        connections_[i].closing = true;
+                        flush(i);
+                    }
+                }
+                break;
+            }
+            if (record->connection % count_ != index_) {
+                cursor += record->size;
+                continue;
+            }
+            uint64_t due = options_.speed > 0
+                ? start + static_cast<uint64_t>(static_cast<double>(record->timestamp_ns) / options_.speed)
+                : now;
+            if (due > now) {
+                next_due = due;
+                break;
+            }
+            apply(*record, now, due);
+            cursor += record->size;
+            --budget;
+        }
+
+        if (fed && (open_count_ == 0 || now >= drain_deadline)) {
+            break;
+        }
+
+        int timeout_ms = 10;
+        if (!fed && options_.speed <= 0) {
+            timeout_ms = 0;
+        } else if (next_due) {
+            // Rounded down: the last millisecond before a record is polled
+            // rather than slept through, so the schedule is kept to the microsecond
+            timeout_ms = static_cast<int>(std::min<uint64_t>((next_due - now) / 1000000, 10));
+        }
+
+        int count = epoll_wait(epoll_fd_, events, 256, timeout_ms);
+        if (count == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "epoll_wait: " << strerror(errno) << std::endl;
+            break;
+        }
+        for (int i = 0; i < count; ++i) {
+            size_t index = static_cast<size_t>(events[i].data.u64);
+            if (!connections_[index].open) {
+                continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)) {
+                handleReadable(index);
+            }
+            if (connections_[index].open && (events[i].events & EPOLLOUT)) {
+                flush(index);
+            }
+        }
+    }
+}
+
+void ReplayThread::apply(const CaptureRecord& record, uint64_t now, uint64_t due) {
+    auto type = static_cast<CaptureRecordType>(record.type);
+    if (type == CaptureRecordType::Open) {
+        FramingMode framing = record.framing <= static_cast<uint8_t>(FramingMode::Varint)
+            ? static_cast<FramingMode>(record.framing) : FramingMode::Newline;
+        connect(record.connection, framing);
+        return;
+    }
+
+    auto found = ids_.find(record.connection);
+    if (found == ids_.end() || !connections_[found->second].open) {
+        result_.skipped += type == CaptureRecordType::Message;
+        return;
+    }
+    size_t index = found->second;
+    ReplayConnection& conn = connections_[index];
+
+    if (type == CaptureRecordType::Message) {
+        const char* payload = reinterpret_cast<const char*>(&record) + sizeof(CaptureRecord);
+        struct iovec parts[Framing::MAX_FRAME_PARTS];
+        char header[Framing::MAX_HEADER_SIZE];
+        size_t count = Framing::frameParts(conn.framing, payload, record.length, header, parts);
+        for (size_t i = 0; i < count; ++i) {
+            conn.out.append(static_cast<const char*>(parts[i].iov_base), parts[i].iov_len);
+        }
+        ++result_.messages;
+        if (options_.speed > 0) {
+            result_.lag.record(now - due);
+        }
+    } else if (type == CaptureRecordType::Close) {
+        conn.closing = true;
+    }
+    flush(index);
+}
+
+void ReplayThread::connect(uint32_t id, FramingMode framing) {
+    int port = framing != FramingMode::Newline && options_.binary_port > 0 ? options_.binary_port : options_.port;
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    inet_pton(AF_INET, options_.host.c_str(), &address.sin_addr);
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1 || ::connect(fd, (struct sockaddr*)&address, sizeof(address)) == -1) {
+        ++result_.connect_failures;
+        if (fd != -1) {
+            ::close(fd);
+        }
+        return;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+    size_t index = connections_.size();
+    connections_.emplace_back();
+    ReplayConnection& conn = connections_.back();
+    conn.fd = fd;
+    conn.open = true;
+    conn.framing = framing;
+    ids_[id] = index;
+    ++open_count_;
+    ++result_.connections;
+
+    struct epoll_event event = {};
+    event.events = EPOLLIN | EPOLLRDHUP;
+    event.data.u64 = index;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event);
+}
+
+void ReplayThread::flush(size_t index) {
+    ReplayConnection& conn = connections_[index];
+    while (conn.out_offset < conn.out.size()) {
+        ssize_t sent = send(conn.fd, conn.out.data() + conn.out_offset,
+                            conn.out.size() - conn.out_offset, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            ++result_.server_closes;
+            closeConnection(index);
+            return;
+        }
+        conn.out_offset += static_cast<size_t>(sent);
+        result_.sent_bytes += static_cast<uint64_t>(sent);
+    }
+
+    if (conn.out_offset == conn.out.size()) {
+        conn.out.clear();
+        conn.out_offset = 0;
+        // The server sees the close once everything before it arrived,
+        // and its reply to that ends the connection
+        if (conn.closing && !conn.shut) {
+            ::shutdown(conn.fd, SHUT_WR);
+            conn.shut = true;
+        }
+    } else if (conn.out_offset > 65536) {
+        conn.out.erase(0, conn.out_offset);
+        conn.out_offset = 0;
+    }
+    watchWrite(index, conn.out_offset < conn.out.size());
+}
+
+void ReplayThread::watchWrite(size_t index, bool watch) {
+    ReplayConnection& conn = connections_[index];
+    if (watch == conn.write_watched) {
+        return;
+    }
+    struct epoll_event event = {};
+    event.events = EPOLLIN | EPOLLRDHUP;
+    if (watch) {
+        event.events |= EPOLLOUT;
+    }
+    event.data.u64 = index;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, conn.fd, &event);
+    conn.write_watched = watch;
+}
+
+void ReplayThread::handleReadable(size_t index) {
+    ReplayConnection& conn = connections_[index];
+    char buffer[65536];
+
+    // Replies are counted, not parsed: a capture holds no answers to match
+    while (conn.open) {
+        ssize_t received = recv(conn.fd, buffer, sizeof(buffer), 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (received <= 0) {
+            if (!conn.shut) {
+                ++result_.server_closes;
+            }
+            closeConnection(index);
+            return;
+        }
+        result_.received_bytes += static_cast<uint64_t>(received);
+        if (static_cast<size_t>(received) < sizeof(buffer)) {
+            break;
+        }
+    }
+}
+
+void ReplayThread::closeConnection(size_t index) {
+    ReplayConnection& conn = connections_[index];
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, conn.fd, nullptr);
+    ::close(conn.fd);
+    conn.fd = -1;
+    conn.open = false;
+    conn.out.clear();
+    conn.out_offset = 0;
+    --open_count_;
+}
+
+std::string buildFrame(const Options& options) {
+    // Printable payload that never contains the newline delimiter
+    std::string payload(options.message_size, 'x');
+    for (size_t i = 0; i < payload.size(); ++i) {
+        payload[i] = static_cast<char>('a' + i % 26);
+    }
+
+    struct iovec parts[Framing::MAX_FRAME_PARTS];
+    char header[Framing::MAX_HEADER_SIZE];
+    size_t count = Framing::frameParts(options.framing, payload.data(), payload.size(), header, parts);
+    std::string frame;
+    for (size_t i = 0; i < count; ++i) {
+        frame.append(static_cast<const char*>(parts[i].iov_base), parts[i].iov_len);
+    }
+    return frame;
+}
+
+void appendLatency(std::string& out, const char* name, const LatencyHistogram& histogram) {
+    char text[512];
+    std::snprintf(text, sizeof(text),
+                  "\"%s\": {\"min\": %.3f, \"mean\": %.3f, \"p50\": %.3f, \"p90\": %.3f, "
+                  "\"p99\": %.3f, \"p999\": %.3f, \"max\": %.3f}",
+                  name, histogram.min() / 1e3, histogram.mean() / 1e3,
+                  histogram.percentile(0.5) / 1e3, histogram.percentile(0.9) / 1e3,
+                  histogram.percentile(0.99) / 1e3, histogram.percentile(0.999) / 1e3,
+                  histogram.max() / 1e3);
+    out += text;
+}
+
+std::string jsonEscape(const std::string& value) {
+    std::string out;
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out;
+}
+
+void printUsage(const char* program_name) {
+    std::cout << "Usage: " << program_name << " [options]" << std::endl;
+    std::cout << "  --host <ip>            Server address (default 127.0.0.1)" << std::endl;
+    std::cout << "  --port <n>             Server port (default 8080)" << std::endl;
+    std::cout << "  --connections <n>      Connections to open (default 100)" << std::endl;
+    std::cout << "  --threads <n>          Generator threads (default: hardware threads)" << std::endl;
+    std::cout << "  --duration <s>         Measured seconds (default 10)" << std::endl;
+    std::cout << "  --warmup <s>           Unmeasured seconds before that (default 2)" << std::endl;
+    std::cout << "  --size <bytes>         Message payload size (default 64)" << std::endl;
+    std::cout << "  --pipeline <n>         Closed loop: requests in flight per connection (default 1)" << std::endl;
+    std::cout << "  --rate <req/s>         Total request rate, 0 = as fast as replies allow (default 0)" << std::endl;
+    std::cout << "  --mode <closed|open>   Load model (default closed; open requires --rate)" << std::endl;
+    std::cout << "  --framing <mode>       newline, length32 or varint (default newline)" << std::endl;
+    std::cout << "  --json <file>          Write results as JSON ('-' for stdout)" << std::endl;
+    std::cout << "  --label <text>         Name of this run in the JSON output" << std::endl;
+    std::cout << "  --replay <file>        Replay a server traffic capture (capture_file) instead" << std::endl;
+    std::cout << "  --speed <factor>       Replay pace, 1 = as captured, 0 = full speed (default 1)" << std::endl;
+    std::cout << "  --binary-port <n>      Replay length-prefixed connections to this port (default --port)" << std::endl;
+    std::cout << std::endl;
+    std::cout << "Examples:" << std::endl;
+    std::cout << "  " << program_name << " --connections 1000 --pipeline 8 --duration 20" << std::endl;
+    std::cout << "  " << program_name << " --mode open --rate 200000 --connections 2000 --json run.json" << std::endl;
+    std::cout << "  " << program_name << " --replay capture.bin --speed 0 --json replay.json" << std::endl;
+}
+
+bool parseOptions(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            std::exit(0);
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+        std::string value = argv[++i];
+        try {
+            if (arg == "--host") {
+                options.host = value;
+            } else if (arg == "--port") {
+                options.port = std::stoi(value);
+            } else if (arg == "--connections") {
+                options.connections = std::stoi(value);
+            } else if (arg == "--threads") {
+                options.threads = std::stoi(value);
+            } else if (arg == "--duration") {
+                options.duration = std::stod(value);
+            } else if (arg == "--warmup") {
+                options.warmup = std::stod(value);
+            } else if (arg == "--size") {
+                options.message_size = std::stoul(value);
+            } else if (arg == "--pipeline") {
+                options.pipeline = std::stoi(value);
+            } else if (arg == "--rate") {
+                options.rate = std::stod(value);
+            } else if (arg == "--mode") {
+                if (value != "closed" && value != "open") {
+                    throw std::invalid_argument("unknown mode");
+                }
+                options.open_loop = value == "open";
+            } else if (arg == "--framing") {
+                if (!Framing::parseMode(value, options.framing)) {
+                    throw std::invalid_argument("unknown framing");
+                }
+            } else if (arg == "--json") {
+                options.json_path = value;
+            } else if (arg == "--label") {
+                options.label = value;
+            } else if (arg == "--replay") {
+                options.replay_path = value;
+            } else if (arg == "--speed") {
+                options.speed = std::stod(value);
+                if (options.speed < 0) {
+                    throw std::invalid_argument("negative speed");
+                }
+            } else if (arg == "--binary-port") {
+                options.binary_port = std::stoi(value);
+            } else {
+                std::cerr << "Unknown option " << arg << std::endl;
+                return false;
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Invalid value for " << arg << ": " << value << std::endl;
+            return false;
+        }
+    }
+
+    if (options.connections < 1 || options.pipeline < 1 || options.duration <= 0 || options.warmup < 0) {
+        std::cerr << "connections, pipeline and duration must be positive" << std::endl;
+        return false;
+    }
+    if (options.open_loop && options.rate <= 0) {
+        std::cerr << "Open-loop mode needs --rate" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// --replay: feed a capture back at its captured pace (scaled by --speed)
+// or as fast as possible, one socket per captured connection
+int runReplay(const Options& options) {
+    CaptureLog log;
+    if (!mapCapture(options.replay_path, log)) {
+        return 1;
+    }
+    uint32_t thread_count = static_cast<uint32_t>(
+        std::max<uint64_t>(1, std::min<uint64_t>(static_cast<uint64_t>(options.threads), log.connections)));
+
+    char pace[32] = "full speed";
+    if (options.speed > 0) {
+        std::snprintf(pace, sizeof(pace), "%gx speed", options.speed);
+    }
+    std::printf("Replaying %s: %llu messages on %llu connections over %.2fs, %s, %u threads\n",
+                options.replay_path.c_str(), static_cast<unsigned long long>(log.messages),
+                static_cast<unsigned long long>(log.connections), log.duration_ns / 1e9, pace, thread_count);
+
+    std::vector<std::unique_ptr<ReplayThread>> workers;
+    for (uint32_t t = 0; t < thread_count; ++t) {
+        workers.push_back(std::make_unique<ReplayThread>(options, log, t, thread_count));
+        if (!workers.back()->init()) {
+            return 1;
+        }
+    }
+
+    uint64_t start = nowNs();
+    std::vector<std::thread> threads;
+    for (auto& worker : workers) {
+        threads.emplace_back([&worker, start]() { worker->run(start); });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double elapsed = (nowNs() - start) / 1e9;
+
+    ReplayResult total;
+    for (auto& worker : workers) {
+        const ReplayResult& result = worker->result();
+        total.lag.merge(result.lag);
+        total.connections += result.connections;
+        total.messages += result.messages;
+        total.skipped += result.skipped;
+        total.connect_failures += result.connect_failures;
+        total.server_closes += result.server_closes;
+        total.sent_bytes += result.sent_bytes;
+        total.received_bytes += result.received_bytes;
+    }
+    double rate = elapsed > 0 ? total.messages / elapsed : 0.0;
+
+    std::printf("Replayed:    %llu messages on %llu connections in %.2fs (%.0f msg/s), %llu skipped, "
+                "%llu failed connects, %llu closed by the server\n",
+                static_cast<unsigned long long>(total.messages), static_cast<unsigned long long>(total.connections),
+                elapsed, rate, static_cast<unsigned long long>(total.skipped),
+                static_cast<unsigned long long>(total.connect_failures),
+                static_cast<unsigned long long>(total.server_closes));
+    std::printf("Throughput:  %.1f MB/s out, %.1f MB/s in\n",
+                total.sent_bytes / elapsed / 1e6, total.received_bytes / elapsed / 1e6);
+    if (options.speed > 0) {
+        std::printf("Send lag us: p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f (behind the captured schedule)\n",
+                    total.lag.percentile(0.5) / 1e3, total.lag.percentile(0.9) / 1e3,
+                    total.lag.percentile(0.99) / 1e3, total.lag.percentile(0.999) / 1e3, total.lag.max() / 1e3);
+    }
+
+    if (!options.json_path.empty()) {
+        std::string json = "{";
+        json += "\"label\": \"" + jsonEscape(options.label) + "\", ";
+        json += "\"mode\": \"replay\", ";
+        json += "\"capture\": \"" + jsonEscape(options.replay_path) + "\", ";
+        json += "\"speed\": " + std::to_string(options.speed) + ", ";
+        json += "\"threads\": " + std::to_string(thread_count) + ", ";
+        json += "\"captured_duration_s\": " + std::to_string(log.duration_ns / 1e9) + ", ";
+        json += "\"duration_s\": " + std::to_string(elapsed) + ", ";
+        json += "\"connections\": " + std::to_string(total.connections) + ", ";
+        json += "\"messages\": " + std::to_string(total.messages) + ", ";
+        json += "\"skipped\": " + std::to_string(total.skipped) + ", ";
+        json += "\"connect_failures\": " + std::to_string(total.connect_failures) + ", ";
+        json += "\"server_closes\": " + std::to_string(total.server_closes) + ", ";
+        json += "\"throughput_mps\": " + std::to_string(rate) + ", ";
+        json += "\"sent_bytes\": " + std::to_string(total.sent_bytes) + ", ";
+        json += "\"received_bytes\": " + std::to_string(total.received_bytes) + ", ";
+        appendLatency(json, "send_lag_us", total.lag);
+        json += "}\n";
+
+        if (options.json_path == "-") {
+            std::cout << json;
+        } else {
+            std::ofstream file(options.json_path);
+            file << json;
+            if (!file) {
+                std::cerr << "Failed to write " << options.json_path << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    return total.connect_failures > 0 && total.messages == 0 ? 1 : 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (options.threads <= 0) {
+        unsigned int cores = std::thread::hardware_concurrency();
+        options.threads = cores > 0 ? static_cast<int>(cores) : 1;
+    }
+    options.threads = std::min(options.threads, options.connections);
+
+    // Thousands of connections need more descriptors than the usual soft limit
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    if (!options.replay_path.empty()) {
+        return runReplay(options);
+    }
+
+    std::string frame = buildFrame(options);
+
+    // Connect everything first so setup stays out of the measurement, then
+    // start every thread's schedule at the same instant
+    std::vector<std::unique_ptr<LoadThread>> workers;
+    std::vector<std::thread> threads;
+    std::atomic<int> connected(0);
+    std::atomic<uint64_t> start(0);
+    size_t first_index = 0;
+
+    for (int t = 0; t < options.threads; ++t) {
+        int count = options.connections / options.threads + (t < options.connections % options.threads ? 1 : 0);
+        workers.push_back(std::make_unique<LoadThread>(options, count, frame));
+        threads.emplace_back([&, t, first_index]() {
+            if (!workers[t]->connectAll()) {
+                connected.fetch_add(1);
+                return;
+            }
+            connected.fetch_add(1);
+            uint64_t begin;
+            while ((begin = start.load()) == 0) {
+                std::this_thread::yield();
+            }
+            workers[t]->run(begin, first_index);
+        });
+        first_index += static_cast<size_t>(count);
+    }
+
+    while (connected.load() < options.threads) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    start.store(nowNs());
+
+    std::cout << "Running " << (options.open_loop ? "open" : "closed") << "-loop load: "
+              << options.connections << " connections, " << options.threads << " threads, "
+              << options.message_size << " byte messages, "
+              << (options.rate > 0 ? std::to_string(static_cast<long long>(options.rate)) + " req/s"
+                                   : "pipeline " + std::to_string(options.pipeline))
+              << ", " << options.warmup << "s warmup + " << options.duration << "s" << std::endl;
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    ThreadResult total;
+    for (auto& worker : workers) {
+        const ThreadResult& result = worker->result();
+        total.latency.merge(result.latency);
+        total.uncorrected.merge(result.uncorrected);
+        total.requests += result.requests;
+        total.responses += result.responses;
+        total.errors += result.errors;
+        total.timeouts += result.timeouts;
+        total.connect_failures += result.connect_failures;
+        total.sent_bytes += result.sent_bytes;
+        total.received_bytes += result.received_bytes;
+    }
+
+    double throughput = static_cast<double>(total.responses) / options.duration;
+
+    // With a schedule every latency already counts from its intended send
+    // time. Without one the send time is all we know, so the histogram is
+    // corrected against the mean interval between requests on one slot.
+    bool scheduled = options.rate > 0;
+    uint64_t expected_interval = 0;
+    if (!scheduled && throughput > 0) {
+        expected_interval = static_cast<uint64_t>(1e9 * options.connections * options.pipeline / throughput);
+    }
+    LatencyHistogram latency = total.latency.corrected(expected_interval);
+
+    std::printf("Requests:    %llu sent, %llu answered, %llu errors, %llu timed out, %llu failed connects\n",
+                static_cast<unsigned long long>(total.requests), static_cast<unsigned long long>(total.responses),
+                static_cast<unsigned long long>(total.errors), static_cast<unsigned long long>(total.timeouts),
+                static_cast<unsigned long long>(total.connect_failures));
+    double elapsed = options.warmup + options.duration;   // Bytes include the warmup
+    std::printf("Throughput:  %.0f req/s, %.1f MB/s in, %.1f MB/s out\n", throughput,
+                total.received_bytes / elapsed / 1e6, total.sent_bytes / elapsed / 1e6);
+    std::printf("Latency us:  p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f%s\n",
+                latency.percentile(0.5) / 1e3, latency.percentile(0.9) / 1e3,
+                latency.percentile(0.99) / 1e3, latency.percentile(0.999) / 1e3, latency.max() / 1e3,
+                scheduled ? " (from intended send time)" : " (corrected against the mean interval)");
+
+    if (!options.json_path.empty()) {
+        std::string json = "{";
+        json += "\"label\": \"" + jsonEscape(options.label) + "\", ";
+        json += "\"mode\": \"" + std::string(options.open_loop ? "open" : "closed") + "\", ";
+        json += "\"connections\": " + std::to_string(options.connections) + ", ";
+        json += "\"threads\": " + std::to_string(options.threads) + ", ";
+        json += "\"message_size\": " + std::to_string(options.message_size) + ", ";
+        json += "\"pipeline\": " + std::to_string(options.pipeline) + ", ";
+        json += "\"rate\": " + std::to_string(options.rate) + ", ";
+        json += "\"framing\": \"" + std::string(Framing::modeName(options.framing)) + "\", ";
+        json += "\"duration_s\": " + std::to_string(options.duration) + ", ";
+        json += "\"requests\": " + std::to_string(total.requests) + ", ";
+        json += "\"responses\": " + std::to_string(total.responses) + ", ";
+        json += "\"errors\": " + std::to_string(total.errors) + ", ";
+        json += "\"timeouts\": " + std::to_string(total.timeouts) + ", ";
+        json += "\"connect_failures\": " + std::to_string(total.connect_failures) + ", ";
+        json += "\"throughput_rps\": " + std::to_string(throughput) + ", ";
+        json += "\"sent_bytes\": " + std::to_string(total.sent_bytes) + ", ";
+        json += "\"received_bytes\": " + std::to_string(total.received_bytes) + ", ";
+        json += "\"correction\": \"" + std::string(scheduled ? "schedule" : "expected_interval") + "\", ";
+        json += "\"expected_interval_us\": " + std::to_string(expected_interval / 1e3) + ", ";
+        appendLatency(json, "latency_us", latency);
+        json += ", ";
+        appendLatency(json, "uncorrected_latency_us", total.uncorrected);
+        json += "}\n";
+
+        if (options.json_path == "-") {
+            std::cout << json;
+        } else {
+            std::ofstream file(options.json_path);
+            file << json;
+            if (!file) {
+                std::cerr << "Failed to write " << options.json_path << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    return total.connect_failures > 0 && total.responses == 0 ? 1 : 0;
+}
@@ -0,0 +1,99 @@
+#!/bin/bash
+# ===============================================
+# NetworkServer Benchmark Suite
+# ===============================================
+# Starts the server once per mode and runs the same LoadGenerator scenarios
+# against each, appending one JSON result per run to the output file.
+#
+# Usage:
+#   test/run_benchmarks.sh [build_dir] [output_file]
+#
+# Environment:
+#   MODES        Server modes to run (default "epoll multi-reactor io_uring")
+#   CONNECTIONS  Connections per scenario (default 1000)
+#   DURATION     Measured seconds per scenario (default 10)
+#   WARMUP       Warmup seconds per scenario (default 2)
+#   RATE         Open-loop request rate (default 100000)
+#   PORT         Server port (default 18080)
+#
+# Examples:
+#   test/run_benchmarks.sh build results.jsonl
+#   MODES="epoll io_uring" DURATION=5 test/run_benchmarks.sh
+# ===============================================
+
+BUILD_DIR="${1:-build}"
+OUTPUT="${2:-benchmark_results.jsonl}"
+MODES="${MODES:-epoll multi-reactor io_uring}"
+CONNECTIONS="${CONNECTIONS:-1000}"
+DURATION="${DURATION:-10}"
+WARMUP="${WARMUP:-2}"
+RATE="${RATE:-100000}"
+PORT="${PORT:-18080}"
+
+SERVER="$(cd "$BUILD_DIR" && pwd)/NetworkServer"
+LOADGEN="$(cd "$BUILD_DIR" && pwd)/LoadGenerator"
+if [ ! -x "$SERVER" ] || [ ! -x "$LOADGEN" ]; then
+    echo "ERROR: NetworkServer and LoadGenerator not found in $BUILD_DIR"
+    echo "Build first: cmake -S . -B $BUILD_DIR && cmake --build $BUILD_DIR"
+    exit 1
+fi
+
+# Scenarios: name and LoadGenerator arguments
+SCENARIOS=(
+    "closed-p1|--pipeline 1 --size 64"
+    "closed-p16|--pipeline 16 --size 64"
+    "closed-p16-1k|--pipeline 16 --size 1024"
+    "open-rate|--mode open --rate $RATE --size 64"
+)
+
+mode_settings() {
+    case "$1" in
+        epoll)         echo "reactor_count=1" ;;
+        multi-reactor) echo "reactor_count=0" ;;
+        io_uring)      printf 'reactor_count=0\nio_backend=io_uring\n' ;;
+        *)             return 1 ;;
+    esac
+}
+
+RUN_DIR=$(mktemp -d)
+trap 'kill $SERVER_PID 2>/dev/null; rm -rf "$RUN_DIR"' EXIT
+OUTPUT="$(cd "$(dirname "$OUTPUT")" && pwd)/$(basename "$OUTPUT")"
+
+for mode in $MODES; do
+    settings=$(mode_settings "$mode") || { echo "Unknown mode: $mode"; exit 1; }
+
+    # Quiet server: logging every connection would dominate the profile
+    cat > "$RUN_DIR/settings.config" <<EOF
+port=$PORT
+max_connections=$((CONNECTIONS * 2))
+idle_timeout=0
+log_level=warn
+$settings
+EOF
+
+    (cd "$RUN_DIR" && exec "$SERVER") > "$RUN_DIR/server-$mode.log" 2>&1 &
+    SERVER_PID=$!
+    sleep 1
+    if ! kill -0 $SERVER_PID 2>/dev/null; then
+        echo "ERROR: server failed to start in mode $mode:"
+        cat "$RUN_DIR/server-$mode.log"
+        exit 1
+    fi
+
+    for scenario in "${SCENARIOS[@]}"; do
+        name="${scenario%%|*}"
+        args="${scenario#*|}"
+        echo "=== $mode / $name ==="
+        rm -f "$RUN_DIR/result.json"
+        # shellcheck disable=SC2086
+        "$LOADGEN" --port "$PORT" --connections "$CONNECTIONS" --duration "$DURATION" \
+            --warmup "$WARMUP" --label "$mode/$name" --json "$RUN_DIR/result.json" $args
+        [ -f "$RUN_DIR/result.json" ] && cat "$RUN_DIR/result.json" >> "$OUTPUT"
+    done
+
+    kill -INT $SERVER_PID
+    wait $SERVER_PID 2>/dev/null
+done
+
+echo
+echo "Results appended to $OUTPUT"